@@ -30,6 +30,7 @@
 #include "winerror.h"
 #include "wingdi.h"
 #include "winuser.h"
+#include "winreg.h"
 #include "mmsystem.h"
 #include "winternl.h"
 #include "ddk/d3dkmthk.h"
@@ -3850,6 +3851,416 @@ static void test_GdiAlphaBlend(void)
     HeapFree(GetProcessHeap(), 0, bmi);
 }
 
+static DWORD blend_ref_pixel( DWORD dst, DWORD src, BLENDFUNCTION blend )
+{
+    DWORD i, s, d, alpha = blend.SourceConstantAlpha, ret = 0;
+
+    if (blend.AlphaFormat & AC_SRC_ALPHA)
+    {
+        DWORD src_alpha = ((src >> 24) * alpha + 127) / 255;
+
+        for (i = 0; i < 32; i += 8)
+        {
+            s = (((src >> i) & 0xff) * alpha + 127) / 255;
+            d = (((dst >> i) & 0xff) * (255 - src_alpha) + 127) / 255;
+            ret |= (s + d) << i;
+        }
+    }
+    else
+    {
+        for (i = 0; i < 32; i += 8)
+        {
+            s = (src >> i) & 0xff;
+            d = (dst >> i) & 0xff;
+            ret |= ((s * alpha + d * (255 - alpha) + 127) / 255) << i;
+        }
+    }
+    return ret;
+}
+
+static DWORD next_random( DWORD *seed )
+{
+    *seed = *seed * 1103515245 + 12345;
+    return *seed >> 8;
+}
+
+static void fill_random_pixels( DWORD *bits, int count, BOOL premultiplied, DWORD *seed )
+{
+    DWORD alpha, i;
+
+    while (count--)
+    {
+        *bits = next_random( seed );
+        if (premultiplied)
+        {
+            alpha = next_random( seed ) & 0xff;
+            *bits = alpha << 24;
+            for (i = 0; i < 24; i += 8) *bits |= (next_random( seed ) % (alpha + 1)) << i;
+        }
+        else *bits |= next_random( seed ) << 24;
+        bits++;
+    }
+}
+
+static unsigned int count_pixel_errors( const DWORD *bits, const DWORD *expect, unsigned int count, unsigned int *far )
+{
+    unsigned int i, errors = 0;
+
+    *far = 0;
+    for (i = 0; i < count; i++)
+    {
+        if (bits[i] == expect[i]) continue;
+        errors++;
+        if (abs( (int)(bits[i] & 0xff) - (int)(expect[i] & 0xff) ) > 1 ||
+            abs( (int)((bits[i] >> 8) & 0xff) - (int)((expect[i] >> 8) & 0xff) ) > 1 ||
+            abs( (int)((bits[i] >> 16) & 0xff) - (int)((expect[i] >> 16) & 0xff) ) > 1 ||
+            abs( (int)(bits[i] >> 24) - (int)(expect[i] >> 24) ) > 1)
+            (*far)++;
+    }
+    return errors;
+}
+
+/* Check the 32-bpp blending, fill and conversion primitives pixel by pixel, with widths and
+ * offsets that don't fit the vector sizes. */
+static void test_dib_primitives(void)
+{
+    static const BLENDFUNCTION blends[] =
+    {
+        { AC_SRC_OVER, 0, 255, AC_SRC_ALPHA },
+        { AC_SRC_OVER, 0, 0x99, AC_SRC_ALPHA },
+        { AC_SRC_OVER, 0, 0x40, 0 },
+    };
+    static const int size = 256;
+    BITMAPINFO info;
+    HBITMAP bmp_src, bmp_dst, old_src, old_dst;
+    HBRUSH brush, old_brush;
+    DWORD *src_bits, *dst_bits, *expect, seed = 1;
+    BYTE *bits_24;
+    HDC hdc_src, hdc_dst;
+    unsigned int i, x, width, errors, far;
+    int x_src, x_dst, ret;
+
+    if (!pGdiAlphaBlend)
+    {
+        win_skip( "GdiAlphaBlend() is not implemented\n" );
+        return;
+    }
+
+    memset( &info, 0, sizeof(info) );
+    info.bmiHeader.biSize = sizeof(info.bmiHeader);
+    info.bmiHeader.biWidth = size;
+    info.bmiHeader.biHeight = -size;
+    info.bmiHeader.biPlanes = 1;
+    info.bmiHeader.biBitCount = 32;
+    info.bmiHeader.biCompression = BI_RGB;
+
+    hdc_src = CreateCompatibleDC( 0 );
+    hdc_dst = CreateCompatibleDC( 0 );
+    bmp_src = CreateDIBSection( hdc_src, &info, DIB_RGB_COLORS, (void **)&src_bits, NULL, 0 );
+    ok( bmp_src != NULL, "failed to create source bitmap\n" );
+    bmp_dst = CreateDIBSection( hdc_dst, &info, DIB_RGB_COLORS, (void **)&dst_bits, NULL, 0 );
+    ok( bmp_dst != NULL, "failed to create destination bitmap\n" );
+    old_src = SelectObject( hdc_src, bmp_src );
+    old_dst = SelectObject( hdc_dst, bmp_dst );
+    expect = HeapAlloc( GetProcessHeap(), 0, size * sizeof(DWORD) );
+    bits_24 = HeapAlloc( GetProcessHeap(), 0, get_dib_stride( size, 24 ));
+
+    for (i = 0; i < ARRAY_SIZE(blends); i++)
+    {
+        for (width = 1; width <= 67; width++)
+        {
+            x_src = width % 5;
+            x_dst = width % 3;
+            fill_random_pixels( src_bits, size, blends[i].AlphaFormat & AC_SRC_ALPHA, &seed );
+            fill_random_pixels( dst_bits, size, FALSE, &seed );
+            memcpy( expect, dst_bits, size * sizeof(DWORD) );
+            for (x = 0; x < width; x++)
+                expect[x_dst + x] = blend_ref_pixel( expect[x_dst + x], src_bits[x_src + x], blends[i] );
+
+            ret = pGdiAlphaBlend( hdc_dst, x_dst, 0, width, 1, hdc_src, x_src, 0, width, 1, blends[i] );
+            ok( ret, "%u/%u: GdiAlphaBlend failed\n", i, width );
+            errors = count_pixel_errors( dst_bits, expect, size, &far );
+            ok( !far && (!errors || broken( errors )), "%u/%u: %u pixels differ, %u by more than 1\n",
+                i, width, errors, far );
+        }
+    }
+
+    brush = CreateSolidBrush( RGB( 0x12, 0x34, 0x56 ));
+    old_brush = SelectObject( hdc_dst, brush );
+    for (width = 1; width <= 67; width++)
+    {
+        x_dst = width % 3;
+        fill_random_pixels( dst_bits, size, FALSE, &seed );
+        memcpy( expect, dst_bits, size * sizeof(DWORD) );
+        for (x = 0; x < width; x++) expect[x_dst + x] ^= 0x123456;
+
+        PatBlt( hdc_dst, x_dst, 0, width, 1, PATINVERT );
+        errors = count_pixel_errors( dst_bits, expect, size, &far );
+        ok( !errors, "%u: %u pixels differ\n", width, errors );
+    }
+
+    info.bmiHeader.biBitCount = 24;
+    info.bmiHeader.biHeight = 1;
+    for (width = 1; width <= 67; width++)
+    {
+        info.bmiHeader.biWidth = width;
+        x_dst = width % 3;
+        for (x = 0; x < width * 3; x++) bits_24[x] = next_random( &seed );
+        fill_random_pixels( dst_bits, size, FALSE, &seed );
+        memcpy( expect, dst_bits, size * sizeof(DWORD) );
+        for (x = 0; x < width; x++)
+            expect[x_dst + x] = bits_24[3 * x] | (bits_24[3 * x + 1] << 8) | (bits_24[3 * x + 2] << 16);
+
+        ret = SetDIBitsToDevice( hdc_dst, x_dst, 0, width, 1, 0, 0, 0, 1, bits_24, &info, DIB_RGB_COLORS );
+        ok( ret == 1, "%u: SetDIBitsToDevice returned %d\n", width, ret );
+        errors = count_pixel_errors( dst_bits, expect, size, &far );
+        ok( !errors, "%u: %u pixels differ\n", width, errors );
+    }
+
+    SelectObject( hdc_dst, old_brush );
+    DeleteObject( brush );
+    SelectObject( hdc_src, old_src );
+    SelectObject( hdc_dst, old_dst );
+    DeleteObject( bmp_src );
+    DeleteObject( bmp_dst );
+    DeleteDC( hdc_src );
+    DeleteDC( hdc_dst );
+    HeapFree( GetProcessHeap(), 0, bits_24 );
+    HeapFree( GetProcessHeap(), 0, expect );
+}
+
+/* Check large stretches and blends, which may be split into bands processed by several
+ * threads, against results computed pixel by pixel. */
+static void test_large_blits(void)
+{
+    static const BLENDFUNCTION blend = { AC_SRC_OVER, 0, 0x99, AC_SRC_ALPHA };
+    static const int width = 1024, height = 768;
+    BITMAPINFO info;
+    HBITMAP bmp_src, bmp_dst, old_src, old_dst;
+    DWORD *src_bits, *dst_bits, *expect, seed = 1;
+    HDC hdc_src, hdc_dst;
+    unsigned int i, errors, far;
+    int x, y, ret;
+
+    if (!pGdiAlphaBlend)
+    {
+        win_skip( "GdiAlphaBlend() is not implemented\n" );
+        return;
+    }
+
+    memset( &info, 0, sizeof(info) );
+    info.bmiHeader.biSize = sizeof(info.bmiHeader);
+    info.bmiHeader.biWidth = width;
+    info.bmiHeader.biHeight = -height;
+    info.bmiHeader.biPlanes = 1;
+    info.bmiHeader.biBitCount = 32;
+    info.bmiHeader.biCompression = BI_RGB;
+
+    hdc_src = CreateCompatibleDC( 0 );
+    hdc_dst = CreateCompatibleDC( 0 );
+    bmp_src = CreateDIBSection( hdc_src, &info, DIB_RGB_COLORS, (void **)&src_bits, NULL, 0 );
+    ok( bmp_src != NULL, "failed to create source bitmap\n" );
+    bmp_dst = CreateDIBSection( hdc_dst, &info, DIB_RGB_COLORS, (void **)&dst_bits, NULL, 0 );
+    ok( bmp_dst != NULL, "failed to create destination bitmap\n" );
+    old_src = SelectObject( hdc_src, bmp_src );
+    old_dst = SelectObject( hdc_dst, bmp_dst );
+    expect = HeapAlloc( GetProcessHeap(), 0, width * height * sizeof(DWORD) );
+
+    /* doubling the size only replicates the pixels */
+    fill_random_pixels( src_bits, width * height, FALSE, &seed );
+    SetStretchBltMode( hdc_dst, COLORONCOLOR );
+    ret = StretchBlt( hdc_dst, 0, 0, width, height, hdc_src, 0, 0, width / 2, height / 2, SRCCOPY );
+    ok( ret, "StretchBlt failed\n" );
+    for (y = 0; y < height; y++)
+        for (x = 0; x < width; x++)
+            expect[y * width + x] = src_bits[(y / 2) * width + x / 2];
+    errors = count_pixel_errors( dst_bits, expect, width * height, &far );
+    ok( !errors, "COLORONCOLOR: %u pixels differ\n", errors );
+
+    /* halving the size of a picture made of 2x2 blocks of the same color returns the blocks */
+    for (y = 0; y < height; y++)
+        for (x = 0; x < width; x++)
+            src_bits[y * width + x] = expect[y * width + x] & 0xffffff;
+    memset( dst_bits, 0xcc, width * height * sizeof(DWORD) );
+    for (i = 0; i < width * height; i++) expect[i] = 0xcccccccc;
+    for (y = 0; y < height / 2; y++)
+        for (x = 0; x < width / 2; x++)
+            expect[y * width + x] = src_bits[2 * y * width + 2 * x];
+    SetStretchBltMode( hdc_dst, HALFTONE );
+    ret = StretchBlt( hdc_dst, 0, 0, width / 2, height / 2, hdc_src, 0, 0, width, height, SRCCOPY );
+    ok( ret, "StretchBlt failed\n" );
+    errors = count_pixel_errors( dst_bits, expect, width * height, &far );
+    ok( !far && (!errors || broken( errors )), "HALFTONE: %u pixels differ, %u by more than 1\n",
+        errors, far );
+
+    fill_random_pixels( src_bits, width * height, TRUE, &seed );
+    fill_random_pixels( dst_bits, width * height, FALSE, &seed );
+    for (i = 0; i < width * height; i++) expect[i] = blend_ref_pixel( dst_bits[i], src_bits[i], blend );
+    ret = pGdiAlphaBlend( hdc_dst, 0, 0, width, height, hdc_src, 0, 0, width, height, blend );
+    ok( ret, "GdiAlphaBlend failed\n" );
+    errors = count_pixel_errors( dst_bits, expect, width * height, &far );
+    ok( !far && (!errors || broken( errors )), "GdiAlphaBlend: %u pixels differ, %u by more than 1\n",
+        errors, far );
+
+    SelectObject( hdc_src, old_src );
+    SelectObject( hdc_dst, old_dst );
+    DeleteObject( bmp_src );
+    DeleteObject( bmp_dst );
+    DeleteDC( hdc_src );
+    DeleteDC( hdc_dst );
+    HeapFree( GetProcessHeap(), 0, expect );
+}
+
+#define BLIT_RESULT_WIDTH  1024
+#define BLIT_RESULT_HEIGHT 768
+#define BLIT_RESULT_COUNT  4
+
+/* run a fixed set of large blits, storing each destination bitmap in the results */
+static void run_large_blits( DWORD *results )
+{
+    static const BLENDFUNCTION blend = { AC_SRC_OVER, 0, 0x99, AC_SRC_ALPHA };
+    static const int width = BLIT_RESULT_WIDTH, height = BLIT_RESULT_HEIGHT;
+    BITMAPINFO info;
+    HBITMAP bmp_src, bmp_dst, old_src, old_dst;
+    DWORD *src_bits, *dst_bits, seed = 7;
+    HDC hdc_src, hdc_dst;
+    HRGN clip, hrgn;
+    int size = width * height * sizeof(DWORD);
+
+    memset( &info, 0, sizeof(info) );
+    info.bmiHeader.biSize = sizeof(info.bmiHeader);
+    info.bmiHeader.biWidth = width;
+    info.bmiHeader.biHeight = -height;
+    info.bmiHeader.biPlanes = 1;
+    info.bmiHeader.biBitCount = 32;
+    info.bmiHeader.biCompression = BI_RGB;
+
+    hdc_src = CreateCompatibleDC( 0 );
+    hdc_dst = CreateCompatibleDC( 0 );
+    bmp_src = CreateDIBSection( hdc_src, &info, DIB_RGB_COLORS, (void **)&src_bits, NULL, 0 );
+    bmp_dst = CreateDIBSection( hdc_dst, &info, DIB_RGB_COLORS, (void **)&dst_bits, NULL, 0 );
+    old_src = SelectObject( hdc_src, bmp_src );
+    old_dst = SelectObject( hdc_dst, bmp_dst );
+
+    fill_random_pixels( src_bits, width * height, TRUE, &seed );
+
+    memset( dst_bits, 0, size );
+    SetStretchBltMode( hdc_dst, COLORONCOLOR );
+    StretchBlt( hdc_dst, 0, 0, width, height, hdc_src, 3, 5, width / 3, height / 3, SRCCOPY );
+    memcpy( results, dst_bits, size );
+
+    memset( dst_bits, 0, size );
+    SetStretchBltMode( hdc_dst, HALFTONE );
+    StretchBlt( hdc_dst, 0, 0, width / 2, height / 2, hdc_src, 0, 0, width, height, SRCCOPY );
+    memcpy( results + width * height, dst_bits, size );
+
+    memset( dst_bits, 0, size );
+    StretchBlt( hdc_dst, 0, 0, width, height, hdc_src, 0, 0, width * 2 / 3, height * 2 / 3, SRCCOPY );
+    memcpy( results + 2 * width * height, dst_bits, size );
+
+    /* blend through a clip region made of several rectangles */
+    fill_random_pixels( dst_bits, width * height, FALSE, &seed );
+    clip = CreateRectRgn( 10, 10, width - 10, height / 3 );
+    hrgn = CreateRectRgn( 0, height / 2, width / 2, height );
+    CombineRgn( clip, clip, hrgn, RGN_OR );
+    DeleteObject( hrgn );
+    hrgn = CreateRectRgn( width / 2 + 20, height / 2 + 20, width, height );
+    CombineRgn( clip, clip, hrgn, RGN_OR );
+    DeleteObject( hrgn );
+    SelectClipRgn( hdc_dst, clip );
+    DeleteObject( clip );
+    if (pGdiAlphaBlend) pGdiAlphaBlend( hdc_dst, 0, 0, width, height, hdc_src, 0, 0, width, height, blend );
+    SelectClipRgn( hdc_dst, 0 );
+    memcpy( results + 3 * width * height, dst_bits, size );
+
+    SelectObject( hdc_src, old_src );
+    SelectObject( hdc_dst, old_dst );
+    DeleteObject( bmp_src );
+    DeleteObject( bmp_dst );
+    DeleteDC( hdc_src );
+    DeleteDC( hdc_dst );
+}
+
+static void test_blit_threads_child(void)
+{
+    static const char *names[BLIT_RESULT_COUNT] = { "COLORONCOLOR", "HALFTONE shrink", "HALFTONE grow", "GdiAlphaBlend" };
+    unsigned int count = BLIT_RESULT_WIDTH * BLIT_RESULT_HEIGHT, i, errors, far;
+    DWORD *expect, *results;
+    HANDLE mapping;
+
+    mapping = OpenFileMappingA( FILE_MAP_READ, FALSE, "winetest_bitmap_blit_results" );
+    ok( mapping != NULL, "OpenFileMapping failed, error %lu\n", GetLastError() );
+    if (!mapping) return;
+    expect = MapViewOfFile( mapping, FILE_MAP_READ, 0, 0, 0 );
+    results = HeapAlloc( GetProcessHeap(), 0, BLIT_RESULT_COUNT * count * sizeof(DWORD) );
+
+    run_large_blits( results );
+    for (i = 0; i < BLIT_RESULT_COUNT; i++)
+    {
+        errors = count_pixel_errors( results + i * count, expect + i * count, count, &far );
+        ok( !errors, "%s: %u pixels differ from the single-threaded result\n", names[i], errors );
+    }
+
+    HeapFree( GetProcessHeap(), 0, results );
+    UnmapViewOfFile( expect );
+    CloseHandle( mapping );
+}
+
+/* the blits split into bands for the worker threads must match the single-threaded ones */
+static void test_blit_threads( const char *argv0 )
+{
+    static const DWORD threads = 4;
+    PROCESS_INFORMATION info;
+    STARTUPINFOA startup;
+    char cmdline[MAX_PATH];
+    DWORD *results, prev, type, disposition, size = sizeof(prev);
+    HANDLE mapping;
+    HKEY key;
+    LONG ret;
+
+    /* the number of threads is a Wine setting */
+    if (strcmp( winetest_platform, "wine" ))
+    {
+        skip( "not running on Wine\n" );
+        return;
+    }
+
+    mapping = CreateFileMappingA( INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, 0,
+                                  BLIT_RESULT_COUNT * BLIT_RESULT_WIDTH * BLIT_RESULT_HEIGHT * sizeof(DWORD),
+                                  "winetest_bitmap_blit_results" );
+    ok( mapping != NULL, "CreateFileMapping failed, error %lu\n", GetLastError() );
+    if (!mapping) return;
+    results = MapViewOfFile( mapping, FILE_MAP_WRITE, 0, 0, 0 );
+    run_large_blits( results );
+
+    ret = RegCreateKeyExA( HKEY_CURRENT_USER, "Software\\Wine\\Gdi", 0, NULL, 0, KEY_ALL_ACCESS, NULL,
+                           &key, &disposition );
+    ok( !ret, "RegCreateKeyEx failed, error %ld\n", ret );
+    if (!ret)
+    {
+        if (RegQueryValueExA( key, "BlitThreads", NULL, &type, (BYTE *)&prev, &size ) || type != REG_DWORD)
+            size = 0;
+        RegSetValueExA( key, "BlitThreads", 0, REG_DWORD, (const BYTE *)&threads, sizeof(threads) );
+
+        memset( &startup, 0, sizeof(startup) );
+        startup.cb = sizeof(startup);
+        sprintf( cmdline, "%s bitmap blit_threads", argv0 );
+        ok( CreateProcessA( NULL, cmdline, NULL, NULL, FALSE, 0, NULL, NULL, &startup, &info ),
+            "CreateProcess failed, error %lu\n", GetLastError() );
+        wait_child_process( info.hProcess );
+        CloseHandle( info.hProcess );
+        CloseHandle( info.hThread );
+
+        if (size) RegSetValueExA( key, "BlitThreads", 0, REG_DWORD, (const BYTE *)&prev, sizeof(prev) );
+        else RegDeleteValueA( key, "BlitThreads" );
+        RegCloseKey( key );
+        if (disposition == REG_CREATED_NEW_KEY) RegDeleteKeyA( HKEY_CURRENT_USER, "Software\\Wine\\Gdi" );
+    }
+
+    UnmapViewOfFile( results );
+    CloseHandle( mapping );
+}
+
 static void test_GdiGradientFill(void)
 {
     HDC hdc;
@@ -5978,6 +6389,8 @@ static void test_D3DKMTCreateDCFromMemory( void )
 START_TEST(bitmap)
 {
     HMODULE hdll;
+    char **argv;
+    int argc;
 
     hdll = GetModuleHandleA("gdi32.dll");
     pD3DKMTCreateDCFromMemory  = (void *)GetProcAddress( hdll, "D3DKMTCreateDCFromMemory" );
@@ -5985,6 +6398,13 @@ START_TEST(bitmap)
     pGdiAlphaBlend             = (void *)GetProcAddress( hdll, "GdiAlphaBlend" );
     pGdiGradientFill           = (void *)GetProcAddress( hdll, "GdiGradientFill" );
 
+    argc = winetest_get_mainargs( &argv );
+    if (argc >= 3 && !strcmp( argv[2], "blit_threads" ))
+    {
+        test_blit_threads_child();
+        return;
+    }
+
     test_createdibitmap();
     test_dibsections();
     test_dib_formats();
@@ -6005,6 +6425,9 @@ START_TEST(bitmap)
     test_StretchBlt();
     test_StretchDIBits();
     test_GdiAlphaBlend();
+    test_dib_primitives();
+    test_large_blits();
+    test_blit_threads( argv[0] );
     test_GdiGradientFill();
     test_32bit_ddb();
     test_bitmapinfoheadersize();
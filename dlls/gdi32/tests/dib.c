@@ -3529,11 +3529,90 @@ static void test_simple_graphics(void)
     DeleteDC(mem_dc);
 }
 
+static void test_glyph_runs(void)
+{
+    static const char str[] = "WMQ@#%&gjpqy|}~ABCDEFGHIJKLMNOPRSTUVXYZ";
+    static const BYTE qualities[] = { NONANTIALIASED_QUALITY, ANTIALIASED_QUALITY, CLEARTYPE_QUALITY };
+    static const int heights[] = { -12, -40, -131 };
+    INT dx[ARRAY_SIZE(str) - 1];
+    BITMAPINFO bmi;
+    HBITMAP dib, orig_bm;
+    HFONT font, orig_font;
+    LOGFONTA lf;
+    DWORD *bits, *ref;
+    SIZE sz;
+    HDC hdc;
+    int i, j, k, x, size;
+    BOOL ret;
+
+    memset( &bmi, 0, sizeof(bmi) );
+    bmi.bmiHeader.biSize = sizeof(bmi.bmiHeader);
+    bmi.bmiHeader.biWidth = 1000;
+    bmi.bmiHeader.biHeight = -200;
+    bmi.bmiHeader.biBitCount = 32;
+    bmi.bmiHeader.biPlanes = 1;
+    bmi.bmiHeader.biCompression = BI_RGB;
+    size = 1000 * 200 * sizeof(DWORD);
+
+    hdc = CreateCompatibleDC( NULL );
+    dib = CreateDIBSection( 0, &bmi, DIB_RGB_COLORS, (void **)&bits, NULL, 0 );
+    ok( dib != NULL, "CreateDIBSection failed\n" );
+    orig_bm = SelectObject( hdc, dib );
+    ref = HeapAlloc( GetProcessHeap(), 0, size );
+
+    SetTextColor( hdc, RGB(0x20, 0x40, 0x80) );
+    SetBkMode( hdc, TRANSPARENT );
+
+    for (i = 0; i < ARRAY_SIZE(qualities); i++)
+    {
+        for (j = 0; j < ARRAY_SIZE(heights); j++)
+        {
+            memset( &lf, 0, sizeof(lf) );
+            lf.lfHeight = heights[j];
+            lf.lfQuality = qualities[i];
+            lf.lfPitchAndFamily = FF_SWISS;
+            font = CreateFontIndirectA( &lf );
+            orig_font = SelectObject( hdc, font );
+
+            /* glyphs far enough apart not to overlap, and glyphs overlapping their neighbours */
+            for (k = 0; k < ARRAY_SIZE(dx); k++)
+            {
+                GetTextExtentPoint32A( hdc, str + k, 1, &sz );
+                dx[k] = (k % 8 < 4) ? sz.cx + 2 : sz.cx / 2;
+            }
+
+            /* draw the glyphs one at a time */
+            memset( bits, 0xcc, size );
+            for (k = x = 0; k < ARRAY_SIZE(dx); x += dx[k++])
+            {
+                ret = ExtTextOutA( hdc, 5 + x, 5, 0, NULL, str + k, 1, NULL );
+                ok( ret, "ExtTextOutA failed\n" );
+            }
+            memcpy( ref, bits, size );
+
+            /* and the whole string at once */
+            memset( bits, 0xcc, size );
+            ret = ExtTextOutA( hdc, 5, 5, 0, NULL, str, ARRAY_SIZE(dx), dx );
+            ok( ret, "ExtTextOutA failed\n" );
+            ok( !memcmp( bits, ref, size ), "quality %u height %d: string drawn differently\n",
+                qualities[i], heights[j] );
+
+            DeleteObject( SelectObject( hdc, orig_font ));
+        }
+    }
+
+    HeapFree( GetProcessHeap(), 0, ref );
+    SelectObject( hdc, orig_bm );
+    DeleteObject( dib );
+    DeleteDC( hdc );
+}
+
 START_TEST(dib)
 {
     CryptAcquireContextW(&crypt_prov, NULL, NULL, PROV_RSA_FULL, CRYPT_VERIFYCONTEXT);
 
     test_simple_graphics();
+    test_glyph_runs();
 
     CryptReleaseContext(crypt_prov, 0);
 }
@@ -7715,6 +7715,173 @@ static void test_select_object(void)
     DeleteObject(hfont);
 }
 
+struct child_result
+{
+    DWORD checksum;
+    DWORD count;
+};
+
+/* render a range of glyphs, the result is shared with the parent process */
+static void test_glyph_cache_child(void)
+{
+    static const MAT2 mat = { {0,1}, {0,0}, {0,0}, {0,1} };
+    struct child_result *result;
+    DWORD size, i, j;
+    GLYPHMETRICS gm;
+    HANDLE mapping;
+    HFONT hfont, old_font;
+    LOGFONTA lf;
+    BYTE *buf;
+    HDC hdc;
+
+    mapping = OpenFileMappingA( FILE_MAP_WRITE, FALSE, "winetest_font_child_result" );
+    ok( mapping != NULL, "OpenFileMapping failed, error %lu\n", GetLastError() );
+    result = MapViewOfFile( mapping, FILE_MAP_WRITE, 0, 0, sizeof(*result) );
+    ok( result != NULL, "MapViewOfFile failed, error %lu\n", GetLastError() );
+
+    memset( &lf, 0, sizeof(lf) );
+    strcpy( lf.lfFaceName, "Tahoma" );
+    lf.lfHeight = -32;
+    lf.lfQuality = ANTIALIASED_QUALITY;
+    hfont = CreateFontIndirectA( &lf );
+    hdc = GetDC( 0 );
+    old_font = SelectObject( hdc, hfont );
+
+    result->checksum = 0;
+    result->count = 0;
+    for (i = 0; i < 2000; i++)
+    {
+        size = GetGlyphOutlineA( hdc, i, GGO_GLYPH_INDEX | GGO_GRAY8_BITMAP, &gm, 0, NULL, &mat );
+        if (size == GDI_ERROR) continue;
+        result->checksum = result->checksum * 31 + gm.gmBlackBoxX * 7 + gm.gmBlackBoxY * 13 +
+                           gm.gmptGlyphOrigin.x * 17 + gm.gmptGlyphOrigin.y * 19 + gm.gmCellIncX;
+        result->count++;
+        if (!size) continue;
+        buf = HeapAlloc( GetProcessHeap(), 0, size );
+        size = GetGlyphOutlineA( hdc, i, GGO_GLYPH_INDEX | GGO_GRAY8_BITMAP, &gm, size, buf, &mat );
+        ok( size != GDI_ERROR, "GetGlyphOutlineA failed for glyph %lu\n", i );
+        for (j = 0; size != GDI_ERROR && j < size; j++) result->checksum = result->checksum * 31 + buf[j];
+        HeapFree( GetProcessHeap(), 0, buf );
+    }
+
+    SelectObject( hdc, old_font );
+    DeleteObject( hfont );
+    ReleaseDC( 0, hdc );
+    UnmapViewOfFile( result );
+    CloseHandle( mapping );
+}
+
+static void run_child( const char *argv0, const char *test )
+{
+    PROCESS_INFORMATION info;
+    STARTUPINFOA startup;
+    char cmdline[MAX_PATH];
+
+    memset( &startup, 0, sizeof(startup) );
+    startup.cb = sizeof(startup);
+    sprintf( cmdline, "%s font %s", argv0, test );
+    ok( CreateProcessA( NULL, cmdline, NULL, NULL, FALSE, 0, NULL, NULL, &startup, &info ),
+        "CreateProcess failed.\n" );
+    wait_child_process( info.hProcess );
+    CloseHandle( info.hProcess );
+    CloseHandle( info.hThread );
+}
+
+/* the glyphs rendered by a process are reused by the next ones through the persistent cache */
+static void test_glyph_cache( const char *argv0 )
+{
+    struct child_result *result, cold;
+    HANDLE mapping;
+
+    if (!is_truetype_font_installed( "Tahoma" ))
+    {
+        skip( "Tahoma is not installed\n" );
+        return;
+    }
+
+    mapping = CreateFileMappingA( INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, 0, sizeof(*result),
+                                  "winetest_font_child_result" );
+    ok( mapping != NULL, "CreateFileMapping failed, error %lu\n", GetLastError() );
+    result = MapViewOfFile( mapping, FILE_MAP_WRITE, 0, 0, sizeof(*result) );
+
+    /* start from an empty cache, the file doesn't exist on Windows */
+    DeleteFileA( "C:\\windows\\temp\\wine_glyphcache.dat" );
+
+    run_child( argv0, "glyph_cache" );
+    cold = *result;
+    run_child( argv0, "glyph_cache" );
+    ok( cold.count > 0, "no glyph rendered\n" );
+    ok( result->count == cold.count, "got %lu glyphs, expected %lu\n", result->count, cold.count );
+    ok( result->checksum == cold.checksum, "got checksum %08lx, expected %08lx\n",
+        result->checksum, cold.checksum );
+
+    UnmapViewOfFile( result );
+    CloseHandle( mapping );
+}
+
+static int CALLBACK font_list_checksum_proc( const LOGFONTW *lf, const TEXTMETRICW *tm, DWORD type, LPARAM lparam )
+{
+    struct child_result *result = (struct child_result *)lparam;
+    const WCHAR *p;
+
+    for (p = lf->lfFaceName; *p; p++) result->checksum = result->checksum * 31 + *p;
+    result->checksum = result->checksum * 31 + lf->lfCharSet;
+    result->count++;
+    return 1;
+}
+
+/* report a checksum of the font families */
+static void test_font_list_child(void)
+{
+    struct child_result *result;
+    LOGFONTW lf;
+    HANDLE mapping;
+    HDC hdc;
+
+    mapping = OpenFileMappingA( FILE_MAP_WRITE, FALSE, "winetest_font_child_result" );
+    ok( mapping != NULL, "OpenFileMapping failed, error %lu\n", GetLastError() );
+    result = MapViewOfFile( mapping, FILE_MAP_WRITE, 0, 0, sizeof(*result) );
+    ok( result != NULL, "MapViewOfFile failed, error %lu\n", GetLastError() );
+
+    result->checksum = 0;
+    result->count = 0;
+
+    memset( &lf, 0, sizeof(lf) );
+    lf.lfCharSet = DEFAULT_CHARSET;
+    hdc = GetDC( 0 );
+    EnumFontFamiliesExW( hdc, &lf, font_list_checksum_proc, (LPARAM)result, 0 );
+    ReleaseDC( 0, hdc );
+
+    UnmapViewOfFile( result );
+    CloseHandle( mapping );
+}
+
+/* a process that loads the font list from the index must see the same fonts as one that scanned them */
+static void test_font_list_index( const char *argv0 )
+{
+    struct child_result *result, scan;
+    HANDLE mapping;
+
+    mapping = CreateFileMappingA( INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, 0, sizeof(*result),
+                                  "winetest_font_child_result" );
+    ok( mapping != NULL, "CreateFileMapping failed, error %lu\n", GetLastError() );
+    result = MapViewOfFile( mapping, FILE_MAP_WRITE, 0, 0, sizeof(*result) );
+
+    /* the file doesn't exist on Windows */
+    DeleteFileA( "C:\\windows\\temp\\wine_fontlist.dat" );
+
+    run_child( argv0, "font_list" );
+    scan = *result;
+    run_child( argv0, "font_list" );
+    ok( scan.count > 0, "no font enumerated\n" );
+    ok( result->count == scan.count, "got %lu fonts, expected %lu\n", result->count, scan.count );
+    ok( result->checksum == scan.checksum, "got checksum %08lx, expected %08lx\n",
+        result->checksum, scan.checksum );
+
+    UnmapViewOfFile( result );
+    CloseHandle( mapping );
+}
+
 static void test_GetOutlineTextMetrics_subst(void)
 {
     OUTLINETEXTMETRICA *otm;
@@ -7778,6 +7945,10 @@ START_TEST(font)
     {
         if (!strcmp(argv[2], "AddFontMemResource"))
             test_AddFontMemResource();
+        else if (!strcmp(argv[2], "glyph_cache"))
+            test_glyph_cache_child();
+        else if (!strcmp(argv[2], "font_list"))
+            test_font_list_child();
         return;
     }
 
@@ -7849,6 +8020,8 @@ START_TEST(font)
     test_lang_names();
     test_char_width();
     test_select_object();
+    test_glyph_cache( argv[0] );
+    test_font_list_index( argv[0] );
 
     /* These tests should be last test until RemoveFontResource
      * is properly implemented.
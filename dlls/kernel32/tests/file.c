@@ -5552,6 +5552,61 @@ static void test_post_completion(void)
     CloseHandle( port );
 }
 
+static void test_post_completion_batches(void)
+{
+    static const ULONG total = 20000, batch = 4096;
+    OVERLAPPED_ENTRY entries[64];
+    ULONG i, j, count, posted = 0, removed = 0;
+    HANDLE port;
+    BOOL ret;
+
+    if (!pGetQueuedCompletionStatusEx)
+    {
+        win_skip("GetQueuedCompletionStatusEx not available\n");
+        return;
+    }
+
+    port = CreateIoCompletionPort( INVALID_HANDLE_VALUE, NULL, 0, 0 );
+    ok(port != NULL, "CreateIoCompletionPort failed: %lu\n", GetLastError());
+
+    /* packets come out in order, in batches of up to ARRAY_SIZE(entries) */
+    while (posted < total)
+    {
+        for (i = 0; i < batch && posted < total; i++, posted++)
+        {
+            ret = PostQueuedCompletionStatus( port, posted, posted, (OVERLAPPED *)(ULONG_PTR)posted );
+            if (!ret) break;
+        }
+        ok(ret, "PostQueuedCompletionStatus failed: %lu\n", GetLastError());
+        if (!ret) break;
+
+        while (removed < posted)
+        {
+            ret = pGetQueuedCompletionStatusEx( port, entries, ARRAY_SIZE(entries), &count, 0, FALSE );
+            ok(ret, "GetQueuedCompletionStatusEx failed: %lu\n", GetLastError());
+            if (!ret) break;
+            ok(count && count <= ARRAY_SIZE(entries), "wrong count %lu\n", count);
+            for (j = 0; j < count; j++, removed++)
+            {
+                if (entries[j].lpCompletionKey == removed &&
+                    entries[j].dwNumberOfBytesTransferred == removed) continue;
+                ok(0, "got key %Iu size %lu, expected %lu\n", entries[j].lpCompletionKey,
+                   entries[j].dwNumberOfBytesTransferred, removed);
+                CloseHandle( port );
+                return;
+            }
+        }
+        if (!ret) break;
+    }
+    ok(removed == total, "removed %lu packets, expected %lu\n", removed, total);
+
+    ret = pGetQueuedCompletionStatusEx( port, entries, ARRAY_SIZE(entries), &count, 0, FALSE );
+    ok(!ret, "GetQueuedCompletionStatusEx succeeded\n");
+    ok(GetLastError() == WAIT_TIMEOUT, "wrong error %lu\n", GetLastError());
+
+    CloseHandle( port );
+}
+
 #define TEST_OVERLAPPED_READ_SIZE 4096
 
 static void test_overlapped_read(void)
@@ -5616,6 +5671,105 @@ static void test_overlapped_read(void)
     ok(ret, "Unexpected error %lu.\n", GetLastError());
 }
 
+static void test_overlapped_queue_depth(void)
+{
+    static const char prefix[] = "pfx";
+    static char buffers[64][512];
+    char temp_path[MAX_PATH], file_name[MAX_PATH];
+    OVERLAPPED ovl[ARRAY_SIZE(buffers)];
+    OVERLAPPED_ENTRY entries[16];
+    unsigned int i, j, completed = 0;
+    HANDLE file, port, event;
+    DWORD size;
+    ULONG count;
+    BOOL ret;
+
+    if (!pGetQueuedCompletionStatusEx)
+    {
+        win_skip("GetQueuedCompletionStatusEx not available\n");
+        return;
+    }
+
+    GetTempPathA( MAX_PATH, temp_path );
+    GetTempFileNameA( temp_path, prefix, 0, file_name );
+
+    file = CreateFileA( file_name, GENERIC_READ | GENERIC_WRITE, 0, NULL, CREATE_ALWAYS,
+                        FILE_FLAG_OVERLAPPED | FILE_FLAG_DELETE_ON_CLOSE, NULL );
+    ok(file != INVALID_HANDLE_VALUE, "CreateFile failed: %lu\n", GetLastError());
+    port = CreateIoCompletionPort( file, NULL, 0xdead, 0 );
+    ok(port != NULL, "CreateIoCompletionPort failed: %lu\n", GetLastError());
+
+    /* queue all the writes before waiting for any of them */
+    for (i = 0; i < ARRAY_SIZE(buffers); i++)
+    {
+        memset( buffers[i], i, sizeof(buffers[i]) );
+        memset( &ovl[i], 0, sizeof(ovl[i]) );
+        ovl[i].Offset = i * sizeof(buffers[i]);
+        ret = WriteFile( file, buffers[i], sizeof(buffers[i]), NULL, &ovl[i] );
+        ok(ret || GetLastError() == ERROR_IO_PENDING, "%u: WriteFile failed: %lu\n", i, GetLastError());
+    }
+    while (completed < ARRAY_SIZE(buffers))
+    {
+        ret = pGetQueuedCompletionStatusEx( port, entries, ARRAY_SIZE(entries), &count, 1000, FALSE );
+        ok(ret, "GetQueuedCompletionStatusEx failed: %lu\n", GetLastError());
+        if (!ret) break;
+        for (j = 0; j < count; j++)
+        {
+            ok(entries[j].lpCompletionKey == 0xdead, "wrong key %Iu\n", entries[j].lpCompletionKey);
+            ok(!entries[j].Internal, "wrong status %#Ix\n", entries[j].Internal);
+            ok(entries[j].dwNumberOfBytesTransferred == sizeof(buffers[0]),
+               "wrong size %lu\n", entries[j].dwNumberOfBytesTransferred);
+        }
+        completed += count;
+    }
+    ok(GetFileSize( file, NULL ) == sizeof(buffers), "wrong file size %lu\n", GetFileSize( file, NULL ));
+
+    memset( buffers, 0xcc, sizeof(buffers) );
+    for (i = 0; i < ARRAY_SIZE(buffers); i++)
+    {
+        ret = ReadFile( file, buffers[i], sizeof(buffers[i]), NULL, &ovl[i] );
+        ok(ret || GetLastError() == ERROR_IO_PENDING, "%u: ReadFile failed: %lu\n", i, GetLastError());
+    }
+    for (completed = 0; completed < ARRAY_SIZE(buffers); completed += count)
+    {
+        ret = pGetQueuedCompletionStatusEx( port, entries, ARRAY_SIZE(entries), &count, 1000, FALSE );
+        ok(ret, "GetQueuedCompletionStatusEx failed: %lu\n", GetLastError());
+        if (!ret) break;
+    }
+    for (i = 0; i < ARRAY_SIZE(buffers); i++)
+    {
+        ok(ovl[i].Internal == STATUS_SUCCESS, "%u: wrong status %#Ix\n", i, ovl[i].Internal);
+        ok(ovl[i].InternalHigh == sizeof(buffers[i]), "%u: wrong size %Iu\n", i, ovl[i].InternalHigh);
+        for (j = 0; j < sizeof(buffers[i]); j++) if (buffers[i][j] != (char)i) break;
+        ok(j == sizeof(buffers[i]), "%u: wrong data %#x at %u\n", i, buffers[i][j], j);
+    }
+
+    /* completion through an event, without queuing to the port */
+    event = CreateEventA( NULL, TRUE, TRUE, NULL );
+    memset( &ovl[0], 0, sizeof(ovl[0]) );
+    ovl[0].hEvent = (HANDLE)((ULONG_PTR)event | 1);
+    ovl[0].Offset = sizeof(buffers) - 16;
+    ret = ReadFile( file, buffers[0], sizeof(buffers[0]), NULL, &ovl[0] );
+    ok(ret || GetLastError() == ERROR_IO_PENDING, "ReadFile failed: %lu\n", GetLastError());
+    ret = GetOverlappedResult( file, &ovl[0], &size, TRUE );
+    ok(ret, "GetOverlappedResult failed: %lu\n", GetLastError());
+    ok(size == 16, "wrong size %lu\n", size);
+
+    ovl[0].Offset = sizeof(buffers);
+    ret = ReadFile( file, buffers[0], sizeof(buffers[0]), NULL, &ovl[0] );
+    ok(!ret, "ReadFile succeeded\n");
+    if (GetLastError() == ERROR_IO_PENDING) ret = GetOverlappedResult( file, &ovl[0], &size, TRUE );
+    ok(!ret && GetLastError() == ERROR_HANDLE_EOF, "got %d, error %lu\n", ret, GetLastError());
+
+    ret = pGetQueuedCompletionStatusEx( port, entries, ARRAY_SIZE(entries), &count, 0, FALSE );
+    ok(!ret && GetLastError() == WAIT_TIMEOUT, "GetQueuedCompletionStatusEx returned %d, error %lu\n",
+       ret, GetLastError());
+
+    CloseHandle( event );
+    CloseHandle( port );
+    CloseHandle( file );
+}
+
 static void test_file_readonly_access(void)
 {
     static const DWORD default_sharing = FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE;
@@ -6192,7 +6346,9 @@ START_TEST(file)
     test_SetFileRenameInfo();
     test_GetFileAttributesExW();
     test_post_completion();
+    test_post_completion_batches();
     test_overlapped_read();
+    test_overlapped_queue_depth();
     test_file_readonly_access();
     test_find_file_stream();
     test_SetFileTime();
@@ -92,6 +92,7 @@ C_ASSERT( sizeof(struct block) == 8 );
 #define BLOCK_FLAG_PREV_FREE   0x00000002
 #define BLOCK_FLAG_FREE_LINK   0x00000003
 #define BLOCK_FLAG_LARGE       0x00000004
+#define BLOCK_FLAG_LFH         0x00000008
 
 
 /* entry to link free blocks in free lists */
@@ -174,6 +175,68 @@ typedef struct DECLSPEC_ALIGN(ALIGNMENT) tagSUBHEAP
 C_ASSERT( sizeof(SUBHEAP) == offsetof(SUBHEAP, block) + sizeof(struct block) );
 C_ASSERT( sizeof(SUBHEAP) == 4 * ALIGNMENT );
 
+/* Low Fragmentation Heap frontend */
+
+/* values for HeapCompatibilityInformation */
+#define HEAP_STD  0
+#define HEAP_LAL  1
+#define HEAP_LFH  2
+
+/* block sizes served by the LFH: one bin per ALIGNMENT step up to BIN_LINEAR_MAX,
+ * then 16 bins per power of two up to HEAP_MAX_BIN_BLOCK_SIZE, which keeps the
+ * unused part of the blocks small enough to be stored in their tail_size */
+#define BIN_LINEAR_MAX           0x100
+#define HEAP_MAX_BIN_BLOCK_SIZE  0x800
+#define HEAP_NB_BINS             (BIN_LINEAR_MAX / ALIGNMENT + 3 * 16)
+
+/* number of allocations of a given size before the LFH is used for it */
+#define BIN_ENABLE_THRESHOLD     0x10
+/* number of per-thread group slots in each bin */
+#define BIN_NB_AFFINITY_SLOTS    8
+
+/* LFH blocks are carved out of 64k-aligned groups, so that the group can be found from the block */
+#define GROUP_SIZE               (COMMIT_MASK + 1)
+#define GROUP_COMMIT_MASK        0x3fff
+#define GROUP_MAGIC              ((DWORD)('G' | ('R'<<8) | ('P'<<16) | ('L'<<24)))
+/* low bit of the remote free list, set when the group is full and not referenced by its bin */
+#define GROUP_DETACHED           ((ULONG_PTR)1)
+
+/* groups are carved out of reserved arenas, so that a pointer can be checked against
+ * the arena ranges before anything is read from it */
+#define LFH_ARENA_GROUPS         256
+#define LFH_ARENA_SIZE           ((SIZE_T)LFH_ARENA_GROUPS * GROUP_SIZE)
+#define LFH_MAX_ARENAS           16
+/* minimum delay in ms between two automatic releases of the empty LFH groups */
+#define LFH_TRIM_INTERVAL        1000
+
+struct bin
+{
+    LONG             enabled;       /* whether allocations of this size go through the LFH */
+    RTL_SRWLOCK      lock;          /* lock protecting the groups lists */
+    struct list      groups;        /* groups with free blocks not owned by any thread */
+    struct group    *affinity_group[BIN_NB_AFFINITY_SLOTS];  /* groups cached for threads */
+};
+
+struct group
+{
+    DWORD            magic;         /* GROUP_MAGIC */
+    UINT             block_size;    /* size of the blocks in this group, including header */
+    struct heap     *heap;          /* heap the group belongs to */
+    struct bin      *bin;           /* bin the group belongs to */
+    struct list      entry;         /* entry in bin groups list */
+    struct group    *next_free;     /* next released group in the heap free groups list */
+    char            *next;          /* next never allocated block */
+    char            *commit_end;    /* end of the committed range */
+    struct block    *free_list;     /* free blocks, only accessed by the group owner */
+    void *volatile   remote_free;   /* blocks freed while the group is owned or listed, tagged with GROUP_DETACHED */
+};
+
+struct lfh_arena
+{
+    char            *base;          /* start of the reserved range */
+    LONG             count;         /* number of groups carved out, their first page stays committed */
+};
+
 struct heap
 {                                  /* win32/win64 */
     DWORD_PTR        unknown1[2];   /* 0000/0000 */
@@ -186,6 +249,7 @@ struct heap
     DWORD            force_flags;   /* 0044/0074 */
     /* end of the Windows 10 compatible struct layout */
 
+    LONG             compat_info;   /* HeapCompatibilityInformation / heap type */
     BOOL             shared;        /* System shared heap */
     struct list      entry;         /* Entry in process heap list */
     struct list      subheap_list;  /* Sub-heap list */
@@ -196,6 +260,13 @@ struct heap
     DWORD            pending_pos;   /* Position in pending free requests ring */
     struct block   **pending_free;  /* Ring buffer for pending free requests */
     RTL_CRITICAL_SECTION cs;
+    struct bin      *bins;          /* LFH bins, allocated when the LFH is enabled */
+    RTL_SRWLOCK      lfh_lock;      /* lock protecting the LFH arenas allocation */
+    LONG             lfh_arena_count;
+    struct lfh_arena lfh_arenas[LFH_MAX_ARENAS];
+    struct group    *lfh_free_groups;  /* released groups, available for reuse */
+    LONG             lfh_trim_time; /* tick count of the last release of the empty groups */
+    LONG             bin_counts[HEAP_NB_BINS];  /* live regular blocks per bin, used to enable the LFH */
     struct entry     free_lists[HEAP_NB_FREE_LISTS];
     SUBHEAP          subheap;
 };
@@ -1191,12 +1262,521 @@ static BOOL validate_used_block( const struct heap *heap, const SUBHEAP *subheap
 }
 
 
+static SIZE_T heap_get_block_size( const struct heap *heap, ULONG flags, SIZE_T size )
+{
+    static const ULONG padd_flags = HEAP_VALIDATE | HEAP_VALIDATE_ALL | HEAP_VALIDATE_PARAMS | HEAP_ADD_USER_INFO;
+    static const ULONG check_flags = HEAP_TAIL_CHECKING_ENABLED | HEAP_FREE_CHECKING_ENABLED | HEAP_CHECKING_ENABLED;
+    SIZE_T overhead;
+
+    if ((flags & check_flags)) overhead = ALIGNMENT;
+    else overhead = sizeof(struct block);
+
+    if ((flags & HEAP_TAIL_CHECKING_ENABLED) || RUNNING_ON_VALGRIND) overhead += ALIGNMENT;
+    if (flags & padd_flags) overhead += ALIGNMENT;
+
+    if (size < ALIGNMENT) size = ALIGNMENT;
+    return ROUND_SIZE( size + overhead, ALIGNMENT - 1 );
+}
+
+/* get the LFH bin index for a given block size */
+static inline UINT bin_from_block_size( SIZE_T block_size )
+{
+    UINT shift = 8;
+
+    if (block_size <= BIN_LINEAR_MAX) return (block_size - 1) / ALIGNMENT;
+    while ((block_size - 1) >> (shift + 1)) shift++;
+    return BIN_LINEAR_MAX / ALIGNMENT + (shift - 8) * 16 + (((block_size - 1) >> (shift - 4)) & 15);
+}
+
+/* get the size of the blocks of a given LFH bin */
+static inline SIZE_T bin_block_size( UINT bin )
+{
+    UINT shift;
+
+    if (bin < BIN_LINEAR_MAX / ALIGNMENT) return (bin + 1) * ALIGNMENT;
+    bin -= BIN_LINEAR_MAX / ALIGNMENT;
+    shift = 8 + bin / 16;
+    return ((SIZE_T)1 << shift) + ((SIZE_T)(bin % 16 + 1) << (shift - 4));
+}
+
+static inline BOOL heap_can_use_lfh( const struct heap *heap )
+{
+    static const ULONG disable_flags = HEAP_NO_SERIALIZE | HEAP_TAIL_CHECKING_ENABLED | HEAP_FREE_CHECKING_ENABLED |
+                                       HEAP_CHECKING_ENABLED | HEAP_VALIDATE | HEAP_VALIDATE_ALL |
+                                       HEAP_VALIDATE_PARAMS | HEAP_PAGE_ALLOCS;
+
+    if (heap->shared || !(heap->flags & HEAP_GROWABLE) || RUNNING_ON_VALGRIND) return FALSE;
+    return !(heap->flags & disable_flags);
+}
+
+/* allocate the LFH bins of a heap, the bins themselves are enabled separately */
+static BOOL heap_enable_lfh( struct heap *heap )
+{
+    SIZE_T size = sizeof(*heap->bins) * HEAP_NB_BINS;
+    struct bin *bins = NULL;
+    unsigned int i;
+
+    if (heap->bins) return TRUE;
+    if (!heap_can_use_lfh( heap )) return FALSE;
+
+    if (NtAllocateVirtualMemory( NtCurrentProcess(), (void **)&bins, 0, &size, MEM_COMMIT, PAGE_READWRITE ))
+    {
+        WARN( "Could not allocate LFH bins for heap %p\n", heap );
+        return FALSE;
+    }
+    for (i = 0; i < HEAP_NB_BINS; i++)
+    {
+        RtlInitializeSRWLock( &bins[i].lock );
+        list_init( &bins[i].groups );
+    }
+
+    if (InterlockedCompareExchangePointer( (void **)&heap->bins, bins, NULL ))
+    {
+        /* another thread won the race */
+        size = 0;
+        NtFreeVirtualMemory( NtCurrentProcess(), (void **)&bins, &size, MEM_RELEASE );
+    }
+    return TRUE;
+}
+
+/* keep track of the regular allocations of each bin size, and enable the LFH for the busy ones */
+static void heap_count_bin_alloc( struct heap *heap, SIZE_T block_size )
+{
+    UINT bin;
+
+    if (block_size > HEAP_MAX_BIN_BLOCK_SIZE || !heap_can_use_lfh( heap )) return;
+    bin = bin_from_block_size( block_size );
+    if (++heap->bin_counts[bin] <= BIN_ENABLE_THRESHOLD) return;
+
+    InterlockedCompareExchange( &heap->compat_info, HEAP_LFH, HEAP_STD );
+    if (heap->compat_info != HEAP_LFH || !heap_enable_lfh( heap )) return;
+    if (!ReadNoFence( &heap->bins[bin].enabled ))
+    {
+        TRACE( "heap %p, enabling LFH for block size %#Ix\n", heap, bin_block_size( bin ) );
+        WriteRelease( &heap->bins[bin].enabled, TRUE );
+    }
+}
+
+static void heap_count_bin_free( struct heap *heap, SIZE_T block_size )
+{
+    UINT bin;
+
+    if (block_size > HEAP_MAX_BIN_BLOCK_SIZE) return;
+    bin = bin_from_block_size( block_size );
+    if (heap->bin_counts[bin] > 0) heap->bin_counts[bin]--;
+}
+
+static inline UINT heap_get_affinity_slot(void)
+{
+    static LONG next_affinity;
+    TEB *teb = NtCurrentTeb();
+
+    if (!teb->HeapVirtualAffinity) teb->HeapVirtualAffinity = InterlockedIncrement( &next_affinity );
+    return teb->HeapVirtualAffinity % BIN_NB_AFFINITY_SLOTS;
+}
+
+static inline char *group_first_block( const struct group *group )
+{
+    return (char *)group + ROUND_SIZE( sizeof(*group) + sizeof(struct block), ALIGNMENT - 1 ) - sizeof(struct block);
+}
+
+/* get a group range with its first page committed, reusing a released group if possible */
+static struct group *heap_alloc_lfh_group( struct heap *heap )
+{
+    ULONG protect = get_protection_type( heap->flags );
+    struct lfh_arena *arena = NULL;
+    struct group *group = NULL;
+    void *addr = NULL;
+    SIZE_T size;
+
+    RtlAcquireSRWLockExclusive( &heap->lfh_lock );
+    if ((group = heap->lfh_free_groups))
+    {
+        heap->lfh_free_groups = group->next_free;
+        goto done;
+    }
+
+    if (heap->lfh_arena_count) arena = heap->lfh_arenas + heap->lfh_arena_count - 1;
+    if (!arena || arena->count == LFH_ARENA_GROUPS)
+    {
+        size = LFH_ARENA_SIZE;
+        if (heap->lfh_arena_count == LFH_MAX_ARENAS ||
+            NtAllocateVirtualMemory( NtCurrentProcess(), &addr, 0, &size, MEM_RESERVE, protect ))
+        {
+            WARN( "Could not allocate LFH arena for heap %p\n", heap );
+            goto done;
+        }
+        arena = heap->lfh_arenas + heap->lfh_arena_count;
+        arena->base = addr;
+        arena->count = 0;
+        WriteRelease( &heap->lfh_arena_count, heap->lfh_arena_count + 1 );
+    }
+
+    addr = arena->base + arena->count * GROUP_SIZE;
+    size = GROUP_COMMIT_MASK + 1;
+    if (NtAllocateVirtualMemory( NtCurrentProcess(), &addr, 0, &size, MEM_COMMIT, protect ))
+    {
+        WARN( "Could not commit LFH group %p for heap %p\n", addr, heap );
+        goto done;
+    }
+    group = addr;
+    WriteRelease( &arena->count, arena->count + 1 );
+
+done:
+    RtlReleaseSRWLockExclusive( &heap->lfh_lock );
+    return group;
+}
+
+static struct group *group_create( struct heap *heap, struct bin *bin, UINT block_size )
+{
+    struct group *group;
+
+    if (!(group = heap_alloc_lfh_group( heap ))) return NULL;
+
+    group->block_size  = block_size;
+    group->heap        = heap;
+    group->bin         = bin;
+    group->next        = group_first_block( group );
+    group->commit_end  = (char *)group + GROUP_COMMIT_MASK + 1;
+    group->free_list   = NULL;
+    group->remote_free = NULL;
+    WriteRelease( (LONG *)&group->magic, GROUP_MAGIC );
+
+    TRACE( "heap %p, created LFH group %p for block size %#x\n", heap, group, block_size );
+    return group;
+}
+
+static void group_destroy( struct group *group )
+{
+    struct heap *heap = group->heap;
+    void *addr = (char *)group + GROUP_COMMIT_MASK + 1;
+    SIZE_T size = group->commit_end - (char *)addr;
+
+    /* the header page stays committed, pointers into the group may still be looked up */
+    WriteRelease( (LONG *)&group->magic, 0 );
+    if (size) NtFreeVirtualMemory( NtCurrentProcess(), &addr, &size, MEM_DECOMMIT );
+
+    RtlAcquireSRWLockExclusive( &heap->lfh_lock );
+    group->next_free = heap->lfh_free_groups;
+    heap->lfh_free_groups = group;
+    RtlReleaseSRWLockExclusive( &heap->lfh_lock );
+}
+
+/* check if the group still has free blocks, must be called by the group owner */
+static inline BOOL group_has_free_blocks( const struct group *group )
+{
+    return group->free_list || group->next + group->block_size <= (char *)group + GROUP_SIZE;
+}
+
+/* allocate a block from a group, must be called by the group owner */
+static struct block *group_alloc_block( struct group *group )
+{
+    struct block *block;
+    char *end;
+
+    /* grab the blocks that other threads freed in the meantime */
+    if (!group->free_list) group->free_list = InterlockedExchangePointer( (void **)&group->remote_free, NULL );
+    if ((block = group->free_list))
+    {
+        group->free_list = *(struct block **)(block + 1);
+        return block;
+    }
+
+    end = group->next + group->block_size;
+    if (end > (char *)group + GROUP_SIZE) return NULL;
+    if (end > group->commit_end)
+    {
+        void *addr = group->commit_end;
+        SIZE_T size = ROUND_SIZE( end - group->commit_end, GROUP_COMMIT_MASK );
+
+        if (NtAllocateVirtualMemory( NtCurrentProcess(), &addr, 0, &size, MEM_COMMIT,
+                                     get_protection_type( group->heap->flags ) ))
+        {
+            WARN( "Could not commit %#Ix bytes at %p for LFH group %p\n", size, addr, group );
+            return NULL;
+        }
+        group->commit_end += size;
+    }
+
+    block = (struct block *)group->next;
+    group->next = end;
+    block_set_size( block, BLOCK_FLAG_LFH, group->block_size );
+    return block;
+}
+
+/* free a block to its group, may be called from any thread */
+static void group_free_block( struct group *group, struct block *block )
+{
+    struct bin *bin = group->bin;
+    void *prev;
+
+    block_set_type( block, ARENA_FREE_MAGIC );
+    do
+    {
+        prev = group->remote_free;
+        *(struct block **)(block + 1) = (struct block *)((ULONG_PTR)prev & ~GROUP_DETACHED);
+    }
+    while (InterlockedCompareExchangePointer( (void **)&group->remote_free, block, prev ) != prev);
+
+    if (!((ULONG_PTR)prev & GROUP_DETACHED)) return;
+
+    /* the group was full and forgotten by its bin, make it available again */
+    RtlAcquireSRWLockExclusive( &bin->lock );
+    list_add_tail( &bin->groups, &group->entry );
+    RtlReleaseSRWLockExclusive( &bin->lock );
+}
+
+/* take ownership of a group with free blocks, from the thread slot or from the bin */
+static struct group *bin_acquire_group( struct heap *heap, struct bin *bin, UINT slot )
+{
+    struct group *group = NULL;
+    struct list *ptr;
+
+    if ((group = InterlockedExchangePointer( (void **)&bin->affinity_group[slot], NULL ))) return group;
+
+    RtlAcquireSRWLockExclusive( &bin->lock );
+    if ((ptr = list_head( &bin->groups )))
+    {
+        group = LIST_ENTRY( ptr, struct group, entry );
+        list_remove( &group->entry );
+    }
+    RtlReleaseSRWLockExclusive( &bin->lock );
+
+    if (group) return group;
+    return group_create( heap, bin, bin_block_size( bin - heap->bins ) );
+}
+
+/* give back ownership of a group, keeping it in the thread slot if possible */
+static void bin_release_group( struct bin *bin, struct group *group, UINT slot )
+{
+    /* a full group is detached, the next freed block will put it back in the bin */
+    if (!group_has_free_blocks( group ) &&
+        !InterlockedCompareExchangePointer( (void **)&group->remote_free, (void *)GROUP_DETACHED, NULL ))
+        return;
+
+    if (!InterlockedCompareExchangePointer( (void **)&bin->affinity_group[slot], group, NULL )) return;
+
+    RtlAcquireSRWLockExclusive( &bin->lock );
+    list_add_tail( &bin->groups, &group->entry );
+    RtlReleaseSRWLockExclusive( &bin->lock );
+}
+
+static NTSTATUS heap_allocate_lfh( struct heap *heap, ULONG flags, SIZE_T size, void **ret )
+{
+    SIZE_T block_size = heap_get_block_size( heap, flags, size );
+    struct group *group;
+    struct block *block;
+    struct bin *bin;
+    UINT slot;
+
+    if (block_size < size) return STATUS_NO_MEMORY;  /* overflow */
+    if (block_size < HEAP_MIN_BLOCK_SIZE) block_size = HEAP_MIN_BLOCK_SIZE;
+    if (block_size > HEAP_MAX_BIN_BLOCK_SIZE || (flags & HEAP_CHECKING_ENABLED)) return STATUS_UNSUCCESSFUL;
+
+    bin = heap->bins + bin_from_block_size( block_size );
+    if (!ReadNoFence( &bin->enabled )) return STATUS_UNSUCCESSFUL;
+
+    slot = heap_get_affinity_slot();
+    if (!(group = bin_acquire_group( heap, bin, slot ))) return STATUS_NO_MEMORY;
+    block = group_alloc_block( group );
+    bin_release_group( bin, group, slot );
+    if (!block) return STATUS_NO_MEMORY;
+
+    block_set_type( block, ARENA_INUSE_MAGIC );
+    block->tail_size = block_get_size( block ) - sizeof(*block) - size;
+    initialize_block( block + 1, size, flags );
+
+    *ret = block + 1;
+    return STATUS_SUCCESS;
+}
+
+/* find the LFH group containing an address, checking the arena ranges before reading the group */
+static struct group *heap_find_lfh_group( const struct heap *heap, const void *ptr )
+{
+    LONG i, count = ReadAcquire( &heap->lfh_arena_count );
+    const struct lfh_arena *arena;
+    struct group *group;
+    SIZE_T offset;
+
+    for (i = 0; i < count; i++)
+    {
+        arena = heap->lfh_arenas + i;
+        offset = (const char *)ptr - arena->base;
+        if (offset >= LFH_ARENA_SIZE) continue;
+        if (offset / GROUP_SIZE >= ReadAcquire( &arena->count )) return NULL;
+        group = (struct group *)(arena->base + offset / GROUP_SIZE * GROUP_SIZE);
+        if (ReadAcquire( (const LONG *)&group->magic ) != GROUP_MAGIC) return NULL;
+        return group;
+    }
+    return NULL;
+}
+
+/* check whether a pointer is in an LFH group, without taking the heap lock */
+static inline BOOL is_lfh_block_ptr( const struct heap *heap, const void *ptr )
+{
+    if (!heap->bins || (ULONG_PTR)ptr % ALIGNMENT) return FALSE;
+    return heap_find_lfh_group( heap, (const struct block *)ptr - 1 ) != NULL;
+}
+
+static struct block *unsafe_lfh_block_from_ptr( const struct heap *heap, const void *ptr, struct group **ret )
+{
+    struct block *block = (struct block *)ptr - 1;
+    struct group *group = ROUND_ADDR( block, COMMIT_MASK );
+    const char *err = NULL, *first = group_first_block( group );
+
+    if (group->magic != GROUP_MAGIC || group->heap != heap)
+        err = "invalid LFH group";
+    else if ((char *)block < first || (char *)block >= group->next || ((char *)block - first) % group->block_size)
+        err = "invalid LFH block offset";
+    else if (block_get_type( block ) == ARENA_FREE_MAGIC)
+        err = "already freed block";
+    else if (block_get_type( block ) != ARENA_INUSE_MAGIC)
+        err = "invalid block header";
+    else if (block_get_size( block ) != group->block_size)
+        err = "invalid block size";
+
+    if (err)
+    {
+        WARN( "heap %p, block %p: %s\n", heap, block, err );
+        return NULL;
+    }
+
+    *ret = group;
+    return block;
+}
+
+static NTSTATUS heap_free_lfh( struct heap *heap, void *ptr )
+{
+    struct group *group;
+    struct block *block;
+
+    if (!(block = unsafe_lfh_block_from_ptr( heap, ptr, &group ))) return STATUS_INVALID_PARAMETER;
+    group_free_block( group, block );
+    return STATUS_SUCCESS;
+}
+
+/* release the LFH groups which don't have any allocated block */
+static void heap_trim_lfh( struct heap *heap )
+{
+    struct group *group, *next;
+    struct block *block, **tail;
+    UINT i, slot, free_count;
+    struct list groups;
+    struct bin *bin;
+
+    if (!heap->bins) return;
+
+    for (i = 0; i < HEAP_NB_BINS; i++)
+    {
+        bin = heap->bins + i;
+
+        /* take ownership of the idle groups, their free lists are walked without the bin lock */
+        list_init( &groups );
+        for (slot = 0; slot < BIN_NB_AFFINITY_SLOTS; slot++)
+        {
+            if (!(group = InterlockedExchangePointer( (void **)&bin->affinity_group[slot], NULL ))) continue;
+            list_add_tail( &groups, &group->entry );
+        }
+        RtlAcquireSRWLockExclusive( &bin->lock );
+        list_move_tail( &groups, &bin->groups );
+        RtlReleaseSRWLockExclusive( &bin->lock );
+
+        LIST_FOR_EACH_ENTRY_SAFE( group, next, &groups, struct group, entry )
+        {
+            for (free_count = 0, tail = &group->free_list; *tail; tail = (struct block **)(*tail + 1))
+                free_count++;
+            *tail = InterlockedExchangePointer( (void **)&group->remote_free, NULL );
+            for (block = *tail; block; block = *(struct block **)(block + 1)) free_count++;
+            if (free_count != (group->next - group_first_block( group )) / group->block_size) continue;
+
+            TRACE( "heap %p, releasing LFH group %p\n", heap, group );
+            list_remove( &group->entry );
+            group_destroy( group );
+        }
+
+        if (list_empty( &groups )) continue;
+        RtlAcquireSRWLockExclusive( &bin->lock );
+        list_move_tail( &bin->groups, &groups );
+        RtlReleaseSRWLockExclusive( &bin->lock );
+    }
+}
+
+/* release the empty LFH groups from time to time, so that the memory is given back after a peak */
+static void heap_trim_lfh_periodic( struct heap *heap )
+{
+    LONG now = NtGetTickCount(), last = ReadNoFence( &heap->lfh_trim_time );
+
+    if (now - last < LFH_TRIM_INTERVAL) return;
+    if (InterlockedCompareExchange( &heap->lfh_trim_time, now, last ) != last) return;
+
+    /* the heap lock keeps the groups alive while the heap is walked */
+    heap_lock( heap, 0 );
+    heap_trim_lfh( heap );
+    heap_unlock( heap, 0 );
+}
+
+/* find the next allocated LFH block after a given one, or the first one */
+static const struct block *heap_next_lfh_block( const struct heap *heap, const struct block *prev )
+{
+    LONG i, j, count = ReadAcquire( &heap->lfh_arena_count );
+    const struct lfh_arena *arena;
+    const struct group *group;
+    BOOL found = !prev;
+    const char *ptr;
+
+    for (i = 0; i < count; i++)
+    {
+        arena = heap->lfh_arenas + i;
+        for (j = 0; j < ReadAcquire( &arena->count ); j++)
+        {
+            group = (const struct group *)(arena->base + j * GROUP_SIZE);
+            ptr = group_first_block( group );
+            if (!found)
+            {
+                if ((ULONG_PTR)((const char *)prev - (const char *)group) >= GROUP_SIZE) continue;
+                ptr = (const char *)prev + group->block_size;
+                found = TRUE;
+            }
+            if (ReadAcquire( (const LONG *)&group->magic ) != GROUP_MAGIC) continue;
+            for (; ptr < group->next; ptr += group->block_size)
+                if (block_get_type( (const struct block *)ptr ) == ARENA_INUSE_MAGIC)
+                    return (const struct block *)ptr;
+        }
+    }
+    return NULL;
+}
+
+static void heap_destroy_lfh( struct heap *heap )
+{
+    void *addr = heap->bins;
+    SIZE_T size = 0;
+    LONG i;
+
+    if (!heap->bins) return;
+
+    for (i = 0; i < heap->lfh_arena_count; i++)
+    {
+        void *base = heap->lfh_arenas[i].base;
+        NtFreeVirtualMemory( NtCurrentProcess(), &base, &size, MEM_RELEASE );
+        size = 0;
+    }
+    heap->lfh_arena_count = 0;
+    heap->lfh_free_groups = NULL;
+
+    heap->bins = NULL;
+    NtFreeVirtualMemory( NtCurrentProcess(), &addr, &size, MEM_RELEASE );
+}
+
 static BOOL heap_validate_ptr( const struct heap *heap, const void *ptr, SUBHEAP **subheap )
 {
     const struct block *block = (struct block *)ptr - 1;
+    struct group *group;
 
     if (!(*subheap = find_subheap( heap, block, FALSE )))
     {
+        if (is_lfh_block_ptr( heap, ptr ))
+            return unsafe_lfh_block_from_ptr( heap, ptr, &group ) != NULL;
+
         if (!find_large_block( heap, block ))
         {
             if (WARN_ON(heap)) WARN("heap %p, ptr %p: block region not found\n", heap, ptr );
@@ -1247,6 +1827,13 @@ static inline struct block *unsafe_block_from_ptr( const struct heap *heap, cons
 {
     struct block *block = (struct block *)ptr - 1;
     const char *err = NULL, *base, *commit_end;
+    struct group *group;
+
+    if (is_lfh_block_ptr( heap, ptr ))
+    {
+        *subheap = NULL;
+        return unsafe_lfh_block_from_ptr( heap, ptr, &group );
+    }
 
     if (heap->flags & HEAP_VALIDATE)
     {
@@ -1405,6 +1992,8 @@ HANDLE WINAPI RtlCreateHeap( ULONG flags, PVOID addr, SIZE_T totalSize, SIZE_T c
     {
         process_heap = heap;  /* assume the first heap we create is the process main heap */
         list_init( &process_heap->entry );
+        /* the process heap uses the LFH by default, like on Windows */
+        if (heap_can_use_lfh( heap )) heap->compat_info = HEAP_LFH;
     }
 
     return heap;
@@ -1454,6 +2043,8 @@ HANDLE WINAPI RtlDestroyHeap( HANDLE handle )
 
     if (heap == process_heap) return handle; /* cannot delete the main process heap */
 
+    heap_destroy_lfh( heap );
+
     /* remove it from the per-process list */
     RtlEnterCriticalSection( &process_heap->cs );
     list_remove( &heap->entry );
@@ -1485,22 +2076,6 @@ HANDLE WINAPI RtlDestroyHeap( HANDLE handle )
     return 0;
 }
 
-static SIZE_T heap_get_block_size( const struct heap *heap, ULONG flags, SIZE_T size )
-{
-    static const ULONG padd_flags = HEAP_VALIDATE | HEAP_VALIDATE_ALL | HEAP_VALIDATE_PARAMS | HEAP_ADD_USER_INFO;
-    static const ULONG check_flags = HEAP_TAIL_CHECKING_ENABLED | HEAP_FREE_CHECKING_ENABLED | HEAP_CHECKING_ENABLED;
-    SIZE_T overhead;
-
-    if ((flags & check_flags)) overhead = ALIGNMENT;
-    else overhead = sizeof(struct block);
-
-    if ((flags & HEAP_TAIL_CHECKING_ENABLED) || RUNNING_ON_VALGRIND) overhead += ALIGNMENT;
-    if (flags & padd_flags) overhead += ALIGNMENT;
-
-    if (size < ALIGNMENT) size = ALIGNMENT;
-    return ROUND_SIZE( size + overhead, ALIGNMENT - 1 );
-}
-
 static NTSTATUS heap_allocate( struct heap *heap, ULONG flags, SIZE_T size, void **ret )
 {
     SIZE_T old_block_size, block_size;
@@ -1529,6 +2104,7 @@ static NTSTATUS heap_allocate( struct heap *heap, ULONG flags, SIZE_T size, void
     shrink_used_block( heap, subheap, block, 0, old_block_size, block_size, size );
     initialize_block( block + 1, size, flags );
     mark_block_tail( block, flags );
+    heap_count_bin_alloc( heap, block_get_size( block ) );
 
     *ret = block + 1;
     return STATUS_SUCCESS;
@@ -1545,12 +2121,13 @@ void *WINAPI DECLSPEC_HOTPATCH RtlAllocateHeap( HANDLE handle, ULONG flags, SIZE
 
     if (!(heap = unsafe_heap_from_handle( handle )))
         status = STATUS_INVALID_HANDLE;
-    else
+    else if (!heap->bins || heap_allocate_lfh( heap, heap_get_flags( heap, flags ), size, &ptr ))
     {
         heap_lock( heap, flags );
         status = heap_allocate( heap, heap_get_flags( heap, flags ), size, &ptr );
         heap_unlock( heap, flags );
     }
+    else status = STATUS_SUCCESS;
 
     if (!status) valgrind_notify_alloc( ptr, size, flags & HEAP_ZERO_MEMORY );
 
@@ -1566,8 +2143,13 @@ static NTSTATUS heap_free( struct heap *heap, void *ptr )
     SUBHEAP *subheap;
 
     if (!(block = unsafe_block_from_ptr( heap, ptr, &subheap ))) return STATUS_INVALID_PARAMETER;
-    if (!subheap) free_large_block( heap, block );
-    else free_used_block( heap, subheap, block );
+    if (block_get_flags( block ) & BLOCK_FLAG_LFH) return heap_free_lfh( heap, ptr );
+    if (block_get_flags( block ) & BLOCK_FLAG_LARGE) free_large_block( heap, block );
+    else
+    {
+        heap_count_bin_free( heap, block_get_size( block ) );
+        free_used_block( heap, subheap, block );
+    }
 
     return STATUS_SUCCESS;
 }
@@ -1586,6 +2168,11 @@ BOOLEAN WINAPI DECLSPEC_HOTPATCH RtlFreeHeap( HANDLE handle, ULONG flags, void *
 
     if (!(heap = unsafe_heap_from_handle( handle )))
         status = STATUS_INVALID_PARAMETER;
+    else if (is_lfh_block_ptr( heap, ptr ))
+    {
+        status = heap_free_lfh( heap, ptr );
+        heap_trim_lfh_periodic( heap );
+    }
     else
     {
         heap_lock( heap, flags );
@@ -1611,13 +2198,40 @@ static NTSTATUS heap_reallocate( struct heap *heap, ULONG flags, void *ptr, SIZE
     if (block_size < HEAP_MIN_BLOCK_SIZE) block_size = HEAP_MIN_BLOCK_SIZE;
 
     if (!(block = unsafe_block_from_ptr( heap, ptr, &subheap ))) return STATUS_INVALID_PARAMETER;
-    if (!subheap)
+    if (block_get_flags( block ) & BLOCK_FLAG_LARGE)
     {
         if (!(block = realloc_large_block( heap, flags, block, size ))) return STATUS_NO_MEMORY;
 
         *ret = block + 1;
         return STATUS_SUCCESS;
     }
+    if (block_get_flags( block ) & BLOCK_FLAG_LFH)
+    {
+        old_block_size = block_get_size( block );
+        old_size = old_block_size - block_get_overhead( block );
+
+        if (block_size <= HEAP_MAX_BIN_BLOCK_SIZE && !(flags & HEAP_CHECKING_ENABLED) &&
+            bin_from_block_size( block_size ) == bin_from_block_size( old_block_size ))
+        {
+            /* the new size still fits in the same bin, resize in place */
+            valgrind_notify_resize( block + 1, old_size, size );
+            block->tail_size = old_block_size - sizeof(*block) - size;
+            if (size > old_size) initialize_block( (char *)(block + 1) + old_size, size - old_size, flags );
+
+            *ret = block + 1;
+            return STATUS_SUCCESS;
+        }
+
+        if (flags & HEAP_REALLOC_IN_PLACE_ONLY) return STATUS_NO_MEMORY;
+        if (heap_allocate_lfh( heap, flags & ~HEAP_ZERO_MEMORY, size, ret ) &&
+            (status = heap_allocate( heap, flags & ~HEAP_ZERO_MEMORY, size, ret )))
+            return status;
+        valgrind_notify_alloc( *ret, size, 0 );
+        memcpy( *ret, block + 1, min( old_size, size ) );
+        if ((flags & HEAP_ZERO_MEMORY) && size > old_size) memset( (char *)*ret + old_size, 0, size - old_size );
+        valgrind_notify_free( ptr );
+        return heap_free_lfh( heap, ptr );
+    }
 
     /* Check if we need to grow the block */
 
@@ -1642,6 +2256,7 @@ static NTSTATUS heap_reallocate( struct heap *heap, ULONG flags, void *ptr, SIZE
             memcpy( *ret, block + 1, old_size );
             if (flags & HEAP_ZERO_MEMORY) memset( (char *)*ret + old_size, 0, size - old_size );
             valgrind_notify_free( ptr );
+            heap_count_bin_free( heap, block_get_size( block ) );
             free_used_block( heap, subheap, block );
             return STATUS_SUCCESS;
         }
@@ -1696,12 +2311,21 @@ void *WINAPI RtlReAllocateHeap( HANDLE handle, ULONG flags, void *ptr, SIZE_T si
  *  The number of bytes compacted.
  *
  * NOTES
- *  This function is a harmless stub.
+ *  This function only releases the unused LFH groups.
  */
 ULONG WINAPI RtlCompactHeap( HANDLE handle, ULONG flags )
 {
     static BOOL reported;
-    if (!reported++) FIXME( "handle %p, flags %#x stub!\n", handle, flags );
+    struct heap *heap;
+
+    if (!reported++) FIXME( "handle %p, flags %#x semi-stub!\n", handle, flags );
+
+    if ((heap = unsafe_heap_from_handle( handle )))
+    {
+        heap_lock( heap, flags );
+        heap_trim_lfh( heap );
+        heap_unlock( heap, flags );
+    }
     return 0;
 }
 
@@ -1754,7 +2378,7 @@ static NTSTATUS heap_size( const struct heap *heap, const void *ptr, SIZE_T *siz
     SUBHEAP *subheap;
 
     if (!(block = unsafe_block_from_ptr( heap, ptr, &subheap ))) return STATUS_INVALID_PARAMETER;
-    if (!subheap)
+    if (block_get_flags( block ) & BLOCK_FLAG_LARGE)
     {
         const ARENA_LARGE *large_arena = CONTAINING_RECORD( block, ARENA_LARGE, block );
         *size = large_arena->data_size;
@@ -1867,6 +2491,25 @@ static NTSTATUS heap_walk( const struct heap *heap, struct rtl_heap_entry *entry
     else if (entry->wFlags & RTL_HEAP_ENTRY_BUSY) block = (struct block *)data - 1;
     else block = (struct block *)(data - sizeof(struct list)) - 1;
 
+    /* the allocated LFH blocks are reported right after the heap region */
+    base = subheap_base( &heap->subheap );
+    if ((data == base && (entry->wFlags & RTL_HEAP_ENTRY_REGION)) ||
+        ((entry->wFlags & RTL_HEAP_ENTRY_BUSY) && heap_find_lfh_group( heap, block )))
+    {
+        if ((block = heap_next_lfh_block( heap, data == base ? NULL : block )))
+        {
+            entry->lpData = (void *)(block + 1);
+            entry->cbData = block_get_size( block ) - block_get_overhead( block );
+            entry->cbOverhead = block_get_overhead( block );
+            entry->iRegionIndex = 0;
+            entry->wFlags = RTL_HEAP_ENTRY_COMMITTED|RTL_HEAP_ENTRY_BLOCK|RTL_HEAP_ENTRY_BUSY;
+            return STATUS_SUCCESS;
+        }
+        /* continue with the blocks of the heap region */
+        entry->lpData = base;
+        block = (struct block *)base;
+    }
+
     if (find_large_block( heap, block ))
     {
         large = CONTAINING_RECORD( block, ARENA_LARGE, block );
@@ -1977,15 +2620,20 @@ ULONG WINAPI RtlGetProcessHeaps( ULONG count, HANDLE *heaps )
 NTSTATUS WINAPI RtlQueryHeapInformation( HANDLE handle, HEAP_INFORMATION_CLASS info_class,
                                          void *info, SIZE_T size_in, PSIZE_T size_out )
 {
+    struct heap *heap;
+
+    TRACE( "handle %p, info_class %u, info %p, size_in %Iu, size_out %p.\n", handle, info_class, info, size_in, size_out );
+
     switch (info_class)
     {
     case HeapCompatibilityInformation:
+        if (!(heap = unsafe_heap_from_handle( handle ))) return STATUS_ACCESS_VIOLATION;
         if (size_out) *size_out = sizeof(ULONG);
 
         if (size_in < sizeof(ULONG))
             return STATUS_BUFFER_TOO_SMALL;
 
-        *(ULONG *)info = 0; /* standard heap */
+        *(ULONG *)info = ReadNoFence( &heap->compat_info );
         return STATUS_SUCCESS;
 
     default:
@@ -1999,8 +2647,37 @@ NTSTATUS WINAPI RtlQueryHeapInformation( HANDLE handle, HEAP_INFORMATION_CLASS i
  */
 NTSTATUS WINAPI RtlSetHeapInformation( HANDLE handle, HEAP_INFORMATION_CLASS info_class, void *info, SIZE_T size )
 {
-    FIXME( "handle %p, info_class %d, info %p, size %ld stub!\n", handle, info_class, info, size );
-    return STATUS_SUCCESS;
+    struct heap *heap;
+    ULONG compat_info;
+
+    TRACE( "handle %p, info_class %d, info %p, size %Iu.\n", handle, info_class, info, size );
+
+    switch (info_class)
+    {
+    case HeapCompatibilityInformation:
+        if (size < sizeof(ULONG)) return STATUS_BUFFER_TOO_SMALL;
+        if (!(heap = unsafe_heap_from_handle( handle ))) return STATUS_INVALID_HANDLE;
+        if (heap->flags & HEAP_NO_SERIALIZE) return STATUS_INVALID_PARAMETER;
+
+        compat_info = *(ULONG *)info;
+        if (compat_info != HEAP_STD && compat_info != HEAP_LFH)
+        {
+            FIXME( "HeapCompatibilityInformation %lu not implemented!\n", compat_info );
+            return STATUS_UNSUCCESSFUL;
+        }
+        if (InterlockedCompareExchange( &heap->compat_info, compat_info, HEAP_STD ) != HEAP_STD)
+            return STATUS_UNSUCCESSFUL;
+        if (compat_info == HEAP_LFH && !heap_enable_lfh( heap ))
+        {
+            WriteRelease( &heap->compat_info, HEAP_STD );
+            return STATUS_UNSUCCESSFUL;
+        }
+        return STATUS_SUCCESS;
+
+    default:
+        FIXME( "handle %p, info_class %d, info %p, size %Iu stub!\n", handle, info_class, info, size );
+        return STATUS_SUCCESS;
+    }
 }
 
 /***********************************************************************
@@ -2022,7 +2699,7 @@ BOOLEAN WINAPI RtlGetUserInfoHeap( HANDLE handle, ULONG flags, void *ptr, void *
     if (!(heap = unsafe_heap_from_handle( handle ))) return TRUE;
 
     heap_lock( heap, flags );
-    if ((block = unsafe_block_from_ptr( heap, ptr, &subheap )) && !subheap)
+    if ((block = unsafe_block_from_ptr( heap, ptr, &subheap )) && (block_get_flags( block ) & BLOCK_FLAG_LARGE))
     {
         const ARENA_LARGE *large = CONTAINING_RECORD( block, ARENA_LARGE, block );
         *user_value = large->user_value;
@@ -2055,7 +2732,7 @@ BOOLEAN WINAPI RtlSetUserValueHeap( HANDLE handle, ULONG flags, void *ptr, void
 
     heap_lock( heap, flags );
     if (!(block = unsafe_block_from_ptr( heap, ptr, &subheap ))) ret = FALSE;
-    else if (!subheap)
+    else if (block_get_flags( block ) & BLOCK_FLAG_LARGE)
     {
         ARENA_LARGE *large = CONTAINING_RECORD( block, ARENA_LARGE, block );
         large->user_value = user_value;
@@ -5245,6 +5245,95 @@ static void test_mailslot_name(void)
     CloseHandle( device );
 }
 
+static void mix_case( WCHAR *str, unsigned int seed )
+{
+    for ( ; *str; str++, seed = seed * 1103515245 + 12345)
+        if ((seed >> 16) & 1) *str = (*str >= 'a' && *str <= 'z') ? *str - 'a' + 'A' : *str;
+}
+
+/* case-insensitive lookups in a deep tree, each path is resolved twice */
+static void test_case_insensitive_lookups(void)
+{
+    const unsigned int fanout = 6, count = 2 * fanout * fanout * 2 * fanout;
+    WCHAR temp[MAX_PATH], base[MAX_PATH], path[MAX_PATH];
+    unsigned int i, j, k, idx;
+    DWORD attrs;
+    HANDLE file;
+    BOOL ret;
+
+    GetTempPathW( ARRAY_SIZE(temp), temp );
+    swprintf( base, ARRAY_SIZE(base), L"%swinetest_lookup", temp );
+    ret = CreateDirectoryW( base, NULL );
+    ok( ret, "CreateDirectory failed: %lu\n", GetLastError() );
+
+    for (i = 0; i < fanout; i++)
+    {
+        swprintf( path, ARRAY_SIZE(path), L"%s\\dir%u", base, i );
+        CreateDirectoryW( path, NULL );
+        for (j = 0; j < fanout; j++)
+        {
+            swprintf( path, ARRAY_SIZE(path), L"%s\\dir%u\\subdir%u", base, i, j );
+            CreateDirectoryW( path, NULL );
+            for (k = 0; k < fanout; k++)
+            {
+                swprintf( path, ARRAY_SIZE(path), L"%s\\dir%u\\subdir%u\\file%u.txt", base, i, j, k );
+                file = CreateFileW( path, GENERIC_WRITE, 0, NULL, CREATE_NEW, 0, NULL );
+                ok( file != INVALID_HANDLE_VALUE, "CreateFile failed: %lu\n", GetLastError() );
+                CloseHandle( file );
+            }
+        }
+    }
+
+    /* resolve mixed-case paths, half of them to missing files */
+    for (idx = 0; idx < count; idx++)
+    {
+        i = idx % fanout;
+        j = (idx / fanout) % fanout;
+        k = (idx / (fanout * fanout)) % (2 * fanout);
+        swprintf( path, ARRAY_SIZE(path), L"dir%u\\subdir%u\\file%u.txt", i, j, k );
+        mix_case( path, idx );
+        swprintf( temp, ARRAY_SIZE(temp), L"%s\\%s", base, path );
+        attrs = GetFileAttributesW( temp );
+        if (k < fanout)
+            ok( attrs != INVALID_FILE_ATTRIBUTES, "%s not found\n", debugstr_w(temp) );
+        else
+        {
+            ok( attrs == INVALID_FILE_ATTRIBUTES, "%s found\n", debugstr_w(temp) );
+            ok( GetLastError() == ERROR_FILE_NOT_FOUND, "got error %lu\n", GetLastError() );
+        }
+    }
+    /* changes are visible right away */
+    swprintf( path, ARRAY_SIZE(path), L"%s\\dir0\\subdir0\\NewFile.txt", base );
+    file = CreateFileW( path, GENERIC_WRITE, 0, NULL, CREATE_NEW, 0, NULL );
+    ok( file != INVALID_HANDLE_VALUE, "CreateFile failed: %lu\n", GetLastError() );
+    CloseHandle( file );
+    swprintf( temp, ARRAY_SIZE(temp), L"%s\\DIR0\\SUBDIR0\\newfile.TXT", base );
+    attrs = GetFileAttributesW( temp );
+    ok( attrs != INVALID_FILE_ATTRIBUTES, "%s not found\n", debugstr_w(temp) );
+    ret = DeleteFileW( temp );
+    ok( ret, "DeleteFile failed: %lu\n", GetLastError() );
+    attrs = GetFileAttributesW( path );
+    ok( attrs == INVALID_FILE_ATTRIBUTES, "%s found\n", debugstr_w(path) );
+
+    for (i = 0; i < fanout; i++)
+    {
+        for (j = 0; j < fanout; j++)
+        {
+            for (k = 0; k < fanout; k++)
+            {
+                swprintf( path, ARRAY_SIZE(path), L"%s\\dir%u\\subdir%u\\file%u.txt", base, i, j, k );
+                DeleteFileW( path );
+            }
+            swprintf( path, ARRAY_SIZE(path), L"%s\\dir%u\\subdir%u", base, i, j );
+            RemoveDirectoryW( path );
+        }
+        swprintf( path, ARRAY_SIZE(path), L"%s\\dir%u", base, i );
+        RemoveDirectoryW( path );
+    }
+    ret = RemoveDirectoryW( base );
+    ok( ret, "RemoveDirectory failed: %lu\n", GetLastError() );
+}
+
 START_TEST(file)
 {
     HMODULE hkernel32 = GetModuleHandleA("kernel32.dll");
@@ -5316,4 +5405,5 @@ START_TEST(file)
     test_ioctl();
     test_flush_buffers_file();
     test_mailslot_name();
+    test_case_insensitive_lookups();
 }
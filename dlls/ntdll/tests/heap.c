@@ -0,0 +1,246 @@
+/*
+ * Unit tests for the ntdll heap functions
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA
+ */
+
+#include <stdarg.h>
+
+#include "ntstatus.h"
+#define WIN32_NO_STATUS
+#include "windef.h"
+#include "winbase.h"
+#include "winternl.h"
+#include "wine/test.h"
+
+/* undocumented RtlWalkHeap structure */
+
+struct rtl_heap_entry
+{
+    LPVOID lpData;
+    SIZE_T cbData; /* differs from PROCESS_HEAP_ENTRY */
+    BYTE cbOverhead;
+    BYTE iRegionIndex;
+    WORD wFlags; /* value differs from PROCESS_HEAP_ENTRY */
+    union {
+        struct {
+            HANDLE hMem;
+            DWORD dwReserved[3];
+        } Block;
+        struct {
+            DWORD dwCommittedSize;
+            DWORD dwUnCommittedSize;
+            LPVOID lpFirstBlock;
+            LPVOID lpLastBlock;
+        } Region;
+    };
+};
+
+#define RTL_HEAP_ENTRY_BUSY         0x0001
+
+static HANDLE create_lfh_heap(void)
+{
+    ULONG compat_info = 2;
+    NTSTATUS status;
+    HANDLE heap;
+
+    heap = RtlCreateHeap( HEAP_GROWABLE, NULL, 0, 0, NULL, NULL );
+    ok( !!heap, "RtlCreateHeap failed\n" );
+    status = RtlSetHeapInformation( heap, HeapCompatibilityInformation, &compat_info, sizeof(compat_info) );
+    ok( !status, "RtlSetHeapInformation returned %#lx\n", status );
+    return heap;
+}
+
+/* count how many of the given blocks are reported as allocated by RtlWalkHeap */
+static UINT count_walked_blocks( HANDLE heap, void *const *ptrs, UINT count )
+{
+    struct rtl_heap_entry entry;
+    UINT i, found = 0;
+
+    memset( &entry, 0, sizeof(entry) );
+    while (!RtlWalkHeap( heap, &entry ))
+    {
+        if (!(entry.wFlags & RTL_HEAP_ENTRY_BUSY)) continue;
+        for (i = 0; i < count; i++) if (entry.lpData == ptrs[i]) found++;
+    }
+    return found;
+}
+
+static void test_heap_lfh_walk(void)
+{
+    void *ptrs[256];
+    HANDLE heap;
+    UINT i, count;
+
+    heap = create_lfh_heap();
+
+    /* enough allocations of the same size to make them go through the LFH */
+    for (i = 0; i < ARRAY_SIZE(ptrs); i++)
+    {
+        ptrs[i] = RtlAllocateHeap( heap, 0, 0x30 );
+        ok( !!ptrs[i], "RtlAllocateHeap failed\n" );
+    }
+    count = count_walked_blocks( heap, ptrs, ARRAY_SIZE(ptrs) );
+    ok( count == ARRAY_SIZE(ptrs), "found %u blocks\n", count );
+
+    for (i = 0; i < ARRAY_SIZE(ptrs); i += 2)
+    {
+        ok( RtlFreeHeap( heap, 0, ptrs[i] ), "RtlFreeHeap failed\n" );
+        ptrs[i] = NULL;
+    }
+    RtlCompactHeap( heap, 0 );
+    count = count_walked_blocks( heap, ptrs, ARRAY_SIZE(ptrs) );
+    ok( count == ARRAY_SIZE(ptrs) / 2, "found %u blocks\n", count );
+
+    for (i = 1; i < ARRAY_SIZE(ptrs); i += 2)
+    {
+        ok( RtlSizeHeap( heap, 0, ptrs[i] ) == 0x30, "wrong size %Iu\n", RtlSizeHeap( heap, 0, ptrs[i] ) );
+        ok( RtlFreeHeap( heap, 0, ptrs[i] ), "RtlFreeHeap failed\n" );
+    }
+    RtlCompactHeap( heap, 0 );
+    count = count_walked_blocks( heap, ptrs, ARRAY_SIZE(ptrs) );
+    ok( !count, "found %u blocks\n", count );
+
+    ok( !RtlDestroyHeap( heap ), "RtlDestroyHeap failed\n" );
+}
+
+struct lfh_thread_params
+{
+    HANDLE heap;
+    HANDLE start_event;
+    void *volatile *shared;
+    UINT id;
+    LONG errors;
+};
+
+static BOOL lfh_check_block( HANDLE heap, void *ptr )
+{
+    SIZE_T i, size = *(SIZE_T *)ptr;
+    BYTE *data = ptr;
+
+    if (RtlSizeHeap( heap, 0, ptr ) != size) return FALSE;
+    for (i = sizeof(SIZE_T); i < size; i++) if (data[i] != (BYTE)size) return FALSE;
+    return TRUE;
+}
+
+static DWORD WINAPI lfh_thread_proc( void *arg )
+{
+    struct lfh_thread_params *params = arg;
+    void *ptrs[64] = {0}, *ptr;
+    UINT i, j, seed = params->id;
+    SIZE_T size;
+
+    WaitForSingleObject( params->start_event, INFINITE );
+
+    for (i = 0; i < 0x8000; i++)
+    {
+        seed = seed * 1103515245 + 12345;
+        size = sizeof(SIZE_T) + (seed >> 16) % 0x400;
+        j = (seed >> 8) % ARRAY_SIZE(ptrs);
+
+        if (!(ptr = RtlAllocateHeap( params->heap, 0, size )))
+        {
+            params->errors++;
+            continue;
+        }
+        *(SIZE_T *)ptr = size;
+        memset( (SIZE_T *)ptr + 1, (BYTE)size, size - sizeof(SIZE_T) );
+
+        /* every few allocations, exchange a block with the other threads */
+        if (!(i % 4)) ptr = InterlockedExchangePointer( params->shared + j, ptr );
+        else
+        {
+            void *tmp = ptrs[j];
+            ptrs[j] = ptr;
+            ptr = tmp;
+        }
+
+        if (!ptr) continue;
+        if (!lfh_check_block( params->heap, ptr )) params->errors++;
+        if (!RtlFreeHeap( params->heap, 0, ptr )) params->errors++;
+    }
+
+    for (i = 0; i < ARRAY_SIZE(ptrs); i++)
+    {
+        if (!ptrs[i]) continue;
+        if (!lfh_check_block( params->heap, ptrs[i] )) params->errors++;
+        if (!RtlFreeHeap( params->heap, 0, ptrs[i] )) params->errors++;
+    }
+
+    return 0;
+}
+
+/* blocks allocated and freed concurrently, some of them by other threads than their owner */
+static void test_heap_lfh_threads(void)
+{
+    static const UINT thread_counts[] = {1, 2, 4, 8, 16};
+    struct lfh_thread_params params[16];
+    void *volatile shared[64];
+    HANDLE threads[16], heap;
+    UINT i, j, count, live;
+    DWORD res;
+
+    for (i = 0; i < ARRAY_SIZE(thread_counts); i++)
+    {
+        count = thread_counts[i];
+        winetest_push_context( "%u threads", count );
+
+        heap = create_lfh_heap();
+        memset( (void *)shared, 0, sizeof(shared) );
+
+        for (j = 0; j < count; j++)
+        {
+            params[j].heap = heap;
+            params[j].start_event = CreateEventW( NULL, TRUE, FALSE, NULL );
+            params[j].shared = shared;
+            params[j].id = j + 1;
+            params[j].errors = 0;
+            threads[j] = CreateThread( NULL, 0, lfh_thread_proc, params + j, 0, NULL );
+            ok( !!threads[j], "CreateThread failed, error %lu\n", GetLastError() );
+        }
+
+        for (j = 0; j < count; j++) SetEvent( params[j].start_event );
+        res = WaitForMultipleObjects( count, threads, TRUE, 60000 );
+        ok( res == WAIT_OBJECT_0, "WaitForMultipleObjects returned %#lx\n", res );
+
+        for (j = 0; j < count; j++)
+        {
+            ok( !params[j].errors, "thread %u: got %lu errors\n", j, params[j].errors );
+            CloseHandle( params[j].start_event );
+            CloseHandle( threads[j] );
+        }
+
+        /* the blocks left in the shared array must still be intact and visible to RtlWalkHeap */
+        for (j = live = 0; j < ARRAY_SIZE(shared); j++) if (shared[j]) live++;
+        res = count_walked_blocks( heap, (void *const *)shared, ARRAY_SIZE(shared) );
+        ok( res == live, "found %lu blocks, expected %u\n", res, live );
+
+        for (j = 0; j < ARRAY_SIZE(shared); j++)
+        {
+            if (!shared[j]) continue;
+            ok( lfh_check_block( heap, shared[j] ), "block %p corrupted\n", shared[j] );
+            ok( RtlFreeHeap( heap, 0, shared[j] ), "RtlFreeHeap failed\n" );
+        }
+
+        ok( !RtlDestroyHeap( heap ), "RtlDestroyHeap failed\n" );
+        winetest_pop_context();
+    }
+}
+
+START_TEST(heap)
+{
+    test_heap_lfh_walk();
+    test_heap_lfh_threads();
+}
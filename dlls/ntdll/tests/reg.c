@@ -760,6 +760,81 @@ static void test_NtFlushKey(void)
     pNtClose(hkey);
 }
 
+static char *read_config_file( const WCHAR *dir, const WCHAR *name, DWORD *size )
+{
+    WCHAR path[MAX_PATH];
+    HANDLE file;
+    char *data;
+
+    swprintf( path, ARRAY_SIZE(path), L"%s\\%s", dir, name );
+    file = CreateFileW( path, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                        NULL, OPEN_EXISTING, 0, 0 );
+    if (file == INVALID_HANDLE_VALUE) return NULL;
+    *size = GetFileSize( file, NULL );
+    data = malloc( *size );
+    if (!ReadFile( file, data, *size, size, NULL ))
+    {
+        free( data );
+        data = NULL;
+    }
+    CloseHandle( file );
+    return data;
+}
+
+/* flushing a key saves its branch, the stale binary cache of the branch has to be replaced */
+static void test_registry_cache(void)
+{
+    WCHAR dir[MAX_PATH];
+    OBJECT_ATTRIBUTES attr;
+    UNICODE_STRING name;
+    char *cache, *cache2;
+    DWORD data, len, size, size2;
+    NTSTATUS status;
+    HANDLE key;
+
+    if (strcmp( winetest_platform, "wine" ))
+    {
+        skip( "the registry cache is Wine specific\n" );
+        return;
+    }
+    len = GetEnvironmentVariableW( L"WINECONFIGDIR", dir, ARRAY_SIZE(dir) );
+    if (!len || len >= ARRAY_SIZE(dir) || wcsncmp( dir, L"\\??\\", 4 ))
+    {
+        skip( "config dir not found\n" );
+        return;
+    }
+
+    InitializeObjectAttributes( &attr, &winetestpath, 0, 0, 0 );
+    status = pNtOpenKey( &key, KEY_ALL_ACCESS, &attr );
+    ok( !status, "NtOpenKey failed: %#lx\n", status );
+    pRtlInitUnicodeString( &name, L"CacheTest" );
+
+    data = 0;
+    status = pNtSetValueKey( key, &name, 0, REG_DWORD, &data, sizeof(data) );
+    ok( !status, "NtSetValueKey failed: %#lx\n", status );
+    status = pNtFlushKey( key );
+    ok( !status, "NtFlushKey failed: %#lx\n", status );
+    cache = read_config_file( dir + 4, L"user.reg.bin", &size );
+    ok( cache != NULL, "cache not written\n" );
+    if (cache) ok( size > 4 && !memcmp( cache, "WREG", 4 ), "wrong cache contents\n" );
+
+    data = 1;
+    status = pNtSetValueKey( key, &name, 0, REG_DWORD, &data, sizeof(data) );
+    ok( !status, "NtSetValueKey failed: %#lx\n", status );
+    status = pNtFlushKey( key );
+    ok( !status, "NtFlushKey failed: %#lx\n", status );
+    cache2 = read_config_file( dir + 4, L"user.reg.bin", &size2 );
+    ok( cache2 != NULL, "cache not written\n" );
+    if (cache && cache2)
+        ok( size != size2 || memcmp( cache, cache2, size ), "cache not updated\n" );
+
+    free( cache );
+    free( cache2 );
+    pNtDeleteValueKey( key, &name );
+    pNtFlushKey( key );
+    pNtClose( key );
+}
+
 static void test_NtQueryValueKey(void)
 {
     HANDLE key;
@@ -2205,6 +2280,157 @@ static void test_RtlCreateRegistryKey(void)
     pRtlFreeUnicodeString(&str);
 }
 
+struct reg_load_thread_params
+{
+    HANDLE start;
+    unsigned int id;
+    unsigned int count;
+};
+
+static DWORD WINAPI reg_load_thread( void *arg )
+{
+    struct reg_load_thread_params *params = arg;
+    KEY_VALUE_PARTIAL_INFORMATION *info;
+    char buffer[FIELD_OFFSET(KEY_VALUE_PARTIAL_INFORMATION, Data[sizeof(DWORD)])];
+    OBJECT_ATTRIBUTES attr;
+    UNICODE_STRING name;
+    WCHAR nameW[16];
+    NTSTATUS status;
+    unsigned int i;
+    HANDLE key;
+    DWORD data, len;
+
+    swprintf( nameW, ARRAY_SIZE(nameW), L"load%u", params->id );
+    pRtlInitUnicodeString( &name, nameW );
+    InitializeObjectAttributes( &attr, &winetestpath, 0, 0, 0 );
+    status = pNtOpenKey( &key, KEY_READ | KEY_SET_VALUE, &attr );
+    ok( !status, "NtOpenKey failed: %#lx\n", status );
+    if (status) return 0;
+
+    WaitForSingleObject( params->start, INFINITE );
+    for (i = 0; i < params->count; i++)
+    {
+        data = i;
+        status = pNtSetValueKey( key, &name, 0, REG_DWORD, &data, sizeof(data) );
+        if (!status) status = pNtQueryValueKey( key, &name, KeyValuePartialInformation,
+                                                buffer, sizeof(buffer), &len );
+        if (status)
+        {
+            ok( 0, "thread %u: iteration %u failed: %#lx\n", params->id, i, status );
+            break;
+        }
+        info = (KEY_VALUE_PARTIAL_INFORMATION *)buffer;
+        if (*(DWORD *)info->Data != i)
+        {
+            ok( 0, "thread %u: got %lu, expected %u\n", params->id, *(DWORD *)info->Data, i );
+            break;
+        }
+    }
+    pNtDeleteValueKey( key, &name );
+    pNtClose( key );
+    return 0;
+}
+
+/* several clients hammering the registry at the same time */
+static void test_concurrent_access(void)
+{
+    struct reg_load_thread_params params[8];
+    HANDLE threads[ARRAY_SIZE(params)], start;
+    unsigned int i, nb_threads;
+
+    start = CreateEventW( NULL, TRUE, FALSE, NULL );
+
+    for (nb_threads = 1; nb_threads <= ARRAY_SIZE(params); nb_threads *= 2)
+    {
+        for (i = 0; i < nb_threads; i++)
+        {
+            params[i].start = start;
+            params[i].id = i;
+            params[i].count = 2000;
+            threads[i] = CreateThread( NULL, 0, reg_load_thread, &params[i], 0, NULL );
+            ok( threads[i] != NULL, "CreateThread failed: %lu\n", GetLastError() );
+        }
+        SetEvent( start );
+        WaitForMultipleObjects( nb_threads, threads, TRUE, INFINITE );
+        ResetEvent( start );
+        for (i = 0; i < nb_threads; i++) CloseHandle( threads[i] );
+    }
+
+    CloseHandle( start );
+}
+
+/* stress test for keys with a large number of values */
+static void test_many_values(void)
+{
+    static const unsigned int count = 2000;
+    char buffer[FIELD_OFFSET(KEY_VALUE_FULL_INFORMATION, Name[32])];
+    KEY_VALUE_FULL_INFORMATION *info = (KEY_VALUE_FULL_INFORMATION *)buffer;
+    WCHAR nameW[16];
+    OBJECT_ATTRIBUTES attr;
+    UNICODE_STRING name;
+    HANDLE root, key;
+    NTSTATUS status;
+    unsigned int i, data;
+    BYTE *seen;
+    DWORD len;
+
+    InitializeObjectAttributes( &attr, &winetestpath, 0, 0, 0 );
+    status = pNtOpenKey( &root, KEY_ALL_ACCESS, &attr );
+    ok( !status, "NtOpenKey failed: %#lx\n", status );
+    pRtlInitUnicodeString( &name, L"ManyValues" );
+    InitializeObjectAttributes( &attr, &name, 0, root, 0 );
+    status = pNtCreateKey( &key, KEY_ALL_ACCESS, &attr, 0, 0, REG_OPTION_VOLATILE, 0 );
+    ok( !status, "NtCreateKey failed: %#lx\n", status );
+    pNtClose( root );
+    if (status) return;
+
+    /* scatter the names so that most of them are inserted in the middle */
+    for (i = 0; i < count; i++)
+    {
+        swprintf( nameW, ARRAY_SIZE(nameW), L"v%08x", i * 2654435761u );
+        pRtlInitUnicodeString( &name, nameW );
+        status = pNtSetValueKey( key, &name, 0, REG_DWORD, &i, sizeof(i) );
+        if (status) break;
+    }
+    ok( !status, "NtSetValueKey %u failed: %#lx\n", i, status );
+
+    /* every value is enumerated once, the order isn't checked */
+    seen = calloc( count, 1 );
+    for (i = 0; ; i++)
+    {
+        status = pNtEnumerateValueKey( key, i, KeyValueFullInformation, buffer, sizeof(buffer), &len );
+        if (status) break;
+        ok( info->DataLength == sizeof(data), "got length %lu\n", info->DataLength );
+        memcpy( &data, buffer + info->DataOffset, sizeof(data) );
+        if (data >= count || seen[data]++)
+        {
+            ok( 0, "value %u returned data %u\n", i, data );
+            break;
+        }
+        swprintf( nameW, ARRAY_SIZE(nameW), L"v%08x", data * 2654435761u );
+        ok( info->NameLength == wcslen( nameW ) * sizeof(WCHAR) && !memcmp( info->Name, nameW, info->NameLength ),
+            "value %u has name %s\n", i, debugstr_wn( info->Name, info->NameLength / sizeof(WCHAR) ));
+    }
+    ok( status == STATUS_NO_MORE_ENTRIES, "NtEnumerateValueKey %u failed: %#lx\n", i, status );
+    ok( i == count, "enumerated %u values\n", i );
+    free( seen );
+
+    for (i = 0; i < count; i++)
+    {
+        swprintf( nameW, ARRAY_SIZE(nameW), L"v%08x", i * 2654435761u );
+        pRtlInitUnicodeString( &name, nameW );
+        status = pNtDeleteValueKey( key, &name );
+        if (status) break;
+    }
+    ok( !status, "NtDeleteValueKey %u failed: %#lx\n", i, status );
+
+    status = pNtEnumerateValueKey( key, 0, KeyValueBasicInformation, buffer, sizeof(buffer), &len );
+    ok( status == STATUS_NO_MORE_ENTRIES, "NtEnumerateValueKey returned %#lx\n", status );
+
+    pNtDeleteKey( key );
+    pNtClose( key );
+}
+
 static void test_NtRenameKey(void)
 {
     KEY_NAME_INFORMATION *info = NULL;
@@ -2392,12 +2618,15 @@ START_TEST(reg)
     test_RtlQueryRegistryValues();
     test_RtlpNtQueryValueKey();
     test_NtFlushKey();
+    test_registry_cache();
     test_NtQueryKey();
     test_NtQueryLicenseKey();
     test_NtQueryValueKey();
     test_long_value_name();
     test_notify();
     test_RtlCreateRegistryKey();
+    test_concurrent_access();
+    test_many_values();
     test_NtDeleteKey();
     test_symlinks();
     test_redirection();
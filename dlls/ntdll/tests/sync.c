@@ -529,6 +529,181 @@ static void test_semaphore(void)
     NtClose( semaphore );
 }
 
+static DWORD WINAPI wait_multiple_thread( void *arg )
+{
+    HANDLE *objs = arg;
+    DWORD ret;
+
+    /* grab the mutex and exit without releasing it */
+    ret = WaitForSingleObject( objs[2], 0 );
+    ok( ret == WAIT_OBJECT_0, "got %lu\n", ret );
+    /* block until the main thread signals the auto-reset event */
+    ret = WaitForSingleObject( objs[0], 5000 );
+    ok( ret == WAIT_OBJECT_0, "got %lu\n", ret );
+    return 0;
+}
+
+static DWORD WINAPI pulse_event_thread( void *arg )
+{
+    return WaitForSingleObject( arg, 5000 );
+}
+
+static void test_wait_multiple(void)
+{
+    HANDLE objs[3], thread, limited;
+    NTSTATUS status;
+    unsigned int i;
+    LONG prev;
+    DWORD ret;
+
+    status = pNtCreateEvent( &objs[0], EVENT_ALL_ACCESS, NULL, SynchronizationEvent, FALSE );
+    ok( !status, "got %#lx\n", status );
+    status = pNtCreateSemaphore( &objs[1], SEMAPHORE_ALL_ACCESS, NULL, 0, 2 );
+    ok( !status, "got %#lx\n", status );
+    status = pNtCreateMutant( &objs[2], MUTANT_ALL_ACCESS, NULL, FALSE );
+    ok( !status, "got %#lx\n", status );
+
+    /* the first signaled object wins */
+    ret = WaitForMultipleObjects( 3, objs, FALSE, 0 );
+    ok( ret == WAIT_OBJECT_0 + 2, "got %lu\n", ret );
+    ret = WaitForMultipleObjects( 2, objs, FALSE, 0 );
+    ok( ret == WAIT_TIMEOUT, "got %lu\n", ret );
+
+    status = pNtReleaseSemaphore( objs[1], 2, NULL );
+    ok( !status, "got %#lx\n", status );
+    status = pNtReleaseSemaphore( objs[1], 1, NULL );
+    ok( status == STATUS_SEMAPHORE_LIMIT_EXCEEDED, "got %#lx\n", status );
+    ret = WaitForMultipleObjects( 2, objs, FALSE, 0 );
+    ok( ret == WAIT_OBJECT_0 + 1, "got %lu\n", ret );
+
+    prev = 0xdeadbeef;
+    status = pNtSetEvent( objs[0], &prev );
+    ok( !status, "got %#lx\n", status );
+    ok( !prev, "got %ld\n", prev );
+    ret = WaitForMultipleObjects( 3, objs, TRUE, 0 );
+    ok( ret == WAIT_OBJECT_0, "got %lu\n", ret );
+    ret = WaitForSingleObject( objs[0], 0 );
+    ok( ret == WAIT_TIMEOUT, "got %lu\n", ret );
+
+    /* recursive mutex ownership, acquired by both waits above and this one */
+    ret = WaitForSingleObject( objs[2], 0 );
+    ok( ret == WAIT_OBJECT_0, "got %lu\n", ret );
+    prev = 0xdeadbeef;
+    status = pNtReleaseMutant( objs[2], &prev );
+    ok( !status, "got %#lx\n", status );
+    ok( prev == -2, "got %ld\n", prev );
+    status = pNtReleaseMutant( objs[2], &prev );
+    ok( !status, "got %#lx\n", status );
+    ok( prev == -1, "got %ld\n", prev );
+    status = pNtReleaseMutant( objs[2], &prev );
+    ok( !status, "got %#lx\n", status );
+    ok( !prev, "got %ld\n", prev );
+    status = pNtReleaseMutant( objs[2], NULL );
+    ok( status == STATUS_MUTANT_NOT_OWNED, "got %#lx\n", status );
+
+    /* rights are still checked */
+    ret = DuplicateHandle( GetCurrentProcess(), objs[1], GetCurrentProcess(), &limited,
+                           SYNCHRONIZE, FALSE, 0 );
+    ok( ret, "DuplicateHandle failed %lu\n", GetLastError() );
+    status = pNtReleaseSemaphore( limited, 1, NULL );
+    ok( status == STATUS_ACCESS_DENIED, "got %#lx\n", status );
+    CloseHandle( limited );
+    status = pNtCreateEvent( &limited, EVENT_QUERY_STATE, NULL, NotificationEvent, TRUE );
+    ok( !status, "got %#lx\n", status );
+    ret = WaitForSingleObject( limited, 0 );
+    ok( ret == WAIT_FAILED, "got %lu\n", ret );
+    ok( GetLastError() == ERROR_ACCESS_DENIED, "got %lu\n", GetLastError() );
+    status = pNtSetEvent( limited, NULL );
+    ok( status == STATUS_ACCESS_DENIED, "got %#lx\n", status );
+    NtClose( limited );
+
+    /* wake up a thread blocked in the server, and pick up an abandoned mutex */
+    thread = CreateThread( NULL, 0, wait_multiple_thread, objs, 0, NULL );
+    Sleep( 100 );
+    status = pNtSetEvent( objs[0], NULL );
+    ok( !status, "got %#lx\n", status );
+    ret = WaitForSingleObject( thread, 5000 );
+    ok( ret == WAIT_OBJECT_0, "got %lu\n", ret );
+    CloseHandle( thread );
+    ret = WaitForSingleObject( objs[0], 0 );
+    ok( ret == WAIT_TIMEOUT, "got %lu\n", ret );
+    ret = WaitForSingleObject( objs[2], 0 );
+    ok( ret == WAIT_ABANDONED_0, "got %lu\n", ret );
+    status = pNtReleaseMutant( objs[2], NULL );
+    ok( !status, "got %#lx\n", status );
+
+    /* a pulse only wakes up current waiters */
+    status = pNtPulseEvent( objs[0], NULL );
+    ok( !status, "got %#lx\n", status );
+    ret = WaitForSingleObject( objs[0], 0 );
+    ok( ret == WAIT_TIMEOUT, "got %lu\n", ret );
+
+    /* the thread may not be waiting yet, pulse until it wakes up */
+    thread = CreateThread( NULL, 0, pulse_event_thread, objs[0], 0, NULL );
+    for (i = 0; i < 500; i++)
+    {
+        status = pNtPulseEvent( objs[0], &prev );
+        ok( !status, "got %#lx\n", status );
+        ok( !prev, "got %ld\n", prev );
+        if (!WaitForSingleObject( thread, 10 )) break;
+    }
+    ok( i < 500, "waiter wasn't woken up\n" );
+    ok( GetExitCodeThread( thread, &ret ), "GetExitCodeThread failed %lu\n", GetLastError() );
+    ok( ret == WAIT_OBJECT_0, "got %lu\n", ret );
+    CloseHandle( thread );
+    ret = WaitForSingleObject( objs[0], 0 );
+    ok( ret == WAIT_TIMEOUT, "got %lu\n", ret );
+
+    NtClose( objs[0] );
+    NtClose( objs[1] );
+    NtClose( objs[2] );
+}
+
+static void test_close_events(void)
+{
+    HANDLE events[200], event;
+    NTSTATUS status;
+    unsigned int i;
+
+    for (i = 0; i < ARRAY_SIZE(events); i++)
+    {
+        status = pNtCreateEvent( &events[i], EVENT_ALL_ACCESS, NULL, NotificationEvent, FALSE );
+        ok( !status, "NtCreateEvent returned %#lx\n", status );
+    }
+    for (i = 0; i < ARRAY_SIZE(events); i++)
+    {
+        status = pNtClose( events[i] );
+        ok( !status, "%u: NtClose returned %#lx\n", i, status );
+    }
+
+    /* the handles must be gone right away */
+    for (i = 0; i < ARRAY_SIZE(events); i++)
+    {
+        status = pNtSetEvent( events[i], NULL );
+        ok( status == STATUS_INVALID_HANDLE, "%u: NtSetEvent returned %#lx\n", i, status );
+        status = pNtClose( events[i] );
+        ok( status == STATUS_INVALID_HANDLE, "%u: NtClose returned %#lx\n", i, status );
+    }
+
+    status = pNtCreateEvent( &event, EVENT_ALL_ACCESS, NULL, NotificationEvent, FALSE );
+    ok( !status, "NtCreateEvent returned %#lx\n", status );
+    pNtClose( event );
+    status = WaitForSingleObject( event, 0 );
+    ok( status == WAIT_FAILED, "WaitForSingleObject returned %#lx\n", status );
+
+    /* the close of a protected handle must fail */
+    status = pNtCreateEvent( &event, EVENT_ALL_ACCESS, NULL, NotificationEvent, FALSE );
+    ok( !status, "NtCreateEvent returned %#lx\n", status );
+    ok( SetHandleInformation( event, HANDLE_FLAG_PROTECT_FROM_CLOSE, HANDLE_FLAG_PROTECT_FROM_CLOSE ),
+        "SetHandleInformation failed, error %lu\n", GetLastError() );
+    status = pNtClose( event );
+    ok( status == STATUS_HANDLE_NOT_CLOSABLE, "NtClose returned %#lx\n", status );
+    ok( SetHandleInformation( event, HANDLE_FLAG_PROTECT_FROM_CLOSE, 0 ),
+        "SetHandleInformation failed, error %lu\n", GetLastError() );
+    status = pNtClose( event );
+    ok( !status, "NtClose returned %#lx\n", status );
+}
+
 static void test_wait_on_address(void)
 {
     SIZE_T size;
@@ -879,8 +1054,10 @@ START_TEST(sync)
 
     test_wait_on_address();
     test_event();
+    test_close_events();
     test_mutant();
     test_semaphore();
+    test_wait_multiple();
     test_keyed_events();
     test_resource();
     test_tid_alert( argv );
@@ -2354,6 +2354,143 @@ static void test_kernel32_tp_io(void)
     pTpReleasePool(pool);
 }
 
+#define SUBMIT_THREADS   4
+#define SUBMIT_CALLBACKS 2000
+
+struct submit_threads_info
+{
+    LONG count;
+    HANDLE start_event;
+    HANDLE done_event;
+};
+
+static void CALLBACK submit_threads_cb(TP_CALLBACK_INSTANCE *instance, void *userdata)
+{
+    struct submit_threads_info *info = userdata;
+    if (InterlockedIncrement(&info->count) == SUBMIT_THREADS * SUBMIT_CALLBACKS)
+        SetEvent(info->done_event);
+}
+
+static DWORD WINAPI submit_threads_thread(void *arg)
+{
+    struct submit_threads_info *info = arg;
+    unsigned int i, failed = 0;
+
+    WaitForSingleObject(info->start_event, INFINITE);
+    for (i = 0; i < SUBMIT_CALLBACKS; i++)
+        if (!TrySubmitThreadpoolCallback(submit_threads_cb, info, NULL)) failed++;
+    ok(!failed, "%u callbacks failed to submit, error %lu\n", failed, GetLastError());
+    return 0;
+}
+
+static void test_tp_submit_threads(void)
+{
+    struct submit_threads_info info;
+    HANDLE threads[SUBMIT_THREADS];
+    DWORD result;
+    unsigned int i;
+
+    info.count = 0;
+    info.start_event = CreateEventW(NULL, TRUE, FALSE, NULL);
+    info.done_event = CreateEventW(NULL, TRUE, FALSE, NULL);
+
+    /* simple callbacks submitted concurrently from several threads must all run exactly once */
+    for (i = 0; i < SUBMIT_THREADS; i++)
+    {
+        threads[i] = CreateThread(NULL, 0, submit_threads_thread, &info, 0, NULL);
+        ok(threads[i] != NULL, "CreateThread failed, error %lu\n", GetLastError());
+    }
+    SetEvent(info.start_event);
+
+    result = WaitForSingleObject(info.done_event, 10000);
+    ok(result == WAIT_OBJECT_0, "WaitForSingleObject returned %lu\n", result);
+    result = WaitForMultipleObjects(SUBMIT_THREADS, threads, TRUE, 10000);
+    ok(result == WAIT_OBJECT_0, "WaitForMultipleObjects returned %lu\n", result);
+    Sleep(50);
+    ok(info.count == SUBMIT_THREADS * SUBMIT_CALLBACKS, "got %lu callbacks\n", info.count);
+
+    for (i = 0; i < SUBMIT_THREADS; i++) CloseHandle(threads[i]);
+    CloseHandle(info.start_event);
+    CloseHandle(info.done_event);
+}
+
+static void test_tp_timer_wheel(void)
+{
+    TP_CALLBACK_ENVIRON environment;
+    HANDLE semaphores[3];
+    TP_TIMER *timers[3];
+    DWORD result, ticks, rearm_ticks;
+    LARGE_INTEGER when;
+    NTSTATUS status;
+    TP_POOL *pool;
+    int i, remaining;
+
+    pool = NULL;
+    status = pTpAllocPool(&pool, NULL);
+    ok(!status, "TpAllocPool failed with status %lx\n", status);
+
+    memset(&environment, 0, sizeof(environment));
+    environment.Version = 1;
+    environment.Pool = pool;
+    for (i = 0; i < ARRAY_SIZE(timers); i++)
+    {
+        semaphores[i] = CreateSemaphoreA(NULL, 0, 1, NULL);
+        ok(semaphores[i] != NULL, "CreateSemaphoreA failed %lu\n", GetLastError());
+        timers[i] = NULL;
+        status = pTpAllocTimer(&timers[i], timer_cb, semaphores[i], &environment);
+        ok(!status, "TpAllocTimer failed with status %lx\n", status);
+    }
+
+    ticks = GetTickCount();
+
+    /* due times beyond the first (64 ms) and second (4096 ms) wheel levels */
+    when.QuadPart = (ULONGLONG)100 * -10000;
+    pTpSetTimer(timers[0], &when, 0, 0);
+    when.QuadPart = (ULONGLONG)4200 * -10000;
+    pTpSetTimer(timers[1], &when, 0, 0);
+
+    /* a cancelled timer doesn't fire */
+    when.QuadPart = (ULONGLONG)50 * -10000;
+    pTpSetTimer(timers[2], &when, 0, 0);
+    pTpSetTimer(timers[2], NULL, 0, 0);
+
+    result = WaitForSingleObject(semaphores[0], 1000);
+    ok(result == WAIT_OBJECT_0, "WaitForSingleObject returned %lu\n", result);
+    ok(GetTickCount() - ticks >= 90, "timer fired after %lu ms\n", GetTickCount() - ticks);
+    result = WaitForSingleObject(semaphores[2], 100);
+    ok(result == WAIT_TIMEOUT, "WaitForSingleObject returned %lu\n", result);
+
+    /* re-arming moves the timer from a far slot to a near one */
+    when.QuadPart = (ULONGLONG)5000 * -10000;
+    pTpSetTimer(timers[2], &when, 0, 0);
+    when.QuadPart = (ULONGLONG)150 * -10000;
+    pTpSetTimer(timers[2], &when, 0, 0);
+    rearm_ticks = GetTickCount();
+
+    result = WaitForSingleObject(semaphores[2], 1000);
+    ok(result == WAIT_OBJECT_0, "WaitForSingleObject returned %lu\n", result);
+    ok(GetTickCount() - rearm_ticks >= 140, "timer fired after %lu ms\n", GetTickCount() - rearm_ticks);
+    result = WaitForSingleObject(semaphores[1], 0);
+    ok(result == WAIT_TIMEOUT, "WaitForSingleObject returned %lu\n", result);
+
+    result = WaitForSingleObject(semaphores[1], 5000);
+    ok(result == WAIT_OBJECT_0, "WaitForSingleObject returned %lu\n", result);
+    ok(GetTickCount() - ticks >= 4150, "timer fired after %lu ms\n", GetTickCount() - ticks);
+
+    /* the replaced due time doesn't fire either */
+    remaining = rearm_ticks + 5300 - GetTickCount();
+    result = WaitForSingleObject(semaphores[2], max(remaining, 0));
+    ok(result == WAIT_TIMEOUT, "WaitForSingleObject returned %lu\n", result);
+
+    for (i = 0; i < ARRAY_SIZE(timers); i++)
+    {
+        pTpWaitForTimer(timers[i], TRUE);
+        pTpReleaseTimer(timers[i]);
+        CloseHandle(semaphores[i]);
+    }
+    pTpReleasePool(pool);
+}
+
 START_TEST(threadpool)
 {
     test_RtlQueueWorkItem();
@@ -2363,6 +2500,7 @@ START_TEST(threadpool)
         return;
 
     test_tp_simple();
+    test_tp_submit_threads();
     test_tp_work();
     test_tp_work_scheduler();
     test_tp_group_wait();
@@ -2371,6 +2509,7 @@ START_TEST(threadpool)
     test_tp_disassociate();
     test_tp_timer();
     test_tp_window_length();
+    test_tp_timer_wheel();
     test_tp_wait();
     test_tp_multi_wait();
     test_tp_io();
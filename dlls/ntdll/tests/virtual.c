@@ -1451,6 +1451,84 @@ static void test_NtFreeVirtualMemory(void)
     ok(status == STATUS_SUCCESS, "Unexpected status %08lx.\n", status);
 }
 
+static LONG query_thread_done;
+
+static DWORD WINAPI query_alloc_thread( void *arg )
+{
+    while (!ReadAcquire( &query_thread_done ))
+    {
+        void *addr = NULL;
+        SIZE_T size = 0x10000;
+        ULONG old_prot;
+        NTSTATUS status;
+
+        status = NtAllocateVirtualMemory( NtCurrentProcess(), &addr, 0, &size, MEM_COMMIT, PAGE_READWRITE );
+        ok( !status, "NtAllocateVirtualMemory returned %08lx\n", status );
+        size = page_size;
+        NtProtectVirtualMemory( NtCurrentProcess(), &addr, &size, PAGE_NOACCESS, &old_prot );
+        size = 0;
+        NtFreeVirtualMemory( NtCurrentProcess(), &addr, &size, MEM_RELEASE );
+    }
+    return 0;
+}
+
+static void test_query_concurrent(void)
+{
+    MEMORY_BASIC_INFORMATION mbi;
+    SIZE_T size = 16 * page_size, ret_size;
+    void *addr = NULL, *ro;
+    NTSTATUS status;
+    ULONG old_prot;
+    HANDLE thread;
+    LONG failures;
+    int i;
+
+    status = NtAllocateVirtualMemory( NtCurrentProcess(), &addr, 0, &size, MEM_COMMIT, PAGE_READWRITE );
+    ok( !status, "NtAllocateVirtualMemory returned %08lx\n", status );
+    ro = (char *)addr + 8 * page_size;
+    size = page_size;
+    status = NtProtectVirtualMemory( NtCurrentProcess(), &ro, &size, PAGE_READONLY, &old_prot );
+    ok( !status, "NtProtectVirtualMemory returned %08lx\n", status );
+
+    /* queries of a stable range stay consistent while other threads change the views */
+    query_thread_done = 0;
+    thread = CreateThread( NULL, 0, query_alloc_thread, NULL, 0, NULL );
+    failures = winetest_get_failures();
+    for (i = 0; i < 20000; i++)
+    {
+        void *ptr = (char *)addr + (i % 16) * page_size;
+
+        status = NtQueryVirtualMemory( NtCurrentProcess(), ptr, MemoryBasicInformation, &mbi,
+                                       sizeof(mbi), &ret_size );
+        ok( !status, "NtQueryVirtualMemory returned %08lx\n", status );
+        ok( mbi.AllocationBase == addr, "%d: unexpected base %p / %p\n", i, mbi.AllocationBase, addr );
+        ok( mbi.State == MEM_COMMIT, "%d: unexpected state %#lx\n", i, mbi.State );
+        ok( mbi.Type == MEM_PRIVATE, "%d: unexpected type %#lx\n", i, mbi.Type );
+        if (i % 16 < 8)
+        {
+            ok( mbi.Protect == PAGE_READWRITE, "%d: unexpected protect %#lx\n", i, mbi.Protect );
+            ok( mbi.RegionSize == (8 - i % 16) * page_size, "%d: unexpected size %#Ix\n", i, mbi.RegionSize );
+        }
+        else if (i % 16 == 8)
+        {
+            ok( mbi.Protect == PAGE_READONLY, "%d: unexpected protect %#lx\n", i, mbi.Protect );
+            ok( mbi.RegionSize == page_size, "%d: unexpected size %#Ix\n", i, mbi.RegionSize );
+        }
+        else
+        {
+            ok( mbi.Protect == PAGE_READWRITE, "%d: unexpected protect %#lx\n", i, mbi.Protect );
+            ok( mbi.RegionSize == (16 - i % 16) * page_size, "%d: unexpected size %#Ix\n", i, mbi.RegionSize );
+        }
+        if (winetest_get_failures() != failures) break;
+    }
+    WriteRelease( &query_thread_done, 1 );
+    WaitForSingleObject( thread, INFINITE );
+    CloseHandle( thread );
+
+    size = 0;
+    NtFreeVirtualMemory( NtCurrentProcess(), &addr, &size, MEM_RELEASE );
+}
+
 static void test_prefetch(void)
 {
     NTSTATUS status;
@@ -1617,6 +1695,7 @@ START_TEST(virtual)
     test_NtMapViewOfSection();
     test_NtMapViewOfSectionEx();
     test_prefetch();
+    test_query_concurrent();
     test_user_shared_data();
     test_syscalls();
 }
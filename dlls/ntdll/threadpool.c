@@ -30,6 +30,7 @@
 
 #include "wine/debug.h"
 #include "wine/list.h"
+#include "wine/timer_wheel.h"
 
 #include "ntdll_misc.h"
 
@@ -73,6 +74,7 @@ struct queue_timer
 {
     struct timer_queue *q;
     struct list entry;
+    struct timer_wheel_entry wheel_entry;
     ULONG runcount;             /* number of callbacks pending execution */
     RTL_WAITORTIMERCALLBACKFUNC callback;
     PVOID param;
@@ -87,7 +89,9 @@ struct timer_queue
 {
     DWORD magic;
     RTL_CRITICAL_SECTION cs;
-    struct list timers;         /* sorted by expiration time */
+    struct list timers;         /* all timers of the queue */
+    struct timer_wheel wheel;   /* pending timers, in milliseconds */
+    struct list expired;        /* expired timers, in expiration order */
     BOOL quit;                  /* queue should be deleted; once set, never unset */
     HANDLE event;
     HANDLE thread;
@@ -98,8 +102,20 @@ struct timer_queue
  */
 
 #define THREADPOOL_WORKER_TIMEOUT 5000
+#define THREADPOOL_NUM_DEQUES     32
+#define THREADPOOL_SPIN_MIN       16
+#define THREADPOOL_SPIN_MAX       4096
+#define THREADPOOL_MAX_SPINNING   2
 #define MAXIMUM_WAITQUEUE_OBJECTS (MAXIMUM_WAIT_OBJECTS - 1)
 
+/* queue of simple callbacks owned by a worker thread, idle workers steal from it */
+struct threadpool_deque
+{
+    RTL_SRWLOCK             lock;
+    struct list             items;      /* linked via threadpool_object.pool_entry */
+    LONG                    count;
+};
+
 /* internal threadpool representation */
 struct threadpool
 {
@@ -109,12 +125,21 @@ struct threadpool
     CRITICAL_SECTION        cs;
     /* Pools of work items, locked via .cs, order matches TP_CALLBACK_PRIORITY - high, normal, low. */
     struct list             pools[3];
-    RTL_CONDITION_VARIABLE  update_event;
+    LONG                    num_queued;
+    /* Simple callbacks are submitted without taking .cs, see tp_object_submit_simple. */
+    struct threadpool_object *submitted;
+    LONG                    num_pending;
+    struct threadpool_deque deques[THREADPOOL_NUM_DEQUES];
+    LONG                    next_deque;
+    /* idle worker threads wait for .wake_seq to change */
+    LONG                    wake_seq;
+    LONG                    num_sleeping;
+    LONG                    num_spinning;
     /* information about worker threads, locked via .cs */
     int                     max_workers;
     int                     min_workers;
     int                     num_workers;
-    int                     num_busy_workers;
+    LONG                    num_busy_workers;
     HANDLE                  compl_port;
     TP_POOL_STACK_INFORMATION stack_info;
 };
@@ -155,6 +180,7 @@ struct threadpool_object
     BOOL                    is_group_member;
     /* information about the pool, locked via .pool->cs */
     struct list             pool_entry;
+    struct threadpool_object *submitted_next;
     RTL_CONDITION_VARIABLE  finished_event;
     RTL_CONDITION_VARIABLE  group_finished_event;
     HANDLE                  completed_event;
@@ -178,7 +204,7 @@ struct threadpool_object
             /* information about the timer, locked via timerqueue.cs */
             BOOL            timer_initialized;
             BOOL            timer_pending;
-            struct list     timer_entry;
+            struct timer_wheel_entry timer_entry;
             BOOL            timer_set;
             ULONGLONG       timeout;
             LONG            period;
@@ -244,16 +270,19 @@ static struct
     CRITICAL_SECTION        cs;
     LONG                    objcount;
     BOOL                    thread_running;
-    struct list             pending_timers;
+    struct list             window_timers;      /* timers with a window, sorted by timeout */
     RTL_CONDITION_VARIABLE  update_event;
+    BOOL                    wheel_initialized;
+    struct timer_wheel      wheel;              /* timers without a window, in milliseconds */
 }
 timerqueue =
 {
     { &timerqueue_debug, -1, 0, 0, 0, 0 },      /* cs */
     0,                                          /* objcount */
     FALSE,                                      /* thread_running */
-    LIST_INIT( timerqueue.pending_timers ),     /* pending_timers */
-    RTL_CONDITION_VARIABLE_INIT                 /* update_event */
+    LIST_INIT( timerqueue.window_timers ),      /* window_timers */
+    RTL_CONDITION_VARIABLE_INIT,                /* update_event */
+    FALSE,                                      /* wheel_initialized */
 };
 
 static RTL_CRITICAL_SECTION_DEBUG timerqueue_debug =
@@ -567,6 +596,8 @@ static void queue_remove_timer(struct queue_timer *t)
     assert(t->runcount == 0);
     assert(t->destroy);
 
+    if (t->expire != EXPIRE_NEVER)
+        timer_wheel_remove(&q->wheel, &t->wheel_entry);
     list_remove(&t->entry);
     if (t->event)
         NtSetEvent(t->event, NULL);
@@ -610,24 +641,20 @@ static void queue_add_timer(struct queue_timer *t, ULONGLONG time,
 {
     /* We MUST hold the queue cs while calling this function.  */
     struct timer_queue *q = t->q;
-    struct list *ptr = &q->timers;
+    ULONGLONG next;
 
     assert(!q->quit || (t->destroy && time == EXPIRE_NEVER));
 
-    if (time != EXPIRE_NEVER)
-        LIST_FOR_EACH(ptr, &q->timers)
-        {
-            struct queue_timer *cur = LIST_ENTRY(ptr, struct queue_timer, entry);
-            if (time < cur->expire)
-                break;
-        }
-    list_add_before(ptr, &t->entry);
-
     t->expire = time;
+    if (time == EXPIRE_NEVER)
+        return;
+
+    next = q->wheel.count ? timer_wheel_next(&q->wheel) : EXPIRE_NEVER;
+    timer_wheel_add(&q->wheel, &t->wheel_entry, time);
 
-    /* If we insert at the head of the list, we need to expire sooner
+    /* If the timer expires first, we need to expire sooner
        than expected.  */
-    if (set_event && &t->entry == list_head(&q->timers))
+    if (set_event && time < next && list_empty(&q->expired))
         NtSetEvent(q->event, NULL);
 }
 
@@ -635,7 +662,8 @@ static inline void queue_move_timer(struct queue_timer *t, ULONGLONG time,
                                     BOOL set_event)
 {
     /* We MUST hold the queue cs while calling this function.  */
-    list_remove(&t->entry);
+    if (t->expire != EXPIRE_NEVER)
+        timer_wheel_remove(&t->q->wheel, &t->wheel_entry);
     queue_add_timer(t, time, set_event);
 }
 
@@ -644,12 +672,16 @@ static void queue_timer_expire(struct timer_queue *q)
     struct queue_timer *t = NULL;
 
     RtlEnterCriticalSection(&q->cs);
-    if (list_head(&q->timers))
+    if (q->wheel.count || !list_empty(&q->expired))
     {
-        ULONGLONG now, next;
-        t = LIST_ENTRY(list_head(&q->timers), struct queue_timer, entry);
-        if (!t->destroy && t->expire <= ((now = queue_current_time())))
+        ULONGLONG now = queue_current_time(), next;
+        struct list *ptr;
+
+        timer_wheel_expire(&q->wheel, now, &q->expired);
+        if ((ptr = list_head(&q->expired)))
         {
+            t = LIST_ENTRY(ptr, struct queue_timer, wheel_entry.entry);
+            assert(!t->destroy);
             ++t->runcount;
             if (t->period)
             {
@@ -662,8 +694,6 @@ static void queue_timer_expire(struct timer_queue *q)
                 next = EXPIRE_NEVER;
             queue_move_timer(t, next, FALSE);
         }
-        else
-            t = NULL;
     }
     RtlLeaveCriticalSection(&q->cs);
 
@@ -686,20 +716,16 @@ static void queue_timer_expire(struct timer_queue *q)
 
 static ULONG queue_get_timeout(struct timer_queue *q)
 {
-    struct queue_timer *t;
     ULONG timeout = INFINITE;
 
     RtlEnterCriticalSection(&q->cs);
-    if (list_head(&q->timers))
+    if (!list_empty(&q->expired))
+        timeout = 0;
+    else if (q->wheel.count)
     {
-        t = LIST_ENTRY(list_head(&q->timers), struct queue_timer, entry);
-        assert(!t->destroy || t->expire == EXPIRE_NEVER);
-
-        if (t->expire != EXPIRE_NEVER)
-        {
-            ULONGLONG time = queue_current_time();
-            timeout = t->expire < time ? 0 : t->expire - time;
-        }
+        ULONGLONG expire = timer_wheel_next(&q->wheel);
+        ULONGLONG time = queue_current_time();
+        timeout = expire < time ? 0 : expire - time;
     }
     RtlLeaveCriticalSection(&q->cs);
 
@@ -726,7 +752,7 @@ static void WINAPI timer_queue_thread_proc(LPVOID p)
         {
             /* There are two possible ways to trigger the event.  Either
                we are quitting and the last timer got removed, or a new
-               timer got put at the head of the list so we need to adjust
+               timer expires before the others so we need to adjust
                our timeout.  */
             RtlEnterCriticalSection(&q->cs);
             if (q->quit && list_empty(&q->timers))
@@ -759,8 +785,7 @@ static void queue_destroy_timer(struct queue_timer *t)
            cleanup wrapper.  */
         queue_remove_timer(t);
     else
-        /* Make sure no destroyed timer masks an active timer at the head
-           of the sorted list.  */
+        /* Make sure no destroyed timer expires again.  */
         queue_move_timer(t, EXPIRE_NEVER, FALSE);
 }
 
@@ -785,6 +810,8 @@ NTSTATUS WINAPI RtlCreateTimerQueue(PHANDLE NewTimerQueue)
 
     RtlInitializeCriticalSection(&q->cs);
     list_init(&q->timers);
+    timer_wheel_init(&q->wheel, queue_current_time());
+    list_init(&q->expired);
     q->quit = FALSE;
     q->magic = TIMER_QUEUE_MAGIC;
     status = NtCreateEvent(&q->event, EVENT_ALL_ACCESS, NULL, SynchronizationEvent, FALSE);
@@ -939,13 +966,17 @@ NTSTATUS WINAPI RtlCreateTimer(HANDLE TimerQueue, HANDLE *NewTimer,
     t->flags = Flags;
     t->destroy = FALSE;
     t->event = NULL;
+    t->expire = EXPIRE_NEVER;
 
     status = STATUS_SUCCESS;
     RtlEnterCriticalSection(&q->cs);
     if (q->quit)
         status = STATUS_INVALID_HANDLE;
     else
+    {
+        list_add_tail(&q->timers, &t->entry);
         queue_add_timer(t, queue_current_time() + DueTime, TRUE);
+    }
     RtlLeaveCriticalSection(&q->cs);
 
     if (status == STATUS_SUCCESS)
@@ -1050,15 +1081,80 @@ NTSTATUS WINAPI RtlDeleteTimer(HANDLE TimerQueue, HANDLE Timer,
     return status;
 }
 
+/***********************************************************************
+ *           tp_timerqueue_insert    (internal)
+ *
+ * Adds a timer to the global timerqueue. Timers without a window length are
+ * kept in a timer wheel, so that they can be set and cancelled in constant
+ * time, the other ones in a sorted list to be able to merge their windows.
+ */
+static void tp_timerqueue_insert( struct threadpool_object *timer )
+{
+    struct threadpool_object *other_timer;
+
+    if (!timer->u.timer.window_length)
+    {
+        if (!timerqueue.wheel_initialized)
+        {
+            LARGE_INTEGER now;
+            NtQuerySystemTime( &now );
+            timer_wheel_init( &timerqueue.wheel, now.QuadPart / 10000 );
+            timerqueue.wheel_initialized = TRUE;
+        }
+        timer_wheel_add( &timerqueue.wheel, &timer->u.timer.timer_entry,
+                         (timer->u.timer.timeout + 9999) / 10000 );
+        return;
+    }
+
+    LIST_FOR_EACH_ENTRY( other_timer, &timerqueue.window_timers,
+                         struct threadpool_object, u.timer.timer_entry.entry )
+    {
+        assert( other_timer->type == TP_OBJECT_TYPE_TIMER );
+        if (timer->u.timer.timeout < other_timer->u.timer.timeout)
+            break;
+    }
+    list_add_before( &other_timer->u.timer.timer_entry.entry, &timer->u.timer.timer_entry.entry );
+    timer->u.timer.timer_entry.slot = TIMER_WHEEL_SLOT_NONE;
+}
+
+/***********************************************************************
+ *           tp_timerqueue_remove    (internal)
+ */
+static void tp_timerqueue_remove( struct threadpool_object *timer )
+{
+    /* also takes care of timers in the sorted list or already expired */
+    timer_wheel_remove( &timerqueue.wheel, &timer->u.timer.timer_entry );
+}
+
+/***********************************************************************
+ *           tp_timerqueue_next    (internal)
+ *
+ * Returns the earliest timeout of the global timerqueue.
+ */
+static ULONGLONG tp_timerqueue_next(void)
+{
+    ULONGLONG next = MAXLONGLONG;
+    struct list *ptr;
+
+    if (timerqueue.wheel.count)
+        next = timer_wheel_next( &timerqueue.wheel ) * 10000;
+    if ((ptr = list_head( &timerqueue.window_timers )))
+    {
+        struct threadpool_object *timer = LIST_ENTRY( ptr, struct threadpool_object, u.timer.timer_entry.entry );
+        if (timer->u.timer.timeout < next) next = timer->u.timer.timeout;
+    }
+    return next;
+}
+
 /***********************************************************************
  *           timerqueue_thread_proc    (internal)
  */
 static void CALLBACK timerqueue_thread_proc( void *param )
 {
-    ULONGLONG timeout_lower, timeout_upper, new_timeout;
-    struct threadpool_object *other_timer;
+    ULONGLONG timeout_lower, timeout_upper, new_timeout, next;
+    struct threadpool_object *timer, *other_timer;
     LARGE_INTEGER now, timeout;
-    struct list *ptr;
+    struct list expired, *ptr;
 
     TRACE( "starting timer queue thread\n" );
     set_thread_name(L"wine_threadpool_timerqueue");
@@ -1067,18 +1163,34 @@ static void CALLBACK timerqueue_thread_proc( void *param )
     for (;;)
     {
         NtQuerySystemTime( &now );
+        list_init( &expired );
+
+        /* If the system time went backwards, the wheel has to be moved back,
+         * or its timers would expire early. */
+        if (timerqueue.wheel_initialized && now.QuadPart / 10000 < timerqueue.wheel.now)
+            timer_wheel_rewind( &timerqueue.wheel, now.QuadPart / 10000 );
 
         /* Check for expired timers. */
-        while ((ptr = list_head( &timerqueue.pending_timers )))
+        if (timerqueue.wheel.count)
+            timer_wheel_expire( &timerqueue.wheel, now.QuadPart / 10000, &expired );
+        while ((ptr = list_head( &timerqueue.window_timers )))
         {
-            struct threadpool_object *timer = LIST_ENTRY( ptr, struct threadpool_object, u.timer.timer_entry );
-            assert( timer->type == TP_OBJECT_TYPE_TIMER );
-            assert( timer->u.timer.timer_pending );
+            timer = LIST_ENTRY( ptr, struct threadpool_object, u.timer.timer_entry.entry );
             if (timer->u.timer.timeout > now.QuadPart)
                 break;
+            list_remove( ptr );
+            list_add_tail( &expired, ptr );
+        }
+
+        while ((ptr = list_head( &expired )))
+        {
+            timer = LIST_ENTRY( ptr, struct threadpool_object, u.timer.timer_entry.entry );
+            assert( timer->type == TP_OBJECT_TYPE_TIMER );
+            assert( timer->u.timer.timer_pending );
 
             /* Queue a new callback in one of the worker threads. */
-            list_remove( &timer->u.timer.timer_entry );
+            list_remove( ptr );
+            timer->u.timer.timer_entry.slot = TIMER_WHEEL_SLOT_NONE;
             timer->u.timer.timer_pending = FALSE;
             tp_object_submit( timer, FALSE );
 
@@ -1089,26 +1201,21 @@ static void CALLBACK timerqueue_thread_proc( void *param )
                 if (timer->u.timer.timeout <= now.QuadPart)
                     timer->u.timer.timeout = now.QuadPart + 1;
 
-                LIST_FOR_EACH_ENTRY( other_timer, &timerqueue.pending_timers,
-                                     struct threadpool_object, u.timer.timer_entry )
-                {
-                    assert( other_timer->type == TP_OBJECT_TYPE_TIMER );
-                    if (timer->u.timer.timeout < other_timer->u.timer.timeout)
-                        break;
-                }
-                list_add_before( &other_timer->u.timer.timer_entry, &timer->u.timer.timer_entry );
+                tp_timerqueue_insert( timer );
                 timer->u.timer.timer_pending = TRUE;
             }
         }
 
         timeout_lower = timeout_upper = MAXLONGLONG;
+        next = timerqueue.wheel.count ? timer_wheel_next( &timerqueue.wheel ) * 10000 : MAXLONGLONG;
 
-        /* Determine next timeout and use the window length to optimize wakeup times. */
-        LIST_FOR_EACH_ENTRY( other_timer, &timerqueue.pending_timers,
-                             struct threadpool_object, u.timer.timer_entry )
+        /* Determine next timeout and use the window length to optimize wakeup times,
+         * the timers of the wheel have no window and end the merge. */
+        LIST_FOR_EACH_ENTRY( other_timer, &timerqueue.window_timers,
+                             struct threadpool_object, u.timer.timer_entry.entry )
         {
             assert( other_timer->type == TP_OBJECT_TYPE_TIMER );
-            if (other_timer->u.timer.timeout >= timeout_upper)
+            if (other_timer->u.timer.timeout >= timeout_upper || next <= other_timer->u.timer.timeout)
                 break;
 
             timeout_lower = other_timer->u.timer.timeout;
@@ -1116,6 +1223,8 @@ static void CALLBACK timerqueue_thread_proc( void *param )
             if (new_timeout < timeout_upper)
                 timeout_upper = new_timeout;
         }
+        if (next < timeout_upper)
+            timeout_lower = next;
 
         /* Wait for timer update events or until the next timer expires. */
         if (timerqueue.objcount)
@@ -1221,14 +1330,14 @@ static void tp_timerqueue_unlock( struct threadpool_object *timer )
         /* If timer was pending, remove it. */
         if (timer->u.timer.timer_pending)
         {
-            list_remove( &timer->u.timer.timer_entry );
+            tp_timerqueue_remove( timer );
             timer->u.timer.timer_pending = FALSE;
         }
 
         /* If the last timer object was destroyed, then wake up the thread. */
         if (!--timerqueue.objcount)
         {
-            assert( list_empty( &timerqueue.pending_timers ) );
+            assert( !timerqueue.wheel.count && list_empty( &timerqueue.window_timers ) );
             RtlWakeAllConditionVariable( &timerqueue.update_event );
         }
 
@@ -1680,7 +1789,19 @@ static NTSTATUS tp_threadpool_alloc( struct threadpool **out )
 
     for (i = 0; i < ARRAY_SIZE(pool->pools); ++i)
         list_init( &pool->pools[i] );
-    RtlInitializeConditionVariable( &pool->update_event );
+    pool->num_queued            = 0;
+    pool->submitted             = NULL;
+    pool->num_pending           = 0;
+    for (i = 0; i < ARRAY_SIZE(pool->deques); ++i)
+    {
+        RtlInitializeSRWLock( &pool->deques[i].lock );
+        list_init( &pool->deques[i].items );
+        pool->deques[i].count = 0;
+    }
+    pool->next_deque            = 0;
+    pool->wake_seq              = 0;
+    pool->num_sleeping          = 0;
+    pool->num_spinning          = 0;
 
     pool->max_workers             = 500;
     pool->min_workers             = 0;
@@ -1695,6 +1816,21 @@ static NTSTATUS tp_threadpool_alloc( struct threadpool **out )
     return STATUS_SUCCESS;
 }
 
+/***********************************************************************
+ *           tp_threadpool_wake    (internal)
+ *
+ * Wakes up one or all idle worker threads. A worker which is still
+ * spinning notices new work by itself.
+ */
+static void tp_threadpool_wake( struct threadpool *pool, BOOL all )
+{
+    InterlockedIncrement( &pool->wake_seq );
+    if (all)
+        RtlWakeAddressAll( &pool->wake_seq );
+    else if (pool->num_sleeping && !pool->num_spinning)
+        RtlWakeAddressSingle( &pool->wake_seq );
+}
+
 /***********************************************************************
  *           tp_threadpool_shutdown    (internal)
  *
@@ -1707,7 +1843,7 @@ static void tp_threadpool_shutdown( struct threadpool *pool )
     assert( pool != default_threadpool );
 
     pool->shutdown = TRUE;
-    RtlWakeAllConditionVariable( &pool->update_event );
+    tp_threadpool_wake( pool, TRUE );
 }
 
 /***********************************************************************
@@ -1728,6 +1864,9 @@ static BOOL tp_threadpool_release( struct threadpool *pool )
     assert( !pool->objcount );
     for (i = 0; i < ARRAY_SIZE(pool->pools); ++i)
         assert( list_empty( &pool->pools[i] ) );
+    assert( !pool->submitted );
+    for (i = 0; i < ARRAY_SIZE(pool->deques); ++i)
+        assert( list_empty( &pool->deques[i].items ) );
 
     pool->cs.DebugInfo->Spare[0] = 0;
     RtlDeleteCriticalSection( &pool->cs );
@@ -1787,24 +1926,27 @@ static NTSTATUS tp_threadpool_lock( struct threadpool **out, TP_CALLBACK_ENVIRON
         pool = default_threadpool;
     }
 
-    RtlEnterCriticalSection( &pool->cs );
+    /* Keep a reference, and increment objcount to ensure that the
+     * last thread doesn't terminate. A worker thread about to terminate
+     * checks objcount again after decrementing num_workers. */
+    InterlockedIncrement( &pool->refcount );
+    InterlockedIncrement( &pool->objcount );
 
     /* Make sure that the threadpool has at least one thread. */
     if (!pool->num_workers)
-        status = tp_new_worker_thread( pool );
-
-    /* Keep a reference, and increment objcount to ensure that the
-     * last thread doesn't terminate. */
-    if (status == STATUS_SUCCESS)
     {
-        InterlockedIncrement( &pool->refcount );
-        pool->objcount++;
+        RtlEnterCriticalSection( &pool->cs );
+        if (!pool->num_workers)
+            status = tp_new_worker_thread( pool );
+        RtlLeaveCriticalSection( &pool->cs );
     }
 
-    RtlLeaveCriticalSection( &pool->cs );
-
     if (status != STATUS_SUCCESS)
+    {
+        InterlockedDecrement( &pool->objcount );
+        tp_threadpool_release( pool );
         return status;
+    }
 
     *out = pool;
     return STATUS_SUCCESS;
@@ -1817,9 +1959,7 @@ static NTSTATUS tp_threadpool_lock( struct threadpool **out, TP_CALLBACK_ENVIRON
  */
 static void tp_threadpool_unlock( struct threadpool *pool )
 {
-    RtlEnterCriticalSection( &pool->cs );
-    pool->objcount--;
-    RtlLeaveCriticalSection( &pool->cs );
+    InterlockedDecrement( &pool->objcount );
     tp_threadpool_release( pool );
 }
 
@@ -1969,10 +2109,49 @@ static void tp_object_initialize( struct threadpool_object *object, struct threa
 
 static void tp_object_prio_queue( struct threadpool_object *object )
 {
-    ++object->pool->num_busy_workers;
+    InterlockedIncrement( &object->pool->num_busy_workers );
+    object->pool->num_queued++;
     list_add_tail( &object->pool->pools[object->priority], &object->pool_entry );
 }
 
+/***********************************************************************
+ *           tp_object_submit_simple    (internal)
+ *
+ * Submits a simple callback without taking the pool lock. The object is
+ * pushed on a lock-free list, from which worker threads move it to their
+ * own queue. Such objects have no cleanup group and can neither be waited
+ * for nor canceled.
+ */
+static void tp_object_submit_simple( struct threadpool_object *object )
+{
+    struct threadpool *pool = object->pool;
+    struct threadpool_object *head;
+
+    InterlockedIncrement( &object->refcount );
+    object->num_pending_callbacks = 1;
+
+    do
+    {
+        head = pool->submitted;
+        object->submitted_next = head;
+    }
+    while (InterlockedCompareExchangePointer( (void **)&pool->submitted, object, head ) != head);
+    InterlockedIncrement( &pool->num_pending );
+
+    /* Start a new worker thread if all of them are busy. */
+    if (InterlockedIncrement( &pool->num_busy_workers ) > pool->num_workers &&
+        pool->num_workers < pool->max_workers)
+    {
+        RtlEnterCriticalSection( &pool->cs );
+        if (pool->num_busy_workers > pool->num_workers &&
+            pool->num_workers < pool->max_workers)
+            tp_new_worker_thread( pool );
+        RtlLeaveCriticalSection( &pool->cs );
+    }
+
+    tp_threadpool_wake( pool, FALSE );
+}
+
 /***********************************************************************
  *           tp_object_submit    (internal)
  *
@@ -1987,6 +2166,13 @@ static void tp_object_submit( struct threadpool_object *object, BOOL signaled )
     assert( !object->shutdown );
     assert( !pool->shutdown );
 
+    if (object->type == TP_OBJECT_TYPE_SIMPLE && !object->group &&
+        object->priority == TP_CALLBACK_PRIORITY_NORMAL)
+    {
+        tp_object_submit_simple( object );
+        return;
+    }
+
     RtlEnterCriticalSection( &pool->cs );
 
     /* Start new worker threads if required. */
@@ -2007,7 +2193,7 @@ static void tp_object_submit( struct threadpool_object *object, BOOL signaled )
     if (status != STATUS_SUCCESS)
     {
         assert( pool->num_workers > 0 );
-        RtlWakeConditionVariable( &pool->update_event );
+        tp_threadpool_wake( pool, FALSE );
     }
 
     RtlLeaveCriticalSection( &pool->cs );
@@ -2029,6 +2215,7 @@ static void tp_object_cancel( struct threadpool_object *object )
         pending_callbacks = object->num_pending_callbacks;
         object->num_pending_callbacks = 0;
         list_remove( &object->pool_entry );
+        pool->num_queued--;
 
         if (object->type == TP_OBJECT_TYPE_WAIT)
             object->u.wait.signaled = 0;
@@ -2167,40 +2354,19 @@ static struct list *threadpool_get_next_item( const struct threadpool *pool )
 }
 
 /***********************************************************************
- *           tp_object_execute    (internal)
+ *           tp_object_run_callback    (internal)
  *
- * Executes a threadpool object callback, object->pool->cs has to be
- * held.
+ * Runs the callback of a threadpool object and the cleanup tasks
+ * requested by it. Returns whether the callback is still associated
+ * with the object.
  */
-static void tp_object_execute( struct threadpool_object *object, BOOL wait_thread )
+static BOOL tp_object_run_callback( struct threadpool_object *object, TP_WAIT_RESULT wait_result,
+                                    struct io_completion *completion )
 {
     TP_CALLBACK_INSTANCE *callback_instance;
     struct threadpool_instance instance;
-    struct io_completion completion;
-    struct threadpool *pool = object->pool;
-    TP_WAIT_RESULT wait_result = 0;
     NTSTATUS status;
 
-    object->num_pending_callbacks--;
-
-    /* For wait objects check if they were signaled or have timed out. */
-    if (object->type == TP_OBJECT_TYPE_WAIT)
-    {
-        wait_result = object->u.wait.signaled ? WAIT_OBJECT_0 : WAIT_TIMEOUT;
-        if (wait_result == WAIT_OBJECT_0) object->u.wait.signaled--;
-    }
-    else if (object->type == TP_OBJECT_TYPE_IO)
-    {
-        assert( object->u.io.completion_count );
-        completion = object->u.io.completions[--object->u.io.completion_count];
-    }
-
-    /* Leave critical section and do the actual callback. */
-    object->num_associated_callbacks++;
-    object->num_running_callbacks++;
-    RtlLeaveCriticalSection( &pool->cs );
-    if (wait_thread) RtlLeaveCriticalSection( &waitqueue.cs );
-
     /* Initialize threadpool instance struct. */
     callback_instance = (TP_CALLBACK_INSTANCE *)&instance;
     instance.object                     = object;
@@ -2256,9 +2422,9 @@ static void tp_object_execute( struct threadpool_object *object, BOOL wait_threa
         {
             TRACE( "executing I/O callback %p(%p, %p, %#lx, %p, %p)\n",
                     object->u.io.callback, callback_instance, object->userdata,
-                    completion.cvalue, &completion.iosb, (TP_IO *)object );
+                    completion->cvalue, &completion->iosb, (TP_IO *)object );
             object->u.io.callback( callback_instance, object->userdata,
-                    (void *)completion.cvalue, &completion.iosb, (TP_IO *)object );
+                    (void *)completion->cvalue, &completion->iosb, (TP_IO *)object );
             TRACE( "callback %p returned\n", object->u.io.callback );
             break;
         }
@@ -2303,6 +2469,44 @@ static void tp_object_execute( struct threadpool_object *object, BOOL wait_threa
     }
 
 skip_cleanup:
+    return instance.associated;
+}
+
+/***********************************************************************
+ *           tp_object_execute    (internal)
+ *
+ * Executes a threadpool object callback, object->pool->cs has to be
+ * held.
+ */
+static void tp_object_execute( struct threadpool_object *object, BOOL wait_thread )
+{
+    struct io_completion completion;
+    struct threadpool *pool = object->pool;
+    TP_WAIT_RESULT wait_result = 0;
+    BOOL associated;
+
+    object->num_pending_callbacks--;
+
+    /* For wait objects check if they were signaled or have timed out. */
+    if (object->type == TP_OBJECT_TYPE_WAIT)
+    {
+        wait_result = object->u.wait.signaled ? WAIT_OBJECT_0 : WAIT_TIMEOUT;
+        if (wait_result == WAIT_OBJECT_0) object->u.wait.signaled--;
+    }
+    else if (object->type == TP_OBJECT_TYPE_IO)
+    {
+        assert( object->u.io.completion_count );
+        completion = object->u.io.completions[--object->u.io.completion_count];
+    }
+
+    /* Leave critical section and do the actual callback. */
+    object->num_associated_callbacks++;
+    object->num_running_callbacks++;
+    RtlLeaveCriticalSection( &pool->cs );
+    if (wait_thread) RtlLeaveCriticalSection( &waitqueue.cs );
+
+    associated = tp_object_run_callback( object, wait_result, &completion );
+
     if (wait_thread) RtlEnterCriticalSection( &waitqueue.cs );
     RtlEnterCriticalSection( &pool->cs );
 
@@ -2317,7 +2521,7 @@ skip_cleanup:
     if (object_is_finished( object, TRUE ))
         RtlWakeAllConditionVariable( &object->group_finished_event );
 
-    if (instance.associated)
+    if (associated)
     {
         object->num_associated_callbacks--;
         if (object_is_finished( object, FALSE ))
@@ -2325,58 +2529,249 @@ skip_cleanup:
     }
 }
 
+/***********************************************************************
+ *           tp_object_execute_simple    (internal)
+ *
+ * Executes a simple callback submitted with tp_object_submit_simple.
+ * Nobody can wait for such an object, so the callback counters are
+ * updated without taking the pool lock.
+ */
+static void tp_object_execute_simple( struct threadpool_object *object )
+{
+    struct threadpool *pool = object->pool;
+
+    object->num_pending_callbacks = 0;
+    object->num_associated_callbacks = 1;
+    object->num_running_callbacks = 1;
+
+    tp_object_run_callback( object, 0, NULL );
+
+    object->shutdown = TRUE;
+    object->num_running_callbacks = 0;
+    object->num_associated_callbacks = 0;
+
+    InterlockedDecrement( &pool->num_busy_workers );
+    tp_object_release( object );
+}
+
+/***********************************************************************
+ *           tp_deque_take    (internal)
+ *
+ * Moves the first item, or the first half of the items, of a worker
+ * queue to a list. Returns the number of items moved.
+ */
+static LONG tp_deque_take( struct threadpool_deque *deque, struct list *items, BOOL half )
+{
+    LONG i, count;
+
+    RtlAcquireSRWLockExclusive( &deque->lock );
+    count = half ? (deque->count + 1) / 2 : min( deque->count, 1 );
+    for (i = 0; i < count; i++)
+    {
+        struct list *ptr = list_head( &deque->items );
+        list_remove( ptr );
+        list_add_tail( items, ptr );
+    }
+    deque->count -= count;
+    RtlReleaseSRWLockExclusive( &deque->lock );
+
+    return count;
+}
+
+static void tp_deque_put( struct threadpool_deque *deque, struct list *items, LONG count )
+{
+    RtlAcquireSRWLockExclusive( &deque->lock );
+    list_move_tail( &deque->items, items );
+    deque->count += count;
+    RtlReleaseSRWLockExclusive( &deque->lock );
+}
+
+/***********************************************************************
+ *           tp_worker_next_simple    (internal)
+ *
+ * Returns the next simple callback for a worker thread: from its own
+ * queue first, then from the lock-free submission list, and finally
+ * by stealing half of the queue of another worker.
+ */
+static struct threadpool_object *tp_worker_next_simple( struct threadpool *pool,
+                                                        struct threadpool_deque *deque )
+{
+    struct threadpool_object *object, *next;
+    struct list items = LIST_INIT( items );
+    struct list *ptr;
+    unsigned int i, index;
+    LONG count = 0;
+
+    if (!pool->num_pending)
+        return NULL;
+
+    if (deque->count)
+        count = tp_deque_take( deque, &items, FALSE );
+
+    /* The submission list is in reverse order, restore FIFO order. */
+    if (!count && (object = InterlockedExchangePointer( (void **)&pool->submitted, NULL )))
+    {
+        for (; object; object = next)
+        {
+            next = object->submitted_next;
+            list_add_head( &items, &object->pool_entry );
+            count++;
+        }
+    }
+
+    index = deque - pool->deques;
+    for (i = 1; !count && i < ARRAY_SIZE(pool->deques); i++)
+    {
+        struct threadpool_deque *victim = &pool->deques[(index + i) % ARRAY_SIZE(pool->deques)];
+        if (victim->count)
+            count = tp_deque_take( victim, &items, TRUE );
+    }
+
+    if (!count)
+        return NULL;
+
+    ptr = list_head( &items );
+    list_remove( ptr );
+
+    /* Let another idle worker steal the remaining items. */
+    if (--count)
+    {
+        tp_deque_put( deque, &items, count );
+        tp_threadpool_wake( pool, FALSE );
+    }
+
+    InterlockedDecrement( &pool->num_pending );
+    return LIST_ENTRY( ptr, struct threadpool_object, pool_entry );
+}
+
+/***********************************************************************
+ *           tp_worker_process_queue    (internal)
+ *
+ * Executes the work items queued in the pool lists.
+ */
+static void tp_worker_process_queue( struct threadpool *pool )
+{
+    struct list *ptr;
+
+    RtlEnterCriticalSection( &pool->cs );
+    while ((ptr = threadpool_get_next_item( pool )))
+    {
+        struct threadpool_object *object = LIST_ENTRY( ptr, struct threadpool_object, pool_entry );
+        assert( object->num_pending_callbacks > 0 );
+
+        /* If further pending callbacks are queued, move the work item to
+         * the end of the pool list. Otherwise remove it from the pool. */
+        list_remove( &object->pool_entry );
+        pool->num_queued--;
+        if (object->num_pending_callbacks > 1)
+            tp_object_prio_queue( object );
+
+        tp_object_execute( object, FALSE );
+
+        assert(pool->num_busy_workers);
+        InterlockedDecrement( &pool->num_busy_workers );
+
+        tp_object_release( object );
+    }
+    RtlLeaveCriticalSection( &pool->cs );
+}
+
+/***********************************************************************
+ *           tp_worker_spin    (internal)
+ *
+ * Spins for a while before a worker thread goes to sleep. The spin count
+ * grows while spinning finds new work, and shrinks when it doesn't.
+ */
+static BOOL tp_worker_spin( struct threadpool *pool, unsigned int *spin )
+{
+    BOOL found = FALSE;
+    unsigned int i;
+
+    if (InterlockedIncrement( &pool->num_spinning ) <= THREADPOOL_MAX_SPINNING)
+    {
+        for (i = 0; i < *spin && !found; i++)
+        {
+            YieldProcessor();
+            found = pool->num_pending || pool->num_queued;
+        }
+    }
+    InterlockedDecrement( &pool->num_spinning );
+
+    if (found)
+        *spin = min( *spin * 2, THREADPOOL_SPIN_MAX );
+    else
+        *spin = max( *spin / 2, THREADPOOL_SPIN_MIN );
+    return found;
+}
+
 /***********************************************************************
  *           threadpool_worker_proc    (internal)
  */
 static void CALLBACK threadpool_worker_proc( void *param )
 {
     struct threadpool *pool = param;
+    struct threadpool_object *object;
+    struct threadpool_deque *deque;
+    unsigned int spin = THREADPOOL_SPIN_MIN;
     LARGE_INTEGER timeout;
-    struct list *ptr;
+    NTSTATUS status;
+    LONG seq;
 
     TRACE( "starting worker thread for pool %p\n", pool );
     set_thread_name(L"wine_threadpool_worker");
 
-    RtlEnterCriticalSection( &pool->cs );
+    deque = &pool->deques[(ULONG)InterlockedIncrement( &pool->next_deque ) % ARRAY_SIZE(pool->deques)];
+    if (NtCurrentTeb()->Peb->NumberOfProcessors <= 1) spin = 0;
+
     for (;;)
     {
-        while ((ptr = threadpool_get_next_item( pool )))
-        {
-            struct threadpool_object *object = LIST_ENTRY( ptr, struct threadpool_object, pool_entry );
-            assert( object->num_pending_callbacks > 0 );
+        /* Prioritized and regular work items are queued in the pool lists. */
+        if (pool->num_queued)
+            tp_worker_process_queue( pool );
 
-            /* If further pending callbacks are queued, move the work item to
-             * the end of the pool list. Otherwise remove it from the pool. */
-            list_remove( &object->pool_entry );
-            if (object->num_pending_callbacks > 1)
-                tp_object_prio_queue( object );
-
-            tp_object_execute( object, FALSE );
-
-            assert(pool->num_busy_workers);
-            pool->num_busy_workers--;
-
-            tp_object_release( object );
+        if ((object = tp_worker_next_simple( pool, deque )))
+        {
+            tp_object_execute_simple( object );
+            continue;
         }
 
-        /* Shutdown worker thread if requested. */
-        if (pool->shutdown)
-            break;
+        if (spin && tp_worker_spin( pool, &spin ))
+            continue;
 
-        /* Wait for new tasks or until the timeout expires. A thread only terminates
-         * when no new tasks are available, and the number of threads can be
-         * decreased without violating the min_workers limit. An exception is when
-         * min_workers == 0, then objcount is used to detect if the last thread
-         * can be terminated. */
+        /* Wait for new tasks or until the timeout expires. Idle threads
+         * exceeding the number of processors terminate sooner. */
+        seq = pool->wake_seq;
         timeout.QuadPart = (ULONGLONG)THREADPOOL_WORKER_TIMEOUT * -10000;
-        if (RtlSleepConditionVariableCS( &pool->update_event, &pool->cs, &timeout ) == STATUS_TIMEOUT &&
-            !threadpool_get_next_item( pool ) && (pool->num_workers > max( pool->min_workers, 1 ) ||
+        if (InterlockedIncrement( &pool->num_sleeping ) > (LONG)NtCurrentTeb()->Peb->NumberOfProcessors)
+            timeout.QuadPart /= 5;
+        if (pool->num_queued || pool->num_pending || pool->shutdown)
+            status = STATUS_SUCCESS;
+        else
+            status = RtlWaitOnAddress( &pool->wake_seq, &seq, sizeof(seq), &timeout );
+        InterlockedDecrement( &pool->num_sleeping );
+
+        if (status != STATUS_TIMEOUT && !pool->shutdown)
+            continue;
+
+        /* A thread only terminates when no new tasks are available, and the
+         * number of threads can be decreased without violating the min_workers
+         * limit. An exception is when min_workers == 0, then objcount is used
+         * to detect if the last thread can be terminated. Simple callbacks and
+         * new objects are added without holding the lock, so check again
+         * after updating num_workers. */
+        RtlEnterCriticalSection( &pool->cs );
+        if (!pool->num_queued && !pool->num_pending && (pool->shutdown ||
+            pool->num_workers > max( pool->min_workers, 1 ) ||
             (!pool->min_workers && !pool->objcount)))
         {
-            break;
+            pool->num_workers--;
+            MemoryBarrier();
+            if (pool->shutdown || (!pool->num_pending && (pool->num_workers || !pool->objcount)))
+                break;
+            pool->num_workers++;
         }
+        RtlLeaveCriticalSection( &pool->cs );
     }
-    pool->num_workers--;
     RtlLeaveCriticalSection( &pool->cs );
 
     TRACE( "terminating worker thread for pool %p\n", pool );
@@ -2969,7 +3364,6 @@ BOOL WINAPI TpSetPoolMinThreads( TP_POOL *pool, DWORD minimum )
 VOID WINAPI TpSetTimer( TP_TIMER *timer, LARGE_INTEGER *timeout, LONG period, LONG window_length )
 {
     struct threadpool_object *this = impl_from_TP_TIMER( timer );
-    struct threadpool_object *other_timer;
     BOOL submit_timer = FALSE;
     ULONGLONG timestamp;
 
@@ -3008,7 +3402,7 @@ VOID WINAPI TpSetTimer( TP_TIMER *timer, LARGE_INTEGER *timeout, LONG period, LO
     /* First remove existing timeout. */
     if (this->u.timer.timer_pending)
     {
-        list_remove( &this->u.timer.timer_entry );
+        tp_timerqueue_remove( this );
         this->u.timer.timer_pending = FALSE;
     }
 
@@ -3019,19 +3413,12 @@ VOID WINAPI TpSetTimer( TP_TIMER *timer, LARGE_INTEGER *timeout, LONG period, LO
         this->u.timer.period        = period;
         this->u.timer.window_length = window_length;
 
-        LIST_FOR_EACH_ENTRY( other_timer, &timerqueue.pending_timers,
-                             struct threadpool_object, u.timer.timer_entry )
-        {
-            assert( other_timer->type == TP_OBJECT_TYPE_TIMER );
-            if (this->u.timer.timeout < other_timer->u.timer.timeout)
-                break;
-        }
-        list_add_before( &other_timer->u.timer.timer_entry, &this->u.timer.timer_entry );
-
         /* Wake up the timer thread when the timeout has to be updated. */
-        if (list_head( &timerqueue.pending_timers ) == &this->u.timer.timer_entry )
+        if (timestamp < tp_timerqueue_next())
             RtlWakeAllConditionVariable( &timerqueue.update_event );
 
+        tp_timerqueue_insert( this );
+
         this->u.timer.timer_pending = TRUE;
     }
 
@@ -42,6 +42,9 @@
 #endif
 #include <poll.h>
 #include <sys/stat.h>
+#ifdef HAVE_SYS_INOTIFY_H
+# include <sys/inotify.h>
+#endif
 #ifdef HAVE_SYS_STATVFS_H
 # include <sys/statvfs.h>
 #endif
@@ -83,6 +86,11 @@
 #ifdef HAVE_LINUX_IOCTL_H
 #include <linux/ioctl.h>
 #endif
+#ifdef HAVE_LINUX_IO_URING_H
+# include <linux/io_uring.h>
+# include <sys/mman.h>
+# include <sys/uio.h>
+#endif
 #ifdef HAVE_LINUX_MAJOR_H
 # include <linux/major.h>
 #endif
@@ -120,6 +128,7 @@
 
 WINE_DEFAULT_DEBUG_CHANNEL(file);
 WINE_DECLARE_DEBUG_CHANNEL(winediag);
+WINE_DECLARE_DEBUG_CHANNEL(dircache);
 
 #define MAX_DOS_DRIVES 26
 
@@ -2511,6 +2520,380 @@ NTSTATUS WINAPI NtQueryDirectoryFile( HANDLE handle, HANDLE event, PIO_APC_ROUTI
 }
 
 
+#ifdef HAVE_SYS_INOTIFY_H
+
+/* Cache of the directory contents used for case-insensitive lookups, shared by all
+ * the threads. The cached directories are watched with inotify, and an entry is
+ * discarded as soon as anything is created, deleted or renamed in the directory.
+ * Directories that can't be watched (network file systems, inotify not available
+ * or out of watches) are cached too, but only the names found in them are used,
+ * after checking that they still exist; a name that isn't found there falls back
+ * to a directory scan. */
+
+#define DIR_LOOKUP_CACHE_SIZE 256  /* max. number of cached directories */
+#define DIR_LOOKUP_MAX_WATCHES 128 /* max. number of inotify watches */
+
+struct dir_lookup_name
+{
+    unsigned int  hash;       /* hash of the upper-case DOS name */
+    int           next;       /* next name in the hash chain, -1 if none */
+    unsigned int  len;        /* length of the DOS name in WCHARs */
+    unsigned int  name_pos;   /* offset of the DOS name in the names buffer */
+    unsigned int  unix_pos;   /* offset of the Unix name in the Unix names buffer */
+};
+
+struct dir_lookup
+{
+    struct list             entry;       /* entry in the LRU list */
+    char                   *path;        /* Unix path of the directory */
+    int                     wd;          /* inotify watch descriptor, -1 if not watched */
+    dev_t                   dev;         /* identity of the directory */
+    ino_t                   ino;
+    LARGE_INTEGER           mtime;       /* modification and change times of the directory */
+    LARGE_INTEGER           ctime;
+    unsigned int            count;       /* number of names */
+    unsigned int            hash_mask;   /* size of the hash table minus one */
+    int                    *buckets;     /* hash table of name indices */
+    struct dir_lookup_name *names;       /* names array */
+    WCHAR                  *namesW;      /* DOS names buffer */
+    char                   *unix_names;  /* Unix names buffer */
+};
+
+static struct list dir_lookup_list = LIST_INIT( dir_lookup_list );
+static unsigned int dir_lookup_count;
+static int dir_lookup_fd = -1;  /* inotify fd, -2 if not available */
+static unsigned int dir_lookup_watches;  /* number of inotify watches in use */
+static unsigned int dir_lookup_max_watches = DIR_LOOKUP_MAX_WATCHES;
+static pthread_mutex_t dir_lookup_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/* directory lookup cache statistics, dumped with WINEDEBUG=+dircache */
+static struct
+{
+    unsigned int hits;
+    unsigned int misses;
+    unsigned int invalidations;
+} dir_lookup_stats;
+
+static unsigned int hash_dir_name( const WCHAR *name, unsigned int len )
+{
+    unsigned int i, hash = 0;
+
+    for (i = 0; i < len; i++) hash = hash * 31 + towupper( name[i] );
+    return hash;
+}
+
+/* the same directory may be cached under several paths, sharing the watch */
+static BOOL is_dir_lookup_watch_used( int wd )
+{
+    struct dir_lookup *dir;
+
+    LIST_FOR_EACH_ENTRY( dir, &dir_lookup_list, struct dir_lookup, entry )
+        if (dir->wd == wd) return TRUE;
+    return FALSE;
+}
+
+/* remove an inotify watch unless it's still in use */
+static void release_dir_lookup_watch( int wd )
+{
+    if (wd == -1 || is_dir_lookup_watch_used( wd )) return;
+    inotify_rm_watch( dir_lookup_fd, wd );
+    dir_lookup_watches--;
+}
+
+/* inotify doesn't report the changes made by other clients of network file systems */
+static BOOL is_dir_watchable( const char *path )
+{
+    struct statfs stfs;
+
+    if (statfs( path, &stfs ) == -1) return FALSE;
+    switch (stfs.f_type)
+    {
+    case 0x6969:      /* nfs */
+    case 0xff534d42:  /* cifs */
+    case 0xfe534d42:  /* smb2 */
+    case 0x517b:      /* smbfs */
+    case 0x564c:      /* ncpfs */
+    case 0x65735546:  /* fuse */
+    case 0x01021997:  /* 9p */
+    case 0x00c36400:  /* ceph */
+    case 0x5346414f:  /* afs */
+        return FALSE;
+    }
+    return TRUE;
+}
+
+/* start watching a directory, if possible */
+static int add_dir_lookup_watch( const char *path )
+{
+    int wd;
+
+    if (dir_lookup_fd < 0 || dir_lookup_watches >= dir_lookup_max_watches) return -1;
+    if (!is_dir_watchable( path )) return -1;
+    wd = inotify_add_watch( dir_lookup_fd, path, IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO |
+                            IN_DELETE_SELF | IN_MOVE_SELF | IN_ONLYDIR );
+    if (wd == -1)
+    {
+        if (errno == ENOSPC)
+        {
+            /* the system-wide limit is shared with the other processes, don't retry past it */
+            WARN( "out of inotify watches, %u in use\n", dir_lookup_watches );
+            dir_lookup_max_watches = dir_lookup_watches;
+        }
+        return -1;
+    }
+    if (!is_dir_lookup_watch_used( wd )) dir_lookup_watches++;
+    return wd;
+}
+
+static void free_dir_lookup( struct dir_lookup *dir )
+{
+    list_remove( &dir->entry );
+    dir_lookup_count--;
+    release_dir_lookup_watch( dir->wd );
+
+    free( dir->path );
+    free( dir->buckets );
+    free( dir->names );
+    free( dir->namesW );
+    free( dir->unix_names );
+    free( dir );
+}
+
+/* discard the cached directories that have changed */
+static void process_dir_lookup_events(void)
+{
+    union
+    {
+        struct inotify_event event;
+        char buffer[4096];
+    } data;
+    struct inotify_event *event;
+    struct dir_lookup *dir, *next;
+    ssize_t size, pos;
+
+    while ((size = read( dir_lookup_fd, &data, sizeof(data) )) > 0)
+    {
+        for (pos = 0; pos < size; pos += sizeof(*event) + event->len)
+        {
+            event = (struct inotify_event *)(data.buffer + pos);
+            LIST_FOR_EACH_ENTRY_SAFE( dir, next, &dir_lookup_list, struct dir_lookup, entry )
+            {
+                if (!(event->mask & IN_Q_OVERFLOW) && dir->wd != event->wd) continue;
+                TRACE_(dircache)( "invalidating %s\n", debugstr_a(dir->path) );
+                free_dir_lookup( dir );
+                dir_lookup_stats.invalidations++;
+            }
+        }
+    }
+}
+
+static void *realloc_or_free( void *ptr, size_t size )
+{
+    void *ret = realloc( ptr, size );
+
+    if (!ret) free( ptr );
+    return ret;
+}
+
+/* read the contents of a directory into the cache */
+static struct dir_lookup *create_dir_lookup( const char *path, const struct stat *st )
+{
+    WCHAR buffer[MAX_DIR_ENTRY_LEN];
+    LARGE_INTEGER atime, creation;
+    struct dir_lookup *dir;
+    struct dirent *de;
+    unsigned int i, hash_size, names_size = 64, namesW_size = 1024, unix_size = 1024;
+    unsigned int namesW_pos = 0, unix_pos = 0;
+    size_t unix_len;
+    DIR *dirp;
+    int len;
+
+    if (!(dir = calloc( 1, sizeof(*dir) ))) return NULL;
+    dir->wd = -1;
+    if (!(dir->path = strdup( path ))) goto failed;
+
+    /* start watching before reading, so that no change can be missed */
+    dir->wd = add_dir_lookup_watch( path );
+    if (!(dirp = opendir( path ))) goto failed;
+
+    dir->names = malloc( names_size * sizeof(*dir->names) );
+    dir->namesW = malloc( namesW_size * sizeof(WCHAR) );
+    dir->unix_names = malloc( unix_size );
+    while (dir->names && dir->namesW && dir->unix_names && (de = readdir( dirp )))
+    {
+        unix_len = strlen( de->d_name ) + 1;
+        len = ntdll_umbstowcs( de->d_name, unix_len - 1, buffer, MAX_DIR_ENTRY_LEN );
+
+        if (dir->count == names_size)
+        {
+            names_size *= 2;
+            if (!(dir->names = realloc_or_free( dir->names, names_size * sizeof(*dir->names) ))) break;
+        }
+        while (namesW_pos + len > namesW_size)
+        {
+            namesW_size *= 2;
+            if (!(dir->namesW = realloc_or_free( dir->namesW, namesW_size * sizeof(WCHAR) ))) break;
+        }
+        while (unix_pos + unix_len > unix_size)
+        {
+            unix_size *= 2;
+            if (!(dir->unix_names = realloc_or_free( dir->unix_names, unix_size ))) break;
+        }
+        if (!dir->namesW || !dir->unix_names) break;
+
+        memcpy( dir->namesW + namesW_pos, buffer, len * sizeof(WCHAR) );
+        memcpy( dir->unix_names + unix_pos, de->d_name, unix_len );
+        dir->names[dir->count].hash = hash_dir_name( buffer, len );
+        dir->names[dir->count].len = len;
+        dir->names[dir->count].name_pos = namesW_pos;
+        dir->names[dir->count].unix_pos = unix_pos;
+        dir->count++;
+        namesW_pos += len;
+        unix_pos += unix_len;
+    }
+    closedir( dirp );
+    if (!dir->names || !dir->namesW || !dir->unix_names) goto failed;
+
+    for (hash_size = 16; hash_size < dir->count; hash_size *= 2) ;
+    if (!(dir->buckets = malloc( hash_size * sizeof(*dir->buckets) ))) goto failed;
+    dir->hash_mask = hash_size - 1;
+    memset( dir->buckets, 0xff, hash_size * sizeof(*dir->buckets) );
+    /* insert in reverse order so that the chains follow the directory order */
+    for (i = dir->count; i > 0; i--)
+    {
+        int *bucket = &dir->buckets[dir->names[i - 1].hash & dir->hash_mask];
+        dir->names[i - 1].next = *bucket;
+        *bucket = i - 1;
+    }
+
+    dir->dev = st->st_dev;
+    dir->ino = st->st_ino;
+    get_file_times( st, &dir->mtime, &dir->ctime, &atime, &creation );
+
+    list_add_head( &dir_lookup_list, &dir->entry );
+    if (++dir_lookup_count > DIR_LOOKUP_CACHE_SIZE)
+        free_dir_lookup( LIST_ENTRY( list_tail( &dir_lookup_list ), struct dir_lookup, entry ));
+    return dir;
+
+failed:
+    release_dir_lookup_watch( dir->wd );
+    free( dir->path );
+    free( dir->names );
+    free( dir->namesW );
+    free( dir->unix_names );
+    free( dir );
+    return NULL;
+}
+
+/***********************************************************************
+ *           lookup_dir_cache
+ *
+ * Find a file in a directory using the cached directory contents.
+ * The directory is in unix_name, and the file found is appended at pos.
+ * Return 1 if found, 0 if not found, and -1 if the cache can't be used.
+ */
+static int lookup_dir_cache( char *unix_name, int pos, const WCHAR *name, int length,
+                             BOOLEAN check_short )
+{
+    struct dir_lookup *dir;
+    struct stat st;
+    LARGE_INTEGER mtime, ctime, atime, creation;
+    const char *found = NULL;
+    unsigned int hash;
+    int i, ret;
+
+    if (stat( unix_name, &st ) == -1) return -1;
+    get_file_times( &st, &mtime, &ctime, &atime, &creation );
+
+    mutex_lock( &dir_lookup_mutex );
+
+    if (dir_lookup_fd == -1 && (dir_lookup_fd = inotify_init1( IN_NONBLOCK | IN_CLOEXEC )) == -1)
+    {
+        WARN( "inotify not available, only the existing names will be cached\n" );
+        dir_lookup_fd = -2;
+    }
+    if (dir_lookup_fd >= 0) process_dir_lookup_events();
+
+    LIST_FOR_EACH_ENTRY( dir, &dir_lookup_list, struct dir_lookup, entry )
+        if (!strcmp( dir->path, unix_name )) break;
+
+    if (&dir->entry != &dir_lookup_list &&
+        (dir->dev != st.st_dev || dir->ino != st.st_ino ||
+         dir->mtime.QuadPart != mtime.QuadPart || dir->ctime.QuadPart != ctime.QuadPart))
+    {
+        /* the directory has been replaced, or modified in a way inotify didn't catch */
+        free_dir_lookup( dir );
+        dir_lookup_stats.invalidations++;
+        dir = LIST_ENTRY( &dir_lookup_list, struct dir_lookup, entry );
+    }
+
+    if (&dir->entry != &dir_lookup_list)
+    {
+        dir_lookup_stats.hits++;
+        list_remove( &dir->entry );
+        list_add_head( &dir_lookup_list, &dir->entry );
+    }
+    else
+    {
+        dir_lookup_stats.misses++;
+        if (!(dir = create_dir_lookup( unix_name, &st )))
+        {
+            mutex_unlock( &dir_lookup_mutex );
+            return -1;
+        }
+    }
+
+    hash = hash_dir_name( name, length );
+    for (i = dir->buckets[hash & dir->hash_mask]; i != -1; i = dir->names[i].next)
+    {
+        if (dir->names[i].hash != hash || dir->names[i].len != length) continue;
+        if (wcsnicmp( dir->namesW + dir->names[i].name_pos, name, length )) continue;
+        found = dir->unix_names + dir->names[i].unix_pos;
+        break;
+    }
+
+    for (i = 0; !found && check_short && i < dir->count; i++)
+    {
+        const WCHAR *nameW = dir->namesW + dir->names[i].name_pos;
+        WCHAR short_nameW[12];
+
+        if (is_legal_8dot3_name( nameW, dir->names[i].len )) continue;
+        if (hash_short_file_name( nameW, dir->names[i].len, short_nameW ) != length) continue;
+        if (!wcsnicmp( short_nameW, name, length )) found = dir->unix_names + dir->names[i].unix_pos;
+    }
+
+    if (found)
+    {
+        unix_name[pos - 1] = '/';
+        strcpy( unix_name + pos, found );
+        ret = 1;
+        /* without a watch, the name may have been removed within the timestamp granularity */
+        if (dir->wd == -1 && lstat( unix_name, &st ) == -1)
+        {
+            unix_name[pos - 1] = 0;
+            ret = -1;
+        }
+    }
+    else ret = dir->wd == -1 ? -1 : 0;  /* don't trust a negative lookup without a watch */
+    mutex_unlock( &dir_lookup_mutex );
+    return ret;
+}
+
+#endif  /* HAVE_SYS_INOTIFY_H */
+
+
+/***********************************************************************
+ *           file_dump_stats
+ */
+void file_dump_stats(void)
+{
+#ifdef HAVE_SYS_INOTIFY_H
+    TRACE_(dircache)( "directory lookups: %u hits, %u misses, %u invalidations\n",
+                      dir_lookup_stats.hits, dir_lookup_stats.misses, dir_lookup_stats.invalidations );
+#endif
+}
+
+
 /***********************************************************************
  *           find_file_in_dir
  *
@@ -2601,6 +2984,14 @@ static NTSTATUS find_file_in_dir( char *unix_name, int pos, const WCHAR *name, i
     }
 #endif /* VFAT_IOCTL_READDIR_BOTH */
 
+#ifdef HAVE_SYS_INOTIFY_H
+    switch (lookup_dir_cache( unix_name, pos, name, length, is_name_8_dot_3 ))
+    {
+    case 1: return STATUS_SUCCESS;
+    case 0: goto not_found;
+    }
+#endif
+
     if (!(dir = opendir( unix_name ))) return errno_to_status( errno );
 
     unix_name[pos - 1] = '/';
@@ -4504,6 +4895,8 @@ NTSTATUS WINAPI NtSetInformationFile( HANDLE handle, IO_STATUS_BLOCK *io,
                 status = wine_server_call( req );
             }
             SERVER_END_REQ;
+            /* let the server return the new flags with the next socket I/O */
+            if (!status) sock_direct_io_revoke( handle );
         }
         else status = STATUS_INFO_LENGTH_MISMATCH;
         break;
@@ -5133,6 +5526,400 @@ void add_completion( HANDLE handle, ULONG_PTR value, NTSTATUS status, ULONG info
     SERVER_END_REQ;
 }
 
+/* When enabled with WINEIOURING=1, overlapped reads and writes at an explicit
+ * offset on regular files are submitted to an io_uring, so that they run
+ * asynchronously and many of them can be outstanding at once. A unix thread,
+ * which isn't visible to the Windows side and doesn't use the loader, reaps
+ * the results, stores them in the IO_STATUS_BLOCK and writes them to the
+ * client I/O pipe; the server then signals the event or the handle and posts
+ * the completion. The reaper has no TEB of its own, so it avoids tracing and
+ * server calls. */
+
+#if defined(HAVE_LINUX_IO_URING_H) && defined(__NR_io_uring_setup)
+
+struct uring_io
+{
+    struct list      entry;      /* entry in the list of submitted I/O */
+    HANDLE           handle;
+    unsigned int     id;         /* server id of the queued I/O */
+    IO_STATUS_BLOCK *io;
+    DWORD            tid;        /* thread that started the I/O */
+    int              fd;         /* unix fd, owned by the I/O */
+    BOOL             write;
+    struct iovec     iov;
+    ULONGLONG        offset;
+    int              result;     /* result of the read or write, or negative errno */
+};
+
+#define URING_ENTRIES 256
+
+static pthread_mutex_t uring_mutex = PTHREAD_MUTEX_INITIALIZER;
+/* signaled when some submitted I/O has been completed */
+static pthread_cond_t uring_cond = PTHREAD_COND_INITIALIZER;
+static struct list uring_ios = LIST_INIT( uring_ios );
+static unsigned int uring_count;   /* number of submitted I/O */
+static int uring_enabled = -1;
+static int uring_fd = -1;
+
+static struct
+{
+    unsigned int        *tail;
+    unsigned int        *mask;
+    unsigned int        *array;
+    struct io_uring_sqe *sqes;
+} uring_sq;
+
+static struct
+{
+    unsigned int        *head;
+    unsigned int        *tail;
+    unsigned int        *mask;
+    struct io_uring_cqe *cqes;
+} uring_cq;
+
+static int io_uring_enter( unsigned int to_submit, unsigned int min_complete, unsigned int flags )
+{
+    return syscall( __NR_io_uring_enter, uring_fd, to_submit, min_complete, flags, NULL, 0 );
+}
+
+static BOOL start_uring_reaper(void);
+
+/* create the ring and map its queues; uring_mutex must be held */
+static BOOL init_uring(void)
+{
+    struct io_uring_params params;
+    size_t sq_size, cq_size;
+    char *sq_ptr, *cq_ptr;
+    const char *env;
+    void *sqes;
+    int fd;
+
+    if (uring_enabled != -1) return uring_enabled;
+
+    uring_enabled = 0;
+    if ((env = getenv( "WINEIOURING" )) && atoi( env ) && server_init_client_io())
+    {
+        memset( &params, 0, sizeof(params) );
+        if ((fd = syscall( __NR_io_uring_setup, URING_ENTRIES, &params )) == -1)
+        {
+            WARN( "io_uring not available: %s\n", strerror( errno ) );
+            return FALSE;
+        }
+        fcntl( fd, F_SETFD, FD_CLOEXEC );
+
+        sq_size = params.sq_off.array + params.sq_entries * sizeof(unsigned int);
+        cq_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+        if (params.features & IORING_FEAT_SINGLE_MMAP) sq_size = cq_size = max( sq_size, cq_size );
+
+        sq_ptr = mmap( NULL, sq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING );
+        if (sq_ptr == MAP_FAILED) goto failed;
+        if (params.features & IORING_FEAT_SINGLE_MMAP) cq_ptr = sq_ptr;
+        else
+        {
+            cq_ptr = mmap( NULL, cq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING );
+            if (cq_ptr == MAP_FAILED)
+            {
+                munmap( sq_ptr, sq_size );
+                goto failed;
+            }
+        }
+        sqes = mmap( NULL, params.sq_entries * sizeof(struct io_uring_sqe), PROT_READ | PROT_WRITE,
+                     MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES );
+        if (sqes == MAP_FAILED)
+        {
+            if (cq_ptr != sq_ptr) munmap( cq_ptr, cq_size );
+            munmap( sq_ptr, sq_size );
+            goto failed;
+        }
+
+        uring_sq.tail  = (unsigned int *)(sq_ptr + params.sq_off.tail);
+        uring_sq.mask  = (unsigned int *)(sq_ptr + params.sq_off.ring_mask);
+        uring_sq.array = (unsigned int *)(sq_ptr + params.sq_off.array);
+        uring_sq.sqes  = sqes;
+        uring_cq.head  = (unsigned int *)(cq_ptr + params.cq_off.head);
+        uring_cq.tail  = (unsigned int *)(cq_ptr + params.cq_off.tail);
+        uring_cq.mask  = (unsigned int *)(cq_ptr + params.cq_off.ring_mask);
+        uring_cq.cqes  = (struct io_uring_cqe *)(cq_ptr + params.cq_off.cqes);
+        uring_fd = fd;
+        if (!start_uring_reaper())
+        {
+            ERR( "failed to start the io_uring reaper thread\n" );
+            uring_fd = -1;
+            close( fd );
+            return FALSE;
+        }
+        uring_enabled = 1;
+        TRACE( "using io_uring for overlapped file I/O\n" );
+    }
+    return uring_enabled;
+
+failed:
+    WARN( "failed to map the io_uring queues: %s\n", strerror( errno ) );
+    close( fd );
+    return FALSE;
+}
+
+/* errno_to_status() traces, which the reaper can't do; these are the errors of reads and writes on regular files */
+static NTSTATUS uring_errno_to_status( int err )
+{
+    switch (err)
+    {
+    case EBADF:  return STATUS_INVALID_HANDLE;
+    case ENOSPC:
+    case EFBIG:  return STATUS_DISK_FULL;
+    case EPERM:
+    case EACCES: return STATUS_ACCESS_DENIED;
+    case EINVAL: return STATUS_INVALID_PARAMETER;
+    case EIO:    return STATUS_DEVICE_NOT_READY;
+    case EFAULT: return STATUS_INVALID_USER_BUFFER;
+    default:     return STATUS_UNSUCCESSFUL;
+    }
+}
+
+/* store the result of an I/O and report it through the client I/O pipe */
+static void finish_uring_io( struct uring_io *op )
+{
+    int result = op->result, ret;
+    NTSTATUS status;
+    ULONG total = 0, done;
+
+    /* the kernel doesn't go through our page fault handler, so a read into write watched
+     * pages fails or stops short; finish it with the faults handled */
+    if (!op->write && (result == -EFAULT || (result >= 0 && result < op->iov.iov_len)))
+    {
+        done = max( result, 0 );
+        ret = virtual_locked_pread( op->fd, (char *)op->iov.iov_base + done, op->iov.iov_len - done,
+                                    op->offset + done );
+        if (ret != -1) result = done + ret;
+        else if (!done) result = -errno;
+    }
+
+    if (result >= 0)
+    {
+        total = result;
+        status = (total || op->write) ? STATUS_SUCCESS : STATUS_END_OF_FILE;
+    }
+    else status = uring_errno_to_status( -result );
+
+    op->io->Information = total;
+    op->io->u.Status = status;
+    server_report_client_io( op->id, status, total );
+    close( op->fd );
+}
+
+/* reap the completed I/O */
+static void process_uring_completions(void)
+{
+    struct uring_io *ops[64];
+    struct io_uring_cqe *cqe;
+    unsigned int i, count, head, tail;
+
+    io_uring_enter( 0, 1, IORING_ENTER_GETEVENTS );
+
+    mutex_lock( &uring_mutex );
+    head = *uring_cq.head;
+    tail = __atomic_load_n( uring_cq.tail, __ATOMIC_ACQUIRE );
+    for (count = 0; head != tail && count < ARRAY_SIZE(ops); head++, count++)
+    {
+        cqe = &uring_cq.cqes[head & *uring_cq.mask];
+        ops[count] = (struct uring_io *)(ULONG_PTR)cqe->user_data;
+        ops[count]->result = cqe->res;
+    }
+    __atomic_store_n( uring_cq.head, head, __ATOMIC_RELEASE );
+    mutex_unlock( &uring_mutex );
+
+    for (i = 0; i < count; i++) finish_uring_io( ops[i] );
+
+    mutex_lock( &uring_mutex );
+    for (i = 0; i < count; i++)
+    {
+        list_remove( &ops[i]->entry );
+        free( ops[i] );
+    }
+    uring_count -= count;
+    if (count) pthread_cond_broadcast( &uring_cond );
+    mutex_unlock( &uring_mutex );
+}
+
+static void *uring_reaper( void *arg )
+{
+    for (;;) process_uring_completions();
+    return NULL;
+}
+
+/* start the thread reaping the completions; it lives as long as the process */
+static BOOL start_uring_reaper(void)
+{
+    sigset_t sigset, old_sigset;
+    pthread_attr_t attr;
+    pthread_t thread;
+    int ret;
+
+    /* our signal handlers expect a TEB */
+    sigfillset( &sigset );
+    pthread_sigmask( SIG_SETMASK, &sigset, &old_sigset );
+    pthread_attr_init( &attr );
+    pthread_attr_setdetachstate( &attr, PTHREAD_CREATE_DETACHED );
+    ret = pthread_create( &thread, &attr, uring_reaper, NULL );
+    pthread_attr_destroy( &attr );
+    pthread_sigmask( SIG_SETMASK, &old_sigset, NULL );
+    return !ret;
+}
+
+/* submit an overlapped read or write on a regular file to the io_uring;
+ * STATUS_NOT_SUPPORTED means that it needs to be performed synchronously */
+static NTSTATUS uring_file_io( HANDLE handle, int unix_fd, int *needs_close, HANDLE event, ULONG_PTR cvalue,
+                               IO_STATUS_BLOCK *io, void *buffer, ULONG length, ULONGLONG offset, BOOL write )
+{
+    struct io_uring_sqe *sqe;
+    struct uring_io *op;
+    unsigned int index, tail;
+    NTSTATUS status;
+    int ret;
+
+    if (!uring_enabled || in_wow64_call()) return STATUS_NOT_SUPPORTED;
+    if (!(op = malloc( sizeof(*op) ))) return STATUS_NOT_SUPPORTED;
+
+    /* the I/O keeps its own fd, so that it isn't affected by the handle being closed */
+    if (*needs_close) op->fd = unix_fd;
+    else if ((op->fd = fcntl( unix_fd, F_DUPFD_CLOEXEC, 0 )) == -1)
+    {
+        free( op );
+        return STATUS_NOT_SUPPORTED;
+    }
+    op->handle       = handle;
+    op->io           = io;
+    op->tid          = GetCurrentThreadId();
+    op->write        = write;
+    op->iov.iov_base = buffer;
+    op->iov.iov_len  = length;
+    op->offset       = offset;
+
+    /* reserve a slot, the completion queue can't overflow as long as it's large enough for all of them */
+    mutex_lock( &uring_mutex );
+    if (!init_uring() || uring_count == URING_ENTRIES)
+    {
+        mutex_unlock( &uring_mutex );
+        if (!*needs_close) close( op->fd );
+        free( op );
+        return STATUS_NOT_SUPPORTED;
+    }
+    list_add_tail( &uring_ios, &op->entry );
+    uring_count++;
+    mutex_unlock( &uring_mutex );
+
+    /* reset the event and the handle state; the server keeps a reference to the file,
+     * the event and the port until the result is reported with the returned id */
+    SERVER_START_REQ( complete_fd_io )
+    {
+        req->handle = wine_server_obj_handle( handle );
+        req->event  = wine_server_obj_handle( event );
+        req->cvalue = cvalue;
+        req->status = STATUS_PENDING;
+        if (!(status = wine_server_call( req ))) op->id = reply->id;
+    }
+    SERVER_END_REQ;
+
+    if (status || !op->id)
+    {
+        mutex_lock( &uring_mutex );
+        list_remove( &op->entry );
+        uring_count--;
+        pthread_cond_broadcast( &uring_cond );
+        mutex_unlock( &uring_mutex );
+        if (!*needs_close) close( op->fd );
+        free( op );
+        return STATUS_NOT_SUPPORTED;
+    }
+    *needs_close = 0;
+
+    /* the reaper may complete the I/O before we return */
+    io->u.Status = STATUS_PENDING;
+
+    mutex_lock( &uring_mutex );
+    tail = *uring_sq.tail;
+    index = tail & *uring_sq.mask;
+    sqe = &uring_sq.sqes[index];
+    memset( sqe, 0, sizeof(*sqe) );
+    sqe->opcode    = write ? IORING_OP_WRITEV : IORING_OP_READV;
+    sqe->fd        = op->fd;
+    sqe->off       = offset;
+    sqe->addr      = (ULONG_PTR)&op->iov;
+    sqe->len       = 1;
+    sqe->user_data = (ULONG_PTR)op;
+    uring_sq.array[index] = index;
+    __atomic_store_n( uring_sq.tail, tail + 1, __ATOMIC_RELEASE );
+
+    while ((ret = io_uring_enter( 1, 0, 0 )) == -1 && errno == EINTR);
+    if (ret != 1)
+    {
+        WARN( "failed to submit I/O: %s\n", ret == -1 ? strerror( errno ) : "not consumed" );
+        __atomic_store_n( uring_sq.tail, tail, __ATOMIC_RELEASE );
+        mutex_unlock( &uring_mutex );
+
+        /* the I/O is already reported as pending, complete it here */
+        if (write) ret = pwrite( op->fd, buffer, length, offset );
+        else ret = virtual_locked_pread( op->fd, buffer, length, offset );
+        op->result = ret == -1 ? -errno : ret;
+        finish_uring_io( op );
+
+        mutex_lock( &uring_mutex );
+        list_remove( &op->entry );
+        uring_count--;
+        pthread_cond_broadcast( &uring_cond );
+        mutex_unlock( &uring_mutex );
+        free( op );
+        return STATUS_PENDING;
+    }
+    mutex_unlock( &uring_mutex );
+    TRACE( "%p %s %u bytes at %s\n", handle, write ? "write" : "read", length, wine_dbgstr_longlong( offset ));
+    return STATUS_PENDING;
+}
+
+/* wait for the I/O submitted to the io_uring on a handle to complete */
+BOOL file_uring_io_wait( HANDLE handle, IO_STATUS_BLOCK *io, BOOL only_thread )
+{
+    DWORD tid = GetCurrentThreadId();
+    struct uring_io *op;
+    BOOL found, ret = FALSE;
+
+    if (!uring_count || process_exiting) return FALSE;
+
+    mutex_lock( &uring_mutex );
+    for (;;)
+    {
+        found = FALSE;
+        LIST_FOR_EACH_ENTRY( op, &uring_ios, struct uring_io, entry )
+        {
+            if (op->handle != handle) continue;
+            if (only_thread && op->tid != tid) continue;
+            if (io && op->io != io) continue;
+            found = TRUE;
+            break;
+        }
+        if (!found) break;
+        ret = TRUE;
+        pthread_cond_wait( &uring_cond, &uring_mutex );
+    }
+    mutex_unlock( &uring_mutex );
+    return ret;
+}
+
+#else  /* defined(HAVE_LINUX_IO_URING_H) && defined(__NR_io_uring_setup) */
+
+static NTSTATUS uring_file_io( HANDLE handle, int unix_fd, int *needs_close, HANDLE event, ULONG_PTR cvalue,
+                               IO_STATUS_BLOCK *io, void *buffer, ULONG length, ULONGLONG offset, BOOL write )
+{
+    return STATUS_NOT_SUPPORTED;
+}
+
+BOOL file_uring_io_wait( HANDLE handle, IO_STATUS_BLOCK *io, BOOL only_thread )
+{
+    return FALSE;
+}
+
+#endif  /* defined(HAVE_LINUX_IO_URING_H) && defined(__NR_io_uring_setup) */
+
 static NTSTATUS set_pending_write( HANDLE device )
 {
     NTSTATUS status;
@@ -5190,6 +5977,13 @@ NTSTATUS WINAPI NtReadFile( HANDLE handle, HANDLE event, PIO_APC_ROUTINE apc, vo
 
         if (offset && offset->QuadPart != FILE_USE_FILE_POINTER_POSITION)
         {
+            if (async_read && !apc && length)
+            {
+                status = uring_file_io( handle, unix_handle, &needs_close, event, cvalue, io,
+                                        buffer, length, offset->QuadPart, FALSE );
+                if (status != STATUS_NOT_SUPPORTED) goto err;
+            }
+
             /* async I/O doesn't make sense on regular files */
             while ((result = virtual_locked_pread( unix_handle, buffer, length, offset->QuadPart )) == -1)
             {
@@ -5507,6 +6301,12 @@ NTSTATUS WINAPI NtWriteFile( HANDLE handle, HANDLE event, PIO_APC_ROUTINE apc, v
                 status = STATUS_INVALID_PARAMETER;
                 goto done;
             }
+            else if (async_write && !apc && length)
+            {
+                status = uring_file_io( handle, unix_handle, &needs_close, event, cvalue, io,
+                                        (void *)buffer, length, off, TRUE );
+                if (status != STATUS_NOT_SUPPORTED) goto err;
+            }
 
             /* async I/O doesn't make sense on regular files */
             while ((result = pwrite( unix_handle, buffer, length, off )) == -1)
@@ -5984,14 +6784,20 @@ NTSTATUS WINAPI NtFlushBuffersFile( HANDLE handle, IO_STATUS_BLOCK *io )
 NTSTATUS WINAPI NtCancelIoFile( HANDLE handle, IO_STATUS_BLOCK *io_status )
 {
     NTSTATUS status;
+    BOOL found;
 
     TRACE( "%p %p\n", handle, io_status );
 
+    found = sock_direct_io_cancel( handle, NULL, TRUE );
+    if (file_uring_io_wait( handle, NULL, TRUE )) found = TRUE;
+
     SERVER_START_REQ( cancel_async )
     {
         req->handle      = wine_server_obj_handle( handle );
         req->only_thread = TRUE;
-        if (!(status = wine_server_call( req )))
+        status = wine_server_call( req );
+        if (status == STATUS_NOT_FOUND && found) status = STATUS_SUCCESS;
+        if (!status)
         {
             io_status->u.Status = status;
             io_status->Information = 0;
@@ -6009,14 +6815,20 @@ NTSTATUS WINAPI NtCancelIoFile( HANDLE handle, IO_STATUS_BLOCK *io_status )
 NTSTATUS WINAPI NtCancelIoFileEx( HANDLE handle, IO_STATUS_BLOCK *io, IO_STATUS_BLOCK *io_status )
 {
     NTSTATUS status;
+    BOOL found;
 
     TRACE( "%p %p %p\n", handle, io, io_status );
 
+    found = sock_direct_io_cancel( handle, io, FALSE );
+    if (file_uring_io_wait( handle, io, FALSE )) found = TRUE;
+
     SERVER_START_REQ( cancel_async )
     {
         req->handle = wine_server_obj_handle( handle );
         req->iosb   = wine_server_client_ptr( io );
-        if (!(status = wine_server_call( req )))
+        status = wine_server_call( req );
+        if (status == STATUS_NOT_FOUND && found) status = STATUS_SUCCESS;
+        if (!status)
         {
             io_status->u.Status = status;
             io_status->Information = 0;
@@ -6954,6 +7766,8 @@ NTSTATUS WINAPI NtSetInformationObject( HANDLE handle, OBJECT_INFORMATION_CLASS
 
         if (len < sizeof(*p)) return STATUS_INVALID_BUFFER_SIZE;
 
+        if (p->ProtectFromClose) fast_sync_protect_from_close( handle );
+
         SERVER_START_REQ( set_handle_info )
         {
             req->handle = wine_server_obj_handle( handle );
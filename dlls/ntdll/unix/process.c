@@ -683,6 +683,8 @@ NTSTATUS WINAPI NtCreateUserProcess( HANDLE *process_handle_ptr, HANDLE *thread_
     NTSTATUS status;
     BOOL success = FALSE;
     HANDLE file_handle, process_info = 0, process_handle = 0, thread_handle = 0;
+    HANDLE close_list[4];
+    unsigned int nb_close = 0;
     struct object_attributes *objattr;
     data_size_t attr_len;
     char *winedebug = NULL;
@@ -926,10 +928,11 @@ NTSTATUS WINAPI NtCreateUserProcess( HANDLE *process_handle_ptr, HANDLE *thread_
     status = STATUS_SUCCESS;
 
 done:
-    if (file_handle) NtClose( file_handle );
-    if (process_info) NtClose( process_info );
-    if (process_handle) NtClose( process_handle );
-    if (thread_handle) NtClose( thread_handle );
+    if (file_handle) close_list[nb_close++] = file_handle;
+    if (process_info) close_list[nb_close++] = process_info;
+    if (process_handle) close_list[nb_close++] = process_handle;
+    if (thread_handle) close_list[nb_close++] = thread_handle;
+    if (nb_close) close_handles( close_list, nb_close );
     if (socketfd[0] != -1) close( socketfd[0] );
     if (unixdir != -1) close( unixdir );
     free( startup_info );
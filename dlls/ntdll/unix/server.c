@@ -247,25 +247,102 @@ static void read_reply_data( void *buffer, size_t size )
  *
  * Wait for a reply from the server.
  */
-static inline unsigned int wait_reply( struct __server_request_info *req )
+static inline unsigned int wait_reply( struct __server_request_info *req, data_size_t max_size )
 {
-    read_reply_data( &req->u.reply, sizeof(req->u.reply) );
-    if (req->u.reply.reply_header.reply_size)
-        read_reply_data( req->reply_data, req->u.reply.reply_header.reply_size );
+    struct iovec vec[2];
+    int ret;
+
+    /* fetch the reply header and its data in a single read in the common case */
+    vec[0].iov_base = &req->u.reply;
+    vec[0].iov_len  = sizeof(req->u.reply);
+    vec[1].iov_base = req->reply_data;
+    vec[1].iov_len  = max_size;
+    while ((ret = readv( ntdll_get_thread_data()->reply_fd, vec, max_size ? 2 : 1 )) < 0)
+    {
+        if (errno == EINTR) continue;
+        if (errno == EPIPE) abort_thread(0);
+        server_protocol_perror("read");
+    }
+    if (!ret) abort_thread(0);  /* the server closed the connection */
+
+    if (ret < (int)sizeof(req->u.reply))
+    {
+        read_reply_data( (char *)&req->u.reply + ret, sizeof(req->u.reply) - ret );
+        ret = 0;
+    }
+    else ret -= sizeof(req->u.reply);
+
+    if (req->u.reply.reply_header.reply_size > ret)
+        read_reply_data( (char *)req->reply_data + ret, req->u.reply.reply_header.reply_size - ret );
     return req->u.reply.reply_header.error;
 }
 
 
 /***********************************************************************
- *           server_call_unlocked
+ *           send_server_call
  */
-unsigned int server_call_unlocked( void *req_ptr )
+static unsigned int send_server_call( void *req_ptr )
 {
     struct __server_request_info * const req = req_ptr;
+    data_size_t max_size = req->u.req.request_header.reply_size;
     unsigned int ret;
 
     if ((ret = send_request( req ))) return ret;
-    return wait_reply( req );
+    return wait_reply( req, max_size );
+}
+
+
+/***********************************************************************/
+/* deferred handle closing
+ *
+ * Closing a handle to an unnamed synchronization object known from the
+ * shared sync cache has no effect that can be observed without going
+ * through the server, so NtClose only queues these handles. The queue is
+ * sent as a single close_handles request before the next server call of
+ * any thread of the process, or when it is full.
+ */
+
+static pthread_mutex_t deferred_close_mutex = PTHREAD_MUTEX_INITIALIZER;
+static obj_handle_t deferred_closes[64];
+static LONG deferred_close_count;
+
+/* send the deferred closes; caller must hold deferred_close_mutex with the signals blocked */
+static void flush_deferred_closes_locked(void)
+{
+    if (!deferred_close_count) return;
+
+    SERVER_START_REQ( close_handles )
+    {
+        wine_server_add_data( req, deferred_closes, deferred_close_count * sizeof(deferred_closes[0]) );
+        send_server_call( req );
+    }
+    SERVER_END_REQ;
+    deferred_close_count = 0;
+}
+
+/* queue the close of a handle; caller must have the signals blocked */
+static void defer_handle_close( HANDLE handle )
+{
+    mutex_lock( &deferred_close_mutex );
+    if (deferred_close_count == ARRAY_SIZE(deferred_closes)) flush_deferred_closes_locked();
+    deferred_closes[deferred_close_count++] = wine_server_obj_handle( handle );
+    mutex_unlock( &deferred_close_mutex );
+}
+
+
+/***********************************************************************
+ *           server_call_unlocked
+ */
+unsigned int server_call_unlocked( void *req_ptr )
+{
+    /* the closes must be done before anything can observe the handle table */
+    if (ReadNoFence( &deferred_close_count ))
+    {
+        mutex_lock( &deferred_close_mutex );
+        flush_deferred_closes_locked();
+        mutex_unlock( &deferred_close_mutex );
+    }
+    return send_server_call( req_ptr );
 }
 
 
@@ -893,6 +970,31 @@ static inline unsigned int handle_to_index( HANDLE handle, unsigned int *entry )
 }
 
 
+/* fd cache entry of a handle that is being closed, see close_handles */
+#define FD_CACHE_CLOSING_OPTIONS 1
+
+/***********************************************************************
+ *           get_fd_cache_block
+ *
+ * Caller must hold fd_cache_mutex.
+ */
+static BOOL get_fd_cache_block( unsigned int entry )
+{
+    if (fd_cache[entry]) return TRUE;
+
+    /* we need to allocate a new block of entries */
+    if (!entry) fd_cache[0] = fd_cache_initial_block;
+    else
+    {
+        void *ptr = anon_mmap_alloc( FD_CACHE_BLOCK_SIZE * sizeof(union fd_cache_entry),
+                                     PROT_READ | PROT_WRITE );
+        if (ptr == MAP_FAILED) return FALSE;
+        fd_cache[entry] = ptr;
+    }
+    return TRUE;
+}
+
+
 /***********************************************************************
  *           add_fd_to_cache
  *
@@ -910,26 +1012,51 @@ static BOOL add_fd_to_cache( HANDLE handle, int fd, enum server_fd_type type,
         return FALSE;
     }
 
-    if (!fd_cache[entry])  /* do we need to allocate a new block of entries? */
-    {
-        if (!entry) fd_cache[0] = fd_cache_initial_block;
-        else
-        {
-            void *ptr = anon_mmap_alloc( FD_CACHE_BLOCK_SIZE * sizeof(union fd_cache_entry),
-                                         PROT_READ | PROT_WRITE );
-            if (ptr == MAP_FAILED) return FALSE;
-            fd_cache[entry] = ptr;
-        }
-    }
+    if (!get_fd_cache_block( entry )) return FALSE;
 
     /* store fd+1 so that 0 can be used as the unset value */
     cache.s.fd = fd + 1;
     cache.s.type = type;
     cache.s.access = access;
     cache.s.options = options;
+    /* the entry can only be set if the handle isn't being closed */
+    return !InterlockedCompareExchange64( &fd_cache[entry][idx].data, cache.data, 0 );
+}
+
+
+/***********************************************************************
+ *           set_fd_cache_closing
+ *
+ * Mark the fd cache entry of a handle as being closed, so that no fd gets
+ * cached for it until the server is done, and return the previously cached fd.
+ * Caller must hold fd_cache_mutex.
+ */
+static int set_fd_cache_closing( HANDLE handle, LONG64 *closing )
+{
+    unsigned int entry, idx = handle_to_index( handle, &entry );
+    union fd_cache_entry cache;
+
+    if (entry >= FD_CACHE_ENTRIES || !get_fd_cache_block( entry )) return -1;
+
+    cache.data = 0;
+    cache.s.type = FD_TYPE_INVALID;
+    cache.s.options = FD_CACHE_CLOSING_OPTIONS;
+    *closing = cache.data;
     cache.data = interlocked_xchg64( &fd_cache[entry][idx].data, cache.data );
-    assert( !cache.s.fd );
-    return TRUE;
+    if (cache.s.type == FD_TYPE_INVALID || !cache.s.fd) return -1;
+    return cache.s.fd - 1;
+}
+
+
+/***********************************************************************
+ *           clear_fd_cache_closing
+ */
+static void clear_fd_cache_closing( HANDLE handle, LONG64 closing )
+{
+    unsigned int entry, idx = handle_to_index( handle, &entry );
+
+    if (entry < FD_CACHE_ENTRIES && fd_cache[entry])
+        InterlockedCompareExchange64( &fd_cache[entry][idx].data, 0, closing );
 }
 
 
@@ -947,8 +1074,8 @@ static inline NTSTATUS get_cached_fd( HANDLE handle, int *fd, enum server_fd_typ
     cache.data = InterlockedCompareExchange64( &fd_cache[entry][idx].data, 0, 0 );
     if (!cache.data) return STATUS_INVALID_HANDLE;
 
-    /* if fd type is invalid, fd stores an error value */
-    if (cache.s.type == FD_TYPE_INVALID) return cache.s.fd - 1;
+    /* if fd type is invalid, fd stores an error value, unless the handle is being closed */
+    if (cache.s.type == FD_TYPE_INVALID) return cache.s.fd ? cache.s.fd - 1 : STATUS_INVALID_HANDLE;
 
     *fd = cache.s.fd - 1;
     if (type) *type = cache.s.type;
@@ -977,6 +1104,178 @@ static int remove_fd_from_cache( HANDLE handle )
 }
 
 
+/***********************************************************************/
+/* shared synchronization objects support */
+
+union fast_sync_cache_entry
+{
+    LONG64 data;
+    struct
+    {
+        unsigned int index;      /* index in the shared area */
+        unsigned int type : 8;   /* FAST_SYNC_* type */
+        unsigned int access : 2; /* FAST_SYNC_ACCESS_* flags */
+        unsigned int defer_close : 1; /* unnamed object, the close can be deferred */
+    } s;
+};
+
+C_ASSERT( sizeof(union fast_sync_cache_entry) == sizeof(LONG64) );
+
+#define FAST_SYNC_ACCESS_WAIT   1  /* SYNCHRONIZE */
+#define FAST_SYNC_ACCESS_MODIFY 2  /* EVENT_MODIFY_STATE / SEMAPHORE_MODIFY_STATE */
+
+static union fast_sync_cache_entry *fast_sync_cache[FD_CACHE_ENTRIES];
+static union fast_sync_cache_entry fast_sync_cache_initial_block[FD_CACHE_BLOCK_SIZE];
+static fast_sync_t *fast_sync_area;
+static unsigned int fast_sync_count;  /* number of slots in the shared area */
+static int fast_sync_enabled = -1;
+
+/* map the shared area; caller must hold fd_cache_mutex */
+static BOOL map_fast_sync_area(void)
+{
+    obj_handle_t handle;
+    mem_size_t size = 0;
+    void *ptr;
+    int fd = -1;
+
+    if (fast_sync_enabled == -1)
+    {
+        const char *env = getenv( "WINEFASTSYNC" );
+        fast_sync_enabled = !env || atoi( env );
+    }
+    if (fast_sync_area || !fast_sync_enabled) return !!fast_sync_area;
+
+    SERVER_START_REQ( get_fast_sync_area )
+    {
+        if (!wine_server_call( req ))
+        {
+            size = reply->size;
+            fd = receive_fd( &handle );
+        }
+    }
+    SERVER_END_REQ;
+
+    fast_sync_enabled = 0;
+    if (fd == -1) return FALSE;
+    ptr = mmap( NULL, size, PROT_READ, MAP_SHARED, fd, 0 );
+    close( fd );
+    if (ptr == MAP_FAILED) return FALSE;
+    fast_sync_count = size / sizeof(fast_sync_t);
+    fast_sync_area = ptr;
+    fast_sync_enabled = 1;
+    return TRUE;
+}
+
+
+/***********************************************************************
+ *           cache_fast_sync
+ *
+ * Remember the shared state of a newly created or opened object handle.
+ */
+void cache_fast_sync( HANDLE handle, unsigned int index, unsigned int type, unsigned int access,
+                      BOOL unnamed )
+{
+    unsigned int entry, idx = handle_to_index( handle, &entry );
+    union fast_sync_cache_entry cache;
+    sigset_t sigset;
+
+    if (!index || !handle || entry >= FD_CACHE_ENTRIES) return;
+
+    server_enter_uninterrupted_section( &fd_cache_mutex, &sigset );
+
+    if (!map_fast_sync_area() || index >= fast_sync_count) goto done;
+
+    if (!fast_sync_cache[entry])  /* do we need to allocate a new block of entries? */
+    {
+        if (!entry) fast_sync_cache[0] = fast_sync_cache_initial_block;
+        else
+        {
+            void *ptr = anon_mmap_alloc( FD_CACHE_BLOCK_SIZE * sizeof(union fast_sync_cache_entry),
+                                         PROT_READ | PROT_WRITE );
+            if (ptr == MAP_FAILED) goto done;
+            fast_sync_cache[entry] = ptr;
+        }
+    }
+
+    cache.data = 0;
+    cache.s.index = index;
+    cache.s.type = type;
+    if (access & SYNCHRONIZE) cache.s.access |= FAST_SYNC_ACCESS_WAIT;
+    if (access & EVENT_MODIFY_STATE) cache.s.access |= FAST_SYNC_ACCESS_MODIFY;
+    cache.s.defer_close = unnamed;
+    interlocked_xchg64( &fast_sync_cache[entry][idx].data, cache.data );
+
+done:
+    server_leave_uninterrupted_section( &fd_cache_mutex, &sigset );
+}
+
+
+/***********************************************************************
+ *           get_fast_sync
+ *
+ * Return the shared state of an object handle, or NULL if the server has to be used.
+ * 'access' is SYNCHRONIZE for waiting, or the object's modify access right.
+ */
+fast_sync_t *get_fast_sync( HANDLE handle, unsigned int type, unsigned int access )
+{
+    unsigned int entry, idx = handle_to_index( handle, &entry );
+    union fast_sync_cache_entry cache;
+    unsigned int wanted = 0;
+    fast_sync_t *sync;
+
+    if (entry >= FD_CACHE_ENTRIES || !fast_sync_cache[entry]) return NULL;
+
+    cache.data = InterlockedCompareExchange64( &fast_sync_cache[entry][idx].data, 0, 0 );
+    if (!cache.data || (type && cache.s.type != type)) return NULL;
+
+    /* let the server report access errors */
+    if (access & SYNCHRONIZE) wanted |= FAST_SYNC_ACCESS_WAIT;
+    if (access & EVENT_MODIFY_STATE) wanted |= FAST_SYNC_ACCESS_MODIFY;
+    if ((cache.s.access & wanted) != wanted) return NULL;
+
+    sync = &fast_sync_area[cache.s.index];
+    if (sync->type != cache.s.type) return NULL;
+    return sync;
+}
+
+
+/***********************************************************************
+ *           remove_fast_sync_from_cache
+ *
+ * Return TRUE if the handle was cached and its close can be deferred.
+ */
+static BOOL remove_fast_sync_from_cache( HANDLE handle )
+{
+    unsigned int entry, idx = handle_to_index( handle, &entry );
+    union fast_sync_cache_entry cache;
+
+    if (entry >= FD_CACHE_ENTRIES || !fast_sync_cache[entry]) return FALSE;
+    cache.data = interlocked_xchg64( &fast_sync_cache[entry][idx].data, 0 );
+    return cache.data && cache.s.defer_close;
+}
+
+
+/***********************************************************************
+ *           fast_sync_protect_from_close
+ *
+ * The close of a protected handle must fail, so it can't be deferred anymore.
+ */
+void fast_sync_protect_from_close( HANDLE handle )
+{
+    unsigned int entry, idx = handle_to_index( handle, &entry );
+    union fast_sync_cache_entry cache, prev;
+
+    if (entry >= FD_CACHE_ENTRIES || !fast_sync_cache[entry]) return;
+    do
+    {
+        prev.data = InterlockedCompareExchange64( &fast_sync_cache[entry][idx].data, 0, 0 );
+        if (!prev.data || !prev.s.defer_close) return;
+        cache = prev;
+        cache.s.defer_close = 0;
+    } while (InterlockedCompareExchange64( &fast_sync_cache[entry][idx].data, cache.data, prev.data ) != prev.data);
+}
+
+
 /***********************************************************************
  *           server_get_unix_fd
  *
@@ -1079,6 +1378,59 @@ NTSTATUS CDECL wine_server_handle_to_fd( HANDLE handle, unsigned int access, int
 }
 
 
+static int client_io_pipe = -1;  /* write end of the pipe the client I/O results are sent through */
+
+static void init_client_io_pipe(void)
+{
+    unsigned int status;
+    int fds[2];
+
+    if (server_pipe( fds ) == -1) return;
+    wine_server_send_fd( fds[0] );
+    SERVER_START_REQ( set_client_io_pipe )
+    {
+        req->fd = fds[0];
+        status = wine_server_call( req );
+    }
+    SERVER_END_REQ;
+    close( fds[0] );
+    if (!status) client_io_pipe = fds[1];
+    else close( fds[1] );
+}
+
+
+/***********************************************************************
+ *           server_init_client_io
+ *
+ * Set up the pipe the results of the queued client-side I/O are reported through.
+ */
+BOOL server_init_client_io(void)
+{
+    static pthread_once_t once = PTHREAD_ONCE_INIT;
+
+    pthread_once( &once, init_client_io_pipe );
+    return client_io_pipe != -1;
+}
+
+
+/***********************************************************************
+ *           server_report_client_io
+ *
+ * Report the result of a client-side I/O queued with complete_fd_io.
+ * This doesn't need a server connection, so it can be used from the
+ * unix threads that don't have a TEB.
+ */
+void server_report_client_io( unsigned int id, NTSTATUS status, ULONG_PTR information )
+{
+    struct client_io_result result;
+
+    result.id          = id;
+    result.status      = status;
+    result.information = information;
+    while (write( client_io_pipe, &result, sizeof(result) ) == -1 && errno == EINTR);
+}
+
+
 /***********************************************************************
  *           server_pipe
  *
@@ -1646,12 +1998,21 @@ NTSTATUS WINAPI NtDuplicateObject( HANDLE source_process, HANDLE source, HANDLE
         return result.dup_handle.status;
     }
 
+    if (options & DUPLICATE_CLOSE_SOURCE)
+    {
+        sock_direct_io_close( source );
+        file_uring_io_wait( source, NULL, FALSE );
+    }
+
     server_enter_uninterrupted_section( &fd_cache_mutex, &sigset );
 
     /* always remove the cached fd; if the server request fails we'll just
      * retrieve it again */
     if (options & DUPLICATE_CLOSE_SOURCE)
+    {
         fd = remove_fd_from_cache( source );
+        remove_fast_sync_from_cache( source );
+    }
 
     SERVER_START_REQ( dup_handle )
     {
@@ -1694,6 +2055,60 @@ NTSTATUS WINAPI NtCompareObjects( HANDLE first, HANDLE second )
 }
 
 
+/***********************************************************************
+ *           close_handles
+ *
+ * Close a list of handles with a single server call. Return the status of the first failure.
+ */
+NTSTATUS close_handles( const HANDLE *handles, unsigned int count )
+{
+    obj_handle_t list[64];
+    int fds[ARRAY_SIZE(list)];
+    unsigned int i, pos, nb_fds;
+    sigset_t sigset;
+    LONG64 closing = 0;
+    NTSTATUS ret = STATUS_SUCCESS, status;
+
+    for (pos = 0; pos < count; pos += ARRAY_SIZE(list))
+    {
+        unsigned int nb_handles = 0;
+
+        nb_fds = 0;
+        for (i = pos; i < count && i < pos + ARRAY_SIZE(list); i++)
+        {
+            if (HandleToLong( handles[i] ) >= ~5 && HandleToLong( handles[i] ) <= ~0) continue;
+            sock_direct_io_close( handles[i] );
+            file_uring_io_wait( handles[i], NULL, FALSE );
+            list[nb_handles++] = wine_server_obj_handle( handles[i] );
+        }
+        if (!nb_handles) continue;
+
+        server_enter_uninterrupted_section( &fd_cache_mutex, &sigset );
+        for (i = 0; i < nb_handles; i++)
+        {
+            int fd = set_fd_cache_closing( wine_server_ptr_handle( list[i] ), &closing );
+
+            if (fd != -1) fds[nb_fds++] = fd;
+            remove_fast_sync_from_cache( wine_server_ptr_handle( list[i] ) );
+        }
+        /* the closing entries keep the fds from being cached again, the mutex isn't needed anymore */
+        server_leave_uninterrupted_section( &fd_cache_mutex, &sigset );
+
+        SERVER_START_REQ( close_handles )
+        {
+            wine_server_add_data( req, list, nb_handles * sizeof(list[0]) );
+            status = wine_server_call( req );
+        }
+        SERVER_END_REQ;
+        if (!ret) ret = status;
+
+        for (i = 0; i < nb_handles; i++) clear_fd_cache_closing( wine_server_ptr_handle( list[i] ), closing );
+        for (i = 0; i < nb_fds; i++) close( fds[i] );
+    }
+    return ret;
+}
+
+
 /**************************************************************************
  *           NtClose
  */
@@ -1707,11 +2122,20 @@ NTSTATUS WINAPI NtClose( HANDLE handle )
     if (HandleToLong( handle ) >= ~5 && HandleToLong( handle ) <= ~0)
         return STATUS_SUCCESS;
 
+    sock_direct_io_close( handle );
+    file_uring_io_wait( handle, NULL, FALSE );
+
     server_enter_uninterrupted_section( &fd_cache_mutex, &sigset );
 
     /* always remove the cached fd; if the server request fails we'll just
      * retrieve it again */
     fd = remove_fd_from_cache( handle );
+    if (remove_fast_sync_from_cache( handle ) && fd == -1)
+    {
+        defer_handle_close( handle );
+        server_leave_uninterrupted_section( &fd_cache_mutex, &sigset );
+        return STATUS_SUCCESS;
+    }
 
     SERVER_START_REQ( close_handle )
     {
@@ -27,7 +27,12 @@
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <fcntl.h>
 #include <unistd.h>
+#ifdef HAVE_SYS_EPOLL_H
+# include <sys/epoll.h>
+#endif
 #ifdef HAVE_IFADDRS_H
 # include <ifaddrs.h>
 #endif
@@ -848,14 +853,537 @@ static BOOL is_icmp_over_dgram( int fd )
 #endif
 }
 
+/* Overlapped I/O on connected stream sockets bound to a completion port is
+ * performed by a reactor thread of the process once the server has told us
+ * that it doesn't need to track the socket state. The server only gets told
+ * about the results, so that it can post completions and signal events. */
+
+#if defined(HAVE_SYS_EPOLL_H) && defined(HAVE_EPOLL_CREATE)
+
+/* The I/O queued on sockets handled by the client is performed by a unix
+ * thread, which isn't visible to the Windows side and doesn't use the loader.
+ * It has no TEB of its own, so it reports the results through the client I/O
+ * pipe instead of making server calls. */
+
+struct direct_io
+{
+    struct list          entry;        /* entry in the socket read or write queue */
+    struct async_fileio *async;        /* async_recv_ioctl or async_send_ioctl */
+    BOOL                 send;
+    unsigned int         id;           /* server id of the queued I/O */
+    IO_STATUS_BLOCK     *io;
+    DWORD                tid;          /* thread that started the I/O */
+    NTSTATUS             status;
+    ULONG_PTR            information;
+};
+
+struct direct_sock
+{
+    struct direct_sock *next;          /* next socket in the hash chain */
+    HANDLE              handle;
+    unsigned int        serial;        /* tells apart the sockets using the same handle value */
+    int                 fd;            /* private copy of the unix fd */
+    dev_t               dev;           /* identity of the socket, to detect a reused handle value */
+    ino_t               ino;
+    unsigned int        comp_flags;    /* FILE_SKIP_* completion flags */
+    unsigned int        events;        /* epoll events currently selected */
+    BOOL                revoked;       /* new I/O must go through the server again */
+    struct list         read_q;
+    struct list         write_q;
+};
+
+#define DIRECT_SOCK_HASH_SIZE 256
+
+static pthread_mutex_t direct_mutex = PTHREAD_MUTEX_INITIALIZER;
+/* held while reporting results to the server, so that closing a socket
+ * waits for the results the reactor is still reporting for it */
+static pthread_mutex_t direct_report_mutex = PTHREAD_MUTEX_INITIALIZER;
+static struct direct_sock *direct_socks[DIRECT_SOCK_HASH_SIZE];
+static unsigned int direct_sock_count;
+static unsigned int direct_sock_serial;
+static int reactor_fd = -1;
+
+static NTSTATUS try_send( int fd, struct async_send_ioctl *async );
+
+static inline struct direct_sock **direct_sock_bucket( HANDLE handle )
+{
+    return &direct_socks[((ULONG_PTR)handle >> 2) % DIRECT_SOCK_HASH_SIZE];
+}
+
+/* direct_mutex must be held */
+static struct direct_sock *find_direct_sock( HANDLE handle )
+{
+    struct direct_sock *sock;
+
+    for (sock = *direct_sock_bucket( handle ); sock; sock = sock->next)
+        if (sock->handle == handle) return sock;
+    return NULL;
+}
+
+/* select the events needed by the queued I/O; direct_mutex must be held */
+static void update_direct_sock_events( struct direct_sock *sock )
+{
+    struct epoll_event ev;
+    unsigned int events = 0;
+    int op;
+
+    if (!list_empty( &sock->read_q )) events |= EPOLLIN;
+    if (!list_empty( &sock->write_q )) events |= EPOLLOUT;
+    if (events == sock->events) return;
+
+    /* an idle socket is removed from the set, otherwise a hangup would be reported forever */
+    if (!events) op = EPOLL_CTL_DEL;
+    else if (!sock->events) op = EPOLL_CTL_ADD;
+    else op = EPOLL_CTL_MOD;
+
+    memset( &ev, 0, sizeof(ev) );
+    ev.events = events;
+    ev.data.u64 = ((UINT64)sock->serial << 32) | HandleToULong( sock->handle );
+    epoll_ctl( reactor_fd, op, sock->fd, &ev );
+    sock->events = events;
+}
+
+static NTSTATUS try_direct_io( int fd, struct async_fileio *async, BOOL send, ULONG_PTR *information )
+{
+    struct async_send_ioctl *send_async = (struct async_send_ioctl *)async;
+    NTSTATUS status;
+
+    if (!send) return try_recv( fd, (struct async_recv_ioctl *)async, information );
+
+    status = try_send( fd, send_async );
+    *information = send_async->sent_len;
+    return status;
+}
+
+/* direct_report_mutex must be held */
+static void finish_direct_io( struct direct_io *op )
+{
+    op->io->Status = op->status;
+    op->io->Information = op->information;
+    server_report_client_io( op->id, op->status, op->information );
+    release_fileio( op->async );
+    free( op );
+}
+
+/* direct_report_mutex must be held */
+static void abort_direct_io( struct list *ops, NTSTATUS status )
+{
+    struct direct_io *op, *next;
+
+    LIST_FOR_EACH_ENTRY_SAFE( op, next, ops, struct direct_io, entry )
+    {
+        op->status = status;
+        op->information = op->send ? ((struct async_send_ioctl *)op->async)->sent_len : 0;
+        finish_direct_io( op );
+    }
+}
+
+/* direct_mutex must be held */
+static void process_direct_queue( struct direct_sock *sock, struct list *queue, struct list *done )
+{
+    struct direct_io *op, *next;
+
+    LIST_FOR_EACH_ENTRY_SAFE( op, next, queue, struct direct_io, entry )
+    {
+        op->status = try_direct_io( sock->fd, op->async, op->send, &op->information );
+        if (op->status == STATUS_DEVICE_NOT_READY) break;
+        list_remove( &op->entry );
+        list_add_tail( done, &op->entry );
+    }
+}
+
+static void *direct_io_reactor( void *arg )
+{
+    struct epoll_event events[64];
+    struct direct_sock *sock;
+    struct direct_io *op, *next;
+    struct list done;
+    int i, count;
+
+    for (;;)
+    {
+        count = epoll_wait( reactor_fd, events, ARRAY_SIZE(events), -1 );
+
+        list_init( &done );
+        mutex_lock( &direct_mutex );
+        for (i = 0; i < count; i++)
+        {
+            /* events of sockets closed in the meantime are stale */
+            if (!(sock = find_direct_sock( ULongToHandle( (UINT)events[i].data.u64 )))) continue;
+            if (sock->serial != events[i].data.u64 >> 32) continue;
+            if (events[i].events & (EPOLLIN | EPOLLERR | EPOLLHUP))
+                process_direct_queue( sock, &sock->read_q, &done );
+            if (events[i].events & (EPOLLOUT | EPOLLERR | EPOLLHUP))
+                process_direct_queue( sock, &sock->write_q, &done );
+            update_direct_sock_events( sock );
+        }
+        mutex_lock( &direct_report_mutex );
+        mutex_unlock( &direct_mutex );
+
+        LIST_FOR_EACH_ENTRY_SAFE( op, next, &done, struct direct_io, entry )
+            finish_direct_io( op );
+        mutex_unlock( &direct_report_mutex );
+    }
+    return NULL;
+}
+
+/* start the reactor thread; it lives as long as the process */
+static BOOL start_direct_io_reactor(void)
+{
+    sigset_t sigset, old_sigset;
+    pthread_attr_t attr;
+    pthread_t thread;
+    int ret;
+
+    /* our signal handlers expect a TEB */
+    sigfillset( &sigset );
+    pthread_sigmask( SIG_SETMASK, &sigset, &old_sigset );
+    pthread_attr_init( &attr );
+    pthread_attr_setdetachstate( &attr, PTHREAD_CREATE_DETACHED );
+    ret = pthread_create( &thread, &attr, direct_io_reactor, NULL );
+    pthread_attr_destroy( &attr );
+    pthread_sigmask( SIG_SETMASK, &old_sigset, NULL );
+    return !ret;
+}
+
+static BOOL use_direct_io( PIO_APC_ROUTINE apc, int force_async, int unix_flags )
+{
+    return force_async && !apc && !(unix_flags & MSG_OOB) && !in_wow64_call();
+}
+
+/* remove a socket from the table and take its queued I/O; direct_mutex must be held */
+static struct direct_sock *remove_direct_sock( HANDLE handle, struct list *ops )
+{
+    struct direct_sock *sock, **prev;
+
+    for (prev = direct_sock_bucket( handle ); (sock = *prev); prev = &sock->next)
+        if (sock->handle == handle) break;
+    if (!sock) return NULL;
+
+    *prev = sock->next;
+    direct_sock_count--;
+    list_move_tail( ops, &sock->read_q );
+    list_move_tail( ops, &sock->write_q );
+    update_direct_sock_events( sock );
+    return sock;
+}
+
+/* abort the I/O of a socket removed from the table and free it; direct_mutex must be held, and is released */
+static void free_direct_sock( struct direct_sock *sock, struct list *ops )
+{
+    mutex_lock( &direct_report_mutex );
+    mutex_unlock( &direct_mutex );
+
+    abort_direct_io( ops, STATUS_CANCELLED );
+    mutex_unlock( &direct_report_mutex );
+
+    close( sock->fd );
+    free( sock );
+}
+
+/* check that a socket of the table is still the one the handle refers to; direct_mutex must be held */
+static BOOL is_same_direct_sock( struct direct_sock *sock, int fd )
+{
+    struct stat st;
+
+    return !fstat( fd, &st ) && st.st_dev == sock->dev && st.st_ino == sock->ino;
+}
+
+/* start handling the overlapped I/O on a socket in the reactor */
+static BOOL register_direct_sock( HANDLE handle, int fd, unsigned int comp_flags )
+{
+    struct direct_sock *sock, **bucket;
+    struct list ops = LIST_INIT( ops );
+    struct stat st;
+
+    if (fstat( fd, &st ) == -1 || !server_init_client_io()) return FALSE;
+
+    mutex_lock( &direct_mutex );
+    if ((sock = find_direct_sock( handle )))
+    {
+        if (is_same_direct_sock( sock, fd ))
+        {
+            sock->comp_flags = comp_flags;
+            sock->revoked = FALSE;
+            mutex_unlock( &direct_mutex );
+            return TRUE;
+        }
+        /* the handle value was reused for another socket */
+        free_direct_sock( remove_direct_sock( handle, &ops ), &ops );
+        mutex_lock( &direct_mutex );
+    }
+
+    if (reactor_fd == -1)
+    {
+        if ((reactor_fd = epoll_create( 64 )) == -1)
+        {
+            mutex_unlock( &direct_mutex );
+            return FALSE;
+        }
+        fcntl( reactor_fd, F_SETFD, FD_CLOEXEC );
+        if (!start_direct_io_reactor())
+        {
+            ERR( "failed to start the socket reactor thread\n" );
+            close( reactor_fd );
+            reactor_fd = -1;
+            mutex_unlock( &direct_mutex );
+            return FALSE;
+        }
+    }
+    if (!(sock = malloc( sizeof(*sock) )))
+    {
+        mutex_unlock( &direct_mutex );
+        return FALSE;
+    }
+    if ((sock->fd = fcntl( fd, F_DUPFD_CLOEXEC, 0 )) == -1)
+    {
+        mutex_unlock( &direct_mutex );
+        free( sock );
+        return FALSE;
+    }
+    sock->handle = handle;
+    sock->serial = ++direct_sock_serial;
+    sock->dev = st.st_dev;
+    sock->ino = st.st_ino;
+    sock->comp_flags = comp_flags;
+    sock->events = 0;
+    sock->revoked = FALSE;
+    list_init( &sock->read_q );
+    list_init( &sock->write_q );
+
+    bucket = direct_sock_bucket( handle );
+    sock->next = *bucket;
+    *bucket = sock;
+    direct_sock_count++;
+    mutex_unlock( &direct_mutex );
+
+    TRACE( "handling I/O on %p directly\n", handle );
+    return TRUE;
+}
+
+/* perform an overlapped I/O on a socket handled by the reactor;
+ * STATUS_NOT_SUPPORTED means that it needs to go through the server */
+static NTSTATUS direct_sock_io( HANDLE handle, int fd, HANDLE event, void *apc_user, IO_STATUS_BLOCK *io,
+                                struct async_fileio *async, BOOL send )
+{
+    struct list ops = LIST_INIT( ops );
+    struct direct_sock *sock;
+    struct direct_io *op;
+    ULONG_PTR information = 0;
+    unsigned int comp_flags, serial, id = 0;
+    struct list *queue;
+    NTSTATUS status;
+
+    if (!direct_sock_count) return STATUS_NOT_SUPPORTED;
+
+    mutex_lock( &direct_mutex );
+    if (!(sock = find_direct_sock( handle )))
+    {
+        mutex_unlock( &direct_mutex );
+        return STATUS_NOT_SUPPORTED;
+    }
+    if (!is_same_direct_sock( sock, fd ))
+    {
+        /* the socket was closed without us knowing, and the handle value reused */
+        free_direct_sock( remove_direct_sock( handle, &ops ), &ops );
+        return STATUS_NOT_SUPPORTED;
+    }
+    queue = send ? &sock->write_q : &sock->read_q;
+    /* I/O which is already queued must complete first */
+    if (!list_empty( queue )) status = STATUS_DEVICE_NOT_READY;
+    else if (sock->revoked) status = STATUS_NOT_SUPPORTED;
+    else status = try_direct_io( sock->fd, async, send, &information );
+    comp_flags = sock->comp_flags;
+    serial = sock->serial;
+    mutex_unlock( &direct_mutex );
+
+    if (status == STATUS_NOT_SUPPORTED) return status;
+
+    if (status != STATUS_DEVICE_NOT_READY)
+    {
+        /* as in async_set_result(), there's nothing to signal if the I/O failed right away */
+        if (!NT_ERROR(status))
+        {
+            io->Status = status;
+            io->Information = information;
+            if (event || !(comp_flags & FILE_SKIP_SET_EVENT_ON_HANDLE) ||
+                (apc_user && !(comp_flags & FILE_SKIP_COMPLETION_PORT_ON_SUCCESS)))
+            {
+                SERVER_START_REQ( complete_fd_io )
+                {
+                    req->handle      = wine_server_obj_handle( handle );
+                    req->event       = wine_server_obj_handle( event );
+                    req->cvalue      = wine_server_client_ptr( apc_user );
+                    req->information = information;
+                    req->status      = status;
+                    if (wine_server_call( req )) WARN( "failed to report result %#x for %p\n", status, handle );
+                }
+                SERVER_END_REQ;
+            }
+        }
+        release_fileio( async );
+        return status;
+    }
+
+    if (!(op = malloc( sizeof(*op) ))) return STATUS_NOT_SUPPORTED;
+
+    /* reset the event and the handle state before the reactor can signal them; the server keeps
+     * a reference to the socket, the event and the port until the result is reported with the id */
+    SERVER_START_REQ( complete_fd_io )
+    {
+        req->handle = wine_server_obj_handle( handle );
+        req->event  = wine_server_obj_handle( event );
+        req->cvalue = wine_server_client_ptr( apc_user );
+        req->status = STATUS_PENDING;
+        if (!wine_server_call( req )) id = reply->id;
+    }
+    SERVER_END_REQ;
+
+    if (!id)
+    {
+        free( op );
+        return STATUS_NOT_SUPPORTED;
+    }
+    op->async = async;
+    op->send  = send;
+    op->id    = id;
+    op->io    = io;
+    op->tid   = GetCurrentThreadId();
+
+    mutex_lock( &direct_mutex );
+    if (!(sock = find_direct_sock( handle )) || sock->serial != serial)
+    {
+        /* the socket has been closed in the meantime, which cancels the I/O */
+        mutex_unlock( &direct_mutex );
+        io->Status = STATUS_CANCELLED;
+        io->Information = 0;
+        server_report_client_io( id, STATUS_CANCELLED, 0 );
+        release_fileio( async );
+        free( op );
+        return STATUS_PENDING;
+    }
+    list_add_tail( send ? &sock->write_q : &sock->read_q, &op->entry );
+    update_direct_sock_events( sock );
+    mutex_unlock( &direct_mutex );
+    return STATUS_PENDING;
+}
+
+/* direct_mutex must be held */
+static void take_direct_io( struct list *queue, struct list *ops, IO_STATUS_BLOCK *io, BOOL only_thread )
+{
+    struct direct_io *op, *next;
+    DWORD tid = GetCurrentThreadId();
+
+    LIST_FOR_EACH_ENTRY_SAFE( op, next, queue, struct direct_io, entry )
+    {
+        if (only_thread && op->tid != tid) continue;
+        if (io && op->io != io) continue;
+        list_remove( &op->entry );
+        list_add_tail( ops, &op->entry );
+    }
+}
+
+/* cancel the I/O performed by the reactor on a socket handle */
+BOOL sock_direct_io_cancel( HANDLE handle, IO_STATUS_BLOCK *io, BOOL only_thread )
+{
+    struct direct_sock *sock;
+    struct list ops;
+
+    if (!direct_sock_count) return FALSE;
+
+    list_init( &ops );
+    mutex_lock( &direct_mutex );
+    if (!(sock = find_direct_sock( handle )))
+    {
+        mutex_unlock( &direct_mutex );
+        return FALSE;
+    }
+    take_direct_io( &sock->read_q, &ops, io, only_thread );
+    take_direct_io( &sock->write_q, &ops, io, only_thread );
+    update_direct_sock_events( sock );
+    mutex_lock( &direct_report_mutex );
+    mutex_unlock( &direct_mutex );
+
+    if (list_empty( &ops ))
+    {
+        mutex_unlock( &direct_report_mutex );
+        return FALSE;
+    }
+    abort_direct_io( &ops, STATUS_CANCELLED );
+    mutex_unlock( &direct_report_mutex );
+    return TRUE;
+}
+
+/* make new I/O on a socket handle go through the server again */
+void sock_direct_io_revoke( HANDLE handle )
+{
+    struct direct_sock *sock;
+
+    if (!direct_sock_count) return;
+
+    mutex_lock( &direct_mutex );
+    if ((sock = find_direct_sock( handle ))) sock->revoked = TRUE;
+    mutex_unlock( &direct_mutex );
+}
+
+/* abort the I/O performed by the reactor on a socket handle being closed */
+void sock_direct_io_close( HANDLE handle )
+{
+    struct direct_sock *sock;
+    struct list ops = LIST_INIT( ops );
+
+    if (!direct_sock_count) return;
+
+    mutex_lock( &direct_mutex );
+    if (!(sock = remove_direct_sock( handle, &ops )))
+    {
+        mutex_unlock( &direct_mutex );
+        return;
+    }
+    free_direct_sock( sock, &ops );
+}
+
+#else  /* defined(HAVE_SYS_EPOLL_H) && defined(HAVE_EPOLL_CREATE) */
+
+static BOOL use_direct_io( PIO_APC_ROUTINE apc, int force_async, int unix_flags )
+{
+    return FALSE;
+}
+
+static BOOL register_direct_sock( HANDLE handle, int fd, unsigned int comp_flags )
+{
+    return FALSE;
+}
+
+static NTSTATUS direct_sock_io( HANDLE handle, int fd, HANDLE event, void *apc_user, IO_STATUS_BLOCK *io,
+                                struct async_fileio *async, BOOL send )
+{
+    return STATUS_NOT_SUPPORTED;
+}
+
+BOOL sock_direct_io_cancel( HANDLE handle, IO_STATUS_BLOCK *io, BOOL only_thread )
+{
+    return FALSE;
+}
+
+void sock_direct_io_revoke( HANDLE handle )
+{
+}
+
+void sock_direct_io_close( HANDLE handle )
+{
+}
+
+#endif  /* defined(HAVE_SYS_EPOLL_H) && defined(HAVE_EPOLL_CREATE) */
+
 static NTSTATUS sock_recv( HANDLE handle, HANDLE event, PIO_APC_ROUTINE apc, void *apc_user, IO_STATUS_BLOCK *io,
                            int fd, struct async_recv_ioctl *async, int force_async )
 {
-    BOOL nonblocking, alerted;
+    BOOL nonblocking, alerted, direct;
+    unsigned int i, comp_flags;
     ULONG_PTR information;
     HANDLE wait_handle;
     NTSTATUS status;
-    unsigned int i;
     ULONG options;
 
     for (i = 0; i < async->count; ++i)
@@ -867,17 +1395,34 @@ static NTSTATUS sock_recv( HANDLE handle, HANDLE event, PIO_APC_ROUTINE apc, voi
         }
     }
 
-    SERVER_START_REQ( recv_socket )
+    direct = use_direct_io( apc, force_async, async->unix_flags );
+    if (direct && (status = direct_sock_io( handle, fd, event, apc_user, io, &async->io, FALSE )) != STATUS_NOT_SUPPORTED)
+        return status;
+
+    for (;;)
     {
-        req->force_async = force_async;
-        req->async  = server_async( handle, &async->io, event, apc, apc_user, iosb_client_ptr(io) );
-        req->oob    = !!(async->unix_flags & MSG_OOB);
-        status = wine_server_call( req );
-        wait_handle = wine_server_ptr_handle( reply->wait );
-        options     = reply->options;
-        nonblocking = reply->nonblocking;
+        SERVER_START_REQ( recv_socket )
+        {
+            req->force_async = force_async;
+            req->async  = server_async( handle, &async->io, event, apc, apc_user, iosb_client_ptr(io) );
+            req->oob    = !!(async->unix_flags & MSG_OOB);
+            req->direct = direct;
+            status = wine_server_call( req );
+            wait_handle = wine_server_ptr_handle( reply->wait );
+            options     = reply->options;
+            nonblocking = reply->nonblocking;
+            direct      = reply->direct;
+            comp_flags  = reply->comp_flags;
+        }
+        SERVER_END_REQ;
+
+        /* the server didn't queue anything, the I/O is up to us */
+        if (!direct) break;
+        if (register_direct_sock( handle, fd, comp_flags ) &&
+            (status = direct_sock_io( handle, fd, event, apc_user, io, &async->io, FALSE )) != STATUS_NOT_SUPPORTED)
+            return status;
+        direct = FALSE;
     }
-    SERVER_END_REQ;
 
     alerted = status == STATUS_ALERTED;
     if (alerted)
@@ -1097,22 +1642,40 @@ static void sock_save_icmp_id( struct async_send_ioctl *async )
 static NTSTATUS sock_send( HANDLE handle, HANDLE event, PIO_APC_ROUTINE apc, void *apc_user,
                            IO_STATUS_BLOCK *io, int fd, struct async_send_ioctl *async, int force_async )
 {
-    BOOL nonblocking, alerted;
+    BOOL nonblocking, alerted, direct;
+    unsigned int comp_flags;
     ULONG_PTR information;
     HANDLE wait_handle;
     NTSTATUS status;
     ULONG options;
 
-    SERVER_START_REQ( send_socket )
+    direct = use_direct_io( apc, force_async, async->unix_flags );
+    if (direct && (status = direct_sock_io( handle, fd, event, apc_user, io, &async->io, TRUE )) != STATUS_NOT_SUPPORTED)
+        return status;
+
+    for (;;)
     {
-        req->force_async = force_async;
-        req->async  = server_async( handle, &async->io, event, apc, apc_user, iosb_client_ptr(io) );
-        status = wine_server_call( req );
-        wait_handle = wine_server_ptr_handle( reply->wait );
-        options     = reply->options;
-        nonblocking = reply->nonblocking;
+        SERVER_START_REQ( send_socket )
+        {
+            req->force_async = force_async;
+            req->async  = server_async( handle, &async->io, event, apc, apc_user, iosb_client_ptr(io) );
+            req->direct = direct;
+            status = wine_server_call( req );
+            wait_handle = wine_server_ptr_handle( reply->wait );
+            options     = reply->options;
+            nonblocking = reply->nonblocking;
+            direct      = reply->direct;
+            comp_flags  = reply->comp_flags;
+        }
+        SERVER_END_REQ;
+
+        /* the server didn't queue anything, the I/O is up to us */
+        if (!direct) break;
+        if (register_direct_sock( handle, fd, comp_flags ) &&
+            (status = direct_sock_io( handle, fd, event, apc_user, io, &async->io, TRUE )) != STATUS_NOT_SUPPORTED)
+            return status;
+        direct = FALSE;
     }
-    SERVER_END_REQ;
 
     if (!NT_ERROR(status) && is_icmp_over_dgram( fd ))
         sock_save_icmp_id( async );
@@ -1529,6 +2092,7 @@ NTSTATUS sock_ioctl( HANDLE handle, HANDLE event, PIO_APC_ROUTINE apc, void *apc
 
             TRACE( "event %p, mask %#x\n", params->event, params->mask );
             if (out_size) FIXME( "unexpected output size %u\n", out_size );
+            sock_direct_io_revoke( handle );
 
             status = STATUS_BAD_DEVICE_TYPE;
             break;
@@ -1672,6 +2236,7 @@ NTSTATUS sock_ioctl( HANDLE handle, HANDLE event, PIO_APC_ROUTINE apc, void *apc
                 status = STATUS_BUFFER_TOO_SMALL;
                 break;
             }
+            sock_direct_io_revoke( handle );
             status = sock_transmit( handle, event, apc, apc_user, io, fd, params );
             if (needs_close) close( fd );
             return status;
@@ -2501,7 +3066,11 @@ NTSTATUS sock_ioctl( HANDLE handle, HANDLE event, PIO_APC_ROUTINE apc, void *apc
         {
             if ((code >> 16) == FILE_DEVICE_NETWORK)
             {
-                /* Wine-internal ioctl */
+                /* Wine-internal ioctl; the server needs to see the I/O
+                 * following the state changes made by these ones */
+                if (code == IOCTL_AFD_WINE_MESSAGE_SELECT || code == IOCTL_AFD_WINE_FIONBIO ||
+                    code == IOCTL_AFD_WINE_SHUTDOWN)
+                    sock_direct_io_revoke( handle );
                 status = STATUS_BAD_DEVICE_TYPE;
             }
             else
@@ -150,6 +150,53 @@ static inline int use_futexes(void)
 #endif
 
 
+/* shared synchronization objects: the server publishes the state of the objects created by
+ * the process, which lets us skip the requests that couldn't change anything */
+
+/* set or reset an event that is already in that state */
+static NTSTATUS fast_event_op( HANDLE handle, unsigned int new, LONG *prev_state )
+{
+    fast_sync_t *sync;
+
+    if (!(sync = get_fast_sync( handle, FAST_SYNC_EVENT, EVENT_MODIFY_STATE ))) return STATUS_NOT_IMPLEMENTED;
+    if (sync->state != new) return STATUS_NOT_IMPLEMENTED;
+    if (prev_state) *prev_state = new;
+    return STATUS_SUCCESS;
+}
+
+/* satisfy a wait on a single object without a server round-trip if the wait can't change its state */
+static NTSTATUS fast_wait( HANDLE handle, const LARGE_INTEGER *timeout )
+{
+    unsigned int tid = HandleToULong( NtCurrentTeb()->ClientId.UniqueThread );
+    unsigned int state;
+    fast_sync_t *sync;
+
+    if (!(sync = get_fast_sync( handle, 0, SYNCHRONIZE ))) return STATUS_NOT_IMPLEMENTED;
+
+    state = sync->state;
+    switch (sync->type)
+    {
+    case FAST_SYNC_EVENT:
+        if (!state) break;
+        /* a wait doesn't reset a manual reset event */
+        if (sync->data) return STATUS_WAIT_0;
+        return STATUS_NOT_IMPLEMENTED;
+    case FAST_SYNC_SEMAPHORE:
+        if (!state) break;
+        return STATUS_NOT_IMPLEMENTED;
+    case FAST_SYNC_MUTEX:
+        if (state && state != tid) break;
+        return STATUS_NOT_IMPLEMENTED;
+    default:
+        return STATUS_NOT_IMPLEMENTED;
+    }
+
+    /* the object isn't available */
+    if (timeout && !timeout->QuadPart) return STATUS_TIMEOUT;
+    return STATUS_NOT_IMPLEMENTED;
+}
+
+
 /* create a struct security_descriptor and contained information in one contiguous piece of memory */
 NTSTATUS alloc_object_attributes( const OBJECT_ATTRIBUTES *attr, struct object_attributes **ret,
                                   data_size_t *ret_len )
@@ -259,6 +306,13 @@ static NTSTATUS validate_open_object_attributes( const OBJECT_ATTRIBUTES *attr )
 }
 
 
+/* the close of an unnamed object can be deferred, see NtClose */
+static inline BOOL is_unnamed( const OBJECT_ATTRIBUTES *attr )
+{
+    return !attr || !attr->ObjectName || !attr->ObjectName->Length;
+}
+
+
 /******************************************************************************
  *              NtCreateSemaphore (NTDLL.@)
  */
@@ -281,6 +335,8 @@ NTSTATUS WINAPI NtCreateSemaphore( HANDLE *handle, ACCESS_MASK access, const OBJ
         wine_server_add_data( req, objattr, len );
         ret = wine_server_call( req );
         *handle = wine_server_ptr_handle( reply->handle );
+        if (!ret) cache_fast_sync( *handle, reply->fast_sync, FAST_SYNC_SEMAPHORE, reply->access,
+                                  is_unnamed( attr ));
     }
     SERVER_END_REQ;
 
@@ -308,6 +364,7 @@ NTSTATUS WINAPI NtOpenSemaphore( HANDLE *handle, ACCESS_MASK access, const OBJEC
             wine_server_add_data( req, attr->ObjectName->Buffer, attr->ObjectName->Length );
         ret = wine_server_call( req );
         *handle = wine_server_ptr_handle( reply->handle );
+        if (!ret) cache_fast_sync( *handle, reply->fast_sync, FAST_SYNC_SEMAPHORE, reply->access, FALSE );
     }
     SERVER_END_REQ;
     return ret;
@@ -391,6 +448,8 @@ NTSTATUS WINAPI NtCreateEvent( HANDLE *handle, ACCESS_MASK access, const OBJECT_
         wine_server_add_data( req, objattr, len );
         ret = wine_server_call( req );
         *handle = wine_server_ptr_handle( reply->handle );
+        if (!ret) cache_fast_sync( *handle, reply->fast_sync, FAST_SYNC_EVENT, reply->access,
+                                  is_unnamed( attr ));
     }
     SERVER_END_REQ;
 
@@ -418,6 +477,7 @@ NTSTATUS WINAPI NtOpenEvent( HANDLE *handle, ACCESS_MASK access, const OBJECT_AT
             wine_server_add_data( req, attr->ObjectName->Buffer, attr->ObjectName->Length );
         ret = wine_server_call( req );
         *handle = wine_server_ptr_handle( reply->handle );
+        if (!ret) cache_fast_sync( *handle, reply->fast_sync, FAST_SYNC_EVENT, reply->access, FALSE );
     }
     SERVER_END_REQ;
     return ret;
@@ -431,6 +491,8 @@ NTSTATUS WINAPI NtSetEvent( HANDLE handle, LONG *prev_state )
 {
     NTSTATUS ret;
 
+    if ((ret = fast_event_op( handle, 1, prev_state )) != STATUS_NOT_IMPLEMENTED) return ret;
+
     SERVER_START_REQ( event_op )
     {
         req->handle = wine_server_obj_handle( handle );
@@ -450,6 +512,8 @@ NTSTATUS WINAPI NtResetEvent( HANDLE handle, LONG *prev_state )
 {
     NTSTATUS ret;
 
+    if ((ret = fast_event_op( handle, 0, prev_state )) != STATUS_NOT_IMPLEMENTED) return ret;
+
     SERVER_START_REQ( event_op )
     {
         req->handle = wine_server_obj_handle( handle );
@@ -546,6 +610,8 @@ NTSTATUS WINAPI NtCreateMutant( HANDLE *handle, ACCESS_MASK access, const OBJECT
         wine_server_add_data( req, objattr, len );
         ret = wine_server_call( req );
         *handle = wine_server_ptr_handle( reply->handle );
+        if (!ret) cache_fast_sync( *handle, reply->fast_sync, FAST_SYNC_MUTEX, reply->access,
+                                  is_unnamed( attr ));
     }
     SERVER_END_REQ;
 
@@ -573,6 +639,7 @@ NTSTATUS WINAPI NtOpenMutant( HANDLE *handle, ACCESS_MASK access, const OBJECT_A
             wine_server_add_data( req, attr->ObjectName->Buffer, attr->ObjectName->Length );
         ret = wine_server_call( req );
         *handle = wine_server_ptr_handle( reply->handle );
+        if (!ret) cache_fast_sync( *handle, reply->fast_sync, FAST_SYNC_MUTEX, reply->access, FALSE );
     }
     SERVER_END_REQ;
     return ret;
@@ -1422,6 +1489,13 @@ NTSTATUS WINAPI NtWaitForMultipleObjects( DWORD count, const HANDLE *handles, BO
 
     if (!count || count > MAXIMUM_WAIT_OBJECTS) return STATUS_INVALID_PARAMETER_1;
 
+    /* alertable waits need the server to deliver the APCs */
+    if (!alertable && count == 1)
+    {
+        NTSTATUS ret = fast_wait( handles[0], timeout );
+        if (ret != STATUS_NOT_IMPLEMENTED) return ret;
+    }
+
     if (alertable) flags |= SELECT_ALERTABLE;
     select_op.wait.op = wait_any ? SELECT_WAIT : SELECT_WAIT_ALL;
     for (i = 0; i < count; i++) select_op.wait.handles[i] = wine_server_obj_handle( handles[i] );
@@ -1860,8 +1934,9 @@ NTSTATUS WINAPI NtRemoveIoCompletion( HANDLE handle, ULONG_PTR *key, ULONG_PTR *
 NTSTATUS WINAPI NtRemoveIoCompletionEx( HANDLE handle, FILE_IO_COMPLETION_INFORMATION *info, ULONG count,
                                         ULONG *written, LARGE_INTEGER *timeout, BOOLEAN alertable )
 {
+    completion_msg_t msgs[64];
     NTSTATUS status;
-    ULONG i = 0;
+    ULONG i = 0, j, size, ret;
 
     TRACE( "%p %p %u %p %p %u\n", handle, info, count, written, timeout, alertable );
 
@@ -1869,20 +1944,29 @@ NTSTATUS WINAPI NtRemoveIoCompletionEx( HANDLE handle, FILE_IO_COMPLETION_INFORM
     {
         while (i < count)
         {
-            SERVER_START_REQ( remove_completion )
+            size = min( count - i, ARRAY_SIZE(msgs) );
+            SERVER_START_REQ( remove_completions )
             {
                 req->handle = wine_server_obj_handle( handle );
-                if (!(status = wine_server_call( req )))
-                {
-                    info[i].CompletionKey             = reply->ckey;
-                    info[i].CompletionValue           = reply->cvalue;
-                    info[i].IoStatusBlock.Information = reply->information;
-                    info[i].IoStatusBlock.u.Status    = reply->status;
-                }
+                wine_server_set_reply( req, msgs, size * sizeof(msgs[0]) );
+                status = wine_server_call( req );
+                ret = wine_server_reply_size( reply ) / sizeof(msgs[0]);
             }
             SERVER_END_REQ;
             if (status != STATUS_SUCCESS) break;
-            ++i;
+            for (j = 0; j < ret; j++, i++)
+            {
+                info[i].CompletionKey             = msgs[j].ckey;
+                info[i].CompletionValue           = msgs[j].cvalue;
+                info[i].IoStatusBlock.Information = msgs[j].information;
+                info[i].IoStatusBlock.u.Status    = msgs[j].status;
+            }
+            /* a short reply means the queue has been drained */
+            if (ret < size)
+            {
+                status = STATUS_PENDING;
+                break;
+            }
         }
         if (i || status != STATUS_PENDING)
         {
@@ -1415,6 +1415,8 @@ static DECLSPEC_NORETURN void exit_thread( int status )
  */
 void exit_process( int status )
 {
+    virtual_dump_stats();
+    file_dump_stats();
     pthread_sigmask( SIG_BLOCK, &server_block_set, NULL );
     signal_exit_thread( get_unix_exit_code( status ), process_exit_wrapper, NtCurrentTeb() );
 }
@@ -76,6 +76,7 @@
 
 WINE_DEFAULT_DEBUG_CHANNEL(virtual);
 WINE_DECLARE_DEBUG_CHANNEL(module);
+WINE_DECLARE_DEBUG_CHANNEL(virtstat);
 
 struct preload_info
 {
@@ -145,6 +146,15 @@ static const BYTE VIRTUAL_Win32Flags[16] =
 
 static struct wine_rb_tree views_tree;
 static pthread_mutex_t virtual_mutex;
+static LONG views_seq;  /* odd while the views tree or the page protections are being changed */
+
+/* virtual_mutex contention statistics, dumped with WINEDEBUG=+virtstat */
+static struct
+{
+    LONG contended;   /* acquisitions that had to wait for another thread */
+    LONG fallbacks;   /* lock-free lookups that had to take the mutex after all */
+    LONG dump_time;   /* tick count of the last periodic dump */
+} virtual_stats;
 
 static const UINT page_shift = 12;
 static const UINT_PTR page_mask = 0xfff;
@@ -186,6 +196,79 @@ static struct list teb_list = LIST_INIT( teb_list );
 
 #define VIRTUAL_DEBUG_DUMP_VIEW(view) do { if (TRACE_ON(virtual)) dump_view(view); } while (0)
 
+/***********************************************************************
+ *           virtual_dump_stats
+ */
+void virtual_dump_stats(void)
+{
+    TRACE_( virtstat )( "virtual_mutex contended %d times, %d lock-free lookups fell back to the mutex\n",
+                        (int)virtual_stats.contended, (int)virtual_stats.fallbacks );
+}
+
+/* dump the statistics at most once per second while the process runs,
+ * this must not be called from the fault handler */
+static void virtual_dump_stats_periodic(void)
+{
+    LONG now, last;
+
+    if (!TRACE_ON(virtstat)) return;
+    now = NtGetTickCount();
+    last = ReadNoFence( &virtual_stats.dump_time );
+    if (now - last < 1000) return;
+    if (InterlockedCompareExchange( &virtual_stats.dump_time, now, last ) != last) return;
+    virtual_dump_stats();
+}
+
+static inline void lock_virtual_mutex(void)
+{
+    if (process_exiting) return;
+    if (!pthread_mutex_trylock( &virtual_mutex )) return;
+    /* this can run from the fault handler, so only count here; the stats are dumped from
+     * NtQueryVirtualMemory and on process exit */
+    InterlockedIncrement( &virtual_stats.contended );
+    pthread_mutex_lock( &virtual_mutex );
+}
+
+static inline void unlock_virtual_mutex(void)
+{
+    mutex_unlock( &virtual_mutex );
+}
+
+static inline void enter_virtual_section( sigset_t *sigset )
+{
+    pthread_sigmask( SIG_BLOCK, &server_block_set, sigset );
+    lock_virtual_mutex();
+}
+
+static inline void leave_virtual_section( sigset_t *sigset )
+{
+    server_leave_uninterrupted_section( &virtual_mutex, sigset );
+}
+
+/* writers hold virtual_mutex, and bump views_seq around every change that lock-free readers can see */
+static inline void views_write_begin(void)
+{
+    InterlockedIncrement( &views_seq );
+}
+
+static inline void views_write_end(void)
+{
+    InterlockedIncrement( &views_seq );
+}
+
+/* return the sequence to check the lock-free reads against, or -1 if a change is in progress */
+static inline LONG views_read_begin(void)
+{
+    LONG seq = ReadAcquire( &views_seq );
+    return (seq & 1) ? -1 : seq;
+}
+
+static inline BOOL views_read_end( LONG seq )
+{
+    MemoryBarrier();
+    return ReadNoFence( &views_seq ) == seq;
+}
+
 #ifndef MAP_NORESERVE
 #define MAP_NORESERVE 0
 #endif
@@ -619,7 +702,7 @@ void *get_builtin_so_handle( void *module )
     void *ret = NULL;
     struct builtin_module *builtin;
 
-    server_enter_uninterrupted_section( &virtual_mutex, &sigset );
+    enter_virtual_section( &sigset );
     LIST_FOR_EACH_ENTRY( builtin, &builtin_modules, struct builtin_module, entry )
     {
         if (builtin->module != module) continue;
@@ -627,7 +710,7 @@ void *get_builtin_so_handle( void *module )
         if (ret) builtin->refcount++;
         break;
     }
-    server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+    leave_virtual_section( &sigset );
     return ret;
 }
 
@@ -642,7 +725,7 @@ static NTSTATUS get_builtin_unix_funcs( void *module, BOOL wow, void **funcs )
     NTSTATUS status = STATUS_DLL_NOT_FOUND;
     struct builtin_module *builtin;
 
-    server_enter_uninterrupted_section( &virtual_mutex, &sigset );
+    enter_virtual_section( &sigset );
     LIST_FOR_EACH_ENTRY( builtin, &builtin_modules, struct builtin_module, entry )
     {
         if (builtin->module != module) continue;
@@ -653,7 +736,7 @@ static NTSTATUS get_builtin_unix_funcs( void *module, BOOL wow, void **funcs )
         }
         break;
     }
-    server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+    leave_virtual_section( &sigset );
     return status;
 }
 
@@ -669,7 +752,7 @@ NTSTATUS load_builtin_unixlib( void *module, const char *name )
     struct builtin_module *builtin;
 
     if (!(handle = dlopen( name, RTLD_NOW ))) return status;
-    server_enter_uninterrupted_section( &virtual_mutex, &sigset );
+    enter_virtual_section( &sigset );
     LIST_FOR_EACH_ENTRY( builtin, &builtin_modules, struct builtin_module, entry )
     {
         if (builtin->module != module) continue;
@@ -681,7 +764,7 @@ NTSTATUS load_builtin_unixlib( void *module, const char *name )
         else status = STATUS_IMAGE_ALREADY_LOADED;
         break;
     }
-    server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+    leave_virtual_section( &sigset );
     if (status) dlclose( handle );
     return status;
 }
@@ -938,6 +1021,7 @@ static void set_page_vprot( const void *addr, size_t size, BYTE vprot )
     size_t idx = (size_t)addr >> page_shift;
     size_t end = ((size_t)addr + size + page_mask) >> page_shift;
 
+    views_write_begin();
 #ifdef _WIN64
     while (idx >> pages_vprot_shift != end >> pages_vprot_shift)
     {
@@ -949,6 +1033,7 @@ static void set_page_vprot( const void *addr, size_t size, BYTE vprot )
 #else
     memset( pages_vprot + idx, vprot, end - idx );
 #endif
+    views_write_end();
 }
 
 
@@ -962,6 +1047,7 @@ static void set_page_vprot_bits( const void *addr, size_t size, BYTE set, BYTE c
     size_t idx = (size_t)addr >> page_shift;
     size_t end = ((size_t)addr + size + page_mask) >> page_shift;
 
+    views_write_begin();
 #ifdef _WIN64
     for ( ; idx < end; idx++)
     {
@@ -971,6 +1057,7 @@ static void set_page_vprot_bits( const void *addr, size_t size, BYTE set, BYTE c
 #else
     for ( ; idx < end; idx++) pages_vprot[idx] = (pages_vprot[idx] & ~clear) | set;
 #endif
+    views_write_end();
 }
 
 
@@ -1099,12 +1186,12 @@ static void VIRTUAL_Dump(void)
     struct file_view *view;
 
     TRACE( "Dump of all virtual memory views:\n" );
-    server_enter_uninterrupted_section( &virtual_mutex, &sigset );
+    enter_virtual_section( &sigset );
     WINE_RB_FOR_EACH_ENTRY( view, &views_tree, struct file_view, entry )
     {
         dump_view( view );
     }
-    server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+    leave_virtual_section( &sigset );
 }
 #endif
 
@@ -1140,6 +1227,40 @@ static struct file_view *find_view( const void *addr, size_t size )
 }
 
 
+/***********************************************************************
+ *           find_view_nolock
+ *
+ * Lock-free version of find_view() for read-only lookups: copy the view containing
+ * a given address to 'ret'. Views are never unmapped, so following stale tree
+ * pointers is safe, but the results may be inconsistent and the caller needs to
+ * check them with views_read_end().
+ */
+static BOOL find_view_nolock( const void *addr, struct file_view *ret )
+{
+    const struct wine_rb_entry *ptr = ((struct wine_rb_tree volatile *)&views_tree)->root;
+    unsigned int depth = 0;
+
+    /* the depth of the tree is bounded, stop on loops caused by concurrent rebalancing */
+    while (ptr && depth++ < 2 * 8 * sizeof(void *))
+    {
+        const volatile struct file_view *view = WINE_RB_ENTRY_VALUE( ptr, struct file_view, entry );
+        char *base = view->base;
+        size_t size = view->size;
+
+        if (base > (const char *)addr) ptr = ((const volatile struct wine_rb_entry *)ptr)->left;
+        else if (base + size <= (const char *)addr) ptr = ((const volatile struct wine_rb_entry *)ptr)->right;
+        else
+        {
+            ret->base    = base;
+            ret->size    = size;
+            ret->protect = view->protect;
+            return TRUE;
+        }
+    }
+    return FALSE;
+}
+
+
 /***********************************************************************
  *           get_zero_bits_mask
  */
@@ -1530,8 +1651,10 @@ static void delete_view( struct file_view *view ) /* [in] View */
     set_page_vprot( view->base, view->size, 0 );
     if (mmap_is_in_reserved_area( view->base, view->size ))
         free_ranges_remove_view( view );
+    views_write_begin();
     wine_rb_remove( &views_tree, &view->entry );
     *(struct file_view **)view = next_free_view;
+    views_write_end();
     next_free_view = view;
 }
 
@@ -1576,7 +1699,9 @@ static NTSTATUS create_view( struct file_view **view_ret, void *base, size_t siz
     view->protect = vprot;
     set_page_vprot( base, size, vprot );
 
+    views_write_begin();
     wine_rb_put( &views_tree, view->base, &view->entry );
+    views_write_end();
     if (mmap_is_in_reserved_area( view->base, view->size ))
         free_ranges_insert_view( view );
 
@@ -2445,7 +2570,7 @@ static NTSTATUS virtual_map_image( HANDLE mapping, ACCESS_MASK access, void **ad
     }
 
     status = STATUS_INVALID_PARAMETER;
-    server_enter_uninterrupted_section( &virtual_mutex, &sigset );
+    enter_virtual_section( &sigset );
 
     base = wine_server_get_ptr( image_info->base );
     if ((ULONG_PTR)base != image_info->base) base = NULL;
@@ -2480,7 +2605,7 @@ static NTSTATUS virtual_map_image( HANDLE mapping, ACCESS_MASK access, void **ad
     else delete_view( view );
 
 done:
-    server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+    leave_virtual_section( &sigset );
     if (needs_close) close( unix_fd );
     if (shared_needs_close) close( shared_fd );
     return status;
@@ -2574,7 +2699,7 @@ static NTSTATUS virtual_map_section( HANDLE handle, PVOID *addr_ptr, ULONG_PTR z
 
     if ((res = server_get_unix_fd( handle, 0, &unix_handle, &needs_close, NULL, NULL ))) return res;
 
-    server_enter_uninterrupted_section( &virtual_mutex, &sigset );
+    enter_virtual_section( &sigset );
 
     res = map_view( &view, base, size, alloc_type & MEM_TOP_DOWN, vprot, zero_bits );
     if (res) goto done;
@@ -2605,7 +2730,7 @@ static NTSTATUS virtual_map_section( HANDLE handle, PVOID *addr_ptr, ULONG_PTR z
     else delete_view( view );
 
 done:
-    server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+    leave_virtual_section( &sigset );
     if (needs_close) close( unix_handle );
     return res;
 }
@@ -2820,7 +2945,7 @@ NTSTATUS virtual_create_builtin_view( void *module, const UNICODE_STRING *nt_nam
     void *base = wine_server_get_ptr( info->base );
     int i;
 
-    server_enter_uninterrupted_section( &virtual_mutex, &sigset );
+    enter_virtual_section( &sigset );
     status = create_view( &view, base, size, SEC_IMAGE | SEC_FILE | VPROT_SYSTEM |
                           VPROT_COMMITTED | VPROT_READ | VPROT_WRITECOPY | VPROT_EXEC );
     if (!status)
@@ -2859,7 +2984,7 @@ NTSTATUS virtual_create_builtin_view( void *module, const UNICODE_STRING *nt_nam
         }
         else delete_view( view );
     }
-    server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+    leave_virtual_section( &sigset );
 
     return status;
 }
@@ -2966,7 +3091,7 @@ NTSTATUS virtual_alloc_teb( TEB **ret_teb )
     SIZE_T block_size = signal_stack_mask + 1;
     BOOL is_wow = !!NtCurrentTeb()->WowTebOffset;
 
-    server_enter_uninterrupted_section( &virtual_mutex, &sigset );
+    enter_virtual_section( &sigset );
     if (next_free_teb)
     {
         ptr = next_free_teb;
@@ -2982,7 +3107,7 @@ NTSTATUS virtual_alloc_teb( TEB **ret_teb )
             if ((status = NtAllocateVirtualMemory( NtCurrentProcess(), &ptr, is_win64 && is_wow ? 0x7fffffff : 0,
                                                    &total, MEM_RESERVE, PAGE_READWRITE )))
             {
-                server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+                leave_virtual_section( &sigset );
                 return status;
             }
             teb_block = ptr;
@@ -2993,14 +3118,14 @@ NTSTATUS virtual_alloc_teb( TEB **ret_teb )
                                  MEM_COMMIT, PAGE_READWRITE );
     }
     *ret_teb = teb = init_teb( ptr, is_wow );
-    server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+    leave_virtual_section( &sigset );
 
     if ((status = signal_alloc_thread( teb )))
     {
-        server_enter_uninterrupted_section( &virtual_mutex, &sigset );
+        enter_virtual_section( &sigset );
         *(void **)ptr = next_free_teb;
         next_free_teb = ptr;
-        server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+        leave_virtual_section( &sigset );
     }
     return status;
 }
@@ -3034,13 +3159,13 @@ void virtual_free_teb( TEB *teb )
         NtFreeVirtualMemory( GetCurrentProcess(), &ptr, &size, MEM_RELEASE );
     }
 
-    server_enter_uninterrupted_section( &virtual_mutex, &sigset );
+    enter_virtual_section( &sigset );
     list_remove( &thread_data->entry );
     ptr = teb;
     if (!is_win64) ptr = (char *)ptr - teb_offset;
     *(void **)ptr = next_free_teb;
     next_free_teb = ptr;
-    server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+    leave_virtual_section( &sigset );
 }
 
 
@@ -3054,7 +3179,7 @@ NTSTATUS virtual_clear_tls_index( ULONG index )
 
     if (index < TLS_MINIMUM_AVAILABLE)
     {
-        server_enter_uninterrupted_section( &virtual_mutex, &sigset );
+        enter_virtual_section( &sigset );
         LIST_FOR_EACH_ENTRY( thread_data, &teb_list, struct ntdll_thread_data, entry )
         {
             TEB *teb = CONTAINING_RECORD( thread_data, TEB, GdiTebBatch );
@@ -3065,14 +3190,14 @@ NTSTATUS virtual_clear_tls_index( ULONG index )
 #endif
             teb->TlsSlots[index] = 0;
         }
-        server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+        leave_virtual_section( &sigset );
     }
     else
     {
         index -= TLS_MINIMUM_AVAILABLE;
         if (index >= 8 * sizeof(peb->TlsExpansionBitmapBits)) return STATUS_INVALID_PARAMETER;
 
-        server_enter_uninterrupted_section( &virtual_mutex, &sigset );
+        enter_virtual_section( &sigset );
         LIST_FOR_EACH_ENTRY( thread_data, &teb_list, struct ntdll_thread_data, entry )
         {
             TEB *teb = CONTAINING_RECORD( thread_data, TEB, GdiTebBatch );
@@ -3087,7 +3212,7 @@ NTSTATUS virtual_clear_tls_index( ULONG index )
 #endif
             if (teb->TlsExpansionSlots) teb->TlsExpansionSlots[index] = 0;
         }
-        server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+        leave_virtual_section( &sigset );
     }
     return STATUS_SUCCESS;
 }
@@ -3111,7 +3236,7 @@ NTSTATUS virtual_alloc_thread_stack( INITIAL_TEB *stack, ULONG_PTR zero_bits, SI
     if (size < 1024 * 1024) size = 1024 * 1024;  /* Xlib needs a large stack */
     size = (size + 0xffff) & ~0xffff;  /* round to 64K boundary */
 
-    server_enter_uninterrupted_section( &virtual_mutex, &sigset );
+    enter_virtual_section( &sigset );
 
     if ((status = map_view( &view, NULL, size + extra_size, FALSE,
                             VPROT_READ | VPROT_WRITE | VPROT_COMMITTED, zero_bits )) != STATUS_SUCCESS)
@@ -3134,12 +3259,16 @@ NTSTATUS virtual_alloc_thread_stack( INITIAL_TEB *stack, ULONG_PTR zero_bits, SI
 
         /* shrink the first view and create a second one for the extra size */
         /* this allows the app to free the stack without freeing the thread start portion */
+        views_write_begin();
         view->size -= extra_size;
+        views_write_end();
         status = create_view( &extra_view, (char *)view->base + view->size, extra_size,
                               VPROT_READ | VPROT_WRITE | VPROT_COMMITTED );
         if (status != STATUS_SUCCESS)
         {
+            views_write_begin();
             view->size += extra_size;
+            views_write_end();
             delete_view( view );
             goto done;
         }
@@ -3152,7 +3281,7 @@ NTSTATUS virtual_alloc_thread_stack( INITIAL_TEB *stack, ULONG_PTR zero_bits, SI
     stack->StackBase = (char *)view->base + view->size;
     stack->StackLimit = (char *)view->base + 2 * page_size;
 done:
-    server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+    leave_virtual_section( &sigset );
     return status;
 }
 
@@ -3260,7 +3389,13 @@ NTSTATUS virtual_handle_fault( void *addr, DWORD err, void *stack )
     char *page = ROUND_ADDR( addr, page_mask );
     BYTE vprot;
 
-    mutex_lock( &virtual_mutex );  /* no need for signal masking inside signal handler */
+    /* faults that don't need any state change are resolved without taking the mutex */
+    vprot = get_page_vprot( page );
+    if (!(vprot & (VPROT_GUARD | VPROT_WRITEWATCH)) &&
+        (!(err & EXCEPTION_WRITE_FAULT) || !(get_unix_prot( vprot ) & PROT_WRITE)))
+        return ret;
+
+    lock_virtual_mutex();  /* no need for signal masking inside signal handler */
     vprot = get_page_vprot( page );
     if (!is_inside_signal_stack( stack ) && (vprot & VPROT_GUARD))
     {
@@ -3287,7 +3422,7 @@ NTSTATUS virtual_handle_fault( void *addr, DWORD err, void *stack )
                 ret = STATUS_SUCCESS;
         }
     }
-    mutex_unlock( &virtual_mutex );
+    unlock_virtual_mutex();
     return ret;
 }
 
@@ -3327,14 +3462,14 @@ void *virtual_setup_exception( void *stack_ptr, size_t size, EXCEPTION_RECORD *r
     }
     else if (stack < stack_info.limit)
     {
-        mutex_lock( &virtual_mutex );  /* no need for signal masking inside signal handler */
+        lock_virtual_mutex();  /* no need for signal masking inside signal handler */
         if ((get_page_vprot( stack ) & VPROT_GUARD) &&
             grow_thread_stack( ROUND_ADDR( stack, page_mask ), &stack_info ))
         {
             rec->ExceptionCode = STATUS_STACK_OVERFLOW;
             rec->NumberParameters = 0;
         }
-        mutex_unlock( &virtual_mutex );
+        unlock_virtual_mutex();
     }
 #if defined(VALGRIND_MAKE_MEM_UNDEFINED)
     VALGRIND_MAKE_MEM_UNDEFINED( stack, size );
@@ -3383,14 +3518,14 @@ unsigned int virtual_locked_server_call( void *req_ptr )
 
     if (!size) return wine_server_call( req_ptr );
 
-    server_enter_uninterrupted_section( &virtual_mutex, &sigset );
+    enter_virtual_section( &sigset );
     if (!(ret = check_write_access( addr, size, &has_write_watch )))
     {
         ret = server_call_unlocked( req );
         if (has_write_watch) update_write_watches( addr, size, wine_server_reply_size( req ));
     }
     else memset( &req->u.reply, 0, sizeof(req->u.reply) );
-    server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+    leave_virtual_section( &sigset );
     return ret;
 }
 
@@ -3407,14 +3542,14 @@ ssize_t virtual_locked_read( int fd, void *addr, size_t size )
     ssize_t ret = read( fd, addr, size );
     if (ret != -1 || errno != EFAULT) return ret;
 
-    server_enter_uninterrupted_section( &virtual_mutex, &sigset );
+    enter_virtual_section( &sigset );
     if (!check_write_access( addr, size, &has_write_watch ))
     {
         ret = read( fd, addr, size );
         err = errno;
         if (has_write_watch) update_write_watches( addr, size, max( 0, ret ));
     }
-    server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+    leave_virtual_section( &sigset );
     errno = err;
     return ret;
 }
@@ -3432,14 +3567,14 @@ ssize_t virtual_locked_pread( int fd, void *addr, size_t size, off_t offset )
     ssize_t ret = pread( fd, addr, size, offset );
     if (ret != -1 || errno != EFAULT) return ret;
 
-    server_enter_uninterrupted_section( &virtual_mutex, &sigset );
+    enter_virtual_section( &sigset );
     if (!check_write_access( addr, size, &has_write_watch ))
     {
         ret = pread( fd, addr, size, offset );
         err = errno;
         if (has_write_watch) update_write_watches( addr, size, max( 0, ret ));
     }
-    server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+    leave_virtual_section( &sigset );
     errno = err;
     return ret;
 }
@@ -3458,7 +3593,7 @@ ssize_t virtual_locked_recvmsg( int fd, struct msghdr *hdr, int flags )
     ssize_t ret = recvmsg( fd, hdr, flags );
     if (ret != -1 || errno != EFAULT) return ret;
 
-    server_enter_uninterrupted_section( &virtual_mutex, &sigset );
+    enter_virtual_section( &sigset );
     for (i = 0; i < hdr->msg_iovlen; i++)
         if (check_write_access( hdr->msg_iov[i].iov_base, hdr->msg_iov[i].iov_len, &has_write_watch ))
             break;
@@ -3470,7 +3605,7 @@ ssize_t virtual_locked_recvmsg( int fd, struct msghdr *hdr, int flags )
     if (has_write_watch)
         while (i--) update_write_watches( hdr->msg_iov[i].iov_base, hdr->msg_iov[i].iov_len, 0 );
 
-    server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+    leave_virtual_section( &sigset );
     errno = err;
     return ret;
 }
@@ -3481,14 +3616,27 @@ ssize_t virtual_locked_recvmsg( int fd, struct msghdr *hdr, int flags )
  */
 BOOL virtual_is_valid_code_address( const void *addr, SIZE_T size )
 {
-    struct file_view *view;
+    struct file_view *view, copy;
     BOOL ret = FALSE;
     sigset_t sigset;
+    LONG seq;
 
-    server_enter_uninterrupted_section( &virtual_mutex, &sigset );
+    if ((const char *)addr + size < (const char *)addr) return FALSE; /* overflow */
+
+    if ((seq = views_read_begin()) != -1)
+    {
+        ret = find_view_nolock( addr, &copy ) &&
+              (const char *)copy.base + copy.size >= (const char *)addr + size &&
+              !(copy.protect & VPROT_SYSTEM);
+        if (views_read_end( seq )) return ret;
+        ret = FALSE;
+    }
+    InterlockedIncrement( &virtual_stats.fallbacks );
+
+    enter_virtual_section( &sigset );
     if ((view = find_view( addr, size )))
         ret = !(view->protect & VPROT_SYSTEM);  /* system views are not visible to the app */
-    server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+    leave_virtual_section( &sigset );
     return ret;
 }
 
@@ -3575,7 +3723,7 @@ SIZE_T virtual_uninterrupted_read_memory( const void *addr, void *buffer, SIZE_T
 
     if (!size) return 0;
 
-    server_enter_uninterrupted_section( &virtual_mutex, &sigset );
+    enter_virtual_section( &sigset );
     if ((view = find_view( addr, size )))
     {
         if (!(view->protect & VPROT_SYSTEM))
@@ -3591,7 +3739,7 @@ SIZE_T virtual_uninterrupted_read_memory( const void *addr, void *buffer, SIZE_T
             }
         }
     }
-    server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+    leave_virtual_section( &sigset );
     return bytes_read;
 }
 
@@ -3611,13 +3759,13 @@ NTSTATUS virtual_uninterrupted_write_memory( void *addr, const void *buffer, SIZ
 
     if (!size) return STATUS_SUCCESS;
 
-    server_enter_uninterrupted_section( &virtual_mutex, &sigset );
+    enter_virtual_section( &sigset );
     if (!(ret = check_write_access( addr, size, &has_write_watch )))
     {
         memcpy( addr, buffer, size );
         if (has_write_watch) update_write_watches( addr, size, size );
     }
-    server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+    leave_virtual_section( &sigset );
     return ret;
 }
 
@@ -3632,7 +3780,7 @@ void virtual_set_force_exec( BOOL enable )
     struct file_view *view;
     sigset_t sigset;
 
-    server_enter_uninterrupted_section( &virtual_mutex, &sigset );
+    enter_virtual_section( &sigset );
     if (!force_exec_prot != !enable)  /* change all existing views */
     {
         force_exec_prot = enable;
@@ -3645,7 +3793,7 @@ void virtual_set_force_exec( BOOL enable )
             mprotect_range( view->base, view->size, commit, 0 );
         }
     }
-    server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+    leave_virtual_section( &sigset );
 }
 
 struct free_range
@@ -3803,7 +3951,7 @@ NTSTATUS WINAPI NtAllocateVirtualMemory( HANDLE process, PVOID *ret, ULONG_PTR z
 
     /* Reserve the memory */
 
-    server_enter_uninterrupted_section( &virtual_mutex, &sigset );
+    enter_virtual_section( &sigset );
 
     if ((type & MEM_RESERVE) || !base)
     {
@@ -3844,7 +3992,7 @@ NTSTATUS WINAPI NtAllocateVirtualMemory( HANDLE process, PVOID *ret, ULONG_PTR z
 
     if (!status) VIRTUAL_DEBUG_DUMP_VIEW( view );
 
-    server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+    leave_virtual_section( &sigset );
 
     if (status == STATUS_SUCCESS)
     {
@@ -3912,7 +4060,7 @@ NTSTATUS WINAPI NtFreeVirtualMemory( HANDLE process, PVOID *addr_ptr, SIZE_T *si
     if (size) size = ROUND_SIZE( addr, size );
     base = ROUND_ADDR( addr, page_mask );
 
-    server_enter_uninterrupted_section( &virtual_mutex, &sigset );
+    enter_virtual_section( &sigset );
 
     /* avoid freeing the DOS area when a broken app passes a NULL pointer */
     if (!base)
@@ -3954,7 +4102,7 @@ NTSTATUS WINAPI NtFreeVirtualMemory( HANDLE process, PVOID *addr_ptr, SIZE_T *si
         status = STATUS_INVALID_PARAMETER;
     }
 
-    server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+    leave_virtual_section( &sigset );
     return status;
 }
 
@@ -4008,7 +4156,7 @@ NTSTATUS WINAPI NtProtectVirtualMemory( HANDLE process, PVOID *addr_ptr, SIZE_T
     size = ROUND_SIZE( addr, size );
     base = ROUND_ADDR( addr, page_mask );
 
-    server_enter_uninterrupted_section( &virtual_mutex, &sigset );
+    enter_virtual_section( &sigset );
 
     if ((view = find_view( base, size )))
     {
@@ -4024,7 +4172,7 @@ NTSTATUS WINAPI NtProtectVirtualMemory( HANDLE process, PVOID *addr_ptr, SIZE_T
 
     if (!status) VIRTUAL_DEBUG_DUMP_VIEW( view );
 
-    server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+    leave_virtual_section( &sigset );
 
     if (status == STATUS_SUCCESS)
     {
@@ -4081,6 +4229,48 @@ static int get_free_mem_state_callback( void *start, SIZE_T size, void *arg )
 }
 
 /* get basic information about a memory block */
+static void fill_view_memory_info( MEMORY_BASIC_INFORMATION *info, const struct file_view *view,
+                                   SIZE_T size, BYTE vprot )
+{
+    info->RegionSize = size;
+    info->State = (vprot & VPROT_COMMITTED) ? MEM_COMMIT : MEM_RESERVE;
+    info->Protect = (vprot & VPROT_COMMITTED) ? get_win32_prot( vprot, view->protect ) : 0;
+    info->AllocationProtect = get_win32_prot( view->protect, view->protect );
+    if (view->protect & SEC_IMAGE) info->Type = MEM_IMAGE;
+    else if (view->protect & (SEC_FILE | SEC_RESERVE | SEC_COMMIT)) info->Type = MEM_MAPPED;
+    else info->Type = MEM_PRIVATE;
+}
+
+/* lock-free query of an address inside a view; free areas and SEC_RESERVE views are left to the caller */
+static BOOL get_basic_memory_info_nolock( char *base, MEMORY_BASIC_INFORMATION *info )
+{
+    struct file_view view;
+    SIZE_T size;
+    BYTE vprot;
+    LONG seq;
+
+    if ((seq = views_read_begin()) != -1)
+    {
+        if (!find_view_nolock( base, &view ) || (view.protect & SEC_RESERVE))
+            return FALSE;
+        /* the page protections of a view that was in the tree are allocated */
+        if (views_read_end( seq ))
+        {
+            size = get_vprot_range_size( base, view.size - (base - (char *)view.base),
+                                         ~VPROT_WRITEWATCH, &vprot );
+            if (views_read_end( seq ))
+            {
+                info->AllocationBase = view.base;
+                info->BaseAddress    = base;
+                fill_view_memory_info( info, &view, size, vprot );
+                return TRUE;
+            }
+        }
+    }
+    InterlockedIncrement( &virtual_stats.fallbacks );
+    return FALSE;
+}
+
 static NTSTATUS get_basic_memory_info( HANDLE process, LPCVOID addr,
                                        MEMORY_BASIC_INFORMATION *info,
                                        SIZE_T len, SIZE_T *res_len )
@@ -4126,9 +4316,15 @@ static NTSTATUS get_basic_memory_info( HANDLE process, LPCVOID addr,
 
     if (is_beyond_limit( base, 1, working_set_limit )) return STATUS_INVALID_PARAMETER;
 
+    if (get_basic_memory_info_nolock( base, info ))
+    {
+        if (res_len) *res_len = sizeof(*info);
+        return STATUS_SUCCESS;
+    }
+
     /* Find the view containing the address */
 
-    server_enter_uninterrupted_section( &virtual_mutex, &sigset );
+    enter_virtual_section( &sigset );
     ptr = views_tree.root;
     while (ptr)
     {
@@ -4184,16 +4380,11 @@ static NTSTATUS get_basic_memory_info( HANDLE process, LPCVOID addr,
     else
     {
         BYTE vprot;
+        SIZE_T size = get_committed_size( view, base, &vprot, ~VPROT_WRITEWATCH );
 
-        info->RegionSize = get_committed_size( view, base, &vprot, ~VPROT_WRITEWATCH );
-        info->State = (vprot & VPROT_COMMITTED) ? MEM_COMMIT : MEM_RESERVE;
-        info->Protect = (vprot & VPROT_COMMITTED) ? get_win32_prot( vprot, view->protect ) : 0;
-        info->AllocationProtect = get_win32_prot( view->protect, view->protect );
-        if (view->protect & SEC_IMAGE) info->Type = MEM_IMAGE;
-        else if (view->protect & (SEC_FILE | SEC_RESERVE | SEC_COMMIT)) info->Type = MEM_MAPPED;
-        else info->Type = MEM_PRIVATE;
+        fill_view_memory_info( info, view, size, vprot );
     }
-    server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+    leave_virtual_section( &sigset );
 
     if (res_len) *res_len = sizeof(*info);
     return STATUS_SUCCESS;
@@ -4231,7 +4422,7 @@ static NTSTATUS get_working_set_ex( HANDLE process, LPCVOID addr,
         if (vmentries == NULL)
             WARN( "couldn't get process vmmap, errno %d\n", errno );
 
-        server_enter_uninterrupted_section( &virtual_mutex, &sigset );
+        enter_virtual_section( &sigset );
         for (p = info; (UINT_PTR)(p + 1) <= (UINT_PTR)info + len; p++)
         {
              int i;
@@ -4258,7 +4449,7 @@ static NTSTATUS get_working_set_ex( HANDLE process, LPCVOID addr,
                      p->VirtualAttributes.Win32Protection = get_win32_prot( vprot, view->protect );
              }
         }
-        server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+        leave_virtual_section( &sigset );
 
         if (vmentries)
             procstat_freevmmap( pstat, vmentries );
@@ -4268,7 +4459,7 @@ static NTSTATUS get_working_set_ex( HANDLE process, LPCVOID addr,
             procstat_close( pstat );
     }
 #else
-    server_enter_uninterrupted_section( &virtual_mutex, &sigset );
+    enter_virtual_section( &sigset );
     if (pagemap_fd == -2)
     {
 #ifdef O_CLOEXEC
@@ -4307,7 +4498,7 @@ static NTSTATUS get_working_set_ex( HANDLE process, LPCVOID addr,
                 p->VirtualAttributes.Win32Protection = get_win32_prot( vprot, view->protect );
         }
     }
-    server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+    leave_virtual_section( &sigset );
 #endif
 
     if (res_len)
@@ -4360,6 +4551,8 @@ NTSTATUS WINAPI NtQueryVirtualMemory( HANDLE process, LPCVOID addr,
     TRACE("(%p, %p, info_class=%d, %p, %ld, %p)\n",
           process, addr, info_class, buffer, len, res_len);
 
+    virtual_dump_stats_periodic();
+
     switch(info_class)
     {
         case MemoryBasicInformation:
@@ -4578,7 +4771,7 @@ NTSTATUS WINAPI NtUnmapViewOfSection( HANDLE process, PVOID addr )
         return status;
     }
 
-    server_enter_uninterrupted_section( &virtual_mutex, &sigset );
+    enter_virtual_section( &sigset );
     if ((view = find_view( addr, 0 )) && !is_view_valloc( view ))
     {
         if (view->protect & VPROT_SYSTEM)
@@ -4592,7 +4785,7 @@ NTSTATUS WINAPI NtUnmapViewOfSection( HANDLE process, PVOID addr )
                 {
                     TRACE( "not freeing in-use builtin %p\n", view->base );
                     builtin->refcount--;
-                    server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+                    leave_virtual_section( &sigset );
                     return STATUS_SUCCESS;
                 }
             }
@@ -4611,7 +4804,7 @@ NTSTATUS WINAPI NtUnmapViewOfSection( HANDLE process, PVOID addr )
         }
         else FIXME( "failed to unmap %p %x\n", view->base, status );
     }
-    server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+    leave_virtual_section( &sigset );
     return status;
 }
 
@@ -4746,7 +4939,7 @@ NTSTATUS WINAPI NtFlushVirtualMemory( HANDLE process, LPCVOID *addr_ptr,
         return result.virtual_flush.status;
     }
 
-    server_enter_uninterrupted_section( &virtual_mutex, &sigset );
+    enter_virtual_section( &sigset );
     if (!(view = find_view( addr, *size_ptr ))) status = STATUS_INVALID_PARAMETER;
     else
     {
@@ -4756,7 +4949,7 @@ NTSTATUS WINAPI NtFlushVirtualMemory( HANDLE process, LPCVOID *addr_ptr,
         if (msync( addr, *size_ptr, MS_ASYNC )) status = STATUS_NOT_MAPPED_DATA;
 #endif
     }
-    server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+    leave_virtual_section( &sigset );
     return status;
 }
 
@@ -4783,7 +4976,7 @@ NTSTATUS WINAPI NtGetWriteWatch( HANDLE process, ULONG flags, PVOID base, SIZE_T
     TRACE( "%p %x %p-%p %p %lu\n", process, flags, base, (char *)base + size,
            addresses, *count );
 
-    server_enter_uninterrupted_section( &virtual_mutex, &sigset );
+    enter_virtual_section( &sigset );
 
     if (is_write_watch_range( base, size ))
     {
@@ -4802,7 +4995,7 @@ NTSTATUS WINAPI NtGetWriteWatch( HANDLE process, ULONG flags, PVOID base, SIZE_T
     }
     else status = STATUS_INVALID_PARAMETER;
 
-    server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+    leave_virtual_section( &sigset );
     return status;
 }
 
@@ -4823,14 +5016,14 @@ NTSTATUS WINAPI NtResetWriteWatch( HANDLE process, PVOID base, SIZE_T size )
 
     if (!size) return STATUS_INVALID_PARAMETER;
 
-    server_enter_uninterrupted_section( &virtual_mutex, &sigset );
+    enter_virtual_section( &sigset );
 
     if (is_write_watch_range( base, size ))
         reset_write_watches( base, size );
     else
         status = STATUS_INVALID_PARAMETER;
 
-    server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+    leave_virtual_section( &sigset );
     return status;
 }
 
@@ -4907,7 +5100,7 @@ NTSTATUS WINAPI NtAreMappedFilesTheSame(PVOID addr1, PVOID addr2)
 
     TRACE("%p %p\n", addr1, addr2);
 
-    server_enter_uninterrupted_section( &virtual_mutex, &sigset );
+    enter_virtual_section( &sigset );
 
     view1 = find_view( addr1, 0 );
     view2 = find_view( addr2, 0 );
@@ -4931,7 +5124,7 @@ NTSTATUS WINAPI NtAreMappedFilesTheSame(PVOID addr1, PVOID addr2)
         SERVER_END_REQ;
     }
 
-    server_leave_uninterrupted_section( &virtual_mutex, &sigset );
+    leave_virtual_section( &sigset );
     return status;
 }
 
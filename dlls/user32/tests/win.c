@@ -9071,6 +9071,304 @@ static void test_layered_window(void)
     DeleteObject( hbm );
 }
 
+static void fill_layered_frame( DWORD *bits, int width, int height, int pos )
+{
+    int x, y;
+
+    /* an opaque rectangle with a translucent shadow, moving across a transparent background */
+    memset( bits, 0, width * height * sizeof(*bits) );
+    for (y = 100; y < 400; y++)
+        for (x = pos; x < pos + 300; x++)
+            bits[y * width + x] = (y < 110 || y >= 390 || x < pos + 10 || x >= pos + 290) ? 0x40000000 : 0xff336699;
+}
+
+/* read back what ends up on the screen, layered windows included */
+static COLORREF get_screen_pixel( int x, int y )
+{
+    HDC hdc = GetDC( 0 );
+    COLORREF color = GetPixel( hdc, x, y );
+
+    ReleaseDC( 0, hdc );
+    return color;
+}
+
+static void test_layered_window_animation(void)
+{
+    static const int width = 1000, height = 800, frames = 50;
+    static const COLORREF rect_color = RGB( 0x33, 0x66, 0x99 );
+    BLENDFUNCTION blend = { AC_SRC_OVER, 0, 255, AC_SRC_ALPHA };
+    UPDATELAYEREDWINDOWINFO info;
+    BITMAPINFO bmi;
+    POINT pt = { 0, 0 };
+    SIZE sz = { width, height };
+    COLORREF color;
+    RECT dirty;
+    HBITMAP hbm, old_hbm;
+    DWORD *bits;
+    HWND hwnd;
+    HDC hdc;
+    BOOL ret, check_pixels;
+    int i;
+
+    if (!pUpdateLayeredWindow || !pUpdateLayeredWindowIndirect)
+    {
+        win_skip( "layered windows not supported\n" );
+        return;
+    }
+
+    hdc = GetDC( 0 );
+    check_pixels = GetDeviceCaps( hdc, BITSPIXEL ) >= 24;
+    ReleaseDC( 0, hdc );
+    if (!check_pixels) skip( "screen depth too low, not checking the layered window contents\n" );
+
+    memset( &bmi, 0, sizeof(bmi) );
+    bmi.bmiHeader.biSize = sizeof(bmi.bmiHeader);
+    bmi.bmiHeader.biWidth = width;
+    bmi.bmiHeader.biHeight = -height;
+    bmi.bmiHeader.biPlanes = 1;
+    bmi.bmiHeader.biBitCount = 32;
+    bmi.bmiHeader.biCompression = BI_RGB;
+    hdc = CreateCompatibleDC( 0 );
+    hbm = CreateDIBSection( hdc, &bmi, DIB_RGB_COLORS, (void **)&bits, NULL, 0 );
+    ok( hbm != NULL, "CreateDIBSection failed\n" );
+    old_hbm = SelectObject( hdc, hbm );
+
+    hwnd = CreateWindowExA( WS_EX_LAYERED | WS_EX_TOOLWINDOW | WS_EX_TOPMOST, "MainWindowClass",
+                            "layered animation", WS_POPUP, 0, 0, width, height, 0, 0, 0, NULL );
+    ok( hwnd != NULL, "CreateWindowEx error %lu\n", GetLastError() );
+
+    fill_layered_frame( bits, width, height, 0 );
+    ret = pUpdateLayeredWindow( hwnd, 0, NULL, &sz, hdc, &pt, 0, &blend, ULW_ALPHA );
+    ok( ret, "UpdateLayeredWindow failed error %lu\n", GetLastError() );
+    ShowWindow( hwnd, SW_SHOWNOACTIVATE );
+    flush_events( TRUE );
+
+    if (check_pixels)
+    {
+        color = get_screen_pixel( 150, 250 );
+        ok( color == rect_color, "got color %#lx\n", color );
+    }
+
+    /* full updates, like most applications do */
+    for (i = 1; i <= frames; i++)
+    {
+        fill_layered_frame( bits, width, height, i * 8 );
+        ret = pUpdateLayeredWindow( hwnd, 0, NULL, &sz, hdc, &pt, 0, &blend, ULW_ALPHA );
+        ok( ret, "%u: UpdateLayeredWindow failed error %lu\n", i, GetLastError() );
+    }
+    flush_events( TRUE );
+
+    /* the rectangle now covers 400-700, and the area it left is transparent again */
+    if (check_pixels)
+    {
+        color = get_screen_pixel( 550, 250 );
+        ok( color == rect_color, "got color %#lx\n", color );
+        color = get_screen_pixel( 150, 250 );
+        ok( color != rect_color, "got color %#lx\n", color );
+    }
+
+    /* updates restricted to the moving part */
+    memset( &info, 0, sizeof(info) );
+    info.cbSize   = sizeof(info);
+    info.hdcSrc   = hdc;
+    info.pptSrc   = &pt;
+    info.psize    = &sz;
+    info.pblend   = &blend;
+    info.dwFlags  = ULW_ALPHA;
+    info.prcDirty = &dirty;
+    for (i = frames - 1; i >= 0; i--)
+    {
+        fill_layered_frame( bits, width, height, i * 8 );
+        SetRect( &dirty, i * 8, 100, i * 8 + 308, 400 );
+        ret = pUpdateLayeredWindowIndirect( hwnd, &info );
+        ok( ret, "%u: UpdateLayeredWindowIndirect failed error %lu\n", i, GetLastError() );
+    }
+    flush_events( TRUE );
+
+    /* only the dirty rectangles were updated, but they add up to the whole move back */
+    if (check_pixels)
+    {
+        color = get_screen_pixel( 150, 250 );
+        ok( color == rect_color, "got color %#lx\n", color );
+        color = get_screen_pixel( 550, 250 );
+        ok( color != rect_color, "got color %#lx\n", color );
+    }
+
+    DestroyWindow( hwnd );
+    SelectObject( hdc, old_hbm );
+    DeleteObject( hbm );
+    DeleteDC( hdc );
+}
+
+static void test_move_over_children(void)
+{
+    static const int cols = 25, rows = 20, moves = 200;
+    HWND parent, mover, children[500];
+    DWORD ticks;
+    POINT pt;
+    HRGN hrgn;
+    RECT rect;
+    HDC hdc;
+    int i;
+
+    parent = CreateWindowExA( 0, "MainWindowClass", "children", WS_POPUP | WS_CLIPCHILDREN,
+                              0, 0, cols * 20 + 100, rows * 20 + 100, 0, 0, 0, NULL );
+    ok( parent != NULL, "CreateWindowEx error %lu\n", GetLastError() );
+    for (i = 0; i < cols * rows; i++)
+    {
+        children[i] = CreateWindowExA( 0, "static", NULL, WS_CHILD | WS_VISIBLE | WS_CLIPSIBLINGS,
+                                       (i % cols) * 20, (i / cols) * 20, 16, 16, parent, 0, 0, NULL );
+        ok( children[i] != NULL, "%u: CreateWindowEx error %lu\n", i, GetLastError() );
+    }
+    mover = CreateWindowExA( 0, "static", NULL, WS_CHILD | WS_VISIBLE | WS_CLIPSIBLINGS,
+                             0, 0, 90, 90, parent, 0, 0, NULL );
+    ok( mover != NULL, "CreateWindowEx error %lu\n", GetLastError() );
+    SetWindowPos( mover, HWND_TOP, 0, 0, 0, 0, SWP_NOMOVE | SWP_NOSIZE | SWP_NOACTIVATE );
+    ShowWindow( parent, SW_SHOWNOACTIVATE );
+    flush_events( TRUE );
+
+    /* every move recomputes the visible region of the windows it overlaps */
+    ticks = GetTickCount();
+    for (i = 0; i < moves; i++)
+        SetWindowPos( mover, 0, (i * 7) % (cols * 20), (i * 3) % (rows * 20), 0, 0,
+                      SWP_NOZORDER | SWP_NOSIZE | SWP_NOACTIVATE );
+    ticks = GetTickCount() - ticks;
+    trace( "%u moves of a window over %u siblings: %lu ms\n", moves, cols * rows, ticks );
+    flush_events( TRUE );
+
+    /* the parent visible region must exclude all the children */
+    hrgn = CreateRectRgn( 0, 0, 0, 0 );
+    hdc = GetDC( parent );
+    ok( GetRandomRgn( hdc, hrgn, SYSRGN ) != 0, "GetRandomRgn failed\n" );
+    ReleaseDC( parent, hdc );
+    for (i = 0; i < cols * rows; i++)
+    {
+        GetWindowRect( children[i], &rect );
+        ok( !RectInRegion( hrgn, &rect ), "%u: child %s is in the parent visible region\n",
+            i, wine_dbgstr_rect( &rect ));
+    }
+    GetWindowRect( mover, &rect );
+    ok( !RectInRegion( hrgn, &rect ), "moved child %s is in the parent visible region\n",
+        wine_dbgstr_rect( &rect ));
+    pt.x = cols * 20 + 50;
+    pt.y = rows * 20 + 50;
+    ClientToScreen( parent, &pt );
+    ok( PtInRegion( hrgn, pt.x, pt.y ), "point %s is not in the parent visible region\n",
+        wine_dbgstr_point( &pt ));
+
+    DeleteObject( hrgn );
+    DestroyWindow( parent );
+}
+
+struct update_rgn_params
+{
+    HWND hwnd;
+    HRGN expect;
+};
+
+static DWORD WINAPI update_rgn_thread( void *arg )
+{
+    struct update_rgn_params *params = arg;
+    HRGN update = CreateRectRgn( 0, 0, 0, 0 );
+    int ret;
+
+    ret = GetUpdateRgn( params->hwnd, update, FALSE );
+    ok( ret == COMPLEXREGION, "GetUpdateRgn returned %d\n", ret );
+    ok( EqualRgn( update, params->expect ), "wrong update region\n" );
+    DeleteObject( update );
+    return 0;
+}
+
+static void test_many_invalidations(void)
+{
+    struct update_rgn_params params;
+    static const int count = 10000;
+    HRGN update, expect, hrgn;
+    DWORD ticks, status;
+    HANDLE thread;
+    HWND hwnd;
+    RECT rect;
+    MSG msg;
+    int i, ret;
+
+    hwnd = CreateWindowExA( 0, "static", NULL, WS_POPUP | WS_VISIBLE, 0, 0, 200, 200, 0, 0, 0, NULL );
+    ok( hwnd != NULL, "CreateWindowEx error %lu\n", GetLastError() );
+    flush_events( TRUE );
+
+    update = CreateRectRgn( 0, 0, 0, 0 );
+    expect = CreateRectRgn( 0, 0, 0, 0 );
+    for (i = 0; i < 100; i++)
+    {
+        SetRect( &rect, (i % 10) * 20, (i / 10) * 20, (i % 10) * 20 + 10, (i / 10) * 20 + 10 );
+        InvalidateRect( hwnd, &rect, FALSE );
+        hrgn = CreateRectRgnIndirect( &rect );
+        CombineRgn( expect, expect, hrgn, RGN_OR );
+        DeleteObject( hrgn );
+    }
+    /* validating must be applied after the previous invalidations */
+    SetRect( &rect, 0, 0, 200, 20 );
+    ValidateRect( hwnd, &rect );
+    hrgn = CreateRectRgnIndirect( &rect );
+    CombineRgn( expect, expect, hrgn, RGN_DIFF );
+    DeleteObject( hrgn );
+
+    ret = GetUpdateRgn( hwnd, update, FALSE );
+    ok( ret == COMPLEXREGION, "GetUpdateRgn returned %d\n", ret );
+    ok( EqualRgn( update, expect ), "wrong update region\n" );
+    ValidateRect( hwnd, NULL );
+
+    /* the invalidations must be visible in the queue state right away */
+    SetRect( &rect, 10, 10, 20, 20 );
+    InvalidateRect( hwnd, &rect, FALSE );
+    status = GetQueueStatus( QS_PAINT );
+    ok( HIWORD(status) & QS_PAINT, "QS_PAINT not set, status %#lx\n", status );
+    ok( PeekMessageA( &msg, hwnd, WM_PAINT, WM_PAINT, PM_NOREMOVE ), "WM_PAINT not received\n" );
+    ValidateRect( hwnd, NULL );
+
+    SetRect( &rect, 10, 10, 20, 20 );
+    InvalidateRect( hwnd, &rect, FALSE );
+    ok( GetUpdateRect( hwnd, &rect, FALSE ), "GetUpdateRect failed\n" );
+    ok( rect.left == 10 && rect.top == 10 && rect.right == 20 && rect.bottom == 20,
+        "wrong update rect %s\n", wine_dbgstr_rect( &rect ));
+    flush_events( TRUE );
+
+    /* the invalidations must be visible from other threads too */
+    SetRectRgn( expect, 0, 0, 0, 0 );
+    for (i = 0; i < 4; i++)
+    {
+        SetRect( &rect, i * 20, i * 20, i * 20 + 10, i * 20 + 10 );
+        InvalidateRect( hwnd, &rect, FALSE );
+        hrgn = CreateRectRgnIndirect( &rect );
+        CombineRgn( expect, expect, hrgn, RGN_OR );
+        DeleteObject( hrgn );
+    }
+    params.hwnd = hwnd;
+    params.expect = expect;
+    thread = CreateThread( NULL, 0, update_rgn_thread, &params, 0, NULL );
+    ok( thread != NULL, "CreateThread failed, error %lu\n", GetLastError() );
+    WaitForSingleObject( thread, INFINITE );
+    CloseHandle( thread );
+    flush_events( TRUE );
+
+    ticks = GetTickCount();
+    for (i = 0; i < count; i++)
+    {
+        SetRect( &rect, i % 200, (i / 200) % 200, i % 200 + 2, (i / 200) % 200 + 2 );
+        InvalidateRect( hwnd, &rect, FALSE );
+        if (i % 100 == 99)
+            while (PeekMessageA( &msg, 0, 0, 0, PM_REMOVE )) DispatchMessageA( &msg );
+    }
+    ticks = GetTickCount() - ticks;
+    trace( "%u small invalidations painted every 100: %lu ms\n", count, ticks );
+
+    ret = GetUpdateRgn( hwnd, update, FALSE );
+    ok( ret == NULLREGION, "GetUpdateRgn returned %d\n", ret );
+
+    DeleteObject( update );
+    DeleteObject( expect );
+    DestroyWindow( hwnd );
+}
+
 static MONITORINFO mi;
 
 static LRESULT CALLBACK fullscreen_wnd_proc(HWND hwnd, UINT msg, WPARAM wp, LPARAM lp)
@@ -12705,6 +13003,131 @@ static void other_process_proc(HWND hwnd)
     CloseHandle(test_done_event);
 }
 
+#define OTHER_PROCESS_TREE_SIZE 256
+
+static void other_process_tree_proc(HWND hwnd)
+{
+    HANDLE window_ready_event, test_done_event;
+    HWND child;
+    RECT rect;
+    DWORD ret, pid;
+    int count;
+
+    window_ready_event = OpenEventA(EVENT_ALL_ACCESS, FALSE, "test_opwt_window");
+    ok(!!window_ready_event, "OpenEvent failed.\n");
+    test_done_event = OpenEventA(EVENT_ALL_ACCESS, FALSE, "test_opwt_test");
+    ok(!!test_done_event, "OpenEvent failed.\n");
+
+    ret = WaitForSingleObject(window_ready_event, 5000);
+    ok(ret == WAIT_OBJECT_0, "Unexpected ret %lx.\n", ret);
+
+    ok(IsWindow(hwnd), "IsWindow failed.\n");
+    ok(GetWindowThreadProcessId(hwnd, &pid) != 0, "GetWindowThreadProcessId failed.\n");
+    ok(pid != GetCurrentProcessId(), "Unexpected pid %#lx.\n", pid);
+    ok(GetAncestor(hwnd, GA_PARENT) == GetDesktopWindow(), "Unexpected parent %p.\n",
+       GetAncestor(hwnd, GA_PARENT));
+
+    count = 0;
+    for (child = GetWindow(hwnd, GW_CHILD); child; child = GetWindow(child, GW_HWNDNEXT))
+    {
+        ok(GetParent(child) == hwnd, "Unexpected parent %p.\n", GetParent(child));
+        ok(GetWindowLongA(child, GWL_STYLE) == (WS_CHILD | WS_VISIBLE), "Unexpected style %#lx.\n",
+           GetWindowLongA(child, GWL_STYLE));
+        ok(!GetWindowLongA(child, GWL_EXSTYLE), "Unexpected exstyle %#lx.\n",
+           GetWindowLongA(child, GWL_EXSTYLE));
+        ok(IsWindowVisible(child), "Window %p isn't visible.\n", child);
+        GetWindowRect(child, &rect);
+        ok(rect.right - rect.left == 10 && rect.bottom - rect.top == 10, "Unexpected rect %s.\n",
+           wine_dbgstr_rect(&rect));
+        GetClientRect(child, &rect);
+        ok(rect.right == 10 && rect.bottom == 10, "Unexpected rect %s.\n", wine_dbgstr_rect(&rect));
+        count++;
+    }
+    ok(count == OTHER_PROCESS_TREE_SIZE, "Unexpected count %d.\n", count);
+
+    child = GetWindow(hwnd, GW_CHILD);
+    SetEvent(test_done_event);
+
+    /* changes made by the owner are visible right away */
+    ret = WaitForSingleObject(window_ready_event, 5000);
+    ok(ret == WAIT_OBJECT_0, "Unexpected ret %lx.\n", ret);
+    ok(!IsWindowVisible(child), "Window %p is visible.\n", child);
+    ok(GetWindowLongA(child, GWL_STYLE) == WS_CHILD, "Unexpected style %#lx.\n",
+       GetWindowLongA(child, GWL_STYLE));
+    ok(GetWindowLongA(child, GWL_EXSTYLE) == WS_EX_TRANSPARENT, "Unexpected exstyle %#lx.\n",
+       GetWindowLongA(child, GWL_EXSTYLE));
+    GetWindowRect(child, &rect);
+    ok(rect.right - rect.left == 20 && rect.bottom - rect.top == 30, "Unexpected rect %s.\n",
+       wine_dbgstr_rect(&rect));
+    SetEvent(test_done_event);
+
+    ret = WaitForSingleObject(window_ready_event, 5000);
+    ok(ret == WAIT_OBJECT_0, "Unexpected ret %lx.\n", ret);
+    ok(!IsWindow(child), "Window %p still exists.\n", child);
+    ok(!GetWindowLongA(child, GWL_STYLE), "Unexpected style %#lx.\n", GetWindowLongA(child, GWL_STYLE));
+    SetEvent(test_done_event);
+
+    CloseHandle(window_ready_event);
+    CloseHandle(test_done_event);
+}
+
+static void test_other_process_window_tree(const char *argv0)
+{
+    HANDLE window_ready_event, test_done_event;
+    PROCESS_INFORMATION info;
+    STARTUPINFOA startup;
+    char cmd[MAX_PATH];
+    HWND hwnd, child;
+    DWORD ret;
+    int i;
+
+    hwnd = CreateWindowExA(0, "static", NULL, WS_POPUP | WS_VISIBLE,
+            0, 0, 400, 400, 0, 0, NULL, NULL);
+    ok(!!hwnd, "CreateWindowEx failed.\n");
+    for (i = 0; i < OTHER_PROCESS_TREE_SIZE; i++)
+    {
+        child = CreateWindowExA(0, "static", NULL, WS_CHILD | WS_VISIBLE,
+                (i % 16) * 20, (i / 16) * 20, 10, 10, hwnd, 0, NULL, NULL);
+        ok(!!child, "CreateWindowEx failed.\n");
+    }
+
+    window_ready_event = CreateEventA(NULL, FALSE, FALSE, "test_opwt_window");
+    ok(!!window_ready_event, "CreateEvent failed.\n");
+    test_done_event = CreateEventA(NULL, FALSE, FALSE, "test_opwt_test");
+    ok(!!test_done_event, "CreateEvent failed.\n");
+
+    sprintf(cmd, "%s win test_other_process_window_tree %p", argv0, hwnd);
+    memset(&startup, 0, sizeof(startup));
+    startup.cb = sizeof(startup);
+
+    ok(CreateProcessA(NULL, cmd, NULL, NULL, FALSE, 0, NULL, NULL,
+            &startup, &info), "CreateProcess failed.\n");
+
+    SetEvent(window_ready_event);
+    ret = WaitForSingleObject(test_done_event, 10000);
+    ok(ret == WAIT_OBJECT_0, "Unexpected ret %lx.\n", ret);
+
+    child = GetWindow(hwnd, GW_CHILD);
+    ShowWindow(child, SW_HIDE);
+    SetWindowLongA(child, GWL_EXSTYLE, WS_EX_TRANSPARENT);
+    SetWindowPos(child, 0, 0, 0, 20, 30, SWP_NOMOVE | SWP_NOZORDER | SWP_NOACTIVATE);
+    SetEvent(window_ready_event);
+    ret = WaitForSingleObject(test_done_event, 5000);
+    ok(ret == WAIT_OBJECT_0, "Unexpected ret %lx.\n", ret);
+
+    DestroyWindow(child);
+    SetEvent(window_ready_event);
+    ret = WaitForSingleObject(test_done_event, 5000);
+    ok(ret == WAIT_OBJECT_0, "Unexpected ret %lx.\n", ret);
+
+    wait_child_process(info.hProcess);
+    CloseHandle(window_ready_event);
+    CloseHandle(test_done_event);
+    CloseHandle(info.hProcess);
+    CloseHandle(info.hThread);
+    DestroyWindow(hwnd);
+}
+
 static void test_SC_SIZE(void)
 {
     HWND hwnd;
@@ -13020,6 +13443,11 @@ START_TEST(win)
             other_process_proc(hwnd);
             return;
         }
+        else if (!strcmp(argv[2], "test_other_process_window_tree"))
+        {
+            other_process_tree_proc(hwnd);
+            return;
+        }
     }
 
     if (argc == 3 && !strcmp(argv[2], "winproc_limit"))
@@ -13136,6 +13564,9 @@ START_TEST(win)
     test_GetUpdateRect();
     test_Expose();
     test_layered_window();
+    test_layered_window_animation();
+    test_move_over_children();
+    test_many_invalidations();
 
     test_SetForegroundWindow(hwndMain);
     test_handles( hwndMain );
@@ -13158,6 +13589,7 @@ START_TEST(win)
     test_window_placement();
     test_arrange_iconic_windows();
     test_other_process_window(argv[0]);
+    test_other_process_window_tree(argv[0]);
     test_SC_SIZE();
     test_cancel_mode();
     test_DragDetect();
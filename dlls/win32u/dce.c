@@ -33,6 +33,7 @@
 #include "wine/debug.h"
 
 WINE_DEFAULT_DEBUG_CHANNEL(win);
+WINE_DECLARE_DEBUG_CHANNEL(fps);
 
 struct dce
 {
@@ -90,6 +91,11 @@ static RECT *dummy_surface_get_bounds( struct window_surface *window_surface )
     return &dummy_bounds;
 }
 
+static void dummy_surface_add_bounds( struct window_surface *window_surface, const RECT *rect )
+{
+    /* nothing to do */
+}
+
 static void dummy_surface_set_region( struct window_surface *window_surface, HRGN region )
 {
     /* nothing to do */
@@ -111,6 +117,7 @@ static const struct window_surface_funcs dummy_surface_funcs =
     dummy_surface_unlock,
     dummy_surface_get_bitmap_info,
     dummy_surface_get_bounds,
+    dummy_surface_add_bounds,
     dummy_surface_set_region,
     dummy_surface_flush,
     dummy_surface_destroy
@@ -157,6 +164,12 @@ static RECT *offscreen_window_surface_get_bounds( struct window_surface *base )
     return &impl->bounds;
 }
 
+static void offscreen_window_surface_add_bounds( struct window_surface *base, const RECT *rect )
+{
+    struct offscreen_window_surface *impl = impl_from_window_surface( base );
+    add_bounds_rect( &impl->bounds, rect );
+}
+
 static void *offscreen_window_surface_get_bitmap_info( struct window_surface *base, BITMAPINFO *info )
 {
     struct offscreen_window_surface *impl = impl_from_window_surface( base );
@@ -188,6 +201,7 @@ static const struct window_surface_funcs offscreen_window_surface_funcs =
     offscreen_window_surface_unlock,
     offscreen_window_surface_get_bitmap_info,
     offscreen_window_surface_get_bounds,
+    offscreen_window_surface_add_bounds,
     offscreen_window_surface_set_region,
     offscreen_window_surface_flush,
     offscreen_window_surface_destroy
@@ -298,6 +312,16 @@ static RECT *dib_surface_get_bounds( struct window_surface *window_surface )
     return &surface->bounds;
 }
 
+/***********************************************************************
+ *           dib_surface_add_bounds
+ */
+static void dib_surface_add_bounds( struct window_surface *window_surface, const RECT *rect )
+{
+    struct dib_window_surface *surface = get_dib_surface( window_surface );
+
+    add_bounds_rect( &surface->bounds, rect );
+}
+
 /***********************************************************************
  *           dib_surface_set_region
  */
@@ -331,6 +355,7 @@ static const struct window_surface_funcs dib_surface_funcs =
     dib_surface_unlock,
     dib_surface_get_bitmap_info,
     dib_surface_get_bounds,
+    dib_surface_add_bounds,
     dib_surface_set_region,
     dib_surface_flush,
     dib_surface_destroy
@@ -389,15 +414,43 @@ void register_window_surface( struct window_surface *old, struct window_surface
     pthread_mutex_unlock( &surfaces_lock );
 }
 
+/*******************************************************************
+ *           get_frame_interval
+ *
+ * Return the refresh interval of the primary display, in milliseconds.
+ */
+static DWORD get_frame_interval(void)
+{
+    static DWORD interval;
+    DEVMODEW devmode;
+
+    if (!interval)
+    {
+        memset( &devmode, 0, sizeof(devmode) );
+        devmode.dmSize = sizeof(devmode);
+        if (NtUserEnumDisplaySettings( NULL, ENUM_CURRENT_SETTINGS, &devmode, 0 ) &&
+            devmode.dmDisplayFrequency > 1)
+            interval = max( 1000 / devmode.dmDisplayFrequency, 1 );
+        else
+            interval = 16;
+        TRACE( "using a frame interval of %u ms\n", interval );
+    }
+    return interval;
+}
+
 /*******************************************************************
  *           flush_window_surfaces
  *
- * Flush pending output from all window surfaces.
+ * Flush pending output from all window surfaces. Unless the thread is about
+ * to wait, flushes are not done more often than the display refreshes. A
+ * skipped flush is done on the next idle flush, whatever the pacing.
  */
-void flush_window_surfaces( BOOL idle )
+void flush_window_surfaces( BOOL idle, BOOL wait )
 {
-    static DWORD last_idle;
-    DWORD now;
+    static DWORD last_idle, last_flush, stats_start;
+    static UINT flush_count, skip_count;
+    static BOOL skipped;
+    DWORD now, interval = wait ? 0 : get_frame_interval();
     struct window_surface *surface;
 
     pthread_mutex_lock( &surfaces_lock );
@@ -406,8 +459,29 @@ void flush_window_surfaces( BOOL idle )
     /* if not idle, we only flush if there's evidence that the app never goes idle */
     else if ((int)(now - last_idle) < 50) goto done;
 
+    if ((int)(now - last_flush) < interval && !(idle && skipped))
+    {
+        skipped = TRUE;
+        skip_count++;
+        goto done;
+    }
+    last_flush = now;
+    skipped = FALSE;
+    flush_count++;
+
     LIST_FOR_EACH_ENTRY( surface, &window_surfaces, struct window_surface, entry )
         surface->funcs->flush( surface );
+
+    if (TRACE_ON(fps))
+    {
+        if (!stats_start) stats_start = now;
+        else if (now - stats_start > 1000)
+        {
+            TRACE_(fps)( "%u surface flushes, %u skipped in %u ms\n", flush_count, skip_count, now - stats_start );
+            stats_start = now;
+            flush_count = skip_count = 0;
+        }
+    }
 done:
     pthread_mutex_unlock( &surfaces_lock );
 }
@@ -1056,6 +1130,8 @@ static HRGN get_update_region( HWND hwnd, UINT *flags, HWND *child )
     RGNDATA *data;
     size_t size = 256;
 
+    flush_all_pending_redraws();
+
     do
     {
         if (!(data = malloc( sizeof(*data) + size - 1 )))
@@ -1092,28 +1168,244 @@ static HRGN get_update_region( HWND hwnd, UINT *flags, HWND *child )
 }
 
 /***********************************************************************
- *           redraw_window_rects
+ *           update_paint_stats
  *
- * Redraw part of a window.
+ * Count the paints and redraw requests of a window for the fps channel.
  */
-static BOOL redraw_window_rects( HWND hwnd, UINT flags, const RECT *rects, UINT count )
+static void update_paint_stats( HWND hwnd, UINT paints, UINT requests, UINT merged )
 {
-    BOOL ret;
+    WND *win;
+    DWORD now;
 
-    if (!(flags & (RDW_INVALIDATE|RDW_VALIDATE|RDW_INTERNALPAINT|RDW_NOINTERNALPAINT)))
-        return TRUE;  /* nothing to do */
+    if (!(win = get_win_ptr( hwnd )) || win == WND_OTHER_PROCESS || win == WND_DESKTOP) return;
+
+    win->paint_count += paints;
+    win->redraw_count += requests;
+    win->merge_count += merged;
+    now = NtGetTickCount();
+    if (!win->stats_start) win->stats_start = now;
+    else if (now - win->stats_start > 1000)
+    {
+        TRACE_(fps)( "window %p: %u paints, %u invalidations merged, %u redraw requests in %u ms\n",
+                     hwnd, win->paint_count, win->merge_count, win->redraw_count, now - win->stats_start );
+        win->stats_start = now;
+        win->paint_count = win->redraw_count = win->merge_count = 0;
+    }
+    release_win_ptr( win );
+}
+
+/***********************************************************************
+ *           send_redraw_window
+ */
+static BOOL send_redraw_window( HWND hwnd, UINT flags, const RECT *rects, UINT count, BOOL set_error )
+{
+    BOOL ret;
 
     SERVER_START_REQ( redraw_window )
     {
         req->window = wine_server_user_handle( hwnd );
         req->flags  = flags;
         wine_server_add_data( req, rects, count * sizeof(RECT) );
-        ret = !wine_server_call_err( req );
+        ret = !(set_error ? wine_server_call_err( req ) : wine_server_call( req ));
     }
     SERVER_END_REQ;
+
+    if (TRACE_ON(fps)) update_paint_stats( hwnd, 0, 1, 0 );
     return ret;
 }
 
+/* invalidations merged by a thread, see merge_redraw */
+struct pending_redraw
+{
+    struct list entry;   /* entry in pending_redraws list */
+    HWND        hwnd;    /* window of the merged invalidations */
+    UINT        flags;   /* redraw flags of the merged invalidations */
+    HRGN        rgn;     /* merged invalidations not sent yet, 0 when no batch is open */
+    DWORD       time;    /* time of the first invalidation of the batch */
+};
+
+static struct list pending_redraws = LIST_INIT( pending_redraws );
+static pthread_mutex_t pending_redraw_lock = PTHREAD_MUTEX_INITIALIZER;  /* taken before the user lock */
+static LONG pending_redraw_count;  /* number of open batches */
+
+/***********************************************************************
+ *           send_pending_redraw
+ *
+ * Send the merged region of a batch to the server, leaving the batch open.
+ * Must be called with the pending_redraw_lock held.
+ */
+static void send_pending_redraw( struct pending_redraw *redraw )
+{
+    RGNDATA *data;
+    DWORD size;
+    RECT box;
+
+    if (NtGdiGetRgnBox( redraw->rgn, &box ) <= NULLREGION) return;
+
+    if ((size = NtGdiGetRegionData( redraw->rgn, 0, NULL )) && (data = malloc( size )))
+    {
+        NtGdiGetRegionData( redraw->rgn, size, data );
+        /* the window may be gone by now, don't let that change the last error */
+        send_redraw_window( redraw->hwnd, redraw->flags, (const RECT *)data->Buffer,
+                            data->rdh.nCount, FALSE );
+        free( data );
+    }
+    NtGdiSetRectRgn( redraw->rgn, 0, 0, 0, 0 );
+}
+
+/***********************************************************************
+ *           close_pending_redraw
+ *
+ * Send the merged region of a batch and close it.
+ * Must be called with the pending_redraw_lock held.
+ */
+static void close_pending_redraw( struct pending_redraw *redraw, BOOL send )
+{
+    if (!redraw->rgn) return;
+    if (send) send_pending_redraw( redraw );
+    NtGdiDeleteObjectApp( redraw->rgn );
+    redraw->rgn = 0;
+    InterlockedDecrement( &pending_redraw_count );
+}
+
+/***********************************************************************
+ *           flush_pending_redraw
+ *
+ * Send the invalidations merged by the current thread to the server. This must be
+ * done before the thread looks at its queue state or waits.
+ */
+void flush_pending_redraw(void)
+{
+    struct pending_redraw *redraw = get_user_thread_info()->pending_redraw;
+
+    if (!redraw || !ReadNoFence( &pending_redraw_count )) return;
+
+    pthread_mutex_lock( &pending_redraw_lock );
+    close_pending_redraw( redraw, TRUE );
+    pthread_mutex_unlock( &pending_redraw_lock );
+}
+
+/***********************************************************************
+ *           flush_all_pending_redraws
+ *
+ * Send the invalidations merged by all the threads of the process to the server.
+ * This must be done before anything looks at an update region, since the window
+ * may belong to another thread.
+ */
+void flush_all_pending_redraws(void)
+{
+    struct pending_redraw *redraw;
+
+    if (!ReadAcquire( &pending_redraw_count )) return;
+
+    pthread_mutex_lock( &pending_redraw_lock );
+    LIST_FOR_EACH_ENTRY( redraw, &pending_redraws, struct pending_redraw, entry )
+        close_pending_redraw( redraw, TRUE );
+    pthread_mutex_unlock( &pending_redraw_lock );
+}
+
+/***********************************************************************
+ *           discard_pending_redraw
+ *
+ * Drop the merged invalidations of a window that is being destroyed,
+ * or all the pending state of the thread if hwnd is 0.
+ */
+void discard_pending_redraw( HWND hwnd )
+{
+    struct user_thread_info *thread_info = get_user_thread_info();
+    struct pending_redraw *redraw = thread_info->pending_redraw;
+
+    if (!redraw) return;
+
+    pthread_mutex_lock( &pending_redraw_lock );
+    if (!hwnd || redraw->hwnd == hwnd) close_pending_redraw( redraw, FALSE );
+    if (!hwnd) list_remove( &redraw->entry );
+    pthread_mutex_unlock( &pending_redraw_lock );
+
+    if (hwnd) return;
+    thread_info->pending_redraw = NULL;
+    free( redraw );
+}
+
+/***********************************************************************
+ *           merge_redraw
+ *
+ * Merge a plain invalidation of a window of the current thread with the pending ones,
+ * so that the many small invalidations of a frame end up in a single server request.
+ * The first invalidation of a batch is sent right away, so that the window is known
+ * to need painting even if the thread doesn't come back to check its queue.
+ */
+static BOOL merge_redraw( HWND hwnd, UINT flags, const RECT *rect, HRGN hrgn )
+{
+    struct user_thread_info *thread_info = get_user_thread_info();
+    struct pending_redraw *redraw;
+    DWORD now = NtGetTickCount();
+    BOOL first = FALSE;
+    RECT box;
+    HRGN rgn;
+
+    if ((flags & ~RDW_ERASE) != RDW_INVALIDATE) return FALSE;
+    if (!hwnd || !is_current_thread_window( hwnd ) || hwnd == get_desktop_window()) return FALSE;
+    if (hrgn ? NtGdiGetRgnBox( hrgn, &box ) <= NULLREGION : !rect || IsRectEmpty( rect )) return FALSE;
+
+    if (!(redraw = thread_info->pending_redraw))
+    {
+        if (!(redraw = calloc( 1, sizeof(*redraw) ))) return FALSE;
+        pthread_mutex_lock( &pending_redraw_lock );
+        list_add_tail( &pending_redraws, &redraw->entry );
+        pthread_mutex_unlock( &pending_redraw_lock );
+        thread_info->pending_redraw = redraw;
+    }
+
+    pthread_mutex_lock( &pending_redraw_lock );
+
+    /* start a new batch once the current one is a frame old; there is no timer, an idle
+     * batch is only sent when the thread checks its queue or someone asks for the update */
+    if (redraw->rgn && (redraw->hwnd != hwnd || redraw->flags != flags ||
+                        now - redraw->time >= get_frame_interval()))
+        close_pending_redraw( redraw, TRUE );
+
+    if (!redraw->rgn)
+    {
+        if (!(redraw->rgn = NtGdiCreateRectRgn( 0, 0, 0, 0 )))
+        {
+            pthread_mutex_unlock( &pending_redraw_lock );
+            return FALSE;
+        }
+        redraw->hwnd  = hwnd;
+        redraw->flags = flags;
+        redraw->time  = now;
+        InterlockedIncrement( &pending_redraw_count );
+        first = TRUE;
+    }
+
+    if (hrgn) NtGdiCombineRgn( redraw->rgn, redraw->rgn, hrgn, RGN_OR );
+    else if ((rgn = NtGdiCreateRectRgn( rect->left, rect->top, rect->right, rect->bottom )))
+    {
+        NtGdiCombineRgn( redraw->rgn, redraw->rgn, rgn, RGN_OR );
+        NtGdiDeleteObjectApp( rgn );
+    }
+    if (first) send_pending_redraw( redraw );
+    else if (TRACE_ON(fps)) update_paint_stats( hwnd, 0, 0, 1 );
+
+    pthread_mutex_unlock( &pending_redraw_lock );
+    return TRUE;
+}
+
+/***********************************************************************
+ *           redraw_window_rects
+ *
+ * Redraw part of a window.
+ */
+static BOOL redraw_window_rects( HWND hwnd, UINT flags, const RECT *rects, UINT count )
+{
+    if (!(flags & (RDW_INVALIDATE|RDW_VALIDATE|RDW_INTERNALPAINT|RDW_NOINTERNALPAINT)))
+        return TRUE;  /* nothing to do */
+
+    flush_all_pending_redraws();
+    return send_redraw_window( hwnd, flags, rects, count, TRUE );
+}
+
 /***********************************************************************
  *           get_update_flags
  *
@@ -1123,6 +1415,8 @@ static BOOL get_update_flags( HWND hwnd, HWND *child, UINT *flags )
 {
     BOOL ret;
 
+    flush_all_pending_redraws();
+
     SERVER_START_REQ( get_update_region )
     {
         req->window     = wine_server_user_handle( hwnd );
@@ -1342,6 +1636,8 @@ HDC WINAPI NtUserBeginPaint( HWND hwnd, PAINTSTRUCT *ps )
 
     NtUserHideCaret( hwnd );
 
+    if (TRACE_ON(fps)) update_paint_stats( hwnd, 1, 0, 0 );
+
     if (!(hrgn = send_ncpaint( hwnd, NULL, &flags ))) return 0;
 
     erase = send_erase( hwnd, flags, hrgn, &rect, &hdc );
@@ -1365,7 +1661,7 @@ HDC WINAPI NtUserBeginPaint( HWND hwnd, PAINTSTRUCT *ps )
 BOOL WINAPI NtUserEndPaint( HWND hwnd, const PAINTSTRUCT *ps )
 {
     NtUserShowCaret( hwnd );
-    flush_window_surfaces( FALSE );
+    flush_window_surfaces( FALSE, FALSE );
     if (!ps) return FALSE;
     release_dc( hwnd, ps->hdc, TRUE );
     return TRUE;
@@ -1461,7 +1757,12 @@ BOOL WINAPI NtUserRedrawWindow( HWND hwnd, const RECT *rect, HRGN hrgn, UINT fla
 
         order_rect( &ordered );
         if (IsRectEmpty( &ordered )) ordered = empty;
-        ret = redraw_window_rects( hwnd, flags, &ordered, 1 );
+        if (!(ret = merge_redraw( hwnd, flags, &ordered, 0 )))
+            ret = redraw_window_rects( hwnd, flags, &ordered, 1 );
+    }
+    else if (merge_redraw( hwnd, flags, NULL, hrgn ))
+    {
+        ret = TRUE;
     }
     else if (!hrgn)
     {
@@ -23,6 +23,7 @@
 #endif
 
 #include <assert.h>
+#include <pthread.h>
 
 #include "ntgdi_private.h"
 #include "dibdrv.h"
@@ -585,17 +586,76 @@ static void mask_rect( dib_info *dst, const RECT *dst_rect, const dib_info *src,
     }
 }
 
+struct blend_job
+{
+    dib_info       *dst_dib;
+    const dib_info *src_dib;
+    const RECT     *rects;
+    int             count;
+    RECT            bounds;   /* bounding rectangle of all the rects */
+    POINT           offset;
+    BLENDFUNCTION   blend;
+};
+
+static void blend_band( void *ctx, int band, int bands )
+{
+    const struct blend_job *job = ctx;
+    int i, height = job->bounds.bottom - job->bounds.top;
+    int top = job->bounds.top + height * band / bands;
+    int bottom = job->bounds.top + height * (band + 1) / bands;
+    RECT rect;
+
+    if (bands == 1)
+    {
+        job->dst_dib->funcs->blend_rects( job->dst_dib, job->count, job->rects,
+                                          job->src_dib, &job->offset, job->blend );
+        return;
+    }
+
+    /* the rects don't overlap, so each band only blends its own rows */
+    for (i = 0; i < job->count; i++)
+    {
+        rect = job->rects[i];
+        rect.top = max( rect.top, top );
+        rect.bottom = min( rect.bottom, bottom );
+        if (rect.top >= rect.bottom) continue;
+        job->dst_dib->funcs->blend_rects( job->dst_dib, 1, &rect, job->src_dib, &job->offset, job->blend );
+    }
+}
+
+/* blend the rects of the job, split into bands if they are large enough */
+static void run_blend_job( struct blend_job *job )
+{
+    ULONGLONG pixels = 0;
+    int i;
+
+    if (!job->count) return;
+    job->bounds = job->rects[0];
+    for (i = 0; i < job->count; i++)
+    {
+        union_rect( &job->bounds, &job->bounds, &job->rects[i] );
+        pixels += (ULONGLONG)(job->rects[i].right - job->rects[i].left) *
+                  (job->rects[i].bottom - job->rects[i].top);
+    }
+    run_blit_bands( blend_band, job, get_blit_bands( job->bounds.bottom - job->bounds.top, pixels ));
+}
+
 static DWORD blend_rect( dib_info *dst, const RECT *dst_rect, const dib_info *src, const RECT *src_rect,
                          HRGN clip, BLENDFUNCTION blend )
 {
-    POINT offset;
+    struct blend_job job;
     struct clipped_rects clipped_rects;
 
     if (!get_clipped_rects( dst, dst_rect, clip, &clipped_rects )) return ERROR_SUCCESS;
 
-    offset.x = src_rect->left - dst_rect->left;
-    offset.y = src_rect->top  - dst_rect->top;
-    dst->funcs->blend_rects( dst, clipped_rects.count, clipped_rects.rects, src, &offset, blend );
+    job.dst_dib  = dst;
+    job.src_dib  = src;
+    job.rects    = clipped_rects.rects;
+    job.count    = clipped_rects.count;
+    job.offset.x = src_rect->left - dst_rect->left;
+    job.offset.y = src_rect->top  - dst_rect->top;
+    job.blend    = blend;
+    run_blend_job( &job );
 
     free_clipped_rects( &clipped_rects );
     return ERROR_SUCCESS;
@@ -1091,6 +1151,147 @@ update_format:
     return ERROR_BAD_FORMAT;
 }
 
+/****************************************************************************
+ *               Parallel blits
+ *
+ * Large blits can be split into bands of rows that are processed by a pool of
+ * worker threads. This is disabled by default; the number of worker threads is
+ * set with the BlitThreads value of HKCU\Software\Wine\Gdi. The band
+ * functions run on plain Unix threads, so they must only touch the bitmap
+ * bits and can't use any Wine function, including the debug traces.
+ */
+
+#define BLIT_MAX_THREADS     8
+#define BLIT_BAND_MIN_ROWS   16
+#define BLIT_BAND_MIN_PIXELS (1 << 18)
+
+struct blit_job
+{
+    void (*func)( void *ctx, int band, int bands );
+    void *ctx;
+    int   bands;
+    LONG  next;     /* next band to process */
+    int   workers;  /* number of workers processing the job */
+};
+
+static pthread_once_t blit_once = PTHREAD_ONCE_INIT;
+static pthread_mutex_t blit_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t blit_job_cond = PTHREAD_COND_INITIALIZER;   /* a new job has been posted */
+static pthread_cond_t blit_done_cond = PTHREAD_COND_INITIALIZER;  /* the workers left the job */
+static struct blit_job *blit_job;  /* currently posted job */
+static unsigned int blit_serial;   /* serial number of the posted job */
+static int blit_threads;           /* number of worker threads */
+static LONG blit_busy;             /* set while a job is posted */
+
+static void process_blit_bands( struct blit_job *job )
+{
+    int band;
+
+    while ((band = InterlockedIncrement( &job->next ) - 1) < job->bands)
+        job->func( job->ctx, band, job->bands );
+}
+
+static void *blit_worker( void *arg )
+{
+    unsigned int serial = 0;
+    struct blit_job *job;
+
+    pthread_mutex_lock( &blit_mutex );
+    for (;;)
+    {
+        while (!blit_job || blit_serial == serial) pthread_cond_wait( &blit_job_cond, &blit_mutex );
+        job = blit_job;
+        serial = blit_serial;
+        job->workers++;
+        pthread_mutex_unlock( &blit_mutex );
+
+        process_blit_bands( job );
+
+        pthread_mutex_lock( &blit_mutex );
+        if (!--job->workers) pthread_cond_signal( &blit_done_cond );
+    }
+    return NULL;
+}
+
+static void init_blit_threads(void)
+{
+    char buffer[offsetof(KEY_VALUE_PARTIAL_INFORMATION, Data[32 * sizeof(WCHAR)])];
+    KEY_VALUE_PARTIAL_INFORMATION *info = (void *)buffer;
+    pthread_attr_t attr;
+    pthread_t thread;
+    DWORD count = 0;
+    HKEY hkey;
+    int i;
+
+    /* @@ Wine registry key: HKCU\Software\Wine\Gdi */
+    if ((hkey = reg_open_hkcu_key( "Software\\Wine\\Gdi" )))
+    {
+        if (query_reg_ascii_value( hkey, "BlitThreads", info, sizeof(buffer) - sizeof(WCHAR) ))
+        {
+            if (info->Type == REG_DWORD) count = *(DWORD *)info->Data;
+            else if (info->Type == REG_SZ)
+            {
+                const WCHAR *str = (const WCHAR *)info->Data;
+                for (i = 0; i < info->DataLength / sizeof(WCHAR) && str[i] >= '0' && str[i] <= '9'; i++)
+                    count = count * 10 + str[i] - '0';
+            }
+        }
+        NtClose( hkey );
+    }
+    count = min( count, BLIT_MAX_THREADS );
+
+    pthread_attr_init( &attr );
+    pthread_attr_setdetachstate( &attr, PTHREAD_CREATE_DETACHED );
+    for (i = 0; i < count; i++)
+        if (pthread_create( &thread, &attr, blit_worker, NULL )) break;
+    pthread_attr_destroy( &attr );
+    blit_threads = i;
+    TRACE( "using %u blit threads\n", blit_threads );
+}
+
+/* return the number of bands a blit of the given number of rows and pixels should be split into */
+int get_blit_bands( int rows, ULONGLONG pixels )
+{
+    if (pixels < BLIT_BAND_MIN_PIXELS || rows < 2 * BLIT_BAND_MIN_ROWS) return 1;
+    pthread_once( &blit_once, init_blit_threads );
+    if (!blit_threads) return 1;
+    return min( rows / BLIT_BAND_MIN_ROWS, 4 * (blit_threads + 1) );
+}
+
+/* call func for all the bands, using the worker threads if they are available */
+void run_blit_bands( void (*func)( void *ctx, int band, int bands ), void *ctx, int bands )
+{
+    struct blit_job job;
+    int band;
+
+    /* only one job can be posted at a time, the other threads do their blits themselves */
+    if (bands <= 1 || InterlockedCompareExchange( &blit_busy, 1, 0 ))
+    {
+        for (band = 0; band < bands; band++) func( ctx, band, bands );
+        return;
+    }
+
+    job.func = func;
+    job.ctx = ctx;
+    job.bands = bands;
+    job.next = 0;
+    job.workers = 0;
+
+    pthread_mutex_lock( &blit_mutex );
+    blit_job = &job;
+    blit_serial++;
+    pthread_cond_broadcast( &blit_job_cond );
+    pthread_mutex_unlock( &blit_mutex );
+
+    process_blit_bands( &job );
+
+    pthread_mutex_lock( &blit_mutex );
+    while (job.workers) pthread_cond_wait( &blit_done_cond, &blit_mutex );
+    blit_job = NULL;
+    pthread_mutex_unlock( &blit_mutex );
+    InterlockedExchange( &blit_busy, 0 );
+}
+
 /****************************************************************************
  *               calc_1d_stretch_params   (helper for stretch_bitmapinfo)
  *
@@ -1198,6 +1399,90 @@ static DWORD calc_1d_stretch_params( INT dst_start, INT dst_length, INT dst_vis_
 }
 
 
+struct stretch_job
+{
+    dib_info             *dst_dib;
+    const dib_info       *src_dib;
+    POINT                 dst_start;
+    POINT                 src_start;
+    struct stretch_params v_params;
+    struct stretch_params h_params;
+    BOOL                  vstretch;
+    int                   mode;
+    int                   width;  /* width of the destination rows */
+    int                   rows;   /* number of destination rows */
+    void (* row_fn)(const dib_info *dst_dib, const POINT *dst_start,
+                    const dib_info *src_dib, const POINT *src_start,
+                    const struct stretch_params *params, int mode, BOOL keep_dst);
+};
+
+/* stretch a band of destination rows; the Bresenham state is replayed up to the first row */
+static void stretch_band( void *ctx, int band, int bands )
+{
+    const struct stretch_job *job = ctx;
+    POINT dst_start = job->dst_start, src_start = job->src_start;
+    int err = job->v_params.err_start, length = job->v_params.length, row = 0;
+    int first = job->rows * band / bands;
+    int last = band == bands - 1 ? INT_MAX : job->rows * (band + 1) / bands;
+
+    if (job->vstretch)
+    {
+        BOOL need_row = TRUE;
+        RECT last_row, this_row;
+        last_row.left = 0;
+        last_row.right = job->width;
+
+        for ( ; length-- && row < last; row++)
+        {
+            if (row < first) ;
+            else if (need_row || row == first)
+            {
+                job->row_fn( job->dst_dib, &dst_start, job->src_dib, &src_start, &job->h_params, job->mode, FALSE );
+                need_row = FALSE;
+            }
+            else
+            {
+                last_row.top = dst_start.y - job->v_params.dst_inc;
+                last_row.bottom = last_row.top + 1;
+                this_row = last_row;
+                OffsetRect( &this_row, 0, job->v_params.dst_inc );
+                copy_rect( job->dst_dib, &this_row, job->dst_dib, &last_row, NULL, R2_COPYPEN );
+            }
+
+            if (err > 0)
+            {
+                src_start.y += job->v_params.src_inc;
+                need_row = TRUE;
+                err += job->v_params.err_add_1;
+            }
+            else err += job->v_params.err_add_2;
+            dst_start.y += job->v_params.dst_inc;
+        }
+    }
+    else
+    {
+        int merged_rows = 0;
+
+        while (length-- && row < last)
+        {
+            if (row >= first && (job->mode != STRETCH_DELETESCANS || !merged_rows))
+                job->row_fn( job->dst_dib, &dst_start, job->src_dib, &src_start, &job->h_params,
+                             job->mode, merged_rows != 0 );
+            merged_rows++;
+
+            if (err > 0)
+            {
+                dst_start.y += job->v_params.dst_inc;
+                merged_rows = 0;
+                err += job->v_params.err_add_1;
+                row++;
+            }
+            else err += job->v_params.err_add_2;
+            src_start.y += job->v_params.src_inc;
+        }
+    }
+}
+
 DWORD stretch_bitmapinfo( const BITMAPINFO *src_info, void *src_bits, struct bitblt_coords *src,
                           const BITMAPINFO *dst_info, void *dst_bits, struct bitblt_coords *dst,
                           INT mode )
@@ -1207,11 +1492,8 @@ DWORD stretch_bitmapinfo( const BITMAPINFO *src_info, void *src_bits, struct bit
     RECT rect;
     BOOL hstretch, vstretch;
     struct stretch_params v_params, h_params;
-    int err;
+    struct stretch_job job;
     DWORD ret;
-    void (* row_fn)(const dib_info *dst_dib, const POINT *dst_start,
-                    const dib_info *src_dib, const POINT *src_start,
-                    const struct stretch_params *params, int mode, BOOL keep_dst);
 
     TRACE("dst %d, %d - %d x %d visrect %s src %d, %d - %d x %d visrect %s\n",
           dst->x, dst->y, dst->width, dst->height, wine_dbgstr_rect(&dst->visrect),
@@ -1251,64 +1533,20 @@ DWORD stretch_bitmapinfo( const BITMAPINFO *src_info, void *src_bits, struct bit
     dst_start.x -= dst->visrect.left;
     dst_start.y -= dst->visrect.top;
 
-    err = v_params.err_start;
-
-    row_fn = hstretch ? dst_dib.funcs->stretch_row : dst_dib.funcs->shrink_row;
-
-    if (vstretch)
-    {
-        BOOL need_row = TRUE;
-        RECT last_row, this_row;
-        if (hstretch) mode = STRETCH_DELETESCANS;
-        last_row.left = 0;
-        last_row.right = dst->visrect.right - dst->visrect.left;
-
-        while (v_params.length--)
-        {
-            if (need_row)
-            {
-                row_fn( &dst_dib, &dst_start, &src_dib, &src_start, &h_params, mode, FALSE );
-                need_row = FALSE;
-            }
-            else
-            {
-                last_row.top = dst_start.y - v_params.dst_inc;
-                last_row.bottom = last_row.top + 1;
-                this_row = last_row;
-                OffsetRect( &this_row, 0, v_params.dst_inc );
-                copy_rect( &dst_dib, &this_row, &dst_dib, &last_row, NULL, R2_COPYPEN );
-            }
-
-            if (err > 0)
-            {
-                src_start.y += v_params.src_inc;
-                need_row = TRUE;
-                err += v_params.err_add_1;
-            }
-            else err += v_params.err_add_2;
-            dst_start.y += v_params.dst_inc;
-        }
-    }
-    else
-    {
-        int merged_rows = 0;
-
-        while (v_params.length--)
-        {
-            if (mode != STRETCH_DELETESCANS || !merged_rows)
-                row_fn( &dst_dib, &dst_start, &src_dib, &src_start, &h_params, mode, merged_rows != 0 );
-            merged_rows++;
-
-            if (err > 0)
-            {
-                dst_start.y += v_params.dst_inc;
-                merged_rows = 0;
-                err += v_params.err_add_1;
-            }
-            else err += v_params.err_add_2;
-            src_start.y += v_params.src_inc;
-        }
-    }
+    job.dst_dib   = &dst_dib;
+    job.src_dib   = &src_dib;
+    job.dst_start = dst_start;
+    job.src_start = src_start;
+    job.v_params  = v_params;
+    job.h_params  = h_params;
+    job.vstretch  = vstretch;
+    job.mode      = (vstretch && hstretch) ? STRETCH_DELETESCANS : mode;
+    job.width     = dst->visrect.right - dst->visrect.left;
+    job.rows      = vstretch ? v_params.length : dst->visrect.bottom - dst->visrect.top;
+    job.row_fn    = hstretch ? dst_dib.funcs->stretch_row : dst_dib.funcs->shrink_row;
+
+    run_blit_bands( stretch_band, &job, dst_dib.funcs == &funcs_null ? 1 :
+                    get_blit_bands( job.rows, (ULONGLONG)h_params.length * v_params.length ));
 
 done:
     /* update coordinates, the destination rectangle is always stored at 0,0 */
@@ -1324,11 +1562,24 @@ DWORD blend_bitmapinfo( const BITMAPINFO *src_info, void *src_bits, struct bitbl
                         BLENDFUNCTION blend )
 {
     dib_info src_dib, dst_dib;
+    struct blend_job job;
+    RECT rect;
 
     init_dib_info_from_bitmapinfo( &src_dib, src_info, src_bits );
     init_dib_info_from_bitmapinfo( &dst_dib, dst_info, dst_bits );
 
-    return blend_rect( &dst_dib, &dst->visrect, &src_dib, &src->visrect, NULL, blend );
+    if (!get_dib_rect( &dst_dib, &rect ) || !intersect_rect( &rect, &rect, &dst->visrect ))
+        return ERROR_SUCCESS;
+
+    job.dst_dib  = &dst_dib;
+    job.src_dib  = &src_dib;
+    job.rects    = &rect;
+    job.count    = 1;
+    job.offset.x = src->visrect.left - dst->visrect.left;
+    job.offset.y = src->visrect.top  - dst->visrect.top;
+    job.blend    = blend;
+    run_blend_job( &job );
+    return ERROR_SUCCESS;
 }
 
 DWORD gradient_bitmapinfo( const BITMAPINFO *info, void *bits, TRIVERTEX *vert_array, ULONG nvert,
@@ -731,6 +731,7 @@ struct windrv_physdev
     struct gdi_physdev     dev;
     struct dibdrv_physdev *dibdrv;
     struct window_surface *surface;
+    RECT                   bounds;       /* bounds of the current drawing operation */
     DWORD                  start_ticks;
 };
 
@@ -745,11 +746,14 @@ static inline void lock_surface( struct windrv_physdev *dev )
 {
     /* gdi_lock should not be locked */
     dev->surface->funcs->lock( dev->surface );
-    if (IsRectEmpty( dev->dibdrv->bounds )) dev->start_ticks = NtGetTickCount();
+    if (IsRectEmpty( dev->surface->funcs->get_bounds( dev->surface ))) dev->start_ticks = NtGetTickCount();
+    reset_bounds( &dev->bounds );
 }
 
 static inline void unlock_surface( struct windrv_physdev *dev )
 {
+    /* pass the individual rectangles to the surface, so that it can track the damage precisely */
+    if (!IsRectEmpty( &dev->bounds )) dev->surface->funcs->add_bounds( dev->surface, &dev->bounds );
     dev->surface->funcs->unlock( dev->surface );
     if (NtGetTickCount() - dev->start_ticks > FLUSH_PERIOD) dev->surface->funcs->flush( dev->surface );
 }
@@ -792,7 +796,8 @@ void dibdrv_set_window_surface( DC *dc, struct window_surface *surface )
         init_dib_info_from_bitmapinfo( &dibdrv->dib, info, bits );
         dibdrv->dib.rect = dc->attr->vis_rect;
         OffsetRect( &dibdrv->dib.rect, -dc->device_rect.left, -dc->device_rect.top );
-        dibdrv->bounds = surface->funcs->get_bounds( surface );
+        reset_bounds( &physdev->bounds );
+        dibdrv->bounds = &physdev->bounds;
         DC_InitDC( dc );
     }
     else if (windev)
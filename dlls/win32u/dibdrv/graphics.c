@@ -30,11 +30,32 @@
 #include "wine/debug.h"
 
 WINE_DEFAULT_DEBUG_CHANNEL(dib);
+WINE_DECLARE_DEBUG_CHANNEL(glyphcache);
+
+struct glyph_atlas;
 
 struct cached_glyph
 {
-    GLYPHMETRICS metrics;
-    BYTE         bits[1];
+    GLYPHMETRICS        metrics;
+    struct glyph_atlas *atlas;   /* atlas page that holds the glyph */
+    UINT                type;    /* type and index of the glyph, to remove it from the cache */
+    UINT                index;
+    BYTE                bits[1];
+};
+
+/* The glyphs of a font are packed in atlas pages, which are evicted in LRU
+ * order once the font uses more than its budget. */
+
+#define GLYPH_ATLAS_SIZE    0x10000
+#define GLYPH_CACHE_BUDGET  (4 * 1024 * 1024)
+
+struct glyph_atlas
+{
+    struct list entry;      /* entry in the font atlas list */
+    UINT        size;       /* size of the data */
+    UINT        used;       /* bytes allocated in the data */
+    LONG        last_used;  /* font generation of the last use */
+    BYTE       *data;
 };
 
 enum glyph_type
@@ -56,12 +77,22 @@ struct cached_font
     XFORM                 xform;
     UINT                  aa_flags;
     struct cached_glyph **glyphs[GLYPH_NBTYPES][GLYPH_CACHE_PAGES];
+    pthread_rwlock_t      lock;        /* held for reading while drawing, for writing while evicting */
+    pthread_mutex_t       atlas_lock;  /* protects the atlas allocations */
+    struct list           atlas;       /* atlas pages */
+    struct glyph_atlas   *current;     /* page used for new glyphs */
+    UINT                  atlas_size;  /* total size of the atlas pages */
+    LONG                  generation;  /* incremented for each string drawn */
 };
 
 static struct list font_cache = LIST_INIT( font_cache );
 
 static pthread_mutex_t font_cache_lock = PTHREAD_MUTEX_INITIALIZER;
 
+/* statistics for the glyphcache channel */
+static LONG glyph_cache_hits, glyph_cache_misses, glyph_cache_size, glyph_cache_evictions;
+static DWORD glyph_cache_report_time;
+
 
 static BOOL brush_rect( dibdrv_physdev *pdev, dib_brush *brush, const RECT *rect, HRGN clip )
 {
@@ -554,7 +585,7 @@ static int font_cache_cmp( const struct cached_font *p1, const struct cached_fon
 static struct cached_font *add_cached_font( DC *dc, HFONT hfont, UINT aa_flags )
 {
     struct cached_font font, *ptr, *last_unused = NULL;
-    UINT i = 0, j, k;
+    UINT i = 0, j;
 
     NtGdiExtGetObjectW( hfont, sizeof(font.lf), &font.lf );
     font.xform = dc->xformWorld2Vport;
@@ -587,17 +618,15 @@ static struct cached_font *add_cached_font( DC *dc, HFONT hfont, UINT aa_flags )
 
     if (i > 5)  /* keep at least 5 of the most-recently used fonts around */
     {
+        struct glyph_atlas *atlas, *next;
+
         ptr = last_unused;
         for (i = 0; i < GLYPH_NBTYPES; i++)
-        {
-            for (j = 0; j < GLYPH_CACHE_PAGES; j++)
-            {
-                if (!ptr->glyphs[i][j]) continue;
-                for (k = 0; k < GLYPH_CACHE_PAGE_SIZE; k++)
-                    free( ptr->glyphs[i][j][k] );
-                free( ptr->glyphs[i][j] );
-            }
-        }
+            for (j = 0; j < GLYPH_CACHE_PAGES; j++) free( ptr->glyphs[i][j] );
+        LIST_FOR_EACH_ENTRY_SAFE( atlas, next, &ptr->atlas, struct glyph_atlas, entry ) free( atlas );
+        InterlockedExchangeAdd( &glyph_cache_size, -(LONG)ptr->atlas_size );
+        pthread_rwlock_destroy( &ptr->lock );
+        pthread_mutex_destroy( &ptr->atlas_lock );
         list_remove( &ptr->entry );
     }
     else if (!(ptr = malloc( sizeof(*ptr) )))
@@ -609,6 +638,12 @@ static struct cached_font *add_cached_font( DC *dc, HFONT hfont, UINT aa_flags )
     *ptr = font;
     ptr->ref = 1;
     memset( ptr->glyphs, 0, sizeof(ptr->glyphs) );
+    pthread_rwlock_init( &ptr->lock, NULL );
+    pthread_mutex_init( &ptr->atlas_lock, NULL );
+    list_init( &ptr->atlas );
+    ptr->current = NULL;
+    ptr->atlas_size = 0;
+    ptr->generation = 0;
 done:
     list_add_head( &font_cache, &ptr->entry );
     pthread_mutex_unlock( &font_cache_lock );
@@ -621,40 +656,143 @@ void release_cached_font( struct cached_font *font )
     if (font) InterlockedDecrement( &font->ref );
 }
 
+static int get_glyph_depth( UINT aa_flags )
+{
+    switch (aa_flags)
+    {
+    case GGO_BITMAP: /* we'll convert non-antialiased 1-bpp bitmaps to 8-bpp */
+    case GGO_GRAY2_BITMAP:
+    case GGO_GRAY4_BITMAP:
+    case GGO_GRAY8_BITMAP:
+    case WINE_GGO_GRAY16_BITMAP: return 8;
+
+    case WINE_GGO_HRGB_BITMAP:
+    case WINE_GGO_HBGR_BITMAP:
+    case WINE_GGO_VRGB_BITMAP:
+    case WINE_GGO_VBGR_BITMAP: return 32;
+
+    default:
+        ERR("Unexpected flags %08x\n", aa_flags);
+        return 0;
+    }
+}
+
+static inline UINT get_glyph_record_size( const struct cached_font *font, const GLYPHMETRICS *metrics )
+{
+    UINT size = metrics->gmBlackBoxY * get_dib_stride( metrics->gmBlackBoxX, get_glyph_depth( font->aa_flags ));
+    return (FIELD_OFFSET( struct cached_glyph, bits[size] ) + 7) & ~7;
+}
+
+static struct glyph_atlas *alloc_glyph_atlas( struct cached_font *font, UINT size )
+{
+    struct glyph_atlas *atlas;
+
+    if (!(atlas = malloc( sizeof(*atlas) + size ))) return NULL;
+    atlas->size = size;
+    atlas->used = 0;
+    atlas->last_used = font->generation;
+    atlas->data = (BYTE *)(atlas + 1);
+    list_add_head( &font->atlas, &atlas->entry );
+    font->atlas_size += sizeof(*atlas) + size;
+    InterlockedExchangeAdd( &glyph_cache_size, sizeof(*atlas) + size );
+    return atlas;
+}
+
+/* remove the least recently used atlas pages until the font is well within its budget;
+ * the font lock must be held for writing */
+static void evict_glyph_atlas( struct cached_font *font )
+{
+    struct glyph_atlas *atlas, *lru;
+    struct cached_glyph *glyph;
+    UINT pos;
+
+    while (font->atlas_size > GLYPH_CACHE_BUDGET * 3 / 4)
+    {
+        lru = NULL;
+        LIST_FOR_EACH_ENTRY( atlas, &font->atlas, struct glyph_atlas, entry )
+        {
+            if (atlas == font->current) continue;
+            if (!lru || atlas->last_used - lru->last_used < 0) lru = atlas;
+        }
+        if (!lru) break;
+
+        for (pos = 0; pos < lru->used; pos += get_glyph_record_size( font, &glyph->metrics ))
+        {
+            glyph = (struct cached_glyph *)(lru->data + pos);
+            font->glyphs[glyph->type][glyph->index / GLYPH_CACHE_PAGE_SIZE]
+                        [glyph->index % GLYPH_CACHE_PAGE_SIZE] = NULL;
+        }
+        list_remove( &lru->entry );
+        font->atlas_size -= sizeof(*lru) + lru->size;
+        InterlockedExchangeAdd( &glyph_cache_size, -(LONG)(sizeof(*lru) + lru->size) );
+        InterlockedIncrement( &glyph_cache_evictions );
+        free( lru );
+    }
+    TRACE_(glyphcache)( "font %p: %u bytes left in the atlas\n", font, font->atlas_size );
+}
+
+/* copy a glyph bitmap into the font atlas; the font lock must be held for reading */
 static struct cached_glyph *add_cached_glyph( struct cached_font *font, UINT index, UINT flags,
-                                              struct cached_glyph *glyph )
+                                              const GLYPHMETRICS *metrics, const BYTE *bits )
 {
     struct cached_glyph *ret;
+    struct glyph_atlas *atlas;
     enum glyph_type type = (flags & ETO_GLYPH_INDEX) ? GLYPH_INDEX : GLYPH_WCHAR;
     UINT page = index / GLYPH_CACHE_PAGE_SIZE;
     UINT entry = index % GLYPH_CACHE_PAGE_SIZE;
+    UINT size = get_glyph_record_size( font, metrics );
+
+    pthread_mutex_lock( &font->atlas_lock );
 
     if (!font->glyphs[type][page])
     {
         struct cached_glyph **ptr;
 
-        ptr = calloc( 1, GLYPH_CACHE_PAGE_SIZE * sizeof(*ptr) );
-        if (!ptr)
-        {
-            free( glyph );
-            return NULL;
-        }
-        if (InterlockedCompareExchangePointer( (void **)&font->glyphs[type][page], ptr, NULL ))
-            free( ptr );
+        if (!(ptr = calloc( 1, GLYPH_CACHE_PAGE_SIZE * sizeof(*ptr) ))) goto failed;
+        InterlockedExchangePointer( (void **)&font->glyphs[type][page], ptr );
     }
-    ret = InterlockedCompareExchangePointer( (void **)&font->glyphs[type][page][entry], glyph, NULL );
-    if (!ret) ret = glyph;
-    else free( glyph );
+    /* another thread may have added it in the meantime */
+    if ((ret = font->glyphs[type][page][entry])) goto done;
+
+    if (size > GLYPH_ATLAS_SIZE / 4)  /* large glyphs get their own page */
+    {
+        if (!(atlas = alloc_glyph_atlas( font, size ))) goto failed;
+    }
+    else if (!(atlas = font->current) || atlas->used + size > atlas->size)
+    {
+        if (!(atlas = alloc_glyph_atlas( font, GLYPH_ATLAS_SIZE ))) goto failed;
+        font->current = atlas;
+    }
+
+    ret = (struct cached_glyph *)(atlas->data + atlas->used);
+    atlas->used += size;
+    ret->metrics = *metrics;
+    ret->atlas   = atlas;
+    ret->type    = type;
+    ret->index   = index;
+    memcpy( ret->bits, bits, metrics->gmBlackBoxY * get_dib_stride( metrics->gmBlackBoxX,
+                                                                    get_glyph_depth( font->aa_flags )));
+    InterlockedExchangePointer( (void **)&font->glyphs[type][page][entry], ret );
+
+done:
+    pthread_mutex_unlock( &font->atlas_lock );
     return ret;
+
+failed:
+    pthread_mutex_unlock( &font->atlas_lock );
+    return NULL;
 }
 
 static struct cached_glyph *get_cached_glyph( struct cached_font *font, UINT index, UINT flags )
 {
     enum glyph_type type = (flags & ETO_GLYPH_INDEX) ? GLYPH_INDEX : GLYPH_WCHAR;
     UINT page = index / GLYPH_CACHE_PAGE_SIZE;
+    struct cached_glyph *glyph;
 
     if (!font->glyphs[type][page]) return NULL;
-    return font->glyphs[type][page][index % GLYPH_CACHE_PAGE_SIZE];
+    if (!(glyph = font->glyphs[type][page][index % GLYPH_CACHE_PAGE_SIZE])) return NULL;
+    glyph->atlas->last_used = font->generation;
+    return glyph;
 }
 
 /**********************************************************************
@@ -678,27 +816,20 @@ static inline void get_text_bkgnd_masks( DC *dc, const dib_info *dib, rop_mask *
     }
 }
 
-static void draw_glyph( dib_info *dib, int x, int y, const GLYPHMETRICS *metrics,
-                        const dib_info *glyph_dib, DWORD text_color,
+static void draw_glyph( dib_info *dib, const RECT *rect, const dib_info *glyph_dib, DWORD text_color,
                         const struct font_intensities *intensity,
-                        const struct clipped_rects *clipped_rects, RECT *bounds )
+                        const struct clipped_rects *clipped_rects )
 {
     int i;
-    RECT rect, clipped_rect;
+    RECT clipped_rect;
     POINT src_origin;
 
-    rect.left   = x          + metrics->gmptGlyphOrigin.x;
-    rect.top    = y          - metrics->gmptGlyphOrigin.y;
-    rect.right  = rect.left  + metrics->gmBlackBoxX;
-    rect.bottom = rect.top   + metrics->gmBlackBoxY;
-    if (bounds) add_bounds_rect( bounds, &rect );
-
     for (i = 0; i < clipped_rects->count; i++)
     {
-        if (intersect_rect( &clipped_rect, &rect, clipped_rects->rects + i ))
+        if (intersect_rect( &clipped_rect, rect, clipped_rects->rects + i ))
         {
-            src_origin.x = clipped_rect.left - rect.left;
-            src_origin.y = clipped_rect.top  - rect.top;
+            src_origin.x = clipped_rect.left - rect->left;
+            src_origin.y = clipped_rect.top  - rect->top;
 
             if (glyph_dib->bit_count == 32)
                 dib->funcs->draw_subpixel_glyph( dib, &clipped_rect, glyph_dib, &src_origin,
@@ -710,27 +841,6 @@ static void draw_glyph( dib_info *dib, int x, int y, const GLYPHMETRICS *metrics
     }
 }
 
-static int get_glyph_depth( UINT aa_flags )
-{
-    switch (aa_flags)
-    {
-    case GGO_BITMAP: /* we'll convert non-antialiased 1-bpp bitmaps to 8-bpp */
-    case GGO_GRAY2_BITMAP:
-    case GGO_GRAY4_BITMAP:
-    case GGO_GRAY8_BITMAP:
-    case WINE_GGO_GRAY16_BITMAP: return 8;
-
-    case WINE_GGO_HRGB_BITMAP:
-    case WINE_GGO_HBGR_BITMAP:
-    case WINE_GGO_VRGB_BITMAP:
-    case WINE_GGO_VBGR_BITMAP: return 32;
-
-    default:
-        ERR("Unexpected flags %08x\n", aa_flags);
-        return 0;
-    }
-}
-
 static const BYTE masks[8] = {0x80, 0x40, 0x20, 0x10, 0x08, 0x04, 0x02, 0x01};
 static const int padding[4] = {0, 3, 2, 1};
 
@@ -753,6 +863,7 @@ static struct cached_glyph *cache_glyph_bitmap( DC *dc, struct cached_font *font
     int pad = 0, stride, bit_count;
     GLYPHMETRICS metrics;
     struct cached_glyph *glyph;
+    BYTE *bits;
 
     if (flags & ETO_GLYPH_INDEX) ggo_flags |= GGO_GLYPH_INDEX;
     indices[0] = index;
@@ -769,17 +880,16 @@ static struct cached_glyph *cache_glyph_bitmap( DC *dc, struct cached_font *font
     bit_count = get_glyph_depth( font->aa_flags );
     stride = get_dib_stride( metrics.gmBlackBoxX, bit_count );
     size = metrics.gmBlackBoxY * stride;
-    glyph = malloc( FIELD_OFFSET( struct cached_glyph, bits[size] ));
-    if (!glyph) return NULL;
+    if (!(bits = malloc( max( size, 1 )))) return NULL;
     if (!size) goto done;  /* empty glyph */
 
     if (bit_count == 8) pad = padding[ metrics.gmBlackBoxX % 4 ];
 
-    ret = NtGdiGetGlyphOutline( dc->hSelf, index, ggo_flags, &metrics, size, glyph->bits,
+    ret = NtGdiGetGlyphOutline( dc->hSelf, index, ggo_flags, &metrics, size, bits,
                                 &identity, FALSE );
     if (ret == GDI_ERROR)
     {
-        free( glyph );
+        free( bits );
         return NULL;
     }
     assert( ret <= size );
@@ -787,8 +897,8 @@ static struct cached_glyph *cache_glyph_bitmap( DC *dc, struct cached_font *font
     {
         for (y = metrics.gmBlackBoxY - 1; y >= 0; y--)
         {
-            src = glyph->bits + y * get_dib_stride( metrics.gmBlackBoxX, 1 );
-            dst = glyph->bits + y * stride;
+            src = bits + y * get_dib_stride( metrics.gmBlackBoxX, 1 );
+            dst = bits + y * stride;
 
             if (pad) memset( dst + metrics.gmBlackBoxX, 0, pad );
 
@@ -798,24 +908,131 @@ static struct cached_glyph *cache_glyph_bitmap( DC *dc, struct cached_font *font
     }
     else if (pad)
     {
-        for (y = 0, dst = glyph->bits; y < metrics.gmBlackBoxY; y++, dst += stride)
+        for (y = 0, dst = bits; y < metrics.gmBlackBoxY; y++, dst += stride)
             memset( dst + metrics.gmBlackBoxX, 0, pad );
     }
 
 done:
-    glyph->metrics = metrics;
-    return add_cached_glyph( font, index, flags, glyph );
+    glyph = add_cached_glyph( font, indices[0], flags, &metrics, bits );
+    free( bits );
+    return glyph;
+}
+
+/* non-overlapping glyphs that are composited together in a single mask */
+
+#define GLYPH_RUN_MAX_GLYPHS 64
+#define GLYPH_RUN_MASK_SIZE  0x10000  /* bytes, including the row padding */
+
+struct glyph_run
+{
+    RECT   bounds;
+    UINT   count;
+    BYTE  *mask;
+    struct
+    {
+        RECT                       rect;
+        const struct cached_glyph *glyph;
+    } glyphs[GLYPH_RUN_MAX_GLYPHS];
+};
+
+static void init_glyph_dib( dib_info *glyph_dib, const RECT *rect, void *bits )
+{
+    glyph_dib->width       = rect->right - rect->left;
+    glyph_dib->height      = rect->bottom - rect->top;
+    glyph_dib->rect.right  = glyph_dib->width;
+    glyph_dib->rect.bottom = glyph_dib->height;
+    glyph_dib->stride      = get_dib_stride( glyph_dib->width, glyph_dib->bit_count );
+    glyph_dib->bits.ptr    = bits;
+}
+
+static void flush_glyph_run( dib_info *dib, struct glyph_run *run, dib_info *glyph_dib, DWORD text_color,
+                             const struct font_intensities *intensity,
+                             const struct clipped_rects *clipped_rects )
+{
+    UINT i, y, bpp = glyph_dib->bit_count / 8;
+    const struct cached_glyph *glyph;
+    const RECT *rect;
+    BYTE *dst;
+
+    if (!run->count) return;
+
+    if (run->count == 1)
+    {
+        init_glyph_dib( glyph_dib, &run->glyphs[0].rect, (void *)run->glyphs[0].glyph->bits );
+        draw_glyph( dib, &run->glyphs[0].rect, glyph_dib, text_color, intensity, clipped_rects );
+        run->count = 0;
+        return;
+    }
+
+    /* zero coverage is a no-op for all the glyph primitives, so the glyphs can be merged into one mask */
+    init_glyph_dib( glyph_dib, &run->bounds, run->mask );
+    memset( run->mask, 0, glyph_dib->height * glyph_dib->stride );
+    for (i = 0; i < run->count; i++)
+    {
+        glyph = run->glyphs[i].glyph;
+        rect = &run->glyphs[i].rect;
+        dst = run->mask + (rect->top - run->bounds.top) * glyph_dib->stride + (rect->left - run->bounds.left) * bpp;
+        for (y = 0; y < glyph->metrics.gmBlackBoxY; y++, dst += glyph_dib->stride)
+            memcpy( dst, glyph->bits + y * get_dib_stride( glyph->metrics.gmBlackBoxX, glyph_dib->bit_count ),
+                    glyph->metrics.gmBlackBoxX * bpp );
+    }
+    draw_glyph( dib, &run->bounds, glyph_dib, text_color, intensity, clipped_rects );
+    run->count = 0;
+}
+
+/* add a glyph to the current run, flushing it first if the glyph can't be merged */
+static void add_glyph_to_run( dib_info *dib, struct glyph_run *run, const struct cached_glyph *glyph,
+                              const RECT *rect, dib_info *glyph_dib, DWORD text_color,
+                              const struct font_intensities *intensity,
+                              const struct clipped_rects *clipped_rects )
+{
+    RECT bounds, overlap;
+
+    if (run->count)
+    {
+        union_rect( &bounds, &run->bounds, rect );
+        if (!run->mask || run->count == GLYPH_RUN_MAX_GLYPHS ||
+            intersect_rect( &overlap, &run->bounds, rect ) ||
+            (ULONGLONG)get_dib_stride( bounds.right - bounds.left, glyph_dib->bit_count ) * (bounds.bottom - bounds.top) >
+            GLYPH_RUN_MASK_SIZE)
+        {
+            flush_glyph_run( dib, run, glyph_dib, text_color, intensity, clipped_rects );
+            bounds = *rect;
+        }
+    }
+    else bounds = *rect;
+
+    run->bounds = bounds;
+    run->glyphs[run->count].rect = *rect;
+    run->glyphs[run->count].glyph = glyph;
+    run->count++;
+}
+
+static void report_glyph_cache_stats( UINT hits, UINT misses )
+{
+    LONG total_hits = InterlockedExchangeAdd( &glyph_cache_hits, hits ) + hits;
+    LONG total_misses = InterlockedExchangeAdd( &glyph_cache_misses, misses ) + misses;
+    DWORD time = NtGetTickCount();
+
+    if (time - glyph_cache_report_time < 5000) return;
+    glyph_cache_report_time = time;
+    TRACE_(glyphcache)( "%d hits, %d misses (%u%% hit rate), %d bytes in atlas pages, %d pages evicted\n",
+                        (int)total_hits, (int)total_misses,
+                        total_hits + total_misses ? (UINT)((ULONGLONG)total_hits * 100 / (total_hits + total_misses)) : 0,
+                        (int)glyph_cache_size, (int)glyph_cache_evictions );
 }
 
 static void render_string( DC *dc, dib_info *dib, struct cached_font *font, INT x, INT y,
                            UINT flags, const WCHAR *str, UINT count, const INT *dx,
                            const struct clipped_rects *clipped_rects, RECT *bounds )
 {
-    UINT i;
+    UINT i, hits = 0, misses = 0;
     struct cached_glyph *glyph;
+    struct glyph_run run;
     dib_info glyph_dib;
     DWORD text_color;
     struct font_intensities intensity;
+    RECT rect;
 
     glyph_dib.bit_count    = get_glyph_depth( font->aa_flags );
     glyph_dib.rect.left    = 0;
@@ -830,19 +1047,31 @@ static void render_string( DC *dc, dib_info *dib, struct cached_font *font, INT
     else
         get_aa_ranges( dib->funcs->pixel_to_colorref( dib, text_color ), intensity.ranges );
 
+    if (font->atlas_size > GLYPH_CACHE_BUDGET && !pthread_rwlock_trywrlock( &font->lock ))
+    {
+        evict_glyph_atlas( font );
+        pthread_rwlock_unlock( &font->lock );
+    }
+    pthread_rwlock_rdlock( &font->lock );
+    InterlockedIncrement( &font->generation );
+
+    run.count = 0;
+    run.mask = count > 1 ? malloc( GLYPH_RUN_MASK_SIZE ) : NULL;
+
     for (i = 0; i < count; i++)
     {
-        if (!(glyph = get_cached_glyph( font, str[i], flags )) &&
-            !(glyph = cache_glyph_bitmap( dc, font, str[i], flags ))) continue;
+        if ((glyph = get_cached_glyph( font, str[i], flags ))) hits++;
+        else if ((glyph = cache_glyph_bitmap( dc, font, str[i], flags ))) misses++;
+        else continue;
 
-        glyph_dib.width       = glyph->metrics.gmBlackBoxX;
-        glyph_dib.height      = glyph->metrics.gmBlackBoxY;
-        glyph_dib.rect.right  = glyph->metrics.gmBlackBoxX;
-        glyph_dib.rect.bottom = glyph->metrics.gmBlackBoxY;
-        glyph_dib.stride      = get_dib_stride( glyph->metrics.gmBlackBoxX, glyph_dib.bit_count );
-        glyph_dib.bits.ptr    = glyph->bits;
+        rect.left   = x         + glyph->metrics.gmptGlyphOrigin.x;
+        rect.top    = y         - glyph->metrics.gmptGlyphOrigin.y;
+        rect.right  = rect.left + glyph->metrics.gmBlackBoxX;
+        rect.bottom = rect.top  + glyph->metrics.gmBlackBoxY;
+        if (bounds) add_bounds_rect( bounds, &rect );
 
-        draw_glyph( dib, x, y, &glyph->metrics, &glyph_dib, text_color, &intensity, clipped_rects, bounds );
+        if (!IsRectEmpty( &rect ))
+            add_glyph_to_run( dib, &run, glyph, &rect, &glyph_dib, text_color, &intensity, clipped_rects );
 
         if (dx)
         {
@@ -860,6 +1089,11 @@ static void render_string( DC *dc, dib_info *dib, struct cached_font *font, INT
             y += glyph->metrics.gmCellIncY;
         }
     }
+    flush_glyph_run( dib, &run, &glyph_dib, text_color, &intensity, clipped_rects );
+    free( run.mask );
+
+    pthread_rwlock_unlock( &font->lock );
+    if (TRACE_ON(glyphcache)) report_glyph_cache_stats( hits, misses );
 }
 
 BOOL render_aa_text_bitmapinfo( DC *dc, BITMAPINFO *info, struct gdi_image_bits *bits,
@@ -23,6 +23,11 @@
 #endif
 
 #include <assert.h>
+#if defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__))
+#include <cpuid.h>
+#include <immintrin.h>
+#define HAVE_DIB_SIMD
+#endif
 
 #include "ntgdi_private.h"
 #include "dibdrv.h"
@@ -268,6 +273,76 @@ static inline void memset_16( WORD *start, WORD val, DWORD size )
 #endif
 }
 
+#ifdef HAVE_DIB_SIMD
+
+/* Vector versions of the most common 32-bpp primitives. They have to give exactly the
+ * same results as the generic code, down to the rounding and the overflow behaviour. */
+
+#define SSE2_FUNC __attribute__((target("sse2")))
+#define AVX2_FUNC __attribute__((target("avx2")))
+
+enum simd_level
+{
+    SIMD_NONE,
+    SIMD_SSE2,
+    SIMD_AVX2
+};
+
+static enum simd_level get_simd_level(void)
+{
+    static int level = -1;
+    unsigned int eax, ebx, ecx, edx, xcr0_lo, xcr0_hi;
+    enum simd_level ret = SIMD_NONE;
+
+    if (level != -1) return level;
+
+    if (__get_cpuid( 1, &eax, &ebx, &ecx, &edx ))
+    {
+        if (edx & bit_SSE2) ret = SIMD_SSE2;
+        /* AVX2 also needs the OS to save the ymm registers */
+        if (ret && (ecx & (bit_OSXSAVE | bit_AVX)) == (bit_OSXSAVE | bit_AVX))
+        {
+            __asm__( ".byte 0x0f,0x01,0xd0" /* xgetbv */ : "=a" (xcr0_lo), "=d" (xcr0_hi) : "c" (0) );
+            if ((xcr0_lo & 6) == 6 && __get_cpuid_count( 7, 0, &eax, &ebx, &ecx, &edx ) && (ebx & bit_AVX2))
+                ret = SIMD_AVX2;
+        }
+    }
+    TRACE( "using %s primitives\n", ret == SIMD_AVX2 ? "AVX2" : ret == SIMD_SSE2 ? "SSE2" : "generic" );
+    return level = ret;
+}
+
+static SSE2_FUNC void solid_row_32_sse2( DWORD *ptr, int len, DWORD and, DWORD xor )
+{
+    const __m128i and_vec = _mm_set1_epi32( and ), xor_vec = _mm_set1_epi32( xor );
+
+    for ( ; len >= 4; len -= 4, ptr += 4)
+    {
+        __m128i val = _mm_loadu_si128( (__m128i *)ptr );
+        _mm_storeu_si128( (__m128i *)ptr, _mm_xor_si128( _mm_and_si128( val, and_vec ), xor_vec ));
+    }
+    while (len-- > 0) do_rop_32( ptr++, and, xor );
+}
+
+static AVX2_FUNC void convert_row_24_to_8888_avx2( DWORD *dst, const BYTE *src, int len )
+{
+    const __m256i permute = _mm256_setr_epi32( 0, 1, 2, 0, 3, 4, 5, 0 );
+    const __m256i shuffle = _mm256_setr_epi8( 0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1,
+                                              0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1 );
+
+    /* the loads read past the pixels they convert, stop while the row still has enough bytes left */
+    for ( ; len >= 11; len -= 8, src += 24, dst += 8)
+    {
+        __m256i val = _mm256_permutevar8x32_epi32( _mm256_loadu_si256( (const __m256i *)src ), permute );
+        _mm256_storeu_si256( (__m256i *)dst, _mm256_shuffle_epi8( val, shuffle ));
+    }
+    for ( ; len >= 6; len -= 4, src += 12, dst += 4)
+        _mm_storeu_si128( (__m128i *)dst, _mm_shuffle_epi8( _mm_loadu_si128( (const __m128i *)src ),
+                                                            _mm256_castsi256_si128( shuffle )));
+    for ( ; len > 0; len--, src += 3) *dst++ = src[0] | (src[1] << 8) | (src[2] << 16);
+}
+
+#endif  /* HAVE_DIB_SIMD */
+
 static void solid_rects_32(const dib_info *dib, int num, const RECT *rc, DWORD and, DWORD xor)
 {
     DWORD *ptr, *start;
@@ -278,6 +353,12 @@ static void solid_rects_32(const dib_info *dib, int num, const RECT *rc, DWORD a
         assert( !IsRectEmpty( rc ));
 
         start = get_pixel_ptr_32(dib, rc->left, rc->top);
+#ifdef HAVE_DIB_SIMD
+        if (and && get_simd_level() != SIMD_NONE)
+            for(y = rc->top; y < rc->bottom; y++, start += dib->stride / 4)
+                solid_row_32_sse2( start, rc->right - rc->left, and, xor );
+        else
+#endif
         if (and)
             for(y = rc->top; y < rc->bottom; y++, start += dib->stride / 4)
                 for(x = rc->left, ptr = start; x < rc->right; x++)
@@ -2291,6 +2372,14 @@ static void convert_to_8888(dib_info *dst, const dib_info *src, const RECT *src_
         {
             dst_pixel = dst_start;
             src_pixel = src_start;
+#ifdef HAVE_DIB_SIMD
+            if (get_simd_level() == SIMD_AVX2)
+            {
+                convert_row_24_to_8888_avx2( dst_pixel, src_pixel, src_rect->right - src_rect->left );
+                dst_pixel += src_rect->right - src_rect->left;
+            }
+            else
+#endif
             for(x = src_rect->left; x < src_rect->right; x++)
             {
                 RGBQUAD rgb;
@@ -4682,11 +4771,185 @@ static inline DWORD blend_rgb( BYTE dst_r, BYTE dst_g, BYTE dst_b, DWORD src, BL
             blend_color( dst_r, src >> 16, blend.SourceConstantAlpha ) << 16);
 }
 
+#ifdef HAVE_DIB_SIMD
+
+enum blend_mode
+{
+    BLEND_ARGB,             /* per-pixel alpha */
+    BLEND_ARGB_ALPHA,       /* per-pixel and constant alpha */
+    BLEND_CONSTANT_ALPHA,   /* constant alpha only */
+    BLEND_NO_SRC_ALPHA      /* constant alpha, the source has no alpha channel */
+};
+
+static inline DWORD blend_pixel_8888( DWORD dst, DWORD src, enum blend_mode mode, DWORD alpha )
+{
+    switch (mode)
+    {
+    case BLEND_ARGB:           return blend_argb( dst, src );
+    case BLEND_ARGB_ALPHA:     return blend_argb_alpha( dst, src, alpha );
+    case BLEND_CONSTANT_ALPHA: return blend_argb_constant_alpha( dst, src, alpha );
+    default:                   return blend_argb_no_src_alpha( dst, src, alpha );
+    }
+}
+
+/* The vector code works on pixels unpacked to 16-bit channels; (x + 127) / 255 is
+ * computed as ((x + 128) + ((x + 128) >> 8)) >> 8, which is exact for x <= 255 * 255. */
+
+static inline SSE2_FUNC __m128i div255_sse2( __m128i x )
+{
+    x = _mm_add_epi16( x, _mm_set1_epi16( 128 ));
+    return _mm_srli_epi16( _mm_add_epi16( x, _mm_srli_epi16( x, 8 )), 8 );
+}
+
+static inline SSE2_FUNC __m128i blend_argb_sse2( __m128i dst, __m128i src )
+{
+    __m128i alpha = _mm_shufflehi_epi16( _mm_shufflelo_epi16( src, 0xff ), 0xff );
+    __m128i inv = _mm_sub_epi16( _mm_set1_epi16( 255 ), alpha );
+    return _mm_add_epi16( src, div255_sse2( _mm_mullo_epi16( dst, inv )));
+}
+
+static inline SSE2_FUNC __m128i blend_color_sse2( __m128i dst, __m128i src, __m128i alpha )
+{
+    __m128i inv = _mm_sub_epi16( _mm_set1_epi16( 255 ), alpha );
+    return div255_sse2( _mm_add_epi16( _mm_mullo_epi16( src, alpha ), _mm_mullo_epi16( dst, inv )));
+}
+
+static inline SSE2_FUNC __m128i blend_channels_sse2( __m128i dst, __m128i src, enum blend_mode mode, __m128i alpha )
+{
+    switch (mode)
+    {
+    case BLEND_ARGB:       return blend_argb_sse2( dst, src );
+    case BLEND_ARGB_ALPHA: return blend_argb_sse2( dst, div255_sse2( _mm_mullo_epi16( src, alpha )));
+    default:               return blend_color_sse2( dst, src, alpha );
+    }
+}
+
+/* like the generic code, a channel that overflows carries into the low bit of the next one */
+static inline SSE2_FUNC __m128i pack_argb_sse2( __m128i lo, __m128i hi )
+{
+    const __m128i mask = _mm_set1_epi16( 0xff );
+    __m128i val = _mm_packus_epi16( _mm_and_si128( lo, mask ), _mm_and_si128( hi, mask ));
+    __m128i carry = _mm_packus_epi16( _mm_srli_epi16( lo, 8 ), _mm_srli_epi16( hi, 8 ));
+    return _mm_or_si128( val, _mm_slli_epi32( carry, 8 ));
+}
+
+static SSE2_FUNC void blend_row_8888_sse2( DWORD *dst, const DWORD *src, int len, enum blend_mode mode, DWORD alpha )
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i alpha_vec = _mm_set1_epi16( alpha );
+    const __m128i src_alpha = _mm_set1_epi32( mode == BLEND_NO_SRC_ALPHA ? 0xff000000 : 0 );
+
+    for ( ; len >= 4; len -= 4, dst += 4, src += 4)
+    {
+        __m128i d = _mm_loadu_si128( (__m128i *)dst );
+        __m128i s = _mm_or_si128( _mm_loadu_si128( (const __m128i *)src ), src_alpha );
+        __m128i lo = blend_channels_sse2( _mm_unpacklo_epi8( d, zero ), _mm_unpacklo_epi8( s, zero ), mode, alpha_vec );
+        __m128i hi = blend_channels_sse2( _mm_unpackhi_epi8( d, zero ), _mm_unpackhi_epi8( s, zero ), mode, alpha_vec );
+        _mm_storeu_si128( (__m128i *)dst, pack_argb_sse2( lo, hi ));
+    }
+    for ( ; len > 0; len--, dst++, src++) *dst = blend_pixel_8888( *dst, *src, mode, alpha );
+}
+
+static inline AVX2_FUNC __m256i div255_avx2( __m256i x )
+{
+    x = _mm256_add_epi16( x, _mm256_set1_epi16( 128 ));
+    return _mm256_srli_epi16( _mm256_add_epi16( x, _mm256_srli_epi16( x, 8 )), 8 );
+}
+
+static inline AVX2_FUNC __m256i blend_argb_avx2( __m256i dst, __m256i src )
+{
+    __m256i alpha = _mm256_shufflehi_epi16( _mm256_shufflelo_epi16( src, 0xff ), 0xff );
+    __m256i inv = _mm256_sub_epi16( _mm256_set1_epi16( 255 ), alpha );
+    return _mm256_add_epi16( src, div255_avx2( _mm256_mullo_epi16( dst, inv )));
+}
+
+static inline AVX2_FUNC __m256i blend_color_avx2( __m256i dst, __m256i src, __m256i alpha )
+{
+    __m256i inv = _mm256_sub_epi16( _mm256_set1_epi16( 255 ), alpha );
+    return div255_avx2( _mm256_add_epi16( _mm256_mullo_epi16( src, alpha ), _mm256_mullo_epi16( dst, inv )));
+}
+
+static inline AVX2_FUNC __m256i blend_channels_avx2( __m256i dst, __m256i src, enum blend_mode mode, __m256i alpha )
+{
+    switch (mode)
+    {
+    case BLEND_ARGB:       return blend_argb_avx2( dst, src );
+    case BLEND_ARGB_ALPHA: return blend_argb_avx2( dst, div255_avx2( _mm256_mullo_epi16( src, alpha )));
+    default:               return blend_color_avx2( dst, src, alpha );
+    }
+}
+
+static inline AVX2_FUNC __m256i pack_argb_avx2( __m256i lo, __m256i hi )
+{
+    const __m256i mask = _mm256_set1_epi16( 0xff );
+    __m256i val = _mm256_packus_epi16( _mm256_and_si256( lo, mask ), _mm256_and_si256( hi, mask ));
+    __m256i carry = _mm256_packus_epi16( _mm256_srli_epi16( lo, 8 ), _mm256_srli_epi16( hi, 8 ));
+    return _mm256_or_si256( val, _mm256_slli_epi32( carry, 8 ));
+}
+
+static AVX2_FUNC void blend_row_8888_avx2( DWORD *dst, const DWORD *src, int len, enum blend_mode mode, DWORD alpha )
+{
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i alpha_vec = _mm256_set1_epi16( alpha );
+    const __m256i src_alpha = _mm256_set1_epi32( mode == BLEND_NO_SRC_ALPHA ? 0xff000000 : 0 );
+
+    /* unpacking and packing both work within 128-bit lanes, so the pixel order is preserved */
+    for ( ; len >= 8; len -= 8, dst += 8, src += 8)
+    {
+        __m256i d = _mm256_loadu_si256( (__m256i *)dst );
+        __m256i s = _mm256_or_si256( _mm256_loadu_si256( (const __m256i *)src ), src_alpha );
+        __m256i lo = blend_channels_avx2( _mm256_unpacklo_epi8( d, zero ), _mm256_unpacklo_epi8( s, zero ), mode, alpha_vec );
+        __m256i hi = blend_channels_avx2( _mm256_unpackhi_epi8( d, zero ), _mm256_unpackhi_epi8( s, zero ), mode, alpha_vec );
+        _mm256_storeu_si256( (__m256i *)dst, pack_argb_avx2( lo, hi ));
+    }
+    blend_row_8888_sse2( dst, src, len, mode, alpha );
+}
+
+static void blend_rects_8888_simd( const dib_info *dst, int num, const RECT *rc, const dib_info *src,
+                                   const POINT *offset, BLENDFUNCTION blend, enum simd_level level )
+{
+    enum blend_mode mode;
+    int i, y;
+
+    if (blend.AlphaFormat & AC_SRC_ALPHA)
+        mode = blend.SourceConstantAlpha == 255 ? BLEND_ARGB : BLEND_ARGB_ALPHA;
+    else if (src->compression == BI_RGB)
+        mode = BLEND_CONSTANT_ALPHA;
+    else
+        mode = BLEND_NO_SRC_ALPHA;
+
+    for (i = 0; i < num; i++, rc++)
+    {
+        DWORD *src_ptr = get_pixel_ptr_32( src, rc->left + offset->x, rc->top + offset->y );
+        DWORD *dst_ptr = get_pixel_ptr_32( dst, rc->left, rc->top );
+
+        for (y = rc->top; y < rc->bottom; y++, dst_ptr += dst->stride / 4, src_ptr += src->stride / 4)
+        {
+            if (level == SIMD_AVX2)
+                blend_row_8888_avx2( dst_ptr, src_ptr, rc->right - rc->left, mode, blend.SourceConstantAlpha );
+            else
+                blend_row_8888_sse2( dst_ptr, src_ptr, rc->right - rc->left, mode, blend.SourceConstantAlpha );
+        }
+    }
+}
+
+#endif  /* HAVE_DIB_SIMD */
+
 static void blend_rects_8888(const dib_info *dst, int num, const RECT *rc,
                              const dib_info *src, const POINT *offset, BLENDFUNCTION blend)
 {
     int i, x, y;
 
+#ifdef HAVE_DIB_SIMD
+    enum simd_level level = get_simd_level();
+
+    if (level != SIMD_NONE)
+    {
+        blend_rects_8888_simd( dst, num, rc, src, offset, blend, level );
+        return;
+    }
+#endif
+
     for (i = 0; i < num; i++, rc++)
     {
         DWORD *src_ptr = get_pixel_ptr_32( src, rc->left + offset->x, rc->top + offset->y );
@@ -6133,6 +6396,40 @@ static inline DWORD aa_rgb( BYTE r_dst, BYTE g_dst, BYTE b_dst, DWORD text, cons
             aa_color( r_dst, text >> 16, range->r_min, range->r_max ) << 16);
 }
 
+static inline void draw_glyph_pixel_8888( DWORD *dst, BYTE glyph, DWORD text_pixel,
+                                          const struct intensity_range *ranges )
+{
+    if (glyph <= 1) return;
+    if (glyph >= 16) *dst = text_pixel;
+    else *dst = aa_rgb( *dst >> 16, *dst >> 8, *dst, text_pixel, ranges + glyph );
+}
+
+#ifdef HAVE_DIB_SIMD
+
+/* most of the glyph pixels are either empty or fully covered, skip or fill those 16 at a time */
+static SSE2_FUNC void draw_glyph_row_8888_sse2( DWORD *dst, const BYTE *glyph, int len, DWORD text_pixel,
+                                                const struct intensity_range *ranges )
+{
+    const __m128i one = _mm_set1_epi8( 1 ), sixteen = _mm_set1_epi8( 16 ), text = _mm_set1_epi32( text_pixel );
+    __m128i val;
+    int x, i;
+
+    for (x = 0; x + 16 <= len; x += 16)
+    {
+        val = _mm_loadu_si128( (const __m128i *)(glyph + x) );
+        if (_mm_movemask_epi8( _mm_cmpeq_epi8( _mm_max_epu8( val, one ), one )) == 0xffff) continue;
+        if (_mm_movemask_epi8( _mm_cmpeq_epi8( _mm_min_epu8( val, sixteen ), sixteen )) == 0xffff)
+        {
+            for (i = 0; i < 16; i += 4) _mm_storeu_si128( (__m128i *)(dst + x + i), text );
+            continue;
+        }
+        for (i = x; i < x + 16; i++) draw_glyph_pixel_8888( dst + i, glyph[i], text_pixel, ranges );
+    }
+    for ( ; x < len; x++) draw_glyph_pixel_8888( dst + x, glyph[x], text_pixel, ranges );
+}
+
+#endif  /* HAVE_DIB_SIMD */
+
 static void draw_glyph_8888( const dib_info *dib, const RECT *rect, const dib_info *glyph,
                              const POINT *origin, DWORD text_pixel, const struct intensity_range *ranges )
 {
@@ -6140,14 +6437,18 @@ static void draw_glyph_8888( const dib_info *dib, const RECT *rect, const dib_in
     const BYTE *glyph_ptr = get_pixel_ptr_8( glyph, origin->x, origin->y );
     int x, y;
 
+#ifdef HAVE_DIB_SIMD
+    if (get_simd_level() != SIMD_NONE)
+    {
+        for (y = rect->top; y < rect->bottom; y++, dst_ptr += dib->stride / 4, glyph_ptr += glyph->stride)
+            draw_glyph_row_8888_sse2( dst_ptr, glyph_ptr, rect->right - rect->left, text_pixel, ranges );
+        return;
+    }
+#endif
     for (y = rect->top; y < rect->bottom; y++)
     {
         for (x = 0; x < rect->right - rect->left; x++)
-        {
-            if (glyph_ptr[x] <= 1) continue;
-            if (glyph_ptr[x] >= 16) { dst_ptr[x] = text_pixel; continue; }
-            dst_ptr[x] = aa_rgb( dst_ptr[x] >> 16, dst_ptr[x] >> 8, dst_ptr[x], text_pixel, ranges + glyph_ptr[x] );
-        }
+            draw_glyph_pixel_8888( dst_ptr + x, glyph_ptr[x], text_pixel, ranges );
         dst_ptr += dib->stride / 4;
         glyph_ptr += glyph->stride;
     }
@@ -6365,6 +6666,40 @@ static inline DWORD blend_subpixel( BYTE r, BYTE g, BYTE b, DWORD text, DWORD al
            blend_color( b, text,       (BYTE) alpha );
 }
 
+static inline void draw_subpixel_pixel_8888( DWORD *dst, DWORD glyph, DWORD text_pixel,
+                                             const struct font_gamma_ramp *gamma_ramp )
+{
+    if (glyph == 0) return;
+    *dst = blend_subpixel( *dst >> 16, *dst >> 8, *dst, text_pixel, glyph, gamma_ramp );
+}
+
+#ifdef HAVE_DIB_SIMD
+
+/* a fully covered subpixel glyph pixel blends to the text color whatever the gamma */
+static SSE2_FUNC void draw_subpixel_glyph_row_8888_sse2( DWORD *dst, const DWORD *glyph, int len, DWORD text_pixel,
+                                                         const struct font_gamma_ramp *gamma_ramp )
+{
+    const __m128i zero = _mm_setzero_si128(), full = _mm_set1_epi32( 0x00ffffff );
+    const __m128i text = _mm_set1_epi32( text_pixel & 0x00ffffff );
+    __m128i val;
+    int x, i;
+
+    for (x = 0; x + 4 <= len; x += 4)
+    {
+        val = _mm_loadu_si128( (const __m128i *)(glyph + x) );
+        if (_mm_movemask_epi8( _mm_cmpeq_epi32( val, zero )) == 0xffff) continue;
+        if (_mm_movemask_epi8( _mm_cmpeq_epi32( val, full )) == 0xffff)
+        {
+            _mm_storeu_si128( (__m128i *)(dst + x), text );
+            continue;
+        }
+        for (i = x; i < x + 4; i++) draw_subpixel_pixel_8888( dst + i, glyph[i], text_pixel, gamma_ramp );
+    }
+    for ( ; x < len; x++) draw_subpixel_pixel_8888( dst + x, glyph[x], text_pixel, gamma_ramp );
+}
+
+#endif  /* HAVE_DIB_SIMD */
+
 static void draw_subpixel_glyph_8888( const dib_info *dib, const RECT *rect, const dib_info *glyph,
                                       const POINT *origin, DWORD text_pixel,
                                       const struct font_gamma_ramp *gamma_ramp )
@@ -6373,14 +6708,18 @@ static void draw_subpixel_glyph_8888( const dib_info *dib, const RECT *rect, con
     const DWORD *glyph_ptr = get_pixel_ptr_32( glyph, origin->x, origin->y );
     int x, y;
 
+#ifdef HAVE_DIB_SIMD
+    if (get_simd_level() != SIMD_NONE)
+    {
+        for (y = rect->top; y < rect->bottom; y++, dst_ptr += dib->stride / 4, glyph_ptr += glyph->stride / 4)
+            draw_subpixel_glyph_row_8888_sse2( dst_ptr, glyph_ptr, rect->right - rect->left, text_pixel, gamma_ramp );
+        return;
+    }
+#endif
     for (y = rect->top; y < rect->bottom; y++)
     {
         for (x = 0; x < rect->right - rect->left; x++)
-        {
-            if (glyph_ptr[x] == 0) continue;
-            dst_ptr[x] = blend_subpixel( dst_ptr[x] >> 16, dst_ptr[x] >> 8, dst_ptr[x],
-                                         text_pixel, glyph_ptr[x], gamma_ramp );
-        }
+            draw_subpixel_pixel_8888( dst_ptr + x, glyph_ptr[x], text_pixel, gamma_ramp );
         dst_ptr += dib->stride / 4;
         glyph_ptr += glyph->stride / 4;
     }
@@ -7481,6 +7820,145 @@ static void calc_halftone_params( const struct bitblt_coords *dst, const struct
     *src_inc_y = mirrored_y ? -(float)src_height / dst_height : (float)src_height / dst_height;
 }
 
+/* box filter used by halftone_888 to shrink by a factor 2 or more, where bilinear
+ * interpolation would skip most of the source pixels */
+struct halftone_box
+{
+    const dib_info *dst_dib;
+    const dib_info *src_dib;
+    RECT            dst_rect;
+    RECT            src_rect;
+    BOOL            mirrored_x;
+    BOOL            mirrored_y;
+    const int      *bounds;  /* source columns of each destination column, width + 1 entries */
+    UINT           *sums;    /* channel sums of the destination row, 4 * width entries per band */
+};
+
+static inline int get_box_bound( int start, int src_len, int dst_len, int pos )
+{
+    return start + (LONGLONG)pos * src_len / dst_len;
+}
+
+static void sum_box_row_8888( UINT *sums, const DWORD *src, const int *bounds, int width )
+{
+    int i, x;
+
+    for (i = 0; i < width; i++, sums += 4)
+    {
+        for (x = bounds[i]; x < bounds[i + 1]; x++)
+        {
+            sums[0] += src[x] & 0xff;
+            sums[1] += (src[x] >> 8) & 0xff;
+            sums[2] += (src[x] >> 16) & 0xff;
+        }
+    }
+}
+
+#ifdef HAVE_DIB_SIMD
+
+static SSE2_FUNC void sum_box_row_8888_sse2( UINT *sums, const DWORD *src, const int *bounds, int width )
+{
+    const __m128i zero = _mm_setzero_si128();
+    __m128i sum, val, lo;
+    int i, x, end;
+
+    for (i = 0; i < width; i++, sums += 4)
+    {
+        sum = _mm_loadu_si128( (__m128i *)sums );
+        for (x = bounds[i], end = bounds[i + 1]; x + 4 <= end; x += 4)
+        {
+            /* add pixels 0 and 2, 1 and 3 as words, then the two halves as dwords */
+            val = _mm_loadu_si128( (const __m128i *)(src + x) );
+            lo = _mm_add_epi16( _mm_unpacklo_epi8( val, zero ), _mm_unpackhi_epi8( val, zero ));
+            sum = _mm_add_epi32( sum, _mm_unpacklo_epi16( lo, zero ));
+            sum = _mm_add_epi32( sum, _mm_unpackhi_epi16( lo, zero ));
+        }
+        for ( ; x < end; x++)
+        {
+            val = _mm_unpacklo_epi8( _mm_cvtsi32_si128( src[x] ), zero );
+            sum = _mm_add_epi32( sum, _mm_unpacklo_epi16( val, zero ));
+        }
+        _mm_storeu_si128( (__m128i *)sums, sum );
+    }
+}
+
+#endif  /* HAVE_DIB_SIMD */
+
+static void halftone_box_band_8888( void *ctx, int band, int bands )
+{
+    const struct halftone_box *box = ctx;
+    int width = box->dst_rect.right - box->dst_rect.left;
+    int height = box->dst_rect.bottom - box->dst_rect.top;
+    int src_height = box->src_rect.bottom - box->src_rect.top;
+    int row, col, pos, y, y0, y1;
+    UINT *sums = box->sums + 4 * width * band, *sum, count;
+    DWORD *dst_ptr;
+
+    for (row = height * band / bands; row < height * (band + 1) / bands; row++)
+    {
+        pos = box->mirrored_y ? height - 1 - row : row;
+        y0 = get_box_bound( box->src_rect.top, src_height, height, pos );
+        y1 = get_box_bound( box->src_rect.top, src_height, height, pos + 1 );
+
+        memset( sums, 0, 4 * width * sizeof(*sums) );
+        for (y = y0; y < y1; y++)
+        {
+#ifdef HAVE_DIB_SIMD
+            if (get_simd_level() != SIMD_NONE)
+                sum_box_row_8888_sse2( sums, get_pixel_ptr_32( box->src_dib, 0, y ), box->bounds, width );
+            else
+#endif
+            sum_box_row_8888( sums, get_pixel_ptr_32( box->src_dib, 0, y ), box->bounds, width );
+        }
+
+        dst_ptr = get_pixel_ptr_32( box->dst_dib, box->dst_rect.left, box->dst_rect.top + row );
+        for (col = 0; col < width; col++)
+        {
+            pos = box->mirrored_x ? width - 1 - col : col;
+            sum = sums + 4 * pos;
+            count = (box->bounds[pos + 1] - box->bounds[pos]) * (y1 - y0);
+            dst_ptr[col] = ((sum[2] + count / 2) / count) << 16 |
+                           ((sum[1] + count / 2) / count) << 8 |
+                           ((sum[0] + count / 2) / count);
+        }
+    }
+}
+
+static BOOL halftone_box_8888( const dib_info *dst_dib, const struct bitblt_coords *dst,
+                               const dib_info *src_dib, const struct bitblt_coords *src )
+{
+    struct halftone_box box;
+    int width, height, src_width, src_height, bands, i;
+    int *bounds;
+
+    get_bounding_rect( &box.src_rect, src->x, src->y, src->width, src->height );
+    get_bounding_rect( &box.dst_rect, dst->x, dst->y, dst->width, dst->height );
+    intersect_rect( &box.src_rect, &src->visrect, &box.src_rect );
+    intersect_rect( &box.dst_rect, &dst->visrect, &box.dst_rect );
+    OffsetRect( &box.dst_rect, -box.dst_rect.left, -box.dst_rect.top );
+
+    width = box.dst_rect.right - box.dst_rect.left;
+    height = box.dst_rect.bottom - box.dst_rect.top;
+    src_width = box.src_rect.right - box.src_rect.left;
+    src_height = box.src_rect.bottom - box.src_rect.top;
+    if (width <= 0 || height <= 0 || src_width < 2 * width || src_height < 2 * height) return FALSE;
+
+    bands = get_blit_bands( height, (ULONGLONG)src_width * src_height );
+    if (!(bounds = malloc( (width + 1) * sizeof(*bounds) + 4 * width * bands * sizeof(*box.sums) )))
+        return FALSE;
+    for (i = 0; i <= width; i++) bounds[i] = get_box_bound( box.src_rect.left, src_width, width, i );
+
+    box.dst_dib = dst_dib;
+    box.src_dib = src_dib;
+    box.mirrored_x = (dst->width < 0) != (src->width < 0);
+    box.mirrored_y = (dst->height < 0) != (src->height < 0);
+    box.bounds = bounds;
+    box.sums = (UINT *)(bounds + width + 1);
+    run_blit_bands( halftone_box_band_8888, &box, bands );
+    free( bounds );
+    return TRUE;
+}
+
 static void halftone_888( const dib_info *dst_dib, const struct bitblt_coords *dst,
                           const dib_info *src_dib, const struct bitblt_coords *src )
 {
@@ -7493,6 +7971,8 @@ static void halftone_888( const dib_info *dst_dib, const struct bitblt_coords *d
     RECT dst_rect, src_rect;
     BYTE r, g, b;
 
+    if (halftone_box_8888( dst_dib, dst, src_dib, src )) return;
+
     calc_halftone_params( dst, src, &dst_rect, &src_rect, &src_start_x, &src_start_y, &src_inc_x,
                           &src_inc_y );
 
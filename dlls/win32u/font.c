@@ -26,10 +26,15 @@
 
 #include <limits.h>
 #include <stdarg.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <assert.h>
 #include <pthread.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #include "ntstatus.h"
 #define WIN32_NO_STATUS
@@ -198,6 +203,10 @@ static struct font_gamma_ramp font_gamma_ramp;
 
 static void add_face_to_cache( struct gdi_font_face *face );
 static void remove_face_from_cache( struct gdi_font_face *face );
+static void add_face_to_index( const WCHAR *family_name, const WCHAR *second_name, const WCHAR *style,
+                               const WCHAR *fullname, const WCHAR *file, UINT index, FONTSIGNATURE fs,
+                               DWORD ntmflags, DWORD version, DWORD flags,
+                               const struct bitmap_font_size *size );
 
 static CPTABLEINFO utf8_cp;
 static CPTABLEINFO oem_cp;
@@ -1197,6 +1206,9 @@ int add_gdi_face( const WCHAR *family_name, const WCHAR *second_name,
     struct gdi_font_family *family;
     int ret = 0;
 
+    if (!data_ptr) add_face_to_index( family_name, second_name, style, fullname, file, index, fs,
+                                      ntmflags, version, flags, size );
+
     if ((family = find_family_from_name( family_name ))) family->refcount++;
     else if (!(family = create_family( family_name, second_name ))) return ret;
 
@@ -1411,6 +1423,404 @@ static void remove_face_from_cache( struct gdi_font_face *face )
     NtClose( hkey_family );
 }
 
+/* font list index
+ *
+ * The faces found by scanning the font directories and the fontconfig
+ * configuration are saved in a file, along with the modification time, size
+ * and inode of the directories and font files that were scanned, and a hash
+ * of the backend configuration files. The next processes replay the
+ * add_gdi_face() calls from that file instead of parsing all the font files
+ * again, as long as none of these changed.
+ */
+
+#define FONT_INDEX_MAGIC    0x58494657  /* "WFIX" */
+#define FONT_INDEX_VERSION  2
+
+struct font_index_header
+{
+    UINT   magic;
+    UINT   version;
+    UINT   size;        /* size of the file */
+    UINT   config_len;  /* length of the configuration string, in WCHARs */
+    UINT   path_count;
+    UINT   face_count;
+    UINT64 config_hash; /* hash of the backend configuration */
+    /* WCHAR config[config_len]; */
+    /* struct font_index_path paths[path_count]; */
+    /* struct font_index_face faces[face_count]; */
+};
+
+struct font_index_stamp
+{
+    UINT64 mtime;       /* modification time in ns, 0 if the path doesn't exist */
+    UINT64 size;
+    UINT64 ino;
+};
+
+struct font_index_path
+{
+    struct font_index_stamp stamp;
+    UINT   len;         /* size of the record */
+    char   name[1];
+};
+
+#define FONT_INDEX_NO_SECOND_NAME  0x01
+#define FONT_INDEX_NO_FULL_NAME    0x02
+#define FONT_INDEX_NO_FILE         0x04
+#define FONT_INDEX_BITMAP          0x08
+
+struct font_index_face
+{
+    UINT                    len;    /* size of the record */
+    UINT                    mask;   /* FONT_INDEX_* flags */
+    UINT                    index;
+    UINT                    flags;
+    UINT                    ntmflags;
+    UINT                    version;
+    struct bitmap_font_size size;
+    FONTSIGNATURE           fs;
+    WCHAR                   names[1];  /* family, second, style, full and file names */
+};
+
+struct font_index_buffer
+{
+    BYTE *data;
+    UINT  size;
+    UINT  used;
+    UINT  count;
+};
+
+static BOOL font_index_recording;
+static BOOL font_index_failed;
+static struct font_index_buffer font_index_paths, font_index_faces;
+static UINT font_index_last_path;
+static const WCHAR font_index_file[] =
+    {'\\','?','?','\\','C',':','\\','w','i','n','d','o','w','s','\\','t','e','m','p','\\',
+     'w','i','n','e','_','f','o','n','t','l','i','s','t','.','d','a','t',0};
+
+static void *alloc_font_index_record( struct font_index_buffer *buffer, UINT len )
+{
+    void *ret;
+
+    len = (len + 7) & ~7;
+    if (buffer->used + len > buffer->size)
+    {
+        UINT size = max( buffer->size * 2, buffer->used + len + 4096 );
+        BYTE *data;
+
+        if (!(data = realloc( buffer->data, size )))
+        {
+            font_index_failed = TRUE;
+            return NULL;
+        }
+        buffer->data = data;
+        buffer->size = size;
+    }
+    ret = buffer->data + buffer->used;
+    memset( ret, 0, len );
+    buffer->used += len;
+    buffer->count++;
+    return ret;
+}
+
+static void get_path_stamp( const char *name, struct font_index_stamp *stamp )
+{
+    struct stat st;
+
+    memset( stamp, 0, sizeof(*stamp) );
+    if (stat( name, &st ) == -1) return;
+    stamp->mtime = (UINT64)st.st_mtime * 1000000000 + st.st_mtim.tv_nsec + 1;
+    stamp->size  = st.st_size;
+    stamp->ino   = st.st_ino;
+}
+
+static char *get_font_unix_name( const WCHAR *path )
+{
+    UNICODE_STRING nt_name;
+    OBJECT_ATTRIBUTES attr;
+    NTSTATUS status;
+    ULONG size = 256;
+    char *buffer;
+
+    nt_name.Buffer = (WCHAR *)path;
+    nt_name.MaximumLength = nt_name.Length = lstrlenW( path ) * sizeof(WCHAR);
+    InitializeObjectAttributes( &attr, &nt_name, OBJ_CASE_INSENSITIVE, 0, NULL );
+    for (;;)
+    {
+        if (!(buffer = malloc( size ))) return NULL;
+        status = wine_nt_to_unix_file_name( &attr, buffer, &size, FILE_OPEN_IF );
+        if (status != STATUS_BUFFER_TOO_SMALL) break;
+        free( buffer );
+    }
+    if (status && status != STATUS_NO_SUCH_FILE)
+    {
+        free( buffer );
+        return NULL;
+    }
+    return buffer;
+}
+
+/* record a scanned directory or font file, the index is invalidated when it changes */
+void add_font_index_path( const char *unix_name )
+{
+    struct font_index_path *path;
+    UINT len = strlen( unix_name ) + 1;
+
+    if (!font_index_recording) return;
+    /* the faces of a collection are added one after another */
+    if (font_index_last_path < font_index_paths.used &&
+        !strcmp( ((struct font_index_path *)(font_index_paths.data + font_index_last_path))->name, unix_name ))
+        return;
+    font_index_last_path = font_index_paths.used;
+    if (!(path = alloc_font_index_record( &font_index_paths, FIELD_OFFSET( struct font_index_path, name[len] ))))
+        return;
+    get_path_stamp( unix_name, &path->stamp );
+    path->len = (FIELD_OFFSET( struct font_index_path, name[len] ) + 7) & ~7;
+    memcpy( path->name, unix_name, len );
+}
+
+static void add_nt_font_index_dir( const WCHAR *path )
+{
+    char *unix_name;
+
+    if (!font_index_recording) return;
+    if (!(unix_name = get_font_unix_name( path )))
+    {
+        font_index_failed = TRUE;
+        return;
+    }
+    add_font_index_path( unix_name );
+    free( unix_name );
+}
+
+static WCHAR *put_index_string( WCHAR *ptr, const WCHAR *str )
+{
+    UINT len = str ? lstrlenW( str ) + 1 : 1;
+
+    if (str) memcpy( ptr, str, len * sizeof(WCHAR) );
+    else *ptr = 0;
+    return ptr + len;
+}
+
+static void add_face_to_index( const WCHAR *family_name, const WCHAR *second_name, const WCHAR *style,
+                               const WCHAR *fullname, const WCHAR *file, UINT index, FONTSIGNATURE fs,
+                               DWORD ntmflags, DWORD version, DWORD flags,
+                               const struct bitmap_font_size *size )
+{
+    struct font_index_face *face;
+    UINT len = lstrlenW( family_name ) + lstrlenW( style ) + 5;
+    WCHAR *ptr;
+
+    if (!font_index_recording) return;
+    if (second_name) len += lstrlenW( second_name );
+    if (fullname) len += lstrlenW( fullname );
+    if (file) len += lstrlenW( file );
+    if (!(face = alloc_font_index_record( &font_index_faces, FIELD_OFFSET( struct font_index_face, names[len] ))))
+        return;
+
+    face->len      = (FIELD_OFFSET( struct font_index_face, names[len] ) + 7) & ~7;
+    face->index    = index;
+    face->flags    = flags;
+    face->ntmflags = ntmflags;
+    face->version  = version;
+    face->fs       = fs;
+    if (!second_name) face->mask |= FONT_INDEX_NO_SECOND_NAME;
+    if (!fullname) face->mask |= FONT_INDEX_NO_FULL_NAME;
+    if (!file) face->mask |= FONT_INDEX_NO_FILE;
+    if (size)
+    {
+        face->mask |= FONT_INDEX_BITMAP;
+        face->size = *size;
+    }
+    ptr = put_index_string( face->names, family_name );
+    ptr = put_index_string( ptr, second_name );
+    ptr = put_index_string( ptr, style );
+    ptr = put_index_string( ptr, fullname );
+    put_index_string( ptr, file );
+}
+
+/* the settings that change the set of directories that are scanned */
+static UINT get_font_index_config( WCHAR *config, UINT size )
+{
+    char value_buffer[FIELD_OFFSET(KEY_VALUE_PARTIAL_INFORMATION, Data[1024 * sizeof(WCHAR)])];
+    KEY_VALUE_PARTIAL_INFORMATION *info = (void *)value_buffer;
+    UINT len;
+
+    get_fonts_data_dir_path( NULL, config );
+    len = lstrlenW( config ) + 1;
+    if (query_reg_ascii_value( wine_fonts_key, "Path", info, sizeof(value_buffer) ) &&
+        info->Type == REG_SZ && len + info->DataLength / sizeof(WCHAR) < size)
+    {
+        memcpy( config + len, info->Data, info->DataLength );
+        len += info->DataLength / sizeof(WCHAR);
+    }
+    return len;
+}
+
+static void start_font_index(void)
+{
+    font_index_recording = TRUE;
+    font_index_failed = FALSE;
+    font_index_last_path = ~0u;
+}
+
+static void save_font_index(void)
+{
+    struct font_index_header header;
+    WCHAR config[MAX_PATH + 1024];
+    char *name, *tmp = NULL;
+    int fd = -1;
+
+    font_index_recording = FALSE;
+    if (font_index_failed) goto done;
+
+    header.magic      = FONT_INDEX_MAGIC;
+    header.version    = FONT_INDEX_VERSION;
+    header.config_len  = get_font_index_config( config, ARRAY_SIZE(config) );
+    header.path_count  = font_index_paths.count;
+    header.face_count  = font_index_faces.count;
+    header.config_hash = font_funcs->get_config_hash();
+    header.size        = (sizeof(header) + header.config_len * sizeof(WCHAR) + 7) & ~7;
+    header.size       += font_index_paths.used + font_index_faces.used;
+
+    if (!(name = get_font_unix_name( font_index_file ))) goto done;
+    if ((tmp = malloc( strlen( name ) + 16 )))
+    {
+        sprintf( tmp, "%s.%x", name, (int)getpid() );
+        fd = open( tmp, O_WRONLY | O_CREAT | O_TRUNC, 0666 );
+    }
+    if (fd != -1)
+    {
+        static const BYTE zero[8];
+        UINT pad = ((sizeof(header) + header.config_len * sizeof(WCHAR) + 7) & ~7) -
+                   (sizeof(header) + header.config_len * sizeof(WCHAR));
+        BOOL ret;
+
+        ret = write( fd, &header, sizeof(header) ) == sizeof(header) &&
+              write( fd, config, header.config_len * sizeof(WCHAR) ) == header.config_len * sizeof(WCHAR) &&
+              write( fd, zero, pad ) == pad &&
+              write( fd, font_index_paths.data, font_index_paths.used ) == font_index_paths.used &&
+              write( fd, font_index_faces.data, font_index_faces.used ) == font_index_faces.used;
+        close( fd );
+        if (!ret || rename( tmp, name ) == -1) unlink( tmp );
+        else TRACE( "saved %u faces and %u paths to %s\n", header.face_count, header.path_count,
+                    debugstr_a(name) );
+    }
+    free( tmp );
+    free( name );
+
+done:
+    free( font_index_paths.data );
+    free( font_index_faces.data );
+    memset( &font_index_paths, 0, sizeof(font_index_paths) );
+    memset( &font_index_faces, 0, sizeof(font_index_faces) );
+}
+
+static const WCHAR *get_index_string( const WCHAR **ptr, const WCHAR *end, BOOL null )
+{
+    const WCHAR *str = *ptr;
+
+    while (*ptr < end && **ptr) (*ptr)++;
+    if (*ptr == end) return NULL;
+    (*ptr)++;
+    return null ? NULL : str;
+}
+
+/* check that the index is still valid and add its faces; returns FALSE if the directories need a rescan */
+static BOOL load_font_list_from_index(void)
+{
+    const struct font_index_header *header;
+    const struct font_index_path *path;
+    struct font_index_stamp stamp;
+    const struct font_index_face *face;
+    const WCHAR *ptr, *end, *family, *second, *style, *full, *file;
+    WCHAR config[MAX_PATH + 1024];
+    const BYTE *data, *pos;
+    struct stat st;
+    char *name;
+    BOOL ret = FALSE;
+    UINT i, len;
+    int fd;
+
+    if (!(name = get_font_unix_name( font_index_file ))) return FALSE;
+    fd = open( name, O_RDONLY );
+    free( name );
+    if (fd == -1) return FALSE;
+    if (fstat( fd, &st ) == -1 || st.st_size < sizeof(*header) || st.st_size > INT_MAX)
+    {
+        close( fd );
+        return FALSE;
+    }
+    data = mmap( NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0 );
+    close( fd );
+    if (data == MAP_FAILED) return FALSE;
+
+    header = (const struct font_index_header *)data;
+    if (header->magic != FONT_INDEX_MAGIC || header->version != FONT_INDEX_VERSION ||
+        header->size != st.st_size || header->config_len > ARRAY_SIZE(config) ||
+        header->config_len * sizeof(WCHAR) > st.st_size - sizeof(*header))
+        goto done;
+
+    if (header->config_hash != font_funcs->get_config_hash())
+    {
+        TRACE( "font configuration changed\n" );
+        goto done;
+    }
+
+    len = get_font_index_config( config, ARRAY_SIZE(config) );
+    if (len != header->config_len || memcmp( config, header + 1, len * sizeof(WCHAR) )) goto done;
+    pos = data + ((sizeof(*header) + len * sizeof(WCHAR) + 7) & ~7);
+
+    for (i = 0; i < header->path_count; i++, pos += path->len)
+    {
+        path = (const struct font_index_path *)pos;
+        if (pos + FIELD_OFFSET( struct font_index_path, name[1] ) > data + st.st_size ||
+            path->len > data + st.st_size - pos || path->len <= FIELD_OFFSET( struct font_index_path, name ) ||
+            path->name[path->len - FIELD_OFFSET( struct font_index_path, name ) - 1])
+            goto done;
+        get_path_stamp( path->name, &stamp );
+        if (memcmp( &stamp, &path->stamp, sizeof(stamp) ))
+        {
+            TRACE( "%s changed\n", debugstr_a(path->name) );
+            goto done;
+        }
+    }
+
+    /* validate all the faces before adding any */
+    for (i = 0, face = (const struct font_index_face *)pos; i < header->face_count; i++)
+    {
+        if ((const BYTE *)face + FIELD_OFFSET( struct font_index_face, names[5] ) > data + st.st_size ||
+            face->len > data + st.st_size - (const BYTE *)face ||
+            face->len < FIELD_OFFSET( struct font_index_face, names[5] ))
+            goto done;
+        ptr = face->names;
+        end = (const WCHAR *)((const BYTE *)face + face->len);
+        for (len = 0; len < 5; len++) if (!get_index_string( &ptr, end, FALSE )) goto done;
+        face = (const struct font_index_face *)((const BYTE *)face + face->len);
+    }
+
+    for (i = 0, face = (const struct font_index_face *)pos; i < header->face_count; i++)
+    {
+        ptr = face->names;
+        end = (const WCHAR *)((const BYTE *)face + face->len);
+        family = get_index_string( &ptr, end, FALSE );
+        second = get_index_string( &ptr, end, face->mask & FONT_INDEX_NO_SECOND_NAME );
+        style  = get_index_string( &ptr, end, FALSE );
+        full   = get_index_string( &ptr, end, face->mask & FONT_INDEX_NO_FULL_NAME );
+        file   = get_index_string( &ptr, end, face->mask & FONT_INDEX_NO_FILE );
+        add_gdi_face( family, second, style, full, file, NULL, 0, face->index, face->fs,
+                      face->ntmflags, face->version, face->flags,
+                      (face->mask & FONT_INDEX_BITMAP) ? &face->size : NULL );
+        face = (const struct font_index_face *)((const BYTE *)face + face->len);
+    }
+    TRACE( "loaded %u faces from the index\n", header->face_count );
+    ret = TRUE;
+
+done:
+    munmap( (void *)data, st.st_size );
+    return ret;
+}
+
 /* font links */
 
 struct gdi_font_link
@@ -6061,6 +6471,7 @@ static void load_directory_fonts( WCHAR *path, UINT flags )
 
     len = lstrlenW( path );
     while (len && path[len - 1] == '\\') len--;
+    add_nt_font_index_dir( path );
 
     nt_name.Buffer = path;
     nt_name.MaximumLength = nt_name.Length = len * sizeof(WCHAR);
@@ -6309,7 +6720,7 @@ UINT font_init(void)
     OBJECT_ATTRIBUTES attr = { sizeof(attr) };
     UNICODE_STRING name;
     HANDLE mutex;
-    DWORD disposition;
+    DWORD disposition, start;
     UINT dpi = 0;
 
     static WCHAR wine_font_mutexW[] =
@@ -6329,8 +6740,16 @@ UINT font_init(void)
         return dpi;
 
     load_system_bitmap_fonts();
-    load_file_system_fonts();
-    font_funcs->load_fonts();
+    start = NtGetTickCount();
+    if (!load_font_list_from_index())
+    {
+        start_font_index();
+        load_file_system_fonts();
+        font_funcs->load_fonts();
+        save_font_index();
+        TRACE( "scanned font directories in %u ms\n", (int)(NtGetTickCount() - start) );
+    }
+    else TRACE( "loaded font list index in %u ms\n", (int)(NtGetTickCount() - start) );
 
     attr.Attributes = OBJ_OPENIF;
     attr.ObjectName = &name;
@@ -6351,6 +6770,8 @@ UINT font_init(void)
 
     NtReleaseMutant( mutex, NULL );
 
+    /* the volatile cache only holds the fonts added with AddFontResource during the session,
+     * the scanned fonts come from the index */
     if (disposition != REG_CREATED_NEW_KEY)
     {
         load_registry_fonts();
@@ -203,6 +203,7 @@ MAKE_FUNCPTR(FcPatternDestroy);
 MAKE_FUNCPTR(FcPatternGetBool);
 MAKE_FUNCPTR(FcPatternGetInteger);
 MAKE_FUNCPTR(FcPatternGetString);
+MAKE_FUNCPTR(FcConfigGetConfigFiles);
 MAKE_FUNCPTR(FcConfigGetFontDirs);
 MAKE_FUNCPTR(FcConfigGetCurrent);
 MAKE_FUNCPTR(FcCacheCopySet);
@@ -270,6 +271,7 @@ struct font_private_data
 {
     FT_Face ft_face;
     struct font_mapping *mapping;
+    UINT64 cache_key;  /* key of the font glyphs in the persistent cache, 0 if not computed yet */
 };
 
 static inline FT_Face get_ft_face( struct gdi_font *font )
@@ -1300,6 +1302,7 @@ static int add_unix_face( const char *unix_name, const WCHAR *file, void *data_p
 
     if (num_faces) *num_faces = 0;
 
+    if (unix_name) add_font_index_path( unix_name );
     if (!(unix_face = unix_face_create( unix_name, data_ptr, data_size, face_index, flags )))
         return 0;
 
@@ -1439,6 +1442,7 @@ static BOOL ReadFontDir(const char *dirname, BOOL external_fonts)
 
     TRACE("Loading fonts from %s\n", debugstr_a(dirname));
 
+    add_font_index_path( dirname );
     dir = opendir(dirname);
     if(!dir) {
         WARN("Can't open directory %s\n", debugstr_a(dirname));
@@ -1590,6 +1594,7 @@ static void init_fontconfig(void)
     LOAD_FUNCPTR(FcPatternGetBool);
     LOAD_FUNCPTR(FcPatternGetInteger);
     LOAD_FUNCPTR(FcPatternGetString);
+    LOAD_FUNCPTR(FcConfigGetConfigFiles);
     LOAD_FUNCPTR(FcConfigGetFontDirs);
     LOAD_FUNCPTR(FcConfigGetCurrent);
     LOAD_FUNCPTR(FcCacheCopySet);
@@ -1642,6 +1647,7 @@ static void fontconfig_add_fonts_from_dir_list( FcConfig *config, FcStrList *dir
         if (pFcStrSetMember( done_set, dir )) continue;
 
         TRACE( "adding fonts from %s\n", dir );
+        add_font_index_path( (const char *)dir );
         if (!(cache = pFcDirCacheRead( dir, FcFalse, config ))) continue;
 
         if (!(font_set = pFcCacheCopySet( cache ))) goto done;
@@ -1707,6 +1713,18 @@ static void load_mac_font_callback(const void *value, void *context)
     free( path );
 }
 
+static void add_mac_font_dir_callback( const void *value, void *context )
+{
+    CFStringRef dir_str = value;
+    CFIndex len;
+    char *dir;
+
+    len = CFStringGetMaximumSizeOfFileSystemRepresentation( dir_str );
+    dir = malloc( len );
+    if (dir && CFStringGetFileSystemRepresentation( dir_str, dir, len )) add_font_index_path( dir );
+    free( dir );
+}
+
 static void load_mac_fonts(void)
 {
     CFStringRef removeDupesKey;
@@ -1714,7 +1732,7 @@ static void load_mac_fonts(void)
     CFDictionaryRef options;
     CTFontCollectionRef col;
     CFArrayRef descs;
-    CFMutableSetRef paths;
+    CFMutableSetRef paths, dirs;
     CFIndex i;
 
     removeDupesKey = kCTFontCollectionRemoveDuplicatesOption;
@@ -1738,9 +1756,12 @@ static void load_mac_fonts(void)
     }
 
     paths = CFSetCreateMutable(NULL, 0, &kCFTypeSetCallBacks);
-    if (!paths)
+    dirs = CFSetCreateMutable(NULL, 0, &kCFTypeSetCallBacks);
+    if (!paths || !dirs)
     {
         WARN("CFSetCreateMutable failed\n");
+        if (paths) CFRelease(paths);
+        if (dirs) CFRelease(dirs);
         CFRelease(descs);
         return;
     }
@@ -1748,7 +1769,7 @@ static void load_mac_fonts(void)
     for (i = 0; i < CFArrayGetCount(descs); i++)
     {
         CTFontDescriptorRef desc;
-        CFURLRef url;
+        CFURLRef url, dir_url;
         CFStringRef ext;
         CFStringRef path;
 
@@ -1769,6 +1790,19 @@ static void load_mac_fonts(void)
             }
         }
 
+        /* the font list index is invalidated when fonts are added to or removed from these directories */
+        dir_url = CFURLCreateCopyDeletingLastPathComponent(NULL, url);
+        if (dir_url)
+        {
+            path = CFURLCopyFileSystemPath(dir_url, kCFURLPOSIXPathStyle);
+            CFRelease(dir_url);
+            if (path)
+            {
+                CFSetAddValue(dirs, path);
+                CFRelease(path);
+            }
+        }
+
         path = CFURLCopyFileSystemPath(url, kCFURLPOSIXPathStyle);
         CFRelease(url);
         if (!path) continue;
@@ -1779,6 +1813,8 @@ static void load_mac_fonts(void)
 
     CFRelease(descs);
 
+    CFSetApplyFunction(dirs, add_mac_font_dir_callback, NULL);
+    CFRelease(dirs);
     CFSetApplyFunction(paths, load_mac_font_callback, NULL);
     CFRelease(paths);
 }
@@ -1890,6 +1926,61 @@ static void freetype_load_fonts(void)
 #endif
 }
 
+#ifdef SONAME_LIBFONTCONFIG
+static UINT64 hash_config_path( UINT64 hash, const char *name )
+{
+    UINT64 data[3] = {0};
+    const BYTE *ptr;
+    struct stat st;
+    size_t i;
+
+    if (!stat( name, &st ))
+    {
+        data[0] = (UINT64)st.st_mtime * 1000000000 + st.st_mtim.tv_nsec + 1;
+        data[1] = st.st_size;
+        data[2] = st.st_ino;
+    }
+    /* FNV-1a */
+    for (ptr = (const BYTE *)name; *ptr; ptr++) hash = (hash ^ *ptr) * 0x100000001b3ull;
+    for (i = 0, ptr = (const BYTE *)data; i < sizeof(data); i++) hash = (hash ^ ptr[i]) * 0x100000001b3ull;
+    return hash;
+}
+#endif
+
+/*************************************************************
+ * freetype_get_config_hash
+ *
+ * Hash of the configuration files that select the fonts, used to invalidate the font list index.
+ */
+static UINT64 freetype_get_config_hash(void)
+{
+    UINT64 hash = 0xcbf29ce484222325ull;
+#ifdef SONAME_LIBFONTCONFIG
+    const FcChar8 *file;
+    FcStrList *list;
+    FcConfig *config;
+    char *dir, *p;
+
+    if (!fontconfig_enabled) return hash;
+    if (!(config = pFcConfigGetCurrent())) return hash;
+    if (!(list = pFcConfigGetConfigFiles( config ))) return hash;
+    while ((file = pFcStrListNext( list )))
+    {
+        hash = hash_config_path( hash, (const char *)file );
+        /* catch files added to the conf.d directories */
+        if (!(dir = strdup( (const char *)file ))) continue;
+        if ((p = strrchr( dir, '/' )) && p != dir)
+        {
+            *p = 0;
+            hash = hash_config_path( hash, dir );
+        }
+        free( dir );
+    }
+    pFcStrListDone( list );
+#endif
+    return hash;
+}
+
 /* Some fonts have large usWinDescent values, as a result of storing signed short
    in unsigned field. That's probably caused by sTypoDescent vs usWinDescent confusion in
    some font generation tools. */
@@ -3432,11 +3523,383 @@ static FT_Int get_load_flags( UINT format )
 }
 
 /*************************************************************
- * freetype_get_glyph_outline
+ * Persistent glyph cache
+ *
+ * Glyph metrics and bitmaps are kept in a file that is mapped by all the
+ * processes of the prefix. Records are only ever appended: space is reserved
+ * with an atomic add on the header, and a record is published by linking it
+ * into its hash chain with a compare-and-swap, so lookups don't need any lock.
+ * Chains always go towards the start of the file, so that a corrupted file
+ * can't make a lookup loop. Each process only maps the part of the file that
+ * is in use, and grows the mapping as needed.
+ * The file is replaced by a new one when its version doesn't match or once it
+ * is mostly full; processes that still map the old one keep using it.
  */
-static DWORD freetype_get_glyph_outline( struct gdi_font *font, UINT glyph, UINT format,
-                                         GLYPHMETRICS *lpgm, ABC *abc, DWORD buflen, void *buf,
-                                         const MAT2 *lpmat, BOOL tategaki )
+
+#define GLYPH_CACHE_MAGIC    0x43474e57  /* "WNGC" */
+#define GLYPH_CACHE_VERSION  1
+#define GLYPH_CACHE_SIZE     (64 * 1024 * 1024)
+#define GLYPH_CACHE_BUCKETS  65536
+#define GLYPH_CACHE_CHUNK    (1024 * 1024)
+
+struct glyph_cache_header
+{
+    UINT magic;
+    UINT version;
+    UINT ft_version;                    /* FreeType version used for the rendering */
+    UINT size;                          /* size of the file */
+    UINT used;                          /* bytes allocated in the file, updated atomically */
+    UINT buckets[GLYPH_CACHE_BUCKETS];  /* offsets of the first record of each hash chain */
+};
+
+struct glyph_cache_record
+{
+    UINT64       font_key;  /* see get_glyph_cache_key */
+    UINT         next;      /* offset of the next record in the chain */
+    UINT         glyph;
+    UINT         format;
+    UINT         tategaki;
+    GLYPHMETRICS gm;
+    ABC          abc;
+    UINT         size;      /* size of the glyph bitmap */
+    BYTE         data[1];
+};
+
+static struct glyph_cache_header *glyph_cache;
+static UINT glyph_cache_size;    /* size of the file, the header can't be trusted */
+static UINT glyph_cache_mapped;  /* size of our mapping */
+static int glyph_cache_fd = -1;
+static BOOL glyph_cache_init_done;
+static const WCHAR glyph_cache_file[] =
+    {'\\','?','?','\\','C',':','\\','w','i','n','d','o','w','s','\\','t','e','m','p','\\',
+     'w','i','n','e','_','g','l','y','p','h','c','a','c','h','e','.','d','a','t',0};
+
+static inline UINT64 hash_bytes( UINT64 hash, const void *ptr, SIZE_T size )
+{
+    const BYTE *p = ptr;
+
+    /* 64-bit FNV-1a */
+    while (size--) hash = (hash ^ *p++) * 0x100000001b3ull;
+    return hash;
+}
+
+static BOOL is_glyph_cache_valid( const struct glyph_cache_header *header, SIZE_T size )
+{
+    return size >= sizeof(*header) &&
+           header->magic == GLYPH_CACHE_MAGIC &&
+           header->version == GLYPH_CACHE_VERSION &&
+           header->ft_version == FT_SimpleVersion &&
+           header->size == size &&
+           header->used <= size / 8 * 7;
+}
+
+/* make sure that at least the first size bytes of the file are mapped */
+static BOOL map_glyph_cache( UINT size )
+{
+    void *ptr;
+
+    if (size <= glyph_cache_mapped) return TRUE;
+    if (size > glyph_cache_size) return FALSE;
+    size = min( (size + GLYPH_CACHE_CHUNK - 1) & ~(GLYPH_CACHE_CHUNK - 1), glyph_cache_size );
+    ptr = mmap( NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, glyph_cache_fd, 0 );
+    if (ptr == MAP_FAILED) return FALSE;
+    /* callers hold the font lock, no pointer into the old mapping is in use */
+    if (glyph_cache) munmap( glyph_cache, glyph_cache_mapped );
+    glyph_cache = ptr;
+    glyph_cache_mapped = size;
+    return TRUE;
+}
+
+/* create a new cache file and move it over the old one */
+static int create_glyph_cache( const char *name )
+{
+    struct glyph_cache_header *header;
+    char *tmp;
+    int fd;
+
+    if (!(tmp = malloc( strlen( name ) + 16 ))) return -1;
+    sprintf( tmp, "%s.%x", name, (int)getpid() );
+    if ((fd = open( tmp, O_RDWR | O_CREAT | O_TRUNC, 0666 )) == -1) goto failed;
+    if (ftruncate( fd, GLYPH_CACHE_SIZE ) == -1) goto failed;
+    header = mmap( NULL, sizeof(*header), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0 );
+    if (header == MAP_FAILED) goto failed;
+
+    header->magic      = GLYPH_CACHE_MAGIC;
+    header->version    = GLYPH_CACHE_VERSION;
+    header->ft_version = FT_SimpleVersion;
+    header->size       = GLYPH_CACHE_SIZE;
+    header->used       = sizeof(*header);
+    munmap( header, sizeof(*header) );
+    if (rename( tmp, name ) == -1) goto failed;
+    free( tmp );
+    TRACE( "created new glyph cache %s\n", debugstr_a(name) );
+    return fd;
+
+failed:
+    if (fd != -1)
+    {
+        close( fd );
+        unlink( tmp );
+    }
+    free( tmp );
+    return -1;
+}
+
+static void open_glyph_cache(void)
+{
+    struct glyph_cache_header *header;
+    struct stat st, path_st;
+    struct flock fl;
+    UINT used = 0;
+    char *name;
+    int fd, new_fd;
+
+    if (!(name = get_unix_file_name( glyph_cache_file ))) return;
+
+    fl.l_type   = F_WRLCK;
+    fl.l_whence = SEEK_SET;
+    fl.l_start  = 0;
+    fl.l_len    = 0;
+
+    for (;;)
+    {
+        if ((fd = open( name, O_RDWR | O_CREAT, 0666 )) == -1) break;
+        if (fcntl( fd, F_SETLKW, &fl ) == -1 || fstat( fd, &st ) == -1)
+        {
+            close( fd );
+            fd = -1;
+            break;
+        }
+        /* retry if the file was replaced while we were waiting for the lock */
+        if (!stat( name, &path_st ) && path_st.st_dev == st.st_dev && path_st.st_ino == st.st_ino) break;
+        close( fd );
+    }
+    if (fd == -1) goto done;
+
+    if (st.st_size >= sizeof(*header) && st.st_size <= GLYPH_CACHE_SIZE)
+    {
+        header = mmap( NULL, sizeof(*header), PROT_READ, MAP_SHARED, fd, 0 );
+        if (header != MAP_FAILED)
+        {
+            if (is_glyph_cache_valid( header, st.st_size ))
+            {
+                glyph_cache_size = st.st_size;
+                used = header->used;
+            }
+            munmap( header, sizeof(*header) );
+        }
+    }
+    if (glyph_cache_size)
+    {
+        fl.l_type = F_UNLCK;
+        fcntl( fd, F_SETLK, &fl );
+        glyph_cache_fd = fd;
+    }
+    else
+    {
+        /* keep the old file locked until the new one is in place */
+        if ((new_fd = create_glyph_cache( name )) != -1)
+        {
+            glyph_cache_size = GLYPH_CACHE_SIZE;
+            used = sizeof(*header);
+            glyph_cache_fd = new_fd;
+        }
+        close( fd );  /* this releases the lock */
+    }
+
+    if (glyph_cache_fd != -1 && !map_glyph_cache( max( used, sizeof(*header) )))
+    {
+        close( glyph_cache_fd );
+        glyph_cache_fd = -1;
+    }
+
+done:
+    if (!glyph_cache) WARN( "glyph cache %s not available\n", debugstr_a(name) );
+    free( name );
+}
+
+/* compute the key of a font, it depends on everything that affects the glyph metrics and bitmaps */
+static UINT64 get_glyph_cache_key( struct gdi_font *font )
+{
+    struct font_private_data *data = font->private;
+    FT_Face ft_face = data->ft_face;
+    const BYTE *ptr = ft_face->stream->base;
+    SIZE_T size = ft_face->stream->size;
+    UINT64 hash = 0xcbf29ce484222325ull;
+    INT params[10];
+
+    if (data->cache_key) return data->cache_key;
+    if (!ptr) return 0;
+
+    /* the table directory holds the checksums of all the tables */
+    hash = hash_bytes( hash, &size, sizeof(size) );
+    hash = hash_bytes( hash, ptr, min( size, 4096 ));
+    if (font->ttc_item_offset && font->ttc_item_offset < size)
+        hash = hash_bytes( hash, ptr + font->ttc_item_offset, min( size - font->ttc_item_offset, 1024 ));
+
+    params[0]  = font->face_index;
+    params[1]  = font->ppem;
+    params[2]  = font->scale_y;
+    params[3]  = font->aveWidth;
+    params[4]  = font->fake_bold;
+    params[5]  = font->fake_italic;
+    params[6]  = font->ntmFlags;
+    params[7]  = font->scalable;
+    params[8]  = is_hinting_enabled();
+    params[9]  = is_subpixel_rendering_enabled();
+    hash = hash_bytes( hash, params, sizeof(params) );
+    hash = hash_bytes( hash, &font->lf, FIELD_OFFSET( LOGFONTW, lfFaceName ));
+    hash = hash_bytes( hash, font->lf.lfFaceName, lstrlenW( font->lf.lfFaceName ) * sizeof(WCHAR) );
+    hash = hash_bytes( hash, &font->matrix, sizeof(font->matrix) );
+
+    /* linked fonts are clipped to the metrics of the base font */
+    if (font->base_font && font->base_font != font)
+    {
+        UINT64 base = get_glyph_cache_key( font->base_font );
+        if (!base) return 0;
+        hash = hash_bytes( hash, &base, sizeof(base) );
+    }
+    if (!hash) hash = 1;
+    return data->cache_key = hash;
+}
+
+static BOOL is_glyph_format_cacheable( UINT format )
+{
+    switch (format & ~GGO_UNHINTED)
+    {
+    case GGO_METRICS:
+    case GGO_BITMAP:
+    case GGO_GRAY2_BITMAP:
+    case GGO_GRAY4_BITMAP:
+    case GGO_GRAY8_BITMAP:
+    case WINE_GGO_GRAY16_BITMAP:
+    case WINE_GGO_HRGB_BITMAP:
+    case WINE_GGO_HBGR_BITMAP:
+    case WINE_GGO_VRGB_BITMAP:
+    case WINE_GGO_VBGR_BITMAP:
+        return TRUE;
+    }
+    return FALSE;
+}
+
+static UINT *get_glyph_cache_bucket( UINT64 key, UINT glyph, UINT format, BOOL tategaki )
+{
+    UINT64 hash = key ^ (glyph * 0x9e3779b97f4a7c15ull) ^ ((UINT64)format << 40) ^ ((UINT64)tategaki << 63);
+
+    hash ^= hash >> 29;
+    return &glyph_cache->buckets[(hash * 0xbf58476d1ce4e5b9ull >> 32) % GLYPH_CACHE_BUCKETS];
+}
+
+static const struct glyph_cache_record *find_cached_glyph( UINT64 key, UINT glyph, UINT format, BOOL tategaki )
+{
+    const struct glyph_cache_record *record;
+    UINT pos, next;
+
+    /* map the records added by other processes since the last lookup */
+    map_glyph_cache( min( __atomic_load_n( &glyph_cache->used, __ATOMIC_RELAXED ), glyph_cache_size ));
+    pos = __atomic_load_n( get_glyph_cache_bucket( key, glyph, format, tategaki ), __ATOMIC_ACQUIRE );
+
+    /* the file is shared with other processes, don't trust the offsets: they have to
+     * stay inside our mapping and decrease along the chain */
+    while (pos >= sizeof(*glyph_cache) && pos <= glyph_cache_mapped - FIELD_OFFSET( struct glyph_cache_record, data ))
+    {
+        record = (const struct glyph_cache_record *)((const BYTE *)glyph_cache + pos);
+        if (record->font_key == key && record->glyph == glyph && record->format == format &&
+            record->tategaki == tategaki)
+        {
+            if (record->size > glyph_cache_mapped - pos - FIELD_OFFSET( struct glyph_cache_record, data ))
+                return NULL;
+            return record;
+        }
+        next = __atomic_load_n( &record->next, __ATOMIC_ACQUIRE );
+        if (next >= pos) break;
+        pos = next;
+    }
+    return NULL;
+}
+
+static void add_cached_glyph( UINT64 key, UINT glyph, UINT format, BOOL tategaki, const GLYPHMETRICS *gm,
+                              const ABC *abc, UINT size, const void *data )
+{
+    struct glyph_cache_record *record;
+    UINT len = (FIELD_OFFSET( struct glyph_cache_record, data[size] ) + 7) & ~7;
+    UINT *bucket, pos, next;
+
+    if (size > GLYPH_CACHE_SIZE / 64) return;
+    if (__atomic_load_n( &glyph_cache->used, __ATOMIC_RELAXED ) > glyph_cache_size - len) return;
+    pos = __atomic_fetch_add( &glyph_cache->used, len, __ATOMIC_RELAXED );
+    if (pos > glyph_cache_size - len) return;  /* full, the next process will start a new file */
+    if (!map_glyph_cache( pos + len )) return;
+
+    bucket = get_glyph_cache_bucket( key, glyph, format, tategaki );
+    record = (struct glyph_cache_record *)((BYTE *)glyph_cache + pos);
+    record->font_key = key;
+    record->glyph    = glyph;
+    record->format   = format;
+    record->tategaki = tategaki;
+    record->gm       = *gm;
+    record->abc      = *abc;
+    record->size     = size;
+    memcpy( record->data, data, size );
+
+    next = __atomic_load_n( bucket, __ATOMIC_RELAXED );
+    do
+    {
+        /* a record allocated after us was linked first, drop ours to keep the chain ordered */
+        if (next >= pos) return;
+        record->next = next;
+    }
+    while (!__atomic_compare_exchange_n( bucket, &next, pos, TRUE, __ATOMIC_RELEASE, __ATOMIC_RELAXED ));
+}
+
+/* look up a glyph in the persistent cache, returns FALSE if it needs to be rendered */
+static BOOL get_glyph_from_cache( struct gdi_font *font, UINT glyph, UINT format, BOOL tategaki,
+                                  GLYPHMETRICS *gm, ABC *abc, DWORD buflen, void *buf, DWORD *ret )
+{
+    const struct glyph_cache_record *record;
+    UINT64 key;
+
+    if (!glyph_cache_init_done)
+    {
+        open_glyph_cache();
+        glyph_cache_init_done = TRUE;
+    }
+    if (!glyph_cache || !is_glyph_format_cacheable( format )) return FALSE;
+    if (!(key = get_glyph_cache_key( font ))) return FALSE;
+    if (!(record = find_cached_glyph( key, glyph, format, tategaki ))) return FALSE;
+
+    if (format != GGO_METRICS && buf && buflen)
+    {
+        if (!record->size || record->size > buflen) return FALSE;  /* let the renderer report the error */
+        memcpy( buf, record->data, record->size );
+        memset( (BYTE *)buf + record->size, 0, buflen - record->size );
+    }
+    *gm  = record->gm;
+    *abc = record->abc;
+    *ret = format == GGO_METRICS ? 1 : record->size;
+    return TRUE;
+}
+
+static void add_glyph_to_cache( struct gdi_font *font, UINT glyph, UINT format, BOOL tategaki,
+                                const GLYPHMETRICS *gm, const ABC *abc, DWORD buflen, const void *buf,
+                                DWORD ret )
+{
+    UINT64 key;
+
+    if (!glyph_cache || ret == GDI_ERROR || !is_glyph_format_cacheable( format )) return;
+    if (!(key = get_glyph_cache_key( font ))) return;
+
+    if (format == GGO_METRICS) add_cached_glyph( key, glyph, format, tategaki, gm, abc, 0, NULL );
+    /* empty glyphs can be cached from a size query, the others need the bitmap */
+    else if (!ret || (buf && buflen)) add_cached_glyph( key, glyph, format, tategaki, gm, abc, ret, buf );
+}
+
+/*************************************************************
+ * render_glyph_outline
+ */
+static DWORD render_glyph_outline( struct gdi_font *font, UINT glyph, UINT format,
+                                   GLYPHMETRICS *lpgm, ABC *abc, DWORD buflen, void *buf,
+                                   const MAT2 *lpmat, BOOL tategaki )
 {
     struct gdi_font *base_font = font->base_font ? font->base_font : font;
     FT_Face ft_face = get_ft_face( font );
@@ -3572,6 +4035,22 @@ static DWORD freetype_get_glyph_outline( struct gdi_font *font, UINT glyph, UINT
     }
 }
 
+/*************************************************************
+ * freetype_get_glyph_outline
+ */
+static DWORD freetype_get_glyph_outline( struct gdi_font *font, UINT glyph, UINT format,
+                                         GLYPHMETRICS *lpgm, ABC *abc, DWORD buflen, void *buf,
+                                         const MAT2 *lpmat, BOOL tategaki )
+{
+    DWORD ret;
+
+    if (!lpmat && get_glyph_from_cache( font, glyph, format, tategaki, lpgm, abc, buflen, buf, &ret ))
+        return ret;
+    ret = render_glyph_outline( font, glyph, format, lpgm, abc, buflen, buf, lpmat, tategaki );
+    if (!lpmat) add_glyph_to_cache( font, glyph, format, tategaki, lpgm, abc, buflen, buf, ret );
+    return ret;
+}
+
 /*************************************************************
  * freetype_set_bitmap_text_metrics
  */
@@ -4231,6 +4710,7 @@ static const struct font_backend_funcs font_funcs =
     fontconfig_enum_family_fallbacks,
     freetype_add_font,
     freetype_add_mem_font,
+    freetype_get_config_hash,
     freetype_load_font,
     freetype_get_font_data,
     freetype_get_aa_flags,
@@ -270,7 +270,7 @@ static void check_for_events( UINT flags )
 {
     LARGE_INTEGER zero = { .QuadPart = 0 };
     if (user_driver->pMsgWaitForMultipleObjectsEx( 0, NULL, &zero, flags, 0 ) == WAIT_TIMEOUT)
-        flush_window_surfaces( TRUE );
+        flush_window_surfaces( TRUE, FALSE );
 }
 
 /**********************************************************************
@@ -345,6 +345,7 @@ DWORD WINAPI NtUserGetQueueStatus( UINT flags )
     }
 
     check_for_events( flags );
+    flush_pending_redraw();
 
     SERVER_START_REQ( get_queue_status )
     {
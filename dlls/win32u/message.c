@@ -1799,6 +1799,8 @@ static int peek_message( MSG *msg, HWND hwnd, UINT first, UINT last, UINT flags,
     if (!first && !last) last = ~0;
     if (hwnd == HWND_BROADCAST) hwnd = HWND_TOPMOST;
 
+    flush_pending_redraw();
+
     for (;;)
     {
         NTSTATUS res;
@@ -2084,7 +2086,7 @@ static inline void check_for_driver_events( UINT msg )
     if (get_user_thread_info()->message_count > 200)
     {
         LARGE_INTEGER zero = { .QuadPart = 0 };
-        flush_window_surfaces( FALSE );
+        flush_window_surfaces( FALSE, FALSE );
         user_driver->pMsgWaitForMultipleObjectsEx( 0, NULL, &zero, QS_ALLINPUT, 0 );
     }
     else if (msg == WM_TIMER || msg == WM_SYSTIMER)
@@ -2143,7 +2145,8 @@ static DWORD wait_objects( DWORD count, const HANDLE *handles, DWORD timeout,
 
     assert( count );  /* we must have at least the server queue */
 
-    flush_window_surfaces( TRUE );
+    flush_pending_redraw();
+    flush_window_surfaces( TRUE, timeout != 0 );
 
     if (thread_info->wake_mask != wake_mask || thread_info->changed_mask != changed_mask)
     {
@@ -2268,7 +2271,7 @@ BOOL WINAPI NtUserPeekMessage( MSG *msg_out, HWND hwnd, UINT first, UINT last, U
 
     if (!ret)
     {
-        flush_window_surfaces( TRUE );
+        flush_window_surfaces( TRUE, FALSE );
         ret = wait_message( 0, NULL, 0, QS_ALLINPUT, 0 );
         /* if we received driver events, check again for a pending message */
         if (ret == WAIT_TIMEOUT || peek_message( &msg, hwnd, first, last, flags, 0 ) <= 0) return FALSE;
@@ -316,6 +316,7 @@ struct font_backend_funcs
     BOOL  (*enum_family_fallbacks)( DWORD pitch_and_family, int index, WCHAR buffer[LF_FACESIZE] );
     INT   (*add_font)( const WCHAR *file, DWORD flags );
     INT   (*add_mem_font)( void *ptr, SIZE_T size, DWORD flags );
+    UINT64 (*get_config_hash)(void);
 
     BOOL  (*load_font)( struct gdi_font *gdi_font );
     DWORD (*get_font_data)( struct gdi_font *gdi_font, DWORD table, DWORD offset,
@@ -339,6 +340,7 @@ extern int add_gdi_face( const WCHAR *family_name, const WCHAR *second_name,
                          void *data_ptr, SIZE_T data_size, UINT index, FONTSIGNATURE fs,
                          DWORD ntmflags, DWORD version, DWORD flags,
                          const struct bitmap_font_size *size ) DECLSPEC_HIDDEN;
+extern void add_font_index_path( const char *unix_name ) DECLSPEC_HIDDEN;
 extern UINT font_init(void) DECLSPEC_HIDDEN;
 extern CPTABLEINFO *get_cptable( WORD cp ) DECLSPEC_HIDDEN;
 extern const struct font_backend_funcs *init_freetype_lib(void) DECLSPEC_HIDDEN;
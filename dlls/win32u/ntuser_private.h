@@ -92,6 +92,10 @@ typedef struct tagWND
     int                pixel_format;  /* Pixel format set by the graphics driver */
     int                cbWndExtra;    /* class cbWndExtra at window creation */
     DWORD_PTR          userdata;      /* User private data */
+    UINT               paint_count;   /* statistics for the fps channel */
+    UINT               redraw_count;
+    UINT               merge_count;
+    DWORD              stats_start;
     DWORD              wExtra[1];     /* Window extra bytes */
 } WND;
 
@@ -134,6 +138,7 @@ struct user_thread_info
     DWORD                         kbd_layout_id;          /* Current keyboard layout ID */
     struct rawinput_thread_data  *rawinput;               /* RawInput thread local data / buffer */
     UINT                          spy_indent;             /* Current spy indent */
+    struct pending_redraw        *pending_redraw;         /* Invalidations merged by the thread */
 };
 
 C_ASSERT( sizeof(struct user_thread_info) <= sizeof(((TEB *)0)->Win32ClientInfo) );
@@ -999,7 +999,7 @@ BOOL WINAPI NtGdiRectInRegion( HRGN hrgn, const RECT *rect )
     WINEREGION *obj;
     BOOL ret = FALSE;
     RECT rc;
-    int i;
+    int i, y;
 
     /* swap the coordinates to make right >= left and bottom >= top */
     /* (region building rectangles are normalized the same way) */
@@ -1010,21 +1010,20 @@ BOOL WINAPI NtGdiRectInRegion( HRGN hrgn, const RECT *rect )
     {
 	if ((obj->numRects > 0) && overlapping(&obj->extents, &rc))
 	{
-	    for (i = region_find_pt( obj, rc.left, rc.top, &ret ); !ret && i < obj->numRects; i++ )
+	    /* only check the first rectangle right of rc.left in each band */
+	    y = rc.top;
+	    for (i = region_find_pt( obj, rc.left, y, &ret ); !ret && i < obj->numRects;
+	         i = region_find_pt( obj, rc.left, y, NULL ))
 	    {
-	        if (obj->rects[i].bottom <= rc.top)
-		    continue;             /* not far enough down yet */
-
 		if (obj->rects[i].top >= rc.bottom)
 		    break;                /* too far down */
 
-		if (obj->rects[i].right <= rc.left)
-		    continue;              /* not far enough over yet */
-
-		if (obj->rects[i].left >= rc.right)
-		    continue;
-
-		ret = TRUE;
+		if (obj->rects[i].top > y)
+		    y = obj->rects[i].top;     /* search again in the next band */
+		else if (obj->rects[i].left < rc.right)
+		    ret = TRUE;
+		else
+		    y = obj->rects[i].bottom;  /* nothing more in this band */
 	    }
 	}
 	GDI_ReleaseObj(hrgn);
@@ -1588,6 +1587,7 @@ static BOOL REGION_RegionOp(
     RECT *r2BandEnd;                  /* End of current band in r2 */
     INT top;                          /* Top of non-overlapping band */
     INT bot;                          /* Bottom of non-overlapping band */
+    INT size;                         /* Initial size of newReg */
 
     /*
      * Initialization:
@@ -1607,8 +1607,18 @@ static BOOL REGION_RegionOp(
      * reallocate and copy the array, which is time consuming, yet we don't
      * have to worry about using too much memory. I hope to be able to
      * nuke the Xrealloc() at the end of this function eventually.
+     * If the destination is not one of the sources its rectangles are
+     * about to be thrown away, so build the new region in them instead.
      */
-    if (!init_region( &newReg, max(reg1->numRects,reg2->numRects) * 2 )) return FALSE;
+    size = max( reg1->numRects, reg2->numRects ) * 2;
+    if (destReg != reg1 && destReg != reg2 && destReg->rects != destReg->rects_buf && destReg->size >= size)
+    {
+        newReg.rects = destReg->rects;
+        newReg.size = destReg->size;
+        empty_region( &newReg );
+        init_region( destReg, 0 );
+    }
+    else if (!init_region( &newReg, size )) return FALSE;
 
     /*
      * Initialize ybot and ytop.
@@ -1677,7 +1687,7 @@ static BOOL REGION_RegionOp(
 
             if ((top != bot) && (nonOverlap1Func != NULL))
 	    {
-		if (!nonOverlap1Func(&newReg, r1, r1BandEnd, top, bot)) return FALSE;
+		if (!nonOverlap1Func(&newReg, r1, r1BandEnd, top, bot)) goto failed;
 	    }
 
 	    ytop = r2->top;
@@ -1689,7 +1699,7 @@ static BOOL REGION_RegionOp(
 
             if ((top != bot) && (nonOverlap2Func != NULL))
 	    {
-		if (!nonOverlap2Func(&newReg, r2, r2BandEnd, top, bot)) return FALSE;
+		if (!nonOverlap2Func(&newReg, r2, r2BandEnd, top, bot)) goto failed;
 	    }
 
 	    ytop = r1->top;
@@ -1718,7 +1728,7 @@ static BOOL REGION_RegionOp(
 	curBand = newReg.numRects;
 	if (ybot > ytop)
 	{
-	    if (!overlapFunc(&newReg, r1, r1BandEnd, r2, r2BandEnd, ytop, ybot)) return FALSE;
+	    if (!overlapFunc(&newReg, r1, r1BandEnd, r2, r2BandEnd, ytop, ybot)) goto failed;
 	}
 
 	if (newReg.numRects != curBand)
@@ -1756,7 +1766,7 @@ static BOOL REGION_RegionOp(
 		    r1BandEnd++;
 		}
 		if (!nonOverlap1Func(&newReg, r1, r1BandEnd, max(r1->top,ybot), r1->bottom))
-                    return FALSE;
+                    goto failed;
 		r1 = r1BandEnd;
 	    } while (r1 != r1End);
 	}
@@ -1771,7 +1781,7 @@ static BOOL REGION_RegionOp(
 		 r2BandEnd++;
 	    }
 	    if (!nonOverlap2Func(&newReg, r2, r2BandEnd, max(r2->top,ybot), r2->bottom))
-                return FALSE;
+                goto failed;
 	    r2 = r2BandEnd;
 	} while (r2 != r2End);
     }
@@ -1784,6 +1794,10 @@ static BOOL REGION_RegionOp(
     REGION_compact( &newReg );
     move_rects( destReg, &newReg );
     return TRUE;
+
+failed:
+    destroy_region( &newReg );
+    return FALSE;
 }
 
 /***********************************************************************
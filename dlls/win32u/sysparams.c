@@ -5365,6 +5365,7 @@ static void thread_detach(void)
     free( thread_info->rawinput );
 
     destroy_thread_windows();
+    discard_pending_redraw( 0 );
     cleanup_imm_thread();
     NtClose( thread_info->server_queue );
 
@@ -226,8 +226,11 @@ extern struct window_surface dummy_surface DECLSPEC_HIDDEN;
 extern BOOL create_dib_surface( HDC hdc, const BITMAPINFO *info ) DECLSPEC_HIDDEN;
 extern void create_offscreen_window_surface( const RECT *visible_rect,
                                              struct window_surface **surface ) DECLSPEC_HIDDEN;
+extern void discard_pending_redraw( HWND hwnd ) DECLSPEC_HIDDEN;
 extern void erase_now( HWND hwnd, UINT rdw_flags ) DECLSPEC_HIDDEN;
-extern void flush_window_surfaces( BOOL idle ) DECLSPEC_HIDDEN;
+extern void flush_all_pending_redraws(void) DECLSPEC_HIDDEN;
+extern void flush_pending_redraw(void) DECLSPEC_HIDDEN;
+extern void flush_window_surfaces( BOOL idle, BOOL wait ) DECLSPEC_HIDDEN;
 extern void move_window_bits( HWND hwnd, struct window_surface *old_surface,
                               struct window_surface *new_surface,
                               const RECT *visible_rect, const RECT *old_visible_rect,
@@ -176,6 +176,82 @@ HWND get_hwnd_message_parent(void)
     return UlongToHandle( thread_info->msg_window );
 }
 
+static const volatile window_shm_t *window_shm;
+static unsigned int window_shm_count;
+
+static const volatile window_shm_t *get_window_shm(void)
+{
+    static BOOL failed;
+    window_shm_t *ptr = NULL;
+    obj_handle_t handle = 0;
+    unsigned int count = 0;
+    LARGE_INTEGER offset;
+    SIZE_T size = 0;
+
+    if (window_shm || failed) return window_shm;
+
+    SERVER_START_REQ( get_window_shm_area )
+    {
+        if (!wine_server_call( req ))
+        {
+            handle = reply->handle;
+            count = reply->count;
+        }
+    }
+    SERVER_END_REQ;
+
+    if (!handle)
+    {
+        failed = TRUE;
+        return NULL;
+    }
+
+    offset.QuadPart = 0;
+    if (NtMapViewOfSection( wine_server_ptr_handle( handle ), GetCurrentProcess(), (void **)&ptr, 0, 0,
+                            &offset, &size, ViewShare, 0, PAGE_READONLY ))
+        failed = TRUE;
+    NtClose( wine_server_ptr_handle( handle ));
+    if (failed) return NULL;
+
+    window_shm_count = count;
+    if (InterlockedCompareExchangePointer( (void **)&window_shm, ptr, NULL ))
+        NtUnmapViewOfSection( GetCurrentProcess(), ptr );
+    return window_shm;
+}
+
+/***********************************************************************
+ *           get_shared_window_info
+ *
+ * Retrieve the information of a window belonging to another process from
+ * the area shared with the server, without a server round-trip.
+ * Return FALSE if the information isn't available; the caller then needs
+ * to ask the server.
+ */
+static BOOL get_shared_window_info( HWND hwnd, window_shm_t *info )
+{
+    const volatile window_shm_t *shm;
+    UINT index = USER_HANDLE_TO_INDEX( hwnd ), seq;
+
+    if (!(shm = get_window_shm()) || index >= window_shm_count) return FALSE;
+    shm += index;
+
+    do
+    {
+        seq = ReadAcquire( (const LONG *)&shm->seq );
+        if (seq & 1)
+        {
+            YieldProcessor();
+            continue;
+        }
+        *info = *(const window_shm_t *)shm;
+        MemoryBarrier();
+    } while ((seq & 1) || ReadNoFence( (const LONG *)&shm->seq ) != seq);
+
+    if (!info->handle) return FALSE;
+    if (HIWORD(hwnd) && HIWORD(hwnd) != 0xffff) return UlongToHandle( info->handle ) == hwnd;
+    return LOWORD(info->handle) == LOWORD(hwnd);
+}
+
 /***********************************************************************
  *           get_full_window_handle
  *
@@ -205,6 +281,10 @@ HWND get_full_window_handle( HWND hwnd )
     }
     else  /* may belong to another process */
     {
+        window_shm_t info;
+
+        if (get_shared_window_info( hwnd, &info )) return UlongToHandle( info.handle );
+
         SERVER_START_REQ( get_window_info )
         {
             req->handle = wine_server_user_handle( hwnd );
@@ -290,6 +370,7 @@ HWND is_current_process_window( HWND hwnd )
 /* see IsWindow */
 BOOL is_window( HWND hwnd )
 {
+    window_shm_t info;
     WND *win;
     BOOL ret;
 
@@ -303,6 +384,8 @@ BOOL is_window( HWND hwnd )
     }
 
     /* check other processes */
+    if (get_shared_window_info( hwnd, &info )) return TRUE;
+
     SERVER_START_REQ( get_window_info )
     {
         req->handle = wine_server_user_handle( hwnd );
@@ -315,6 +398,7 @@ BOOL is_window( HWND hwnd )
 /* see GetWindowThreadProcessId */
 DWORD get_window_thread( HWND hwnd, DWORD *process )
 {
+    window_shm_t info;
     WND *ptr;
     DWORD tid = 0;
 
@@ -334,6 +418,12 @@ DWORD get_window_thread( HWND hwnd, DWORD *process )
     }
 
     /* check other processes */
+    if (ptr == WND_OTHER_PROCESS && get_shared_window_info( hwnd, &info ))
+    {
+        if (process) *process = info.pid;
+        return info.tid;
+    }
+
     SERVER_START_REQ( get_window_info )
     {
         req->handle = wine_server_user_handle( hwnd );
@@ -361,7 +451,16 @@ HWND get_parent( HWND hwnd )
     if (win == WND_DESKTOP) return 0;
     if (win == WND_OTHER_PROCESS)
     {
-        LONG style = get_window_long( hwnd, GWL_STYLE );
+        window_shm_t info;
+        LONG style;
+
+        if (get_shared_window_info( hwnd, &info ))
+        {
+            if (info.style & WS_POPUP) return wine_server_ptr_handle( info.owner );
+            if (info.style & WS_CHILD) return wine_server_ptr_handle( info.parent );
+            return 0;
+        }
+        style = get_window_long( hwnd, GWL_STYLE );
         if (style & (WS_POPUP | WS_CHILD))
         {
             SERVER_START_REQ( get_window_tree )
@@ -502,6 +601,11 @@ HWND get_window_relative( HWND hwnd, UINT rel )
             release_win_ptr( win );
             return retval;
         }
+        else
+        {
+            window_shm_t info;
+            if (get_shared_window_info( hwnd, &info )) return wine_server_ptr_handle( info.owner );
+        }
         /* else fall through to server call */
     }
 
@@ -545,6 +649,7 @@ HWND get_window_relative( HWND hwnd, UINT rel )
  */
 static HWND *list_window_parents( HWND hwnd )
 {
+    window_shm_t info;
     WND *win;
     HWND current, *list;
     int i, pos = 0, size = 16, count;
@@ -555,15 +660,23 @@ static HWND *list_window_parents( HWND hwnd )
     for (;;)
     {
         if (!(win = get_win_ptr( current ))) goto empty;
-        if (win == WND_OTHER_PROCESS) break;  /* need to do it the hard way */
         if (win == WND_DESKTOP)
         {
             if (!pos) goto empty;
             list[pos] = 0;
             return list;
         }
-        list[pos] = current = win->parent;
-        release_win_ptr( win );
+        if (win == WND_OTHER_PROCESS)
+        {
+            /* need to do it the hard way */
+            if (!get_shared_window_info( current, &info )) break;
+            list[pos] = current = wine_server_ptr_handle( info.parent );
+        }
+        else
+        {
+            list[pos] = current = win->parent;
+            release_win_ptr( win );
+        }
         if (!current) return list;
         if (++pos == size - 1)
         {
@@ -677,6 +790,13 @@ HWND WINAPI NtUserGetAncestor( HWND hwnd, UINT type )
         }
         else /* need to query the server */
         {
+            window_shm_t info;
+
+            if (get_shared_window_info( hwnd, &info ))
+            {
+                ret = wine_server_ptr_handle( info.parent );
+                break;
+            }
             SERVER_START_REQ( get_window_tree )
             {
                 req->handle = wine_server_user_handle( hwnd );
@@ -801,6 +921,10 @@ BOOL is_window_unicode( HWND hwnd )
     }
     else
     {
+        window_shm_t info;
+
+        if (get_shared_window_info( hwnd, &info )) return info.is_unicode;
+
         SERVER_START_REQ( get_window_info )
         {
             req->handle = wine_server_user_handle( hwnd );
@@ -875,6 +999,10 @@ DPI_AWARENESS_CONTEXT get_window_dpi_awareness_context( HWND hwnd )
     }
     else
     {
+        window_shm_t info;
+
+        if (get_shared_window_info( hwnd, &info )) return ULongToHandle( info.awareness | 0x10 );
+
         SERVER_START_REQ( get_window_info )
         {
             req->handle = wine_server_user_handle( hwnd );
@@ -909,6 +1037,11 @@ UINT get_dpi_for_window( HWND hwnd )
     }
     else
     {
+        window_shm_t info;
+
+        /* per-monitor aware windows have no dpi of their own, ask the server */
+        if (get_shared_window_info( hwnd, &info ) && info.dpi) return info.dpi;
+
         SERVER_START_REQ( get_window_info )
         {
             req->handle = wine_server_user_handle( hwnd );
@@ -1013,11 +1146,16 @@ static LONG_PTR get_window_long_size( HWND hwnd, INT offset, UINT size, BOOL ans
 
     if (win == WND_OTHER_PROCESS)
     {
+        window_shm_t info;
+
         if (offset == GWLP_WNDPROC)
         {
             RtlSetLastWin32Error( ERROR_ACCESS_DENIED );
             return 0;
         }
+        if ((offset == GWL_STYLE || offset == GWL_EXSTYLE) && get_shared_window_info( hwnd, &info ))
+            return offset == GWL_STYLE ? info.style : info.ex_style;
+
         SERVER_START_REQ( set_window_info )
         {
             req->handle = wine_server_user_handle( hwnd );
@@ -1531,6 +1669,57 @@ static void mirror_rect( const RECT *window_rect, RECT *rect )
     rect->right = width - tmp;
 }
 
+static RECT rect_from_shm( const rectangle_t *rect )
+{
+    RECT ret = { rect->left, rect->top, rect->right, rect->bottom };
+    return ret;
+}
+
+/* get the rectangles of a window belonging to another process from the shared area, if possible */
+static BOOL get_shared_window_rects( HWND hwnd, enum coords_relative relative, RECT *window_rect,
+                                     RECT *client_rect, UINT dpi )
+{
+    window_shm_t info, parent_info;
+    RECT window, client, rect;
+
+    /* mapping from the monitor DPI is left to the server */
+    if (!dpi || !get_shared_window_info( hwnd, &info ) || !info.dpi) return FALSE;
+
+    window = rect_from_shm( &info.window_rect );
+    client = rect_from_shm( &info.client_rect );
+
+    switch (relative)
+    {
+    case COORDS_CLIENT:
+        OffsetRect( &window, -client.left, -client.top );
+        rect = client;
+        OffsetRect( &client, -client.left, -client.top );
+        if (info.ex_style & WS_EX_LAYOUTRTL) mirror_rect( &rect, &window );
+        break;
+    case COORDS_WINDOW:
+        OffsetRect( &client, -window.left, -window.top );
+        rect = window;
+        OffsetRect( &window, -window.left, -window.top );
+        if (info.ex_style & WS_EX_LAYOUTRTL) mirror_rect( &rect, &client );
+        break;
+    case COORDS_PARENT:
+        if (!info.parent) break;
+        if (!get_shared_window_info( wine_server_ptr_handle( info.parent ), &parent_info )) return FALSE;
+        if (parent_info.ex_style & WS_EX_LAYOUTRTL)
+        {
+            rect = rect_from_shm( &parent_info.client_rect );
+            mirror_rect( &rect, &window );
+            mirror_rect( &rect, &client );
+        }
+        break;
+    default:
+        return FALSE;
+    }
+    if (window_rect) *window_rect = map_dpi_rect( window, info.dpi, dpi );
+    if (client_rect) *client_rect = map_dpi_rect( client, info.dpi, dpi );
+    return TRUE;
+}
+
 /***********************************************************************
  *           get_window_rects
  *
@@ -1640,6 +1829,8 @@ BOOL get_window_rects( HWND hwnd, enum coords_relative relative, RECT *window_re
         return TRUE;
     }
 
+    if (get_shared_window_rects( hwnd, relative, window_rect, client_rect, dpi )) return TRUE;
+
 other_process:
     SERVER_START_REQ( get_window_rectangles )
     {
@@ -1782,6 +1973,8 @@ static BOOL apply_window_pos( HWND hwnd, HWND insert_after, UINT swp_flags,
     get_window_rects( hwnd, COORDS_SCREEN, &old_window_rect, NULL, get_thread_dpi() );
     if (IsRectEmpty( &valid_rects[0] )) valid_rects = NULL;
 
+    flush_pending_redraw();
+
     if (!(win = get_win_ptr( hwnd )) || win == WND_DESKTOP || win == WND_OTHER_PROCESS)
     {
         if (new_surface) window_surface_release( new_surface );
@@ -4647,6 +4840,7 @@ LRESULT destroy_window( HWND hwnd )
     TRACE( "%p\n", hwnd );
 
     unregister_imm_window( hwnd );
+    discard_pending_redraw( hwnd );
 
     /* free child windows */
     if ((children = list_window_children( 0, hwnd, NULL, 0 )))
@@ -690,6 +690,16 @@ static RECT *android_surface_get_bounds( struct window_surface *window_surface )
     return &surface->bounds;
 }
 
+/***********************************************************************
+ *           android_surface_add_bounds
+ */
+static void android_surface_add_bounds( struct window_surface *window_surface, const RECT *rect )
+{
+    struct android_window_surface *surface = get_android_surface( window_surface );
+
+    add_bounds_rect( &surface->bounds, rect );
+}
+
 /***********************************************************************
  *           android_surface_set_region
  */
@@ -819,6 +829,7 @@ static const struct window_surface_funcs android_surface_funcs =
     android_surface_unlock,
     android_surface_get_bitmap_info,
     android_surface_get_bounds,
+    android_surface_add_bounds,
     android_surface_set_region,
     android_surface_flush,
     android_surface_destroy
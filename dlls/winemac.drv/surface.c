@@ -139,6 +139,19 @@ static RECT *macdrv_surface_get_bounds(struct window_surface *window_surface)
     return &surface->bounds;
 }
 
+/***********************************************************************
+ *              macdrv_surface_add_bounds
+ */
+static void macdrv_surface_add_bounds(struct window_surface *window_surface, const RECT *rect)
+{
+    struct macdrv_window_surface *surface = get_mac_surface(window_surface);
+
+    surface->bounds.left   = min(surface->bounds.left, rect->left);
+    surface->bounds.top    = min(surface->bounds.top, rect->top);
+    surface->bounds.right  = max(surface->bounds.right, rect->right);
+    surface->bounds.bottom = max(surface->bounds.bottom, rect->bottom);
+}
+
 /***********************************************************************
  *              macdrv_surface_set_region
  */
@@ -225,6 +238,7 @@ static const struct window_surface_funcs macdrv_surface_funcs =
     macdrv_surface_unlock,
     macdrv_surface_get_bitmap_info,
     macdrv_surface_get_bounds,
+    macdrv_surface_add_bounds,
     macdrv_surface_set_region,
     macdrv_surface_flush,
     macdrv_surface_destroy,
@@ -29,6 +29,7 @@
 #include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <time.h>
 
 #include <X11/Xlib.h>
 #include <X11/Xresource.h>
@@ -51,6 +52,7 @@
 #include "wine/debug.h"
 
 WINE_DEFAULT_DEBUG_CHANNEL(bitblt);
+WINE_DECLARE_DEBUG_CHANNEL(fps);
 
 
 #define DST 0   /* Destination drawable */
@@ -1569,22 +1571,44 @@ DWORD get_pixmap_image( Pixmap pixmap, int width, int height, const XVisualInfo
 }
 
 
+#define MAX_DAMAGE_RECTS 8
+
+struct shape_row
+{
+    int  count;   /* number of opaque spans times 2, -1 if unknown */
+    int  size;    /* allocated size of the spans array */
+    int *spans;   /* start and end column of each span */
+};
+
 struct x11drv_window_surface
 {
     struct window_surface header;
     Window                window;
     GC                    gc;
     XImage               *image;
-    RECT                  bounds;
+    RECT                  bounds;        /* bounding rectangle of the damaged area */
+    RECT                  damage[MAX_DAMAGE_RECTS];  /* damaged rectangles, all inside bounds */
+    int                   damage_count;
     BOOL                  byteswap;
     BOOL                  is_argb;
+    BOOL                  shape_set;     /* window shape has been set from the surface contents */
+    BOOL                  composited;    /* a compositing manager handles the alpha channel */
+    LONG                  compositor_serial; /* compositor_serial when composited was checked */
+    int                   shape_kind;    /* ShapeBounding, or ShapeInput when composited */
+    struct shape_row     *shape_rows;    /* cached window shape */
     DWORD                 alpha_bits;
     COLORREF              color_key;
     HRGN                  region;
     void                 *bits;
 #ifdef HAVE_LIBXXSHM
     XShmSegmentInfo       shminfo;
+    unsigned long         shm_serial;    /* last upload waiting for its completion event */
 #endif
+    ULONGLONG             upload_bytes;  /* statistics for the fps channel */
+    ULONGLONG             upload_total;
+    ULONGLONG             upload_time;   /* thread CPU time spent in flushes, in microseconds */
+    UINT                  upload_count;
+    DWORD                 upload_start;
     pthread_mutex_t       mutex;
     BITMAPINFO            info;   /* variable size, must be last */
 };
@@ -1602,140 +1626,86 @@ static inline UINT get_color_component( UINT color, UINT mask )
 }
 
 #ifdef HAVE_LIBXSHAPE
-static inline void flush_rgn_data( HRGN rgn, RGNDATA *data )
-{
-    HRGN tmp = NtGdiExtCreateRegion( NULL, data->rdh.dwSize + data->rdh.nRgnSize, data );
-    NtGdiCombineRgn( rgn, rgn, tmp, RGN_OR );
-    NtGdiDeleteObjectApp( tmp );
-    data->rdh.nCount = 0;
-}
-
-static inline void add_row( HRGN rgn, RGNDATA *data, int x, int y, int len )
-{
-    RECT *rect = (RECT *)data->Buffer + data->rdh.nCount;
-
-    if (len <= 0) return;
-    rect->left   = x;
-    rect->top    = y;
-    rect->right  = x + len;
-    rect->bottom = y + 1;
-    data->rdh.nCount++;
-    if (data->rdh.nCount * sizeof(RECT) > data->rdh.nRgnSize - sizeof(RECT))
-        flush_rgn_data( rgn, data );
-}
-#endif
-
 /***********************************************************************
- *           update_surface_region
+ *           get_row_spans
+ *
+ * Compute the opaque spans of a surface row, as pairs of start and end columns.
  */
-static void update_surface_region( struct x11drv_window_surface *surface )
+static int get_row_spans( struct x11drv_window_surface *surface, int y, int *spans )
 {
-#ifdef HAVE_LIBXSHAPE
-    char buffer[4096];
-    RGNDATA *data = (RGNDATA *)buffer;
     BITMAPINFO *info = &surface->info;
     UINT *masks = (UINT *)info->bmiColors;
-    int x, y, start, width;
-    HRGN rgn;
-
-    if (!shape_layered_windows) return;
-
-    if (!surface->is_argb && surface->color_key == CLR_INVALID)
-    {
-        XShapeCombineMask( gdi_display, surface->window, ShapeBounding, 0, 0, None, ShapeSet );
-        return;
-    }
-
-    data->rdh.dwSize = sizeof(data->rdh);
-    data->rdh.iType  = RDH_RECTANGLES;
-    data->rdh.nCount = 0;
-    data->rdh.nRgnSize = sizeof(buffer) - sizeof(data->rdh);
-
-    rgn = NtGdiCreateRectRgn( 0, 0, 0, 0 );
-    width = surface->header.rect.right - surface->header.rect.left;
+    int x, count = 0, width = surface->header.rect.right - surface->header.rect.left;
 
     switch (info->bmiHeader.biBitCount)
     {
     case 16:
     {
-        WORD *bits = surface->bits;
-        int stride = (width + 1) & ~1;
+        WORD *bits = (WORD *)surface->bits + y * ((width + 1) & ~1);
         UINT mask = masks[0] | masks[1] | masks[2];
 
-        for (y = surface->header.rect.top; y < surface->header.rect.bottom; y++, bits += stride)
+        for (x = 0; x < width; )
         {
-            x = 0;
-            while (x < width)
-            {
-                while (x < width && (bits[x] & mask) == surface->color_key) x++;
-                start = x;
-                while (x < width && (bits[x] & mask) != surface->color_key) x++;
-                add_row( rgn, data, surface->header.rect.left + start, y, x - start );
-            }
+            while (x < width && (bits[x] & mask) == surface->color_key) x++;
+            if (x == width) break;
+            spans[count++] = x;
+            while (x < width && (bits[x] & mask) != surface->color_key) x++;
+            spans[count++] = x;
         }
         break;
     }
     case 24:
     {
-        BYTE *bits = surface->bits;
-        int stride = (width * 3 + 3) & ~3;
+        BYTE *bits = (BYTE *)surface->bits + y * ((width * 3 + 3) & ~3);
 
-        for (y = surface->header.rect.top; y < surface->header.rect.bottom; y++, bits += stride)
+        for (x = 0; x < width; )
         {
-            x = 0;
-            while (x < width)
-            {
-                while (x < width &&
-                       (bits[x * 3] == GetBValue(surface->color_key)) &&
-                       (bits[x * 3 + 1] == GetGValue(surface->color_key)) &&
-                       (bits[x * 3 + 2] == GetRValue(surface->color_key)))
-                    x++;
-                start = x;
-                while (x < width &&
-                       ((bits[x * 3] != GetBValue(surface->color_key)) ||
-                        (bits[x * 3 + 1] != GetGValue(surface->color_key)) ||
-                        (bits[x * 3 + 2] != GetRValue(surface->color_key))))
-                    x++;
-                add_row( rgn, data, surface->header.rect.left + start, y, x - start );
-            }
+            while (x < width &&
+                   (bits[x * 3] == GetBValue(surface->color_key)) &&
+                   (bits[x * 3 + 1] == GetGValue(surface->color_key)) &&
+                   (bits[x * 3 + 2] == GetRValue(surface->color_key)))
+                x++;
+            if (x == width) break;
+            spans[count++] = x;
+            while (x < width &&
+                   ((bits[x * 3] != GetBValue(surface->color_key)) ||
+                    (bits[x * 3 + 1] != GetGValue(surface->color_key)) ||
+                    (bits[x * 3 + 2] != GetRValue(surface->color_key))))
+                x++;
+            spans[count++] = x;
         }
         break;
     }
     case 32:
     {
-        DWORD *bits = surface->bits;
+        DWORD *bits = (DWORD *)surface->bits + y * width;
 
         if (info->bmiHeader.biCompression == BI_RGB)
         {
-            for (y = surface->header.rect.top; y < surface->header.rect.bottom; y++, bits += width)
+            for (x = 0; x < width; )
             {
-                x = 0;
-                while (x < width)
-                {
-                    while (x < width &&
-                           ((bits[x] & 0xffffff) == surface->color_key ||
-                            (surface->is_argb && !(bits[x] & 0xff000000)))) x++;
-                    start = x;
-                    while (x < width &&
-                           !((bits[x] & 0xffffff) == surface->color_key ||
-                             (surface->is_argb && !(bits[x] & 0xff000000)))) x++;
-                    add_row( rgn, data, surface->header.rect.left + start, y, x - start );
-                }
+                while (x < width &&
+                       ((bits[x] & 0xffffff) == surface->color_key ||
+                        (surface->is_argb && !(bits[x] & 0xff000000)))) x++;
+                if (x == width) break;
+                spans[count++] = x;
+                while (x < width &&
+                       !((bits[x] & 0xffffff) == surface->color_key ||
+                         (surface->is_argb && !(bits[x] & 0xff000000)))) x++;
+                spans[count++] = x;
             }
         }
         else
         {
             UINT mask = masks[0] | masks[1] | masks[2];
-            for (y = surface->header.rect.top; y < surface->header.rect.bottom; y++, bits += width)
+
+            for (x = 0; x < width; )
             {
-                x = 0;
-                while (x < width)
-                {
-                    while (x < width && (bits[x] & mask) == surface->color_key) x++;
-                    start = x;
-                    while (x < width && (bits[x] & mask) != surface->color_key) x++;
-                    add_row( rgn, data, surface->header.rect.left + start, y, x - start );
-                }
+                while (x < width && (bits[x] & mask) == surface->color_key) x++;
+                if (x == width) break;
+                spans[count++] = x;
+                while (x < width && (bits[x] & mask) != surface->color_key) x++;
+                spans[count++] = x;
             }
         }
         break;
@@ -1743,20 +1713,322 @@ static void update_surface_region( struct x11drv_window_surface *surface )
     default:
         assert(0);
     }
+    return count;
+}
 
-    if (data->rdh.nCount) flush_rgn_data( rgn, data );
+/***********************************************************************
+ *           set_row_spans
+ *
+ * Store the spans of a row in the cached shape, return FALSE if they didn't change.
+ */
+static BOOL set_row_spans( struct shape_row *row, const int *spans, int count )
+{
+    int *new_spans;
 
-    if ((data = X11DRV_GetRegionData( rgn, 0 )))
+    if (row->count == count && !memcmp( row->spans, spans, count * sizeof(*spans) )) return FALSE;
+    if (count > row->size)
     {
-        XShapeCombineRectangles( gdi_display, surface->window, ShapeBounding, 0, 0,
-                                 (XRectangle *)data->Buffer, data->rdh.nCount, ShapeSet, YXBanded );
-        free( data );
+        if (!(new_spans = realloc( row->spans, count * sizeof(*spans) )))
+        {
+            row->count = -1;  /* make sure we try again next time */
+            return TRUE;
+        }
+        row->spans = new_spans;
+        row->size = count;
     }
+    memcpy( row->spans, spans, count * sizeof(*spans) );
+    row->count = count;
+    return TRUE;
+}
 
-    NtGdiDeleteObjectApp( rgn );
+/***********************************************************************
+ *           add_shape_rows
+ *
+ * Convert the cached spans of rows [start, end) to rectangles in YX-banded order,
+ * merging consecutive rows that have identical spans into a single band.
+ */
+static XRectangle *add_shape_rows( struct x11drv_window_surface *surface, int start, int end,
+                                   XRectangle *rects, int *count, int *size )
+{
+    struct shape_row *rows = surface->shape_rows;
+    XRectangle *new_rects;
+    int i, y, height;
+
+    for (y = start; y < end; y += height)
+    {
+        if (rows[y].count <= 0)
+        {
+            height = 1;
+            continue;
+        }
+        for (height = 1; y + height < end; height++)
+            if (rows[y + height].count != rows[y].count ||
+                memcmp( rows[y + height].spans, rows[y].spans, rows[y].count * sizeof(int) )) break;
+
+        if (*count + rows[y].count / 2 > *size)
+        {
+            int new_size = max( *size * 2, *count + rows[y].count / 2 );
+            if (!(new_rects = realloc( rects, new_size * sizeof(*rects) ))) return rects;
+            rects = new_rects;
+            *size = new_size;
+        }
+        for (i = 0; i < rows[y].count; i += 2)
+        {
+            XRectangle *rect = &rects[(*count)++];
+            rect->x      = surface->header.rect.left + rows[y].spans[i];
+            rect->y      = surface->header.rect.top + y;
+            rect->width  = rows[y].spans[i + 1] - rows[y].spans[i];
+            rect->height = height;
+        }
+    }
+    return rects;
+}
+
+/***********************************************************************
+ *           free_surface_shape
+ */
+static void free_surface_shape( struct x11drv_window_surface *surface )
+{
+    int y, height = surface->header.rect.bottom - surface->header.rect.top;
+
+    if (!surface->shape_rows) return;
+    for (y = 0; y < height; y++) free( surface->shape_rows[y].spans );
+    free( surface->shape_rows );
+    surface->shape_rows = NULL;
+}
+#endif
+
+/***********************************************************************
+ *           update_surface_region
+ *
+ * Update the window shape for the given rectangles of the surface, or for
+ * the whole surface if rects is NULL. The shape is cached as a list of
+ * spans for each row, and only the rows that changed are sent to the server.
+ */
+static void update_surface_region( struct x11drv_window_surface *surface, const RECT *rects, int count )
+{
+#ifdef HAVE_LIBXSHAPE
+    int width = surface->header.rect.right - surface->header.rect.left;
+    int height = surface->header.rect.bottom - surface->header.rect.top;
+    int i, y, end, *spans, nb_spans, rect_count = 0, rect_size = 0;
+    XRectangle *xrects = NULL, band;
+    BOOL full = !rects || !surface->shape_set;
+    int kind = ShapeBounding;
+    BYTE *changed;
+
+    if (!shape_layered_windows) return;
+
+    if (surface->composited && surface->color_key == CLR_INVALID)
+    {
+#ifdef ShapeInput
+        /* the compositing manager takes care of the alpha channel,
+         * but transparent pixels must still let the input through */
+        kind = ShapeInput;
+#else
+        if (surface->shape_set)
+            XShapeCombineMask( gdi_display, surface->window, ShapeBounding, 0, 0, None, ShapeSet );
+        surface->shape_set = FALSE;
+        free_surface_shape( surface );
+        return;
+#endif
+    }
+    else if (!surface->is_argb && surface->color_key == CLR_INVALID)
+    {
+        /* no shape needed */
+        if (surface->shape_set && surface->shape_kind != ShapeBounding)
+            XShapeCombineMask( gdi_display, surface->window, surface->shape_kind, 0, 0, None, ShapeSet );
+        XShapeCombineMask( gdi_display, surface->window, ShapeBounding, 0, 0, None, ShapeSet );
+        surface->shape_set = FALSE;
+        surface->shape_kind = ShapeBounding;
+        free_surface_shape( surface );
+        return;
+    }
+
+    if (kind != surface->shape_kind)
+    {
+        /* remove the shape of the previous kind, the new one is built from scratch */
+        if (surface->shape_set)
+            XShapeCombineMask( gdi_display, surface->window, surface->shape_kind, 0, 0, None, ShapeSet );
+        surface->shape_set = FALSE;
+        surface->shape_kind = kind;
+        full = TRUE;
+    }
+
+    if (!surface->shape_rows && !(surface->shape_rows = calloc( height, sizeof(*surface->shape_rows) )))
+        return;
+    if (!(changed = calloc( height, 1 ))) return;
+    if (!(spans = malloc( (width + 1) * sizeof(*spans) )))
+    {
+        free( changed );
+        return;
+    }
+
+    if (full)
+    {
+        for (y = 0; y < height; y++)
+        {
+            nb_spans = get_row_spans( surface, y, spans );
+            set_row_spans( &surface->shape_rows[y], spans, nb_spans );
+        }
+        xrects = add_shape_rows( surface, 0, height, xrects, &rect_count, &rect_size );
+        XShapeCombineRectangles( gdi_display, surface->window, surface->shape_kind, 0, 0,
+                                 xrects, rect_count, ShapeSet, YXBanded );
+        surface->shape_set = TRUE;
+    }
+    else
+    {
+        for (i = 0; i < count; i++)
+        {
+            for (y = max( rects[i].top, 0 ); y < min( rects[i].bottom, height ); y++)
+            {
+                if (changed[y]) continue;
+                nb_spans = get_row_spans( surface, y, spans );
+                changed[y] = 1 + set_row_spans( &surface->shape_rows[y], spans, nb_spans );
+            }
+        }
+
+        /* replace each run of changed rows */
+        for (y = 0; y < height; y = end)
+        {
+            if (changed[y] != 2)
+            {
+                end = y + 1;
+                continue;
+            }
+            for (end = y + 1; end < height && changed[end] == 2; end++) ;
+
+            band.x      = surface->header.rect.left;
+            band.y      = surface->header.rect.top + y;
+            band.width  = width;
+            band.height = end - y;
+            XShapeCombineRectangles( gdi_display, surface->window, surface->shape_kind, 0, 0,
+                                     &band, 1, ShapeSubtract, YXBanded );
+            rect_count = 0;
+            xrects = add_shape_rows( surface, y, end, xrects, &rect_count, &rect_size );
+            if (rect_count)
+                XShapeCombineRectangles( gdi_display, surface->window, surface->shape_kind, 0, 0,
+                                         xrects, rect_count, ShapeUnion, YXBanded );
+        }
+    }
+
+    free( xrects );
+    free( spans );
+    free( changed );
 #endif
 }
 
+static Atom compositor_atom;
+static LONG compositor_serial;  /* incremented when the compositing manager changes */
+
+/***********************************************************************
+ *           get_compositor_atom
+ */
+static Atom get_compositor_atom(void)
+{
+    char name[32];
+
+    if (!compositor_atom)
+    {
+        snprintf( name, sizeof(name), "_NET_WM_CM_S%d", DefaultScreen( gdi_display ));
+        compositor_atom = XInternAtom( gdi_display, name, False );
+    }
+    return compositor_atom;
+}
+
+/***********************************************************************
+ *           is_compositor_running
+ */
+static BOOL is_compositor_running(void)
+{
+    return XGetSelectionOwner( gdi_display, get_compositor_atom() ) != None;
+}
+
+/***********************************************************************
+ *           init_compositor_notify
+ *
+ * Request notifications of compositing manager changes on a thread display.
+ */
+void init_compositor_notify( Display *display )
+{
+    xfixes_select_selection( display, DefaultRootWindow( display ), get_compositor_atom() );
+}
+
+/***********************************************************************
+ *           compositor_selection_notify
+ *
+ * Called on selection owner changes, returns TRUE if the selection is the compositor one.
+ */
+BOOL compositor_selection_notify( Atom selection )
+{
+    if (selection != get_compositor_atom()) return FALSE;
+    TRACE( "compositing manager changed\n" );
+    InterlockedIncrement( &compositor_serial );
+    return TRUE;
+}
+
+/***********************************************************************
+ *           update_surface_compositor
+ *
+ * Check whether the compositing manager changed since the surface was last updated.
+ * Must be called with the surface locked.
+ */
+static void update_surface_compositor( struct x11drv_window_surface *surface )
+{
+    LONG serial = ReadAcquire( &compositor_serial );
+    BOOL composited;
+
+    if (!surface->is_argb || surface->compositor_serial == serial) return;
+    surface->compositor_serial = serial;
+    composited = is_compositor_running();
+    if (composited == surface->composited) return;
+    surface->composited = composited;
+    update_surface_region( surface, NULL, 0 );
+}
+
+/***********************************************************************
+ *           add_surface_damage
+ *
+ * Add a rectangle to the damaged area, merging it with one of the existing
+ * rectangles if that doesn't make us upload more pixels than needed, or if
+ * we run out of rectangles.
+ */
+static void add_surface_damage( struct x11drv_window_surface *surface, const RECT *rect )
+{
+    LONGLONG cost, best_cost = 0;
+    int i, best = -1;
+    RECT *damage, tmp;
+
+    if (rect->left >= rect->right || rect->top >= rect->bottom) return;
+    add_bounds_rect( &surface->bounds, rect );
+
+    for (i = 0; i < surface->damage_count; i++)
+    {
+        damage = &surface->damage[i];
+        tmp.left   = min( damage->left, rect->left );
+        tmp.top    = min( damage->top, rect->top );
+        tmp.right  = max( damage->right, rect->right );
+        tmp.bottom = max( damage->bottom, rect->bottom );
+        cost = (LONGLONG)(tmp.right - tmp.left) * (tmp.bottom - tmp.top)
+             - (LONGLONG)(damage->right - damage->left) * (damage->bottom - damage->top)
+             - (LONGLONG)(rect->right - rect->left) * (rect->bottom - rect->top);
+        if (cost <= 0)
+        {
+            *damage = tmp;
+            return;
+        }
+        if (best == -1 || cost < best_cost)
+        {
+            best = i;
+            best_cost = cost;
+        }
+    }
+
+    if (surface->damage_count < MAX_DAMAGE_RECTS)
+        surface->damage[surface->damage_count++] = *rect;
+    else
+        add_bounds_rect( &surface->damage[best], rect );
+}
+
 /***********************************************************************
  *           set_color_key
  */
@@ -1824,8 +2096,46 @@ failed:
     XDestroyImage( image );
     return NULL;
 }
+
+static Bool is_shm_completion( Display *display, XEvent *event, XPointer arg )
+{
+    struct x11drv_window_surface *surface = (struct x11drv_window_surface *)arg;
+
+    return event->type == XShmGetEventBase( display ) + ShmCompletion &&
+           ((XShmCompletionEvent *)event)->shmseg == surface->shminfo.shmseg;
+}
+
+/* wait until the server is done reading the shared memory, before the image data is overwritten */
+static void wait_shm_completion( struct x11drv_window_surface *surface )
+{
+    BOOL synced = FALSE;
+    XEvent event;
+
+    while (surface->shm_serial)
+    {
+        if (XCheckIfEvent( gdi_display, &event, is_shm_completion, (char *)surface ))
+        {
+            if ((long)(event.xany.serial - surface->shm_serial) >= 0) surface->shm_serial = 0;
+        }
+        else if (!synced)
+        {
+            /* all the completion events are queued after a round trip */
+            XSync( gdi_display, False );
+            synced = TRUE;
+        }
+        else surface->shm_serial = 0;  /* the upload failed, no event is coming */
+    }
+}
 #endif /* HAVE_LIBXXSHM */
 
+static ULONGLONG get_thread_cpu_time(void)
+{
+    struct timespec ts;
+
+    clock_gettime( CLOCK_THREAD_CPUTIME_ID, &ts );
+    return ts.tv_sec * (ULONGLONG)1000000 + ts.tv_nsec / 1000;
+}
+
 /***********************************************************************
  *           x11drv_surface_lock
  */
@@ -1834,6 +2144,10 @@ static void x11drv_surface_lock( struct window_surface *window_surface )
     struct x11drv_window_surface *surface = get_x11_surface( window_surface );
 
     pthread_mutex_lock( &surface->mutex );
+#ifdef HAVE_LIBXXSHM
+    /* the image data is about to change, make sure the previous flush has been read */
+    if (surface->bits == surface->image->data) wait_shm_completion( surface );
+#endif
 }
 
 /***********************************************************************
@@ -1867,6 +2181,16 @@ static RECT *x11drv_surface_get_bounds( struct window_surface *window_surface )
     return &surface->bounds;
 }
 
+/***********************************************************************
+ *           x11drv_surface_add_bounds
+ */
+static void x11drv_surface_add_bounds( struct window_surface *window_surface, const RECT *rect )
+{
+    struct x11drv_window_surface *surface = get_x11_surface( window_surface );
+
+    add_surface_damage( surface, rect );
+}
+
 /***********************************************************************
  *           x11drv_surface_set_region
  */
@@ -1898,70 +2222,126 @@ static void x11drv_surface_set_region( struct window_surface *window_surface, HR
     window_surface->funcs->unlock( window_surface );
 }
 
+/***********************************************************************
+ *           put_surface_rect
+ *
+ * Upload a rectangle of the surface to the window.
+ */
+static void put_surface_rect( struct x11drv_window_surface *surface, const RECT *rect )
+{
+    unsigned char *src = surface->bits;
+    unsigned char *dst = (unsigned char *)surface->image->data;
+    int width_bytes = surface->image->bytes_per_line;
+
+    if (src != dst)
+    {
+        int map[256], *mapping = get_window_surface_mapping( surface->image->bits_per_pixel, map );
+
+        src += rect->top * width_bytes;
+        dst += rect->top * width_bytes;
+        copy_image_byteswap( &surface->info, src, dst, width_bytes, width_bytes,
+                             rect->bottom - rect->top,
+                             surface->byteswap, mapping, ~0u, surface->alpha_bits );
+    }
+    else if (surface->alpha_bits)
+    {
+        int x, y, stride = width_bytes / sizeof(ULONG);
+        ULONG *ptr = (ULONG *)dst + rect->top * stride;
+
+        for (y = rect->top; y < rect->bottom; y++, ptr += stride)
+            for (x = rect->left; x < rect->right; x++)
+                ptr[x] |= surface->alpha_bits;
+    }
+
+#ifdef HAVE_LIBXXSHM
+    if (surface->shminfo.shmid != -1)
+    {
+        surface->shm_serial = NextRequest( gdi_display );
+        XShmPutImage( gdi_display, surface->window, surface->gc, surface->image,
+                      rect->left, rect->top,
+                      surface->header.rect.left + rect->left,
+                      surface->header.rect.top + rect->top,
+                      rect->right - rect->left, rect->bottom - rect->top, True );
+    }
+    else
+#endif
+    XPutImage( gdi_display, surface->window, surface->gc, surface->image,
+               rect->left, rect->top,
+               surface->header.rect.left + rect->left,
+               surface->header.rect.top + rect->top,
+               rect->right - rect->left, rect->bottom - rect->top );
+
+    surface->upload_bytes += (ULONGLONG)(rect->bottom - rect->top) * (rect->right - rect->left) *
+                             surface->image->bits_per_pixel / 8;
+}
+
 /***********************************************************************
  *           x11drv_surface_flush
  */
 static void x11drv_surface_flush( struct window_surface *window_surface )
 {
     struct x11drv_window_surface *surface = get_x11_surface( window_surface );
-    unsigned char *src = surface->bits;
-    unsigned char *dst = (unsigned char *)surface->image->data;
-    struct bitblt_coords coords;
+    RECT rects[MAX_DAMAGE_RECTS], surface_rect;
+    int i, count = 0;
+    ULONGLONG cpu_time = 0;
+    DWORD time;
 
     window_surface->funcs->lock( window_surface );
-    coords.x = 0;
-    coords.y = 0;
-    coords.width  = surface->header.rect.right - surface->header.rect.left;
-    coords.height = surface->header.rect.bottom - surface->header.rect.top;
-    SetRect( &coords.visrect, 0, 0, coords.width, coords.height );
-    if (intersect_rect( &coords.visrect, &coords.visrect, &surface->bounds ))
+    SetRect( &surface_rect, 0, 0, surface->header.rect.right - surface->header.rect.left,
+             surface->header.rect.bottom - surface->header.rect.top );
+
+    /* the bounds may have been set directly by the caller */
+    if (!surface->damage_count && !IsRectEmpty( &surface->bounds ))
     {
-        TRACE( "flushing %p %dx%d bounds %s bits %p\n",
-               surface, coords.width, coords.height,
-               wine_dbgstr_rect( &surface->bounds ), surface->bits );
+        surface->damage[0] = surface->bounds;
+        surface->damage_count = 1;
+    }
+    for (i = 0; i < surface->damage_count; i++)
+        if (intersect_rect( &rects[count], &surface->damage[i], &surface_rect )) count++;
 
-        if (surface->is_argb || surface->color_key != CLR_INVALID) update_surface_region( surface );
+    update_surface_compositor( surface );
 
-        if (src != dst)
-        {
-            int map[256], *mapping = get_window_surface_mapping( surface->image->bits_per_pixel, map );
-            int width_bytes = surface->image->bytes_per_line;
-
-            src += coords.visrect.top * width_bytes;
-            dst += coords.visrect.top * width_bytes;
-            copy_image_byteswap( &surface->info, src, dst, width_bytes, width_bytes,
-                                 coords.visrect.bottom - coords.visrect.top,
-                                 surface->byteswap, mapping, ~0u, surface->alpha_bits );
-        }
-        else if (surface->alpha_bits)
-        {
-            int x, y, stride = surface->image->bytes_per_line / sizeof(ULONG);
-            ULONG *ptr = (ULONG *)dst + coords.visrect.top * stride;
+    if (count)
+    {
+        TRACE( "flushing %p %dx%d bounds %s in %d rects bits %p\n",
+               surface, surface_rect.right, surface_rect.bottom,
+               wine_dbgstr_rect( &surface->bounds ), count, surface->bits );
 
-            for (y = coords.visrect.top; y < coords.visrect.bottom; y++, ptr += stride)
-                for (x = coords.visrect.left; x < coords.visrect.right; x++)
-                    ptr[x] |= surface->alpha_bits;
-        }
+        if (TRACE_ON(fps)) cpu_time = get_thread_cpu_time();
+
+        if (surface->is_argb || surface->color_key != CLR_INVALID)
+            update_surface_region( surface, rects, count );
 
 #ifdef HAVE_LIBXXSHM
-        if (surface->shminfo.shmid != -1)
-            XShmPutImage( gdi_display, surface->window, surface->gc, surface->image,
-                          coords.visrect.left, coords.visrect.top,
-                          surface->header.rect.left + coords.visrect.left,
-                          surface->header.rect.top + coords.visrect.top,
-                          coords.visrect.right - coords.visrect.left,
-                          coords.visrect.bottom - coords.visrect.top, False );
-        else
+        /* the previous flush may still be reading the image data */
+        wait_shm_completion( surface );
 #endif
-        XPutImage( gdi_display, surface->window, surface->gc, surface->image,
-                   coords.visrect.left, coords.visrect.top,
-                   surface->header.rect.left + coords.visrect.left,
-                   surface->header.rect.top + coords.visrect.top,
-                   coords.visrect.right - coords.visrect.left,
-                   coords.visrect.bottom - coords.visrect.top );
+        for (i = 0; i < count; i++) put_surface_rect( surface, &rects[i] );
         XFlush( gdi_display );
+
+        if (TRACE_ON(fps))
+        {
+            surface->upload_count++;
+            surface->upload_time += get_thread_cpu_time() - cpu_time;
+            time = NtGetTickCount();
+            if (!surface->upload_start) surface->upload_start = time;
+            else if (time - surface->upload_start > 1000)
+            {
+                surface->upload_total += surface->upload_bytes;
+                TRACE_(fps)( "window %lx: %u flushes, approx %u bytes/s, %u us cpu per flush, total %s bytes\n",
+                             surface->window, surface->upload_count,
+                             (UINT)(surface->upload_bytes * 1000 / (time - surface->upload_start)),
+                             (UINT)(surface->upload_time / surface->upload_count),
+                             wine_dbgstr_longlong( surface->upload_total ));
+                surface->upload_start = time;
+                surface->upload_bytes = 0;
+                surface->upload_count = 0;
+                surface->upload_time = 0;
+            }
+        }
     }
     reset_bounds( &surface->bounds );
+    surface->damage_count = 0;
     window_surface->funcs->unlock( window_surface );
 }
 
@@ -1980,6 +2360,7 @@ static void x11drv_surface_destroy( struct window_surface *window_surface )
 #ifdef HAVE_LIBXXSHM
         if (surface->shminfo.shmid != -1)
         {
+            wait_shm_completion( surface );
             XShmDetach( gdi_display, &surface->shminfo );
             shmdt( surface->shminfo.shmaddr );
         }
@@ -1990,6 +2371,9 @@ static void x11drv_surface_destroy( struct window_surface *window_surface )
         XDestroyImage( surface->image );
     }
     if (surface->region) NtGdiDeleteObjectApp( surface->region );
+#ifdef HAVE_LIBXSHAPE
+    free_surface_shape( surface );
+#endif
     free( surface );
 }
 
@@ -1999,6 +2383,7 @@ static const struct window_surface_funcs x11drv_surface_funcs =
     x11drv_surface_unlock,
     x11drv_surface_get_bitmap_info,
     x11drv_surface_get_bounds,
+    x11drv_surface_add_bounds,
     x11drv_surface_set_region,
     x11drv_surface_flush,
     x11drv_surface_destroy
@@ -2034,6 +2419,11 @@ struct window_surface *create_surface( Window window, const XVisualInfo *vis, co
     surface->is_argb = (use_alpha && vis->depth == 32 && surface->info.bmiHeader.biCompression == BI_RGB);
     set_color_key( surface, color_key );
     reset_bounds( &surface->bounds );
+    if (surface->is_argb)
+    {
+        surface->compositor_serial = ReadAcquire( &compositor_serial );
+        surface->composited = is_compositor_running();
+    }
 
 #ifdef HAVE_LIBXXSHM
     surface->image = create_shm_image( vis, width, height, &surface->shminfo );
@@ -2086,7 +2476,7 @@ void set_surface_color_key( struct window_surface *window_surface, COLORREF colo
     window_surface->funcs->lock( window_surface );
     prev = surface->color_key;
     set_color_key( surface, color_key );
-    if (surface->color_key != prev) update_surface_region( surface );
+    if (surface->color_key != prev) update_surface_region( surface, NULL, 0 );
     window_surface->funcs->unlock( window_surface );
 }
 
@@ -2103,7 +2493,7 @@ HRGN expose_surface( struct window_surface *window_surface, const RECT *rect )
 
     window_surface->funcs->lock( window_surface );
     OffsetRect( &rc, -window_surface->rect.left, -window_surface->rect.top );
-    add_bounds_rect( &surface->bounds, &rc );
+    add_surface_damage( surface, &rc );
     if (surface->region)
     {
         region = NtGdiCreateRectRgn( rect->left, rect->top, rect->right, rect->bottom );
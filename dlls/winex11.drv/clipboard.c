@@ -200,6 +200,9 @@ static ULONG last_clipboard_update;
 static struct clipboard_format **current_x11_formats;
 static unsigned int nb_current_x11_formats;
 static BOOL use_xfixes;
+#ifdef SONAME_LIBXFIXES
+static typeof(XFixesSelectSelectionInput) *pXFixesSelectSelectionInput;
+#endif
 
 Display *clipboard_display = NULL;
 
@@ -2148,13 +2151,14 @@ BOOL update_clipboard( HWND hwnd )
 /**************************************************************************
  *              selection_notify_event
  *
- * Called when x11 clipboard content changes
+ * Called when x11 clipboard content changes, or when the compositing manager changes
  */
 #ifdef SONAME_LIBXFIXES
 static BOOL selection_notify_event( HWND hwnd, XEvent *event )
 {
     XFixesSelectionNotifyEvent *req = (XFixesSelectionNotifyEvent*)event;
 
+    if (compositor_selection_notify( req->selection )) return FALSE;
     if (!is_clipboard_owner) return FALSE;
     if (req->owner == selection_window) return FALSE;
     request_selection_contents( req->display, TRUE );
@@ -2163,14 +2167,13 @@ static BOOL selection_notify_event( HWND hwnd, XEvent *event )
 #endif
 
 /**************************************************************************
- *		xfixes_init
+ *		X11DRV_XFixes_Init
  *
- * Initialize xfixes to receive clipboard update notifications
+ * Load xfixes to receive selection owner notifications
  */
-static void xfixes_init(void)
+void X11DRV_XFixes_Init(void)
 {
 #ifdef SONAME_LIBXFIXES
-    typeof(XFixesSelectSelectionInput) *pXFixesSelectSelectionInput;
     typeof(XFixesQueryExtension) *pXFixesQueryExtension;
     typeof(XFixesQueryVersion) *pXFixesQueryVersion;
 
@@ -2188,23 +2191,12 @@ static void xfixes_init(void)
     pXFixesSelectSelectionInput = dlsym(handle, "XFixesSelectSelectionInput");
     if (!pXFixesSelectSelectionInput) return;
 
-    if (!pXFixesQueryExtension(clipboard_display, &event_base, &error_base))
+    if (!pXFixesQueryExtension(gdi_display, &event_base, &error_base))
         return;
-    pXFixesQueryVersion(clipboard_display, &major, &minor);
+    pXFixesQueryVersion(gdi_display, &major, &minor);
     use_xfixes = (major >= 1);
     if (!use_xfixes) return;
 
-    pXFixesSelectSelectionInput(clipboard_display, import_window, x11drv_atom(CLIPBOARD),
-            XFixesSetSelectionOwnerNotifyMask |
-            XFixesSelectionWindowDestroyNotifyMask |
-            XFixesSelectionClientCloseNotifyMask);
-    if (use_primary_selection)
-    {
-        pXFixesSelectSelectionInput(clipboard_display, import_window, XA_PRIMARY,
-                XFixesSetSelectionOwnerNotifyMask |
-                XFixesSelectionWindowDestroyNotifyMask |
-                XFixesSelectionClientCloseNotifyMask);
-    }
     X11DRV_register_event_handler(event_base + XFixesSelectionNotify,
             selection_notify_event, "XFixesSelectionNotify");
     TRACE("xfixes succesully initialized\n");
@@ -2213,6 +2205,38 @@ static void xfixes_init(void)
 #endif
 }
 
+/**************************************************************************
+ *		xfixes_select_selection
+ *
+ * Request owner change notifications for a selection, if xfixes is available.
+ */
+BOOL xfixes_select_selection( Display *display, Window window, Atom selection )
+{
+#ifdef SONAME_LIBXFIXES
+    if (!use_xfixes) return FALSE;
+    pXFixesSelectSelectionInput(display, window, selection,
+            XFixesSetSelectionOwnerNotifyMask |
+            XFixesSelectionWindowDestroyNotifyMask |
+            XFixesSelectionClientCloseNotifyMask);
+    return TRUE;
+#else
+    return FALSE;
+#endif
+}
+
+/**************************************************************************
+ *		xfixes_init
+ *
+ * Initialize xfixes to receive clipboard update notifications
+ */
+static void xfixes_init(void)
+{
+    if (!xfixes_select_selection( clipboard_display, import_window, x11drv_atom(CLIPBOARD) ))
+        return;
+    if (use_primary_selection)
+        xfixes_select_selection( clipboard_display, import_window, XA_PRIMARY );
+}
+
 
 /**************************************************************************
  *		clipboard_init
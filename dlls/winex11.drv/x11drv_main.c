@@ -705,6 +705,7 @@ static NTSTATUS x11drv_init( void *arg )
     X11DRV_XComposite_Init();
 #endif
     X11DRV_XInput2_Init();
+    X11DRV_XFixes_Init();
 
 #ifdef HAVE_XKB
     if (use_xkb) use_xkb = XkbUseExtension( gdi_display, NULL, NULL );
@@ -798,6 +799,7 @@ struct x11drv_thread_data *x11drv_init_thread_data(void)
     NtUserGetThreadInfo()->driver_data = (UINT_PTR)data;
 
     if (use_xim) X11DRV_SetupXIM();
+    init_compositor_notify( data->display );
 
     return data;
 }
@@ -12386,6 +12386,208 @@ static void test_simultaneous_async_recv(void)
     for (i = 0; i < num_io; i++) CloseHandle(events[i]);
 }
 
+static void post_iocp_send(SOCKET s, char *buffer, DWORD len, OVERLAPPED *ovl)
+{
+    WSABUF wsabuf;
+    int ret;
+
+    wsabuf.buf = buffer;
+    wsabuf.len = len;
+    ret = WSASend(s, &wsabuf, 1, NULL, 0, ovl, NULL);
+    ok(!ret || WSAGetLastError() == ERROR_IO_PENDING, "got error %u\n", WSAGetLastError());
+}
+
+static int post_iocp_recv(SOCKET s, char *buffer, DWORD len, OVERLAPPED *ovl)
+{
+    DWORD flags = 0;
+    WSABUF wsabuf;
+
+    wsabuf.buf = buffer;
+    wsabuf.len = len;
+    return WSARecv(s, &wsabuf, 1, NULL, &flags, ovl, NULL);
+}
+
+static void test_iocp_loopback(void)
+{
+    static const unsigned int total = 4 * 1024 * 1024, chunk = 64 * 1024, round_trips = 100;
+    OVERLAPPED client_send = {0}, client_recv = {0}, server_send = {0}, server_recv = {0}, *ovl;
+    unsigned int sent = 0, received = 0, count, i;
+    char *send_buf, *recv_buf, ping = 'x', pong = 0, echo = 0;
+    SOCKET client, server;
+    BOOL mismatch = FALSE;
+    ULONG_PTR key;
+    HANDLE port;
+    DWORD size;
+    BOOL ret;
+    int iret;
+
+    tcp_socketpair(&client, &server);
+    port = CreateIoCompletionPort((HANDLE)client, NULL, 1, 0);
+    ok(port != NULL, "got error %lu\n", GetLastError());
+    ok(CreateIoCompletionPort((HANDLE)server, port, 2, 0) == port, "got error %lu\n", GetLastError());
+
+    send_buf = malloc(chunk);
+    recv_buf = malloc(chunk);
+    for (i = 0; i < chunk; i++) send_buf[i] = i * 7;
+
+    post_iocp_send(client, send_buf, chunk, &client_send);
+    iret = post_iocp_recv(server, recv_buf, chunk, &server_recv);
+    ok(!iret || WSAGetLastError() == ERROR_IO_PENDING, "got error %u\n", WSAGetLastError());
+    while (sent < total || received < total)
+    {
+        ret = GetQueuedCompletionStatus(port, &size, &key, &ovl, 5000);
+        ok(ret, "got error %lu\n", GetLastError());
+        if (!ret) break;
+
+        if (ovl == &client_send)
+        {
+            ok(key == 1, "got key %Iu\n", key);
+            ok(size == chunk, "got size %lu\n", size);
+            if ((sent += size) < total) post_iocp_send(client, send_buf, chunk, &client_send);
+        }
+        else
+        {
+            ok(ovl == &server_recv, "got overlapped %p\n", ovl);
+            ok(key == 2, "got key %Iu\n", key);
+            ok(size, "connection closed after %u bytes\n", received);
+            if (!size) break;
+            for (i = 0; i < size && !mismatch; i++)
+                mismatch = recv_buf[i] != (char)(((received + i) % chunk) * 7);
+            ok(!mismatch, "data mismatch after %u bytes\n", received);
+            if ((received += size) < total)
+            {
+                iret = post_iocp_recv(server, recv_buf, chunk, &server_recv);
+                ok(!iret || WSAGetLastError() == ERROR_IO_PENDING, "got error %u\n", WSAGetLastError());
+            }
+        }
+    }
+
+    for (count = 0; count < round_trips; count++)
+    {
+        /* wait for both receives and both sends, so that the buffers can be reused */
+        unsigned int pending = 4;
+
+        iret = post_iocp_recv(client, &pong, 1, &client_recv);
+        ok(iret == SOCKET_ERROR && WSAGetLastError() == ERROR_IO_PENDING, "got %d, error %u\n", iret, WSAGetLastError());
+        iret = post_iocp_recv(server, &echo, 1, &server_recv);
+        ok(iret == SOCKET_ERROR && WSAGetLastError() == ERROR_IO_PENDING, "got %d, error %u\n", iret, WSAGetLastError());
+        post_iocp_send(client, &ping, 1, &client_send);
+        while (pending)
+        {
+            ret = GetQueuedCompletionStatus(port, &size, &key, &ovl, 5000);
+            ok(ret, "got error %lu\n", GetLastError());
+            if (!ret) break;
+
+            ok(size == 1, "got size %lu\n", size);
+            if (ovl == &server_recv) post_iocp_send(server, &echo, 1, &server_send);
+            pending--;
+        }
+        if (!ret) break;
+        ok(pong == ping, "got byte %#x\n", pong);
+    }
+
+    closesocket(client);
+    closesocket(server);
+    CloseHandle(port);
+    free(send_buf);
+    free(recv_buf);
+}
+
+static void test_iocp_pending_io(void)
+{
+    OVERLAPPED ovl = {0}, *ovl_iocp;
+    SOCKET client, server;
+    char buffer[16];
+    ULONG_PTR key;
+    HANDLE port;
+    DWORD size;
+    BOOL ret;
+    int iret;
+
+    tcp_socketpair(&client, &server);
+    port = CreateIoCompletionPort((HANDLE)client, NULL, 125, 0);
+    ok(port != NULL, "got error %lu\n", GetLastError());
+
+    /* completion signaling the event */
+    ovl.hEvent = CreateEventW(NULL, TRUE, TRUE, NULL);
+    iret = post_iocp_recv(client, buffer, sizeof(buffer), &ovl);
+    ok(iret == SOCKET_ERROR && WSAGetLastError() == ERROR_IO_PENDING, "got %d, error %u\n", iret, WSAGetLastError());
+    ok(WaitForSingleObject(ovl.hEvent, 0) == WAIT_TIMEOUT, "event is signaled\n");
+    iret = send(server, "data", 4, 0);
+    ok(iret == 4, "got %d\n", iret);
+    ok(!WaitForSingleObject(ovl.hEvent, 1000), "event is not signaled\n");
+    ret = GetQueuedCompletionStatus(port, &size, &key, &ovl_iocp, 1000);
+    ok(ret, "got error %lu\n", GetLastError());
+    ok(key == 125, "got key %Iu\n", key);
+    ok(size == 4, "got size %lu\n", size);
+    ok(ovl_iocp == &ovl, "got overlapped %p\n", ovl_iocp);
+    ok(!memcmp(buffer, "data", 4), "got data %s\n", debugstr_an(buffer, size));
+
+    /* the completion is still posted if the event is closed while the I/O is pending */
+    iret = post_iocp_recv(client, buffer, sizeof(buffer), &ovl);
+    ok(iret == SOCKET_ERROR && WSAGetLastError() == ERROR_IO_PENDING, "got %d, error %u\n", iret, WSAGetLastError());
+    CloseHandle(ovl.hEvent);
+    ovl.hEvent = NULL;
+    iret = send(server, "more", 4, 0);
+    ok(iret == 4, "got %d\n", iret);
+    ret = GetQueuedCompletionStatus(port, &size, &key, &ovl_iocp, 1000);
+    ok(ret, "got error %lu\n", GetLastError());
+    ok(size == 4, "got size %lu\n", size);
+    ok(ovl_iocp == &ovl, "got overlapped %p\n", ovl_iocp);
+    ok(!memcmp(buffer, "more", 4), "got data %s\n", debugstr_an(buffer, size));
+
+    /* cancelling the pending I/O */
+    iret = post_iocp_recv(client, buffer, sizeof(buffer), &ovl);
+    ok(iret == SOCKET_ERROR && WSAGetLastError() == ERROR_IO_PENDING, "got %d, error %u\n", iret, WSAGetLastError());
+    ret = CancelIoEx((HANDLE)client, &ovl);
+    ok(ret, "got error %lu\n", GetLastError());
+    ret = GetQueuedCompletionStatus(port, &size, &key, &ovl_iocp, 1000);
+    ok(!ret, "expected failure\n");
+    ok(GetLastError() == ERROR_OPERATION_ABORTED, "got error %lu\n", GetLastError());
+    ok(ovl_iocp == &ovl, "got overlapped %p\n", ovl_iocp);
+    ok(ovl.Internal == STATUS_CANCELLED, "got status %#Ix\n", ovl.Internal);
+    ret = CancelIoEx((HANDLE)client, &ovl);
+    ok(!ret && GetLastError() == ERROR_NOT_FOUND, "got %d, error %lu\n", ret, GetLastError());
+
+    /* skipping the completion when the I/O succeeds right away */
+    ret = SetFileCompletionNotificationModes((HANDLE)client, FILE_SKIP_COMPLETION_PORT_ON_SUCCESS);
+    ok(ret, "got error %lu\n", GetLastError());
+    iret = send(server, "sync", 4, 0);
+    ok(iret == 4, "got %d\n", iret);
+    Sleep(100);
+    iret = post_iocp_recv(client, buffer, sizeof(buffer), &ovl);
+    ok(!iret, "got %d, error %u\n", iret, WSAGetLastError());
+    ok(ovl.Internal == STATUS_SUCCESS, "got status %#Ix\n", ovl.Internal);
+    ok(ovl.InternalHigh == 4, "got size %Iu\n", ovl.InternalHigh);
+    ret = GetQueuedCompletionStatus(port, &size, &key, &ovl_iocp, 100);
+    ok(!ret && GetLastError() == WAIT_TIMEOUT, "got %d, error %lu\n", ret, GetLastError());
+
+    /* but not when it's pending */
+    iret = post_iocp_recv(client, buffer, sizeof(buffer), &ovl);
+    ok(iret == SOCKET_ERROR && WSAGetLastError() == ERROR_IO_PENDING, "got %d, error %u\n", iret, WSAGetLastError());
+    iret = send(server, "late", 4, 0);
+    ok(iret == 4, "got %d\n", iret);
+    ret = GetQueuedCompletionStatus(port, &size, &key, &ovl_iocp, 1000);
+    ok(ret, "got error %lu\n", GetLastError());
+    ok(size == 4, "got size %lu\n", size);
+    ok(ovl_iocp == &ovl, "got overlapped %p\n", ovl_iocp);
+
+    /* closing the socket while the I/O is pending */
+    iret = post_iocp_recv(client, buffer, sizeof(buffer), &ovl);
+    ok(iret == SOCKET_ERROR && WSAGetLastError() == ERROR_IO_PENDING, "got %d, error %u\n", iret, WSAGetLastError());
+    closesocket(client);
+    ret = GetQueuedCompletionStatus(port, &size, &key, &ovl_iocp, 1000);
+    ok(!ret, "expected failure\n");
+    ok(GetLastError() == ERROR_OPERATION_ABORTED, "got error %lu\n", GetLastError());
+    ok(key == 125, "got key %Iu\n", key);
+    ok(!size, "got size %lu\n", size);
+    ok(ovl_iocp == &ovl, "got overlapped %p\n", ovl_iocp);
+    ok(ovl.Internal == STATUS_CANCELLED, "got status %#Ix\n", ovl.Internal);
+
+    closesocket(server);
+    CloseHandle(port);
+}
+
 static void test_empty_recv(void)
 {
     OVERLAPPED overlapped = {0};
@@ -13324,6 +13526,8 @@ START_TEST( sock )
     test_WSAGetOverlappedResult();
     test_nonblocking_async_recv();
     test_simultaneous_async_recv();
+    test_iocp_loopback();
+    test_iocp_pending_io();
     test_empty_recv();
     test_timeout();
     test_tcp_reset();
@@ -168,7 +168,7 @@ struct gdi_dc_funcs
 };
 
 /* increment this when you change the DC function table */
-#define WINE_GDI_DRIVER_VERSION 81
+#define WINE_GDI_DRIVER_VERSION 82
 
 #define GDI_PRIORITY_NULL_DRV        0  /* null driver */
 #define GDI_PRIORITY_FONT_DRV      100  /* any font driver */
@@ -206,6 +206,7 @@ struct window_surface_funcs
     void  (*unlock)( struct window_surface *surface );
     void* (*get_info)( struct window_surface *surface, BITMAPINFO *info );
     RECT* (*get_bounds)( struct window_surface *surface );
+    void  (*add_bounds)( struct window_surface *surface, const RECT *rect );
     void  (*set_region)( struct window_surface *surface, HRGN region );
     void  (*flush)( struct window_surface *surface );
     void  (*destroy)( struct window_surface *surface );
@@ -439,6 +439,14 @@ struct object_type_info
 
 };
 
+
+struct client_io_result
+{
+    unsigned int  id;
+    unsigned int  status;
+    apc_param_t   information;
+};
+
 enum select_op
 {
     SELECT_NONE,
@@ -831,6 +839,48 @@ typedef struct
     lparam_t info;
 } cursor_pos_t;
 
+typedef struct
+{
+    apc_param_t   ckey;
+    apc_param_t   cvalue;
+    apc_param_t   information;
+    unsigned int  status;
+    int           __pad;
+} completion_msg_t;
+
+
+typedef volatile struct
+{
+    unsigned int   type;
+    unsigned int   data;
+    unsigned int   state;
+    unsigned int   __pad;
+} fast_sync_t;
+
+#define FAST_SYNC_NONE      0
+#define FAST_SYNC_EVENT     1
+#define FAST_SYNC_MUTEX     2
+#define FAST_SYNC_SEMAPHORE 3
+
+
+typedef struct
+{
+    unsigned int   seq;
+    user_handle_t  handle;
+    process_id_t   pid;
+    thread_id_t    tid;
+    user_handle_t  parent;
+    user_handle_t  owner;
+    unsigned int   style;
+    unsigned int   ex_style;
+    unsigned int   is_unicode;
+    unsigned int   dpi;
+    int            awareness;
+    int            __pad;
+    rectangle_t    window_rect;
+    rectangle_t    client_rect;
+} window_shm_t;
+
 
 
 
@@ -1232,6 +1282,21 @@ struct close_handle_reply
 
 
 
+struct close_handles_request
+{
+    struct request_header __header;
+    /* VARARG(handles,uints); */
+    char __pad_12[4];
+};
+struct close_handles_reply
+{
+    struct reply_header __header;
+    unsigned int closed;
+    char __pad_12[4];
+};
+
+
+
 struct set_handle_info_request
 {
     struct request_header __header;
@@ -1363,7 +1428,9 @@ struct create_event_reply
 {
     struct reply_header __header;
     obj_handle_t handle;
-    char __pad_12[4];
+    unsigned int access;
+    unsigned int fast_sync;
+    char __pad_20[4];
 };
 
 
@@ -1407,7 +1474,9 @@ struct open_event_reply
 {
     struct reply_header __header;
     obj_handle_t handle;
-    char __pad_12[4];
+    unsigned int access;
+    unsigned int fast_sync;
+    char __pad_20[4];
 };
 
 
@@ -1455,7 +1524,9 @@ struct create_mutex_reply
 {
     struct reply_header __header;
     obj_handle_t handle;
-    char __pad_12[4];
+    unsigned int access;
+    unsigned int fast_sync;
+    char __pad_20[4];
 };
 
 
@@ -1486,7 +1557,9 @@ struct open_mutex_reply
 {
     struct reply_header __header;
     obj_handle_t handle;
-    char __pad_12[4];
+    unsigned int access;
+    unsigned int fast_sync;
+    char __pad_20[4];
 };
 
 
@@ -1519,7 +1592,9 @@ struct create_semaphore_reply
 {
     struct reply_header __header;
     obj_handle_t handle;
-    char __pad_12[4];
+    unsigned int access;
+    unsigned int fast_sync;
+    char __pad_20[4];
 };
 
 
@@ -1563,8 +1638,23 @@ struct open_semaphore_reply
 {
     struct reply_header __header;
     obj_handle_t handle;
+    unsigned int access;
+    unsigned int fast_sync;
+    char __pad_20[4];
+};
+
+
+
+struct get_fast_sync_area_request
+{
+    struct request_header __header;
     char __pad_12[4];
 };
+struct get_fast_sync_area_reply
+{
+    struct reply_header __header;
+    mem_size_t   size;
+};
 
 
 
@@ -1765,7 +1855,7 @@ struct recv_socket_request
     int          oob;
     async_data_t async;
     int          force_async;
-    char __pad_60[4];
+    int          direct;
 };
 struct recv_socket_reply
 {
@@ -1773,7 +1863,9 @@ struct recv_socket_reply
     obj_handle_t wait;
     unsigned int options;
     int          nonblocking;
-    char __pad_20[4];
+    int          direct;
+    unsigned int comp_flags;
+    char __pad_28[4];
 };
 
 
@@ -1784,7 +1876,7 @@ struct send_socket_request
     char __pad_12[4];
     async_data_t async;
     int          force_async;
-    char __pad_60[4];
+    int          direct;
 };
 struct send_socket_reply
 {
@@ -1792,7 +1884,9 @@ struct send_socket_reply
     obj_handle_t wait;
     unsigned int options;
     int          nonblocking;
-    char __pad_20[4];
+    int          direct;
+    unsigned int comp_flags;
+    char __pad_28[4];
 };
 
 
@@ -3169,6 +3263,20 @@ struct get_window_info_reply
 
 
 
+struct get_window_shm_area_request
+{
+    struct request_header __header;
+    char __pad_12[4];
+};
+struct get_window_shm_area_reply
+{
+    struct reply_header __header;
+    obj_handle_t   handle;
+    unsigned int   count;
+};
+
+
+
 struct set_window_info_request
 {
     struct request_header __header;
@@ -5081,6 +5189,19 @@ struct remove_completion_reply
 
 
 
+struct remove_completions_request
+{
+    struct request_header __header;
+    obj_handle_t  handle;
+};
+struct remove_completions_reply
+{
+    struct reply_header __header;
+    /* VARARG(msgs,completion_msgs); */
+};
+
+
+
 struct query_completion_request
 {
     struct request_header __header;
@@ -5126,6 +5247,38 @@ struct add_fd_completion_reply
 
 
 
+struct complete_fd_io_request
+{
+    struct request_header __header;
+    obj_handle_t   handle;
+    obj_handle_t   event;
+    char __pad_20[4];
+    apc_param_t    cvalue;
+    apc_param_t    information;
+    unsigned int   status;
+    char __pad_44[4];
+};
+struct complete_fd_io_reply
+{
+    struct reply_header __header;
+    unsigned int   id;
+    char __pad_12[4];
+};
+
+
+
+struct set_client_io_pipe_request
+{
+    struct request_header __header;
+    int            fd;
+};
+struct set_client_io_pipe_reply
+{
+    struct reply_header __header;
+};
+
+
+
 struct set_fd_completion_mode_request
 {
     struct request_header __header;
@@ -5499,6 +5652,7 @@ enum request
     REQ_queue_apc,
     REQ_get_apc_result,
     REQ_close_handle,
+    REQ_close_handles,
     REQ_set_handle_info,
     REQ_dup_handle,
     REQ_compare_objects,
@@ -5520,6 +5674,7 @@ enum request
     REQ_release_semaphore,
     REQ_query_semaphore,
     REQ_open_semaphore,
+    REQ_get_fast_sync_area,
     REQ_create_file,
     REQ_open_file_object,
     REQ_alloc_file_handle,
@@ -5615,6 +5770,7 @@ enum request
     REQ_get_desktop_window,
     REQ_set_window_owner,
     REQ_get_window_info,
+    REQ_get_window_shm_area,
     REQ_set_window_info,
     REQ_set_parent,
     REQ_get_window_parents,
@@ -5728,9 +5884,12 @@ enum request
     REQ_open_completion,
     REQ_add_completion,
     REQ_remove_completion,
+    REQ_remove_completions,
     REQ_query_completion,
     REQ_set_completion_info,
     REQ_add_fd_completion,
+    REQ_complete_fd_io,
+    REQ_set_client_io_pipe,
     REQ_set_fd_completion_mode,
     REQ_set_fd_disp_info,
     REQ_set_fd_name_info,
@@ -5783,6 +5942,7 @@ union generic_request
     struct queue_apc_request queue_apc_request;
     struct get_apc_result_request get_apc_result_request;
     struct close_handle_request close_handle_request;
+    struct close_handles_request close_handles_request;
     struct set_handle_info_request set_handle_info_request;
     struct dup_handle_request dup_handle_request;
     struct compare_objects_request compare_objects_request;
@@ -5804,6 +5964,7 @@ union generic_request
     struct release_semaphore_request release_semaphore_request;
     struct query_semaphore_request query_semaphore_request;
     struct open_semaphore_request open_semaphore_request;
+    struct get_fast_sync_area_request get_fast_sync_area_request;
     struct create_file_request create_file_request;
     struct open_file_object_request open_file_object_request;
     struct alloc_file_handle_request alloc_file_handle_request;
@@ -5899,6 +6060,7 @@ union generic_request
     struct get_desktop_window_request get_desktop_window_request;
     struct set_window_owner_request set_window_owner_request;
     struct get_window_info_request get_window_info_request;
+    struct get_window_shm_area_request get_window_shm_area_request;
     struct set_window_info_request set_window_info_request;
     struct set_parent_request set_parent_request;
     struct get_window_parents_request get_window_parents_request;
@@ -6012,9 +6174,12 @@ union generic_request
     struct open_completion_request open_completion_request;
     struct add_completion_request add_completion_request;
     struct remove_completion_request remove_completion_request;
+    struct remove_completions_request remove_completions_request;
     struct query_completion_request query_completion_request;
     struct set_completion_info_request set_completion_info_request;
     struct add_fd_completion_request add_fd_completion_request;
+    struct complete_fd_io_request complete_fd_io_request;
+    struct set_client_io_pipe_request set_client_io_pipe_request;
     struct set_fd_completion_mode_request set_fd_completion_mode_request;
     struct set_fd_disp_info_request set_fd_disp_info_request;
     struct set_fd_name_info_request set_fd_name_info_request;
@@ -6065,6 +6230,7 @@ union generic_reply
     struct queue_apc_reply queue_apc_reply;
     struct get_apc_result_reply get_apc_result_reply;
     struct close_handle_reply close_handle_reply;
+    struct close_handles_reply close_handles_reply;
     struct set_handle_info_reply set_handle_info_reply;
     struct dup_handle_reply dup_handle_reply;
     struct compare_objects_reply compare_objects_reply;
@@ -6086,6 +6252,7 @@ union generic_reply
     struct release_semaphore_reply release_semaphore_reply;
     struct query_semaphore_reply query_semaphore_reply;
     struct open_semaphore_reply open_semaphore_reply;
+    struct get_fast_sync_area_reply get_fast_sync_area_reply;
     struct create_file_reply create_file_reply;
     struct open_file_object_reply open_file_object_reply;
     struct alloc_file_handle_reply alloc_file_handle_reply;
@@ -6181,6 +6348,7 @@ union generic_reply
     struct get_desktop_window_reply get_desktop_window_reply;
     struct set_window_owner_reply set_window_owner_reply;
     struct get_window_info_reply get_window_info_reply;
+    struct get_window_shm_area_reply get_window_shm_area_reply;
     struct set_window_info_reply set_window_info_reply;
     struct set_parent_reply set_parent_reply;
     struct get_window_parents_reply get_window_parents_reply;
@@ -6294,9 +6462,12 @@ union generic_reply
     struct open_completion_reply open_completion_reply;
     struct add_completion_reply add_completion_reply;
     struct remove_completion_reply remove_completion_reply;
+    struct remove_completions_reply remove_completions_reply;
     struct query_completion_reply query_completion_reply;
     struct set_completion_info_reply set_completion_info_reply;
     struct add_fd_completion_reply add_fd_completion_reply;
+    struct complete_fd_io_reply complete_fd_io_reply;
+    struct set_client_io_pipe_reply set_client_io_pipe_reply;
     struct set_fd_completion_mode_reply set_fd_completion_mode_reply;
     struct set_fd_disp_info_reply set_fd_disp_info_reply;
     struct set_fd_name_info_reply set_fd_name_info_reply;
@@ -6324,7 +6495,7 @@ union generic_reply
 
 /* ### protocol_version begin ### */
 
-#define SERVER_PROTOCOL_VERSION 755
+#define SERVER_PROTOCOL_VERSION 764
 
 /* ### protocol_version end ### */
 
@@ -0,0 +1,277 @@
+/*
+ * Hierarchical timer wheel
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA
+ */
+
+#ifndef __WINE_WINE_TIMER_WHEEL_H
+#define __WINE_WINE_TIMER_WHEEL_H
+
+#include "wine/list.h"
+
+/*
+ * Entries are kept in TIMER_WHEEL_LEVELS levels of TIMER_WHEEL_SIZE slots.
+ * A slot of level n covers TIMER_WHEEL_SIZE^n ticks, and is indexed by the
+ * absolute expiration tick, so that adding and removing an entry is O(1).
+ * Entries of the upper levels move to the lower levels when their slot
+ * comes up; entries beyond the range of the wheel are kept in the last
+ * slot of the upper level until they come within range.
+ */
+
+#define TIMER_WHEEL_BITS    6
+#define TIMER_WHEEL_SIZE    (1 << TIMER_WHEEL_BITS)
+#define TIMER_WHEEL_MASK    (TIMER_WHEEL_SIZE - 1)
+#define TIMER_WHEEL_LEVELS  6
+#define TIMER_WHEEL_NEVER   (~0ull)
+
+#define TIMER_WHEEL_SLOT_NONE  0xffff  /* entry is not in the wheel */
+#define TIMER_WHEEL_SLOT_DUE   0xfffe  /* entry was already expired when added */
+
+struct timer_wheel_entry
+{
+    struct list        entry;
+    unsigned long long tick;  /* expiration tick */
+    unsigned short     slot;  /* level * TIMER_WHEEL_SIZE + index, or one of the TIMER_WHEEL_SLOT values */
+};
+
+struct timer_wheel
+{
+    unsigned long long now;         /* last processed tick */
+    unsigned long long next;        /* earliest expiration tick, valid if next_valid */
+    int                next_valid;
+    unsigned int       count;       /* number of entries in the wheel */
+    struct list        due;         /* entries already expired when added */
+    unsigned long long bitmap[TIMER_WHEEL_LEVELS];
+    struct list        slots[TIMER_WHEEL_LEVELS][TIMER_WHEEL_SIZE];
+};
+
+static inline unsigned int timer_wheel_ctz( unsigned long long mask )
+{
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_ctzll( mask );
+#else
+    unsigned int i = 0;
+    while (!(mask & 1)) { mask >>= 1; i++; }
+    return i;
+#endif
+}
+
+/* offset, between 1 and TIMER_WHEEL_SIZE, of the first used slot following index */
+static inline unsigned int timer_wheel_find( unsigned long long bitmap, unsigned int index )
+{
+    unsigned int start = (index + 1) & TIMER_WHEEL_MASK;
+    if (start) bitmap = (bitmap >> start) | (bitmap << (TIMER_WHEEL_SIZE - start));
+    return 1 + timer_wheel_ctz( bitmap );
+}
+
+static inline void timer_wheel_init( struct timer_wheel *wheel, unsigned long long now )
+{
+    unsigned int level, index;
+
+    wheel->now = now;
+    wheel->next = TIMER_WHEEL_NEVER;
+    wheel->next_valid = 1;
+    wheel->count = 0;
+    list_init( &wheel->due );
+    for (level = 0; level < TIMER_WHEEL_LEVELS; level++)
+    {
+        wheel->bitmap[level] = 0;
+        for (index = 0; index < TIMER_WHEEL_SIZE; index++)
+            list_init( &wheel->slots[level][index] );
+    }
+}
+
+static inline void timer_wheel_insert( struct timer_wheel *wheel, struct timer_wheel_entry *entry )
+{
+    unsigned int level, shift = 0, index;
+
+    if (entry->tick <= wheel->now)
+    {
+        entry->slot = TIMER_WHEEL_SLOT_DUE;
+        list_add_tail( &wheel->due, &entry->entry );
+        return;
+    }
+
+    for (level = 0; level < TIMER_WHEEL_LEVELS - 1; level++, shift += TIMER_WHEEL_BITS)
+        if ((entry->tick >> shift) - (wheel->now >> shift) < TIMER_WHEEL_SIZE) break;
+
+    if ((entry->tick >> shift) - (wheel->now >> shift) < TIMER_WHEEL_SIZE)
+        index = (entry->tick >> shift) & TIMER_WHEEL_MASK;
+    else
+        index = ((wheel->now >> shift) + TIMER_WHEEL_SIZE - 1) & TIMER_WHEEL_MASK;
+
+    entry->slot = level * TIMER_WHEEL_SIZE + index;
+    list_add_tail( &wheel->slots[level][index], &entry->entry );
+    wheel->bitmap[level] |= 1ull << index;
+}
+
+/* add an entry expiring at the specified tick */
+static inline void timer_wheel_add( struct timer_wheel *wheel, struct timer_wheel_entry *entry,
+                                    unsigned long long tick )
+{
+    entry->tick = tick;
+    timer_wheel_insert( wheel, entry );
+    wheel->count++;
+    if (wheel->next_valid && tick < wheel->next) wheel->next = tick;
+}
+
+/* remove an entry, either from the wheel or from the list it was expired to */
+static inline void timer_wheel_remove( struct timer_wheel *wheel, struct timer_wheel_entry *entry )
+{
+    unsigned int level, index;
+
+    list_remove( &entry->entry );
+    if (entry->slot == TIMER_WHEEL_SLOT_NONE) return;
+
+    if (entry->slot != TIMER_WHEEL_SLOT_DUE)
+    {
+        level = entry->slot / TIMER_WHEEL_SIZE;
+        index = entry->slot % TIMER_WHEEL_SIZE;
+        if (list_empty( &wheel->slots[level][index] )) wheel->bitmap[level] &= ~(1ull << index);
+    }
+    if (entry->tick == wheel->next) wheel->next_valid = 0;
+    entry->slot = TIMER_WHEEL_SLOT_NONE;
+    wheel->count--;
+}
+
+/* return the earliest expiration tick, or TIMER_WHEEL_NEVER if the wheel is empty */
+static inline unsigned long long timer_wheel_next( struct timer_wheel *wheel )
+{
+    struct timer_wheel_entry *entry;
+    unsigned int level, shift, index;
+    unsigned long long next = TIMER_WHEEL_NEVER;
+
+    if (wheel->next_valid) return wheel->next;
+
+    LIST_FOR_EACH_ENTRY( entry, &wheel->due, struct timer_wheel_entry, entry )
+        if (entry->tick < next) next = entry->tick;
+
+    /* only the first used slot of each level needs to be looked at, except for
+     * the upper level, where entries beyond the range of the wheel are kept */
+    for (level = 0, shift = 0; level < TIMER_WHEEL_LEVELS; level++, shift += TIMER_WHEEL_BITS)
+    {
+        unsigned long long bitmap = wheel->bitmap[level];
+
+        while (bitmap)
+        {
+            index = (wheel->now >> shift) & TIMER_WHEEL_MASK;
+            index = (index + timer_wheel_find( bitmap, index )) & TIMER_WHEEL_MASK;
+            LIST_FOR_EACH_ENTRY( entry, &wheel->slots[level][index], struct timer_wheel_entry, entry )
+            {
+                if (entry->tick < next) next = entry->tick;
+                if (!level) break;  /* all the entries of a first level slot expire together */
+            }
+            if (level < TIMER_WHEEL_LEVELS - 1) break;
+            bitmap &= ~(1ull << index);
+        }
+    }
+
+    wheel->next = next;
+    wheel->next_valid = 1;
+    return next;
+}
+
+/* move the wheel to an earlier tick, e.g. after a clock change, keeping all the entries */
+static inline void timer_wheel_rewind( struct timer_wheel *wheel, unsigned long long now )
+{
+    unsigned int level, index;
+    struct list entries, *ptr;
+
+    list_init( &entries );
+    list_move_tail( &entries, &wheel->due );
+    for (level = 0; level < TIMER_WHEEL_LEVELS; level++)
+    {
+        wheel->bitmap[level] = 0;
+        for (index = 0; index < TIMER_WHEEL_SIZE; index++)
+            list_move_tail( &entries, &wheel->slots[level][index] );
+    }
+
+    wheel->now = now;
+    while ((ptr = list_head( &entries )))
+    {
+        list_remove( ptr );
+        timer_wheel_insert( wheel, LIST_ENTRY( ptr, struct timer_wheel_entry, entry ) );
+    }
+}
+
+static inline void timer_wheel_move_expired( struct timer_wheel *wheel, struct list *src, struct list *expired )
+{
+    struct list *ptr;
+
+    while ((ptr = list_head( src )))
+    {
+        struct timer_wheel_entry *entry = LIST_ENTRY( ptr, struct timer_wheel_entry, entry );
+        list_remove( &entry->entry );
+        list_add_tail( expired, &entry->entry );
+        entry->slot = TIMER_WHEEL_SLOT_NONE;
+        wheel->count--;
+    }
+}
+
+/* advance the wheel to the specified tick, and move expired entries to a list */
+static inline void timer_wheel_expire( struct timer_wheel *wheel, unsigned long long now, struct list *expired )
+{
+    unsigned int level, shift, index;
+    unsigned long long tick, next;
+    struct list cascade, *ptr;
+
+    timer_wheel_move_expired( wheel, &wheel->due, expired );
+
+    while (wheel->count && wheel->now < now)
+    {
+        /* find the next tick where a slot has to be processed */
+        next = TIMER_WHEEL_NEVER;
+        for (level = 0, shift = 0; level < TIMER_WHEEL_LEVELS; level++, shift += TIMER_WHEEL_BITS)
+        {
+            if (!wheel->bitmap[level]) continue;
+            index = (wheel->now >> shift) & TIMER_WHEEL_MASK;
+            tick = ((wheel->now >> shift) + timer_wheel_find( wheel->bitmap[level], index )) << shift;
+            if (tick < next) next = tick;
+        }
+        if (next > now) break;
+        wheel->now = next;
+
+        /* move the entries of the upper levels down, starting with the highest one */
+        for (level = TIMER_WHEEL_LEVELS - 1; level > 0; level--)
+        {
+            shift = level * TIMER_WHEEL_BITS;
+            if (next & ((1ull << shift) - 1)) continue;
+            index = (next >> shift) & TIMER_WHEEL_MASK;
+            if (!(wheel->bitmap[level] & (1ull << index))) continue;
+
+            wheel->bitmap[level] &= ~(1ull << index);
+            list_init( &cascade );
+            list_move_tail( &cascade, &wheel->slots[level][index] );
+            while ((ptr = list_head( &cascade )))
+            {
+                list_remove( ptr );
+                timer_wheel_insert( wheel, LIST_ENTRY( ptr, struct timer_wheel_entry, entry ) );
+            }
+        }
+
+        index = next & TIMER_WHEEL_MASK;
+        if (wheel->bitmap[0] & (1ull << index))
+        {
+            wheel->bitmap[0] &= ~(1ull << index);
+            timer_wheel_move_expired( wheel, &wheel->slots[0][index], expired );
+        }
+        timer_wheel_move_expired( wheel, &wheel->due, expired );
+    }
+
+    if (wheel->now < now) wheel->now = now;
+    wheel->next_valid = 0;
+}
+
+#endif  /* __WINE_WINE_TIMER_WHEEL_H */
@@ -0,0 +1,371 @@
+/*
+ * Storage load generator, a subset of the DiskSpd options
+ *
+ * Copyright 2026 agent
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <windows.h>
+
+static ULONGLONG block_size = 64 * 1024;
+static ULONGLONG file_size;
+static unsigned int duration = 10;
+static unsigned int outstanding = 2;
+static unsigned int thread_count = 1;
+static unsigned int write_percent;
+static BOOL random_access;
+static const WCHAR *target;
+static LARGE_INTEGER freq;
+static volatile LONG stop;
+
+struct request
+{
+    OVERLAPPED    ovl;
+    LARGE_INTEGER start;
+    BOOL          write;
+    char         *buffer;
+};
+
+struct thread_stats
+{
+    HANDLE        thread;
+    unsigned int  index;
+    ULONGLONG     read_bytes;
+    ULONGLONG     write_bytes;
+    ULONGLONG     read_count;
+    ULONGLONG     write_count;
+    ULONGLONG     latency;      /* sum of the latencies, in counter ticks */
+    ULONGLONG     max_latency;
+    DWORD         error;
+};
+
+static void usage(void)
+{
+    printf( "Usage: diskspd [options] target\n\n"
+            "  -b<size>[K|M|G]   block size in bytes (default 64K)\n"
+            "  -c<size>[K|M|G]   create the target file with the given size\n"
+            "  -d<seconds>       duration of the test (default 10)\n"
+            "  -o<count>         outstanding I/O requests per thread (default 2)\n"
+            "  -t<count>         number of threads (default 1)\n"
+            "  -r                random instead of sequential access\n"
+            "  -w<percent>       percentage of writes (default 0)\n" );
+}
+
+static BOOL parse_size( const WCHAR *str, ULONGLONG *ret )
+{
+    WCHAR *end;
+    ULONGLONG size = wcstoull( str, &end, 10 );
+
+    switch (*end)
+    {
+    case 'g': case 'G': size <<= 10; /* fall through */
+    case 'm': case 'M': size <<= 10; /* fall through */
+    case 'k': case 'K': size <<= 10; end++; break;
+    case 'b': case 'B': end++; break;
+    }
+    if (*end || end == str) return FALSE;
+    *ret = size;
+    return TRUE;
+}
+
+static BOOL parse_number( const WCHAR *str, unsigned int *ret )
+{
+    WCHAR *end;
+    unsigned long value = wcstoul( str, &end, 10 );
+
+    if (*end || end == str) return FALSE;
+    *ret = value;
+    return TRUE;
+}
+
+static BOOL parse_options( int argc, WCHAR *argv[] )
+{
+    int i;
+
+    for (i = 1; i < argc; i++)
+    {
+        const WCHAR *arg = argv[i];
+        BOOL ret = TRUE;
+
+        if (arg[0] != '-' && arg[0] != '/')
+        {
+            if (target) return FALSE;
+            target = arg;
+            continue;
+        }
+
+        switch (arg[1])
+        {
+        case 'b': ret = parse_size( arg + 2, &block_size ) && block_size; break;
+        case 'c': ret = parse_size( arg + 2, &file_size ); break;
+        case 'd': ret = parse_number( arg + 2, &duration ); break;
+        case 'o': ret = parse_number( arg + 2, &outstanding ) && outstanding; break;
+        case 't': ret = parse_number( arg + 2, &thread_count ) && thread_count; break;
+        case 'r': ret = !arg[2]; random_access = TRUE; break;
+        case 'w': ret = parse_number( arg + 2, &write_percent ) && write_percent <= 100; break;
+        default: ret = FALSE; break;
+        }
+        if (!ret)
+        {
+            printf( "Invalid option %ls\n", arg );
+            return FALSE;
+        }
+    }
+    return target != NULL;
+}
+
+static BOOL create_target(void)
+{
+    LARGE_INTEGER size;
+    HANDLE file;
+    BOOL ret;
+
+    file = CreateFileW( target, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE,
+                        NULL, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL );
+    if (file == INVALID_HANDLE_VALUE)
+    {
+        printf( "Failed to create %ls: error %lu\n", target, GetLastError() );
+        return FALSE;
+    }
+    size.QuadPart = file_size;
+    ret = SetFilePointerEx( file, size, NULL, FILE_BEGIN ) && SetEndOfFile( file );
+    if (!ret) printf( "Failed to set the size of %ls: error %lu\n", target, GetLastError() );
+    CloseHandle( file );
+    return ret;
+}
+
+struct io_state
+{
+    ULONGLONG blocks;       /* number of blocks in the file */
+    ULONGLONG next;         /* next block for sequential access */
+    ULONGLONG seed;         /* random number generator state */
+};
+
+static ULONGLONG next_random( struct io_state *state )
+{
+    /* xorshift, seeded per thread */
+    state->seed ^= state->seed << 13;
+    state->seed ^= state->seed >> 7;
+    state->seed ^= state->seed << 17;
+    return state->seed;
+}
+
+static BOOL start_request( HANDLE file, struct request *req, struct io_state *state )
+{
+    ULONGLONG offset;
+    BOOL ret;
+
+    if (random_access) offset = next_random( state ) % state->blocks * block_size;
+    else offset = state->next++ % state->blocks * block_size;
+
+    req->ovl.Offset = offset;
+    req->ovl.OffsetHigh = offset >> 32;
+    req->write = write_percent && next_random( state ) % 100 < write_percent;
+    QueryPerformanceCounter( &req->start );
+
+    if (req->write) ret = WriteFile( file, req->buffer, block_size, NULL, &req->ovl );
+    else ret = ReadFile( file, req->buffer, block_size, NULL, &req->ovl );
+    return ret || GetLastError() == ERROR_IO_PENDING;
+}
+
+static DWORD WINAPI io_thread( void *arg )
+{
+    struct thread_stats *stats = arg;
+    struct request *reqs, *req;
+    OVERLAPPED_ENTRY entries[64];
+    struct io_state state;
+    LARGE_INTEGER now;
+    ULONG i, count, pending = 0;
+    HANDLE file, port;
+    ULONGLONG latency;
+    DWORD size;
+
+    file = CreateFileW( target, GENERIC_READ | (write_percent ? GENERIC_WRITE : 0),
+                        FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, OPEN_EXISTING, FILE_FLAG_OVERLAPPED, NULL );
+    if (file == INVALID_HANDLE_VALUE)
+    {
+        stats->error = GetLastError();
+        return 1;
+    }
+    if (!(port = CreateIoCompletionPort( file, NULL, 0, 1 )))
+    {
+        stats->error = GetLastError();
+        CloseHandle( file );
+        return 1;
+    }
+
+    reqs = calloc( outstanding, sizeof(*reqs) );
+    for (i = 0; i < outstanding; i++)
+        reqs[i].buffer = VirtualAlloc( NULL, block_size, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE );
+
+    /* spread the sequential streams of the threads over the file */
+    state.blocks = file_size / block_size;
+    state.next = state.blocks * stats->index / thread_count;
+    state.seed = 0x9e3779b97f4a7c15ull * (stats->index + 1);
+
+    for (i = 0; i < outstanding; i++)
+    {
+        if (!start_request( file, &reqs[i], &state ))
+        {
+            stats->error = GetLastError();
+            break;
+        }
+        pending++;
+    }
+
+    while (pending)
+    {
+        if (!GetQueuedCompletionStatusEx( port, entries, ARRAY_SIZE(entries), &count, INFINITE, FALSE ))
+        {
+            stats->error = GetLastError();
+            break;
+        }
+        QueryPerformanceCounter( &now );
+
+        for (i = 0; i < count; i++)
+        {
+            req = CONTAINING_RECORD( entries[i].lpOverlapped, struct request, ovl );
+            pending--;
+
+            if (!GetOverlappedResult( file, &req->ovl, &size, FALSE ))
+            {
+                stats->error = GetLastError();
+                InterlockedExchange( &stop, 1 );
+                continue;
+            }
+            if (req->write)
+            {
+                stats->write_bytes += entries[i].dwNumberOfBytesTransferred;
+                stats->write_count++;
+            }
+            else
+            {
+                stats->read_bytes += entries[i].dwNumberOfBytesTransferred;
+                stats->read_count++;
+            }
+            latency = now.QuadPart - req->start.QuadPart;
+            stats->latency += latency;
+            if (latency > stats->max_latency) stats->max_latency = latency;
+
+            if (stop) continue;
+            if (!start_request( file, req, &state ))
+            {
+                stats->error = GetLastError();
+                InterlockedExchange( &stop, 1 );
+                continue;
+            }
+            pending++;
+        }
+    }
+
+    for (i = 0; i < outstanding; i++) VirtualFree( reqs[i].buffer, 0, MEM_RELEASE );
+    free( reqs );
+    CloseHandle( port );
+    CloseHandle( file );
+    return 0;
+}
+
+static double to_ms( ULONGLONG ticks )
+{
+    return (double)ticks * 1000 / freq.QuadPart;
+}
+
+int __cdecl wmain( int argc, WCHAR *argv[] )
+{
+    struct thread_stats *threads, total;
+    LARGE_INTEGER start, end, size;
+    WIN32_FILE_ATTRIBUTE_DATA attr;
+    double elapsed;
+    unsigned int i;
+
+    if (!parse_options( argc, argv ))
+    {
+        usage();
+        return 1;
+    }
+
+    if (file_size && !create_target()) return 1;
+    if (!GetFileAttributesExW( target, GetFileExInfoStandard, &attr ))
+    {
+        printf( "Failed to open %ls: error %lu\n", target, GetLastError() );
+        return 1;
+    }
+    size.u.LowPart = attr.nFileSizeLow;
+    size.u.HighPart = attr.nFileSizeHigh;
+    file_size = size.QuadPart;
+    if (file_size < block_size)
+    {
+        printf( "%ls is smaller than the block size, use -c to create it\n", target );
+        return 1;
+    }
+
+    QueryPerformanceFrequency( &freq );
+    threads = calloc( thread_count, sizeof(*threads) );
+
+    printf( "%ls: %s%s, %I64u bytes blocks, %u threads, %u outstanding per thread, %u s\n", target,
+            random_access ? "random" : "sequential", write_percent ? " mixed" : " read",
+            block_size, thread_count, outstanding, duration );
+
+    QueryPerformanceCounter( &start );
+    for (i = 0; i < thread_count; i++)
+    {
+        threads[i].index = i;
+        threads[i].thread = CreateThread( NULL, 0, io_thread, &threads[i], 0, NULL );
+    }
+    Sleep( duration * 1000 );
+    InterlockedExchange( &stop, 1 );
+
+    memset( &total, 0, sizeof(total) );
+    for (i = 0; i < thread_count; i++)
+    {
+        WaitForSingleObject( threads[i].thread, INFINITE );
+        CloseHandle( threads[i].thread );
+        if (threads[i].error) printf( "thread %u: error %lu\n", i, threads[i].error );
+        total.read_bytes  += threads[i].read_bytes;
+        total.write_bytes += threads[i].write_bytes;
+        total.read_count  += threads[i].read_count;
+        total.write_count += threads[i].write_count;
+        total.latency     += threads[i].latency;
+        total.max_latency  = max( total.max_latency, threads[i].max_latency );
+    }
+    QueryPerformanceCounter( &end );
+    elapsed = (double)(end.QuadPart - start.QuadPart) / freq.QuadPart;
+
+    printf( "\nthread |       bytes |    I/Os |     MiB/s |   I/O per s | avg lat (ms) | max lat (ms)\n" );
+    for (i = 0; i < thread_count; i++)
+    {
+        ULONGLONG bytes = threads[i].read_bytes + threads[i].write_bytes;
+        ULONGLONG ios = threads[i].read_count + threads[i].write_count;
+
+        printf( "%6u | %11I64u | %7I64u | %9.2f | %11.2f | %12.3f | %12.3f\n", i, bytes, ios,
+                bytes / elapsed / (1024 * 1024), ios / elapsed,
+                ios ? to_ms( threads[i].latency ) / ios : 0.0, to_ms( threads[i].max_latency ) );
+    }
+    printf( " total | %11I64u | %7I64u | %9.2f | %11.2f | %12.3f | %12.3f\n",
+            total.read_bytes + total.write_bytes, total.read_count + total.write_count,
+            (total.read_bytes + total.write_bytes) / elapsed / (1024 * 1024),
+            (total.read_count + total.write_count) / elapsed,
+            total.read_count + total.write_count ?
+            to_ms( total.latency ) / (total.read_count + total.write_count) : 0.0,
+            to_ms( total.max_latency ) );
+    printf( "  read | %11I64u | %7I64u |\n", total.read_bytes, total.read_count );
+    printf( " write | %11I64u | %7I64u |\n", total.write_bytes, total.write_count );
+
+    free( threads );
+    return 0;
+}
@@ -39,6 +39,7 @@
 #include "object.h"
 #include "file.h"
 #include "handle.h"
+#include "process.h"
 #include "request.h"
 
 
@@ -56,13 +57,29 @@ struct type_descr completion_type =
     },
 };
 
+/* per-port counters, printed when running with --stats */
+struct completion_stats
+{
+    process_id_t   pid;           /* process that created the port */
+    timeout_t      created;       /* creation time */
+    unsigned int   posted;        /* messages queued */
+    unsigned int   removed;       /* messages dequeued */
+    unsigned int   requests;      /* remove requests that dequeued something */
+    unsigned int   empty;         /* remove requests that found the queue empty */
+    unsigned int   max_depth;     /* highest queue depth */
+};
+
 struct completion
 {
     struct object  obj;
     struct list    queue;
     unsigned int   depth;
+    struct list    entry;         /* entry in the list of completion ports */
+    struct completion_stats stats;
 };
 
+static struct list completion_list = LIST_INIT( completion_list );
+
 static void completion_dump( struct object*, int );
 static int completion_signaled( struct object *obj, struct wait_queue_entry *entry );
 static void completion_destroy( struct object * );
@@ -100,11 +117,47 @@ struct comp_msg
     unsigned int  status;
 };
 
+/* print the counters of a completion port */
+static void dump_completion_port_stats( struct completion *completion )
+{
+    const struct completion_stats *stats = &completion->stats;
+    timeout_t elapsed = monotonic_time - stats->created;
+
+    fprintf( stderr, "%04x %10u %10u %10u %10u %8u %8u %10.0f\n", stats->pid, stats->posted, stats->removed,
+             stats->requests, stats->empty, stats->max_depth, completion->depth,
+             elapsed > 0 ? (double)stats->removed * TICKS_PER_SEC / elapsed : 0.0 );
+}
+
+static void dump_completion_stats_header(void)
+{
+    fprintf( stderr, "%-4s %10s %10s %10s %10s %8s %8s %10s\n", "pid", "posted", "removed",
+             "requests", "empty", "maxdepth", "depth", "removed/s" );
+}
+
+/* dump the counters of all the completion ports to stderr */
+void dump_completion_stats(void)
+{
+    struct completion *completion;
+
+    fprintf( stderr, "wineserver: completion port statistics\n" );
+    dump_completion_stats_header();
+    LIST_FOR_EACH_ENTRY( completion, &completion_list, struct completion, entry )
+        dump_completion_port_stats( completion );
+}
+
 static void completion_destroy( struct object *obj)
 {
     struct completion *completion = (struct completion *) obj;
     struct comp_msg *tmp, *next;
 
+    if (server_stats && completion->stats.posted)
+    {
+        fprintf( stderr, "wineserver: destroyed completion port\n" );
+        dump_completion_stats_header();
+        dump_completion_port_stats( completion );
+    }
+    list_remove( &completion->entry );
+
     LIST_FOR_EACH_ENTRY_SAFE( tmp, next, &completion->queue, struct comp_msg, queue_entry )
     {
         free( tmp );
@@ -138,6 +191,10 @@ static struct completion *create_completion( struct object *root, const struct u
         {
             list_init( &completion->queue );
             completion->depth = 0;
+            memset( &completion->stats, 0, sizeof(completion->stats) );
+            completion->stats.pid = current ? current->process->id : 0;
+            completion->stats.created = monotonic_time;
+            list_add_tail( &completion_list, &completion->entry );
         }
     }
 
@@ -164,9 +221,26 @@ void add_completion( struct completion *completion, apc_param_t ckey, apc_param_
 
     list_add_tail( &completion->queue, &msg->queue_entry );
     completion->depth++;
+    completion->stats.posted++;
+    if (completion->depth > completion->stats.max_depth) completion->stats.max_depth = completion->depth;
     wake_up( &completion->obj, 1 );
 }
 
+/* remove the first message of a non-empty queue */
+static void remove_completion_msg( struct completion *completion, completion_msg_t *ret )
+{
+    struct comp_msg *msg = LIST_ENTRY( list_head( &completion->queue ), struct comp_msg, queue_entry );
+
+    list_remove( &msg->queue_entry );
+    completion->depth--;
+    ret->ckey = msg->ckey;
+    ret->cvalue = msg->cvalue;
+    ret->information = msg->information;
+    ret->status = msg->status;
+    ret->__pad = 0;
+    free( msg );
+}
+
 /* create a completion */
 DECL_HANDLER(create_completion)
 {
@@ -213,24 +287,53 @@ DECL_HANDLER(add_completion)
 DECL_HANDLER(remove_completion)
 {
     struct completion* completion = get_completion_obj( current->process, req->handle, IO_COMPLETION_MODIFY_STATE );
-    struct list *entry;
-    struct comp_msg *msg;
+    completion_msg_t msg;
+
+    if (!completion) return;
+
+    if (list_empty( &completion->queue ))
+    {
+        completion->stats.empty++;
+        set_error( STATUS_PENDING );
+    }
+    else
+    {
+        remove_completion_msg( completion, &msg );
+        completion->stats.removed++;
+        completion->stats.requests++;
+        reply->ckey = msg.ckey;
+        reply->cvalue = msg.cvalue;
+        reply->status = msg.status;
+        reply->information = msg.information;
+    }
+
+    release_object( completion );
+}
+
+/* get as many completions from completion port as fit in the reply */
+DECL_HANDLER(remove_completions)
+{
+    struct completion* completion = get_completion_obj( current->process, req->handle, IO_COMPLETION_MODIFY_STATE );
+    unsigned int i, count = get_reply_max_size() / sizeof(completion_msg_t);
+    completion_msg_t *msgs;
 
     if (!completion) return;
 
-    entry = list_head( &completion->queue );
-    if (!entry)
+    if (!count) set_error( STATUS_BUFFER_TOO_SMALL );
+    else if (list_empty( &completion->queue ))
+    {
+        completion->stats.empty++;
         set_error( STATUS_PENDING );
+    }
     else
     {
-        list_remove( entry );
-        completion->depth--;
-        msg = LIST_ENTRY( entry, struct comp_msg, queue_entry );
-        reply->ckey = msg->ckey;
-        reply->cvalue = msg->cvalue;
-        reply->status = msg->status;
-        reply->information = msg->information;
-        free( msg );
+        count = min( count, completion->depth );
+        if ((msgs = set_reply_data_size( count * sizeof(*msgs) )))
+        {
+            for (i = 0; i < count; i++) remove_completion_msg( completion, &msgs[i] );
+            completion->stats.removed += count;
+            completion->stats.requests++;
+        }
     }
 
     release_object( completion );
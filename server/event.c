@@ -56,6 +56,8 @@ struct event
     struct list    kernel_object;   /* list of kernel object pointers */
     int            manual_reset;    /* is it a manual reset event? */
     int            signaled;        /* event has been signaled */
+    struct fast_sync_area *sync_area; /* area the state is published in, NULL if not published */
+    unsigned int   sync_idx;        /* index of the published state */
 };
 
 static void event_dump( struct object *obj, int verbose );
@@ -63,6 +65,7 @@ static int event_signaled( struct object *obj, struct wait_queue_entry *entry );
 static void event_satisfied( struct object *obj, struct wait_queue_entry *entry );
 static int event_signal( struct object *obj, unsigned int access);
 static struct list *event_get_kernel_obj_list( struct object *obj );
+static void event_destroy( struct object *obj );
 
 static const struct object_ops event_ops =
 {
@@ -85,7 +88,7 @@ static const struct object_ops event_ops =
     no_open_file,              /* open_file */
     event_get_kernel_obj_list, /* get_kernel_obj_list */
     no_close_handle,           /* close_handle */
-    no_destroy                 /* destroy */
+    event_destroy              /* destroy */
 };
 
 
@@ -136,6 +139,11 @@ static const struct object_ops keyed_event_ops =
 };
 
 
+static void update_event_sync( struct event *event )
+{
+    set_fast_sync( event->sync_area, event->sync_idx, event->manual_reset, event->signaled );
+}
+
 struct event *create_event( struct object *root, const struct unicode_str *name,
                             unsigned int attr, int manual_reset, int initial_state,
                             const struct security_descriptor *sd )
@@ -150,6 +158,8 @@ struct event *create_event( struct object *root, const struct unicode_str *name,
             list_init( &event->kernel_object );
             event->manual_reset = manual_reset;
             event->signaled     = initial_state;
+            event->sync_idx     = alloc_fast_sync( FAST_SYNC_EVENT, &event->sync_area );
+            update_event_sync( event );
         }
     }
     return event;
@@ -166,6 +176,7 @@ static void pulse_event( struct event *event )
     /* wake up all waiters if manual reset, a single one otherwise */
     wake_up( &event->obj, !event->manual_reset );
     event->signaled = 0;
+    update_event_sync( event );
 }
 
 void set_event( struct event *event )
@@ -173,11 +184,13 @@ void set_event( struct event *event )
     event->signaled = 1;
     /* wake up all waiters if manual reset, a single one otherwise */
     wake_up( &event->obj, !event->manual_reset );
+    update_event_sync( event );
 }
 
 void reset_event( struct event *event )
 {
     event->signaled = 0;
+    update_event_sync( event );
 }
 
 static void event_dump( struct object *obj, int verbose )
@@ -200,7 +213,11 @@ static void event_satisfied( struct object *obj, struct wait_queue_entry *entry
     struct event *event = (struct event *)obj;
     assert( obj->ops == &event_ops );
     /* Reset if it's an auto-reset event */
-    if (!event->manual_reset) event->signaled = 0;
+    if (!event->manual_reset)
+    {
+        event->signaled = 0;
+        update_event_sync( event );
+    }
 }
 
 static int event_signal( struct object *obj, unsigned int access )
@@ -223,6 +240,26 @@ static struct list *event_get_kernel_obj_list( struct object *obj )
     return &event->kernel_object;
 }
 
+static void event_destroy( struct object *obj )
+{
+    struct event *event = (struct event *)obj;
+    assert( obj->ops == &event_ops );
+    free_fast_sync( event->sync_area, event->sync_idx );
+}
+
+/* return the published state index for a new event handle */
+static unsigned int get_event_fast_sync( obj_handle_t handle, unsigned int *access )
+{
+    struct event *event;
+    unsigned int index;
+
+    if (!handle || !(event = get_event_obj( current->process, handle, 0 ))) return 0;
+    *access = get_handle_access( current->process, handle );
+    index = get_fast_sync_index( event->sync_area, event->sync_idx );
+    release_object( event );
+    return index;
+}
+
 struct keyed_event *create_keyed_event( struct object *root, const struct unicode_str *name,
                                         unsigned int attr, const struct security_descriptor *sd )
 {
@@ -295,6 +332,11 @@ DECL_HANDLER(create_event)
         else
             reply->handle = alloc_handle_no_access_check( current->process, event,
                                                           req->access, objattr->attributes );
+        if (reply->handle)
+        {
+            reply->access = get_handle_access( current->process, reply->handle );
+            reply->fast_sync = get_fast_sync_index( event->sync_area, event->sync_idx );
+        }
         release_object( event );
     }
 
@@ -308,6 +350,7 @@ DECL_HANDLER(open_event)
 
     reply->handle = open_object( current->process, req->rootdir, req->access,
                                  &event_ops, &name, req->attributes );
+    reply->fast_sync = get_event_fast_sync( reply->handle, &reply->access );
 }
 
 /* do an event operation */
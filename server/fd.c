@@ -100,6 +100,7 @@
 #include "winternl.h"
 #include "winioctl.h"
 #include "ddk/wdm.h"
+#include "wine/timer_wheel.h"
 
 #if defined(HAVE_SYS_EPOLL_H) && defined(HAVE_EPOLL_CREATE)
 # include <sys/epoll.h>
@@ -195,6 +196,65 @@ struct fd
     unsigned int         comp_flags;  /* completion flags */
 };
 
+/* overlapped I/O performed by the client, between its pending and final reports */
+struct client_io
+{
+    struct list          entry;       /* entry in the process client I/O list */
+    unsigned int         id;          /* id the client reports the result with */
+    struct fd           *fd;          /* fd the I/O is performed on */
+    struct event        *event;       /* event to signal */
+    struct completion   *completion;  /* completion object to post to */
+    apc_param_t          comp_key;    /* completion key */
+    apc_param_t          cvalue;      /* completion value */
+};
+
+/* pipe a process reports the results of its queued overlapped I/O through */
+struct client_io_pipe
+{
+    struct object        obj;         /* object header */
+    struct fd           *fd;          /* read end of the pipe */
+    struct process      *process;     /* process writing to the pipe */
+};
+
+static void client_io_pipe_dump( struct object *obj, int verbose );
+static void client_io_pipe_destroy( struct object *obj );
+static void client_io_pipe_poll_event( struct fd *fd, int event );
+
+static const struct object_ops client_io_pipe_ops =
+{
+    sizeof(struct client_io_pipe),  /* size */
+    &no_type,                       /* type */
+    client_io_pipe_dump,            /* dump */
+    no_add_queue,                   /* add_queue */
+    NULL,                           /* remove_queue */
+    NULL,                           /* signaled */
+    NULL,                           /* satisfied */
+    no_signal,                      /* signal */
+    no_get_fd,                      /* get_fd */
+    default_map_access,             /* map_access */
+    default_get_sd,                 /* get_sd */
+    default_set_sd,                 /* set_sd */
+    no_get_full_name,               /* get_full_name */
+    no_lookup_name,                 /* lookup_name */
+    no_link_name,                   /* link_name */
+    NULL,                           /* unlink_name */
+    no_open_file,                   /* open_file */
+    no_kernel_obj_list,             /* get_kernel_obj_list */
+    no_close_handle,                /* close_handle */
+    client_io_pipe_destroy          /* destroy */
+};
+
+static const struct fd_ops client_io_pipe_fd_ops =
+{
+    NULL,                           /* get_poll_events */
+    client_io_pipe_poll_event,      /* poll_event */
+    NULL,                           /* flush */
+    NULL,                           /* get_fd_type */
+    NULL,                           /* ioctl */
+    NULL,                           /* queue_async */
+    NULL                            /* reselect_async */
+};
+
 static void fd_dump( struct object *obj, int verbose );
 static void fd_destroy( struct object *obj );
 
@@ -365,14 +425,15 @@ static file_pos_t max_unix_offset = OFF_T_MAX;
 
 struct timeout_user
 {
-    struct list           entry;      /* entry in sorted timeout list */
+    struct timer_wheel_entry wheel;   /* entry in timer wheel or sorted absolute timeouts list */
     abstime_t             when;       /* timeout expiry */
     timeout_callback      callback;   /* callback function */
     void                 *private;    /* callback private data */
 };
 
 static struct list abs_timeout_list = LIST_INIT(abs_timeout_list); /* sorted absolute timeouts list */
-static struct list rel_timeout_list = LIST_INIT(rel_timeout_list); /* sorted relative timeouts list */
+static struct timer_wheel rel_timeout_wheel;  /* relative timeouts, in milliseconds of monotonic time */
+static int rel_timeout_wheel_init;
 timeout_t current_time;
 timeout_t monotonic_time;
 
@@ -460,32 +521,36 @@ struct timeout_user *add_timeout_user( timeout_t when, timeout_callback func, vo
     user->callback = func;
     user->private  = private;
 
-    /* Now insert it in the linked list */
+    /* Relative timeouts go in the timer wheel, absolute ones in the sorted list
+     * since the system time can change */
 
     if (user->when > 0)
     {
         LIST_FOR_EACH( ptr, &abs_timeout_list )
         {
-            struct timeout_user *timeout = LIST_ENTRY( ptr, struct timeout_user, entry );
+            struct timeout_user *timeout = LIST_ENTRY( ptr, struct timeout_user, wheel.entry );
             if (timeout->when >= user->when) break;
         }
+        list_add_before( ptr, &user->wheel.entry );
+        user->wheel.slot = TIMER_WHEEL_SLOT_NONE;
     }
     else
     {
-        LIST_FOR_EACH( ptr, &rel_timeout_list )
+        if (!rel_timeout_wheel_init)
         {
-            struct timeout_user *timeout = LIST_ENTRY( ptr, struct timeout_user, entry );
-            if (timeout->when <= user->when) break;
+            timer_wheel_init( &rel_timeout_wheel, monotonic_time / 10000 );
+            rel_timeout_wheel_init = 1;
         }
+        timer_wheel_add( &rel_timeout_wheel, &user->wheel, (-user->when + 9999) / 10000 );
     }
-    list_add_before( ptr, &user->entry );
     return user;
 }
 
 /* remove a timeout user */
 void remove_timeout_user( struct timeout_user *user )
 {
-    list_remove( &user->entry );
+    if (user->when > 0) list_remove( &user->wheel.entry );
+    else timer_wheel_remove( &rel_timeout_wheel, &user->wheel );
     free( user );
 }
 
@@ -920,59 +985,50 @@ static int get_next_timeout(void)
 {
     int ret = user_shared_data ? user_shared_data_timeout : -1;
 
-    if (!list_empty( &abs_timeout_list ) || !list_empty( &rel_timeout_list ))
+    if (!list_empty( &abs_timeout_list ) || rel_timeout_wheel.count)
     {
         struct list expired_list, *ptr;
+        unsigned long long next;
 
         /* first remove all expired timers from the list */
 
         list_init( &expired_list );
         while ((ptr = list_head( &abs_timeout_list )) != NULL)
         {
-            struct timeout_user *timeout = LIST_ENTRY( ptr, struct timeout_user, entry );
+            struct timeout_user *timeout = LIST_ENTRY( ptr, struct timeout_user, wheel.entry );
 
             if (timeout->when <= current_time)
             {
-                list_remove( &timeout->entry );
-                list_add_tail( &expired_list, &timeout->entry );
-            }
-            else break;
-        }
-        while ((ptr = list_head( &rel_timeout_list )) != NULL)
-        {
-            struct timeout_user *timeout = LIST_ENTRY( ptr, struct timeout_user, entry );
-
-            if (-timeout->when <= monotonic_time)
-            {
-                list_remove( &timeout->entry );
-                list_add_tail( &expired_list, &timeout->entry );
+                list_remove( &timeout->wheel.entry );
+                list_add_tail( &expired_list, &timeout->wheel.entry );
             }
             else break;
         }
+        if (rel_timeout_wheel.count)
+            timer_wheel_expire( &rel_timeout_wheel, monotonic_time / 10000, &expired_list );
 
         /* now call the callback for all the removed timers */
 
         while ((ptr = list_head( &expired_list )) != NULL)
         {
-            struct timeout_user *timeout = LIST_ENTRY( ptr, struct timeout_user, entry );
-            list_remove( &timeout->entry );
+            struct timeout_user *timeout = LIST_ENTRY( ptr, struct timeout_user, wheel.entry );
+            list_remove( &timeout->wheel.entry );
             timeout->callback( timeout->private );
             free( timeout );
         }
 
         if ((ptr = list_head( &abs_timeout_list )) != NULL)
         {
-            struct timeout_user *timeout = LIST_ENTRY( ptr, struct timeout_user, entry );
+            struct timeout_user *timeout = LIST_ENTRY( ptr, struct timeout_user, wheel.entry );
             timeout_t diff = (timeout->when - current_time + 9999) / 10000;
             if (diff > INT_MAX) diff = INT_MAX;
             else if (diff < 0) diff = 0;
             if (ret == -1 || diff < ret) ret = diff;
         }
 
-        if ((ptr = list_head( &rel_timeout_list )) != NULL)
+        if (rel_timeout_wheel.count && (next = timer_wheel_next( &rel_timeout_wheel )) != TIMER_WHEEL_NEVER)
         {
-            struct timeout_user *timeout = LIST_ENTRY( ptr, struct timeout_user, entry );
-            timeout_t diff = (-timeout->when - monotonic_time + 9999) / 10000;
+            timeout_t diff = ((timeout_t)next * 10000 - monotonic_time + 9999) / 10000;
             if (diff > INT_MAX) diff = INT_MAX;
             else if (diff < 0) diff = 0;
             if (ret == -1 || diff < ret) ret = diff;
@@ -2928,6 +2984,170 @@ DECL_HANDLER(add_fd_completion)
     }
 }
 
+static void free_client_io( struct client_io *io )
+{
+    list_remove( &io->entry );
+    release_object( io->fd );
+    if (io->event) release_object( io->event );
+    if (io->completion) release_object( io->completion );
+    free( io );
+}
+
+/* signal the completion of a queued client I/O, as async_set_result() would */
+static void finish_client_io( struct client_io *io, unsigned int status, apc_param_t information )
+{
+    if (io->completion && io->cvalue)
+        add_completion( io->completion, io->comp_key, io->cvalue, status, information );
+
+    if (io->event) set_event( io->event );
+    else set_fd_signaled( io->fd, 1 );
+    free_client_io( io );
+}
+
+/* process the results the client has written to its pipe so far */
+static void read_client_io_results( struct client_io_pipe *pipe )
+{
+    struct client_io_result results[64];
+    struct client_io *io, *next;
+    unsigned int i, count;
+    ssize_t ret;
+
+    while ((ret = read( get_unix_fd( pipe->fd ), results, sizeof(results) )) > 0)
+    {
+        /* results are written atomically, so the pipe never contains a partial one */
+        count = ret / sizeof(results[0]);
+        for (i = 0; i < count; i++)
+        {
+            LIST_FOR_EACH_ENTRY_SAFE( io, next, &pipe->process->client_ios, struct client_io, entry )
+            {
+                if (io->id != results[i].id) continue;
+                finish_client_io( io, results[i].status, results[i].information );
+                break;
+            }
+        }
+        if (ret < sizeof(results)) break;
+    }
+}
+
+static void client_io_pipe_dump( struct object *obj, int verbose )
+{
+    struct client_io_pipe *pipe = (struct client_io_pipe *)obj;
+    assert( obj->ops == &client_io_pipe_ops );
+    fprintf( stderr, "Client I/O pipe process=%p\n", pipe->process );
+}
+
+static void client_io_pipe_destroy( struct object *obj )
+{
+    struct client_io_pipe *pipe = (struct client_io_pipe *)obj;
+    assert( obj->ops == &client_io_pipe_ops );
+    if (pipe->fd) release_object( pipe->fd );
+}
+
+static void client_io_pipe_poll_event( struct fd *fd, int event )
+{
+    struct client_io_pipe *pipe = get_fd_user( fd );
+    assert( pipe->obj.ops == &client_io_pipe_ops );
+
+    if (event & POLLIN) read_client_io_results( pipe );
+    /* the client closed its end, its remaining I/O is freed with the process */
+    if (event & (POLLERR | POLLHUP)) set_fd_events( fd, -1 );
+}
+
+/* free the client I/O of a terminated process */
+void free_process_client_ios( struct process *process )
+{
+    struct list *ptr;
+
+    if (process->client_io_pipe)
+    {
+        release_object( process->client_io_pipe );
+        process->client_io_pipe = NULL;
+    }
+    while ((ptr = list_head( &process->client_ios )))
+        free_client_io( LIST_ENTRY( ptr, struct client_io, entry ));
+}
+
+/* report the state of an overlapped I/O performed by the client, as async_set_result() would */
+DECL_HANDLER(complete_fd_io)
+{
+    struct fd *fd = get_handle_fd_obj( current->process, req->handle, 0 );
+    struct client_io *io;
+    struct event *event = NULL;
+    static unsigned int last_id;
+
+    if (!fd) return;
+
+    /* results written to the pipe before this request must be handled first */
+    if (current->process->client_io_pipe) read_client_io_results( current->process->client_io_pipe );
+
+    if (req->event && !(event = get_event_obj( current->process, req->event, EVENT_MODIFY_STATE )))
+    {
+        release_object( fd );
+        return;
+    }
+
+    if (req->status == STATUS_PENDING)
+    {
+        if (event) reset_event( event );
+        set_fd_signaled( fd, 0 );
+
+        /* the final result is reported with the id, the handle may be closed by then */
+        if ((io = mem_alloc( sizeof(*io) )))
+        {
+            if (!++last_id) last_id = 1;
+            io->id         = last_id;
+            io->fd         = (struct fd *)grab_object( fd );
+            io->event      = event ? (struct event *)grab_object( event ) : NULL;
+            io->completion = fd->completion ? (struct completion *)grab_object( fd->completion ) : NULL;
+            io->comp_key   = fd->comp_key;
+            io->cvalue     = req->cvalue;
+            list_add_tail( &current->process->client_ios, &io->entry );
+            reply->id = io->id;
+        }
+    }
+    else if (!NT_ERROR( req->status ))
+    {
+        if (fd->completion && req->cvalue && !(fd->comp_flags & FILE_SKIP_COMPLETION_PORT_ON_SUCCESS))
+            add_completion( fd->completion, fd->comp_key, req->cvalue, req->status, req->information );
+
+        if (event) set_event( event );
+        else set_fd_signaled( fd, 1 );
+    }
+
+    if (event) release_object( event );
+    release_object( fd );
+}
+
+/* set the pipe the client reports the results of its queued overlapped I/O through */
+DECL_HANDLER(set_client_io_pipe)
+{
+    struct process *process = current->process;
+    struct client_io_pipe *pipe;
+    int unix_fd = thread_get_inflight_fd( current, req->fd );
+
+    if (unix_fd == -1)
+    {
+        set_error( STATUS_INVALID_HANDLE );
+        return;
+    }
+    if (fcntl( unix_fd, F_SETFL, O_NONBLOCK ) == -1 ||
+        !(pipe = alloc_object( &client_io_pipe_ops )))
+    {
+        close( unix_fd );
+        return;
+    }
+    pipe->process = process;
+    if (!(pipe->fd = create_anonymous_fd( &client_io_pipe_fd_ops, unix_fd, &pipe->obj, 0 )))
+    {
+        release_object( pipe );
+        return;
+    }
+    set_fd_events( pipe->fd, POLLIN );
+
+    if (process->client_io_pipe) release_object( process->client_io_pipe );
+    process->client_io_pipe = pipe;
+}
+
 /* set fd completion information */
 DECL_HANDLER(set_fd_completion_mode)
 {
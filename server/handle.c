@@ -45,17 +45,33 @@ struct handle_entry
     unsigned int   access;    /* access rights */
 };
 
+/* handle table operation counters, dumped when running with --stats */
+struct handle_stats
+{
+    unsigned int allocs;      /* handles allocated */
+    unsigned int closes;      /* handles closed */
+    unsigned int batches;     /* close_handles requests */
+    unsigned int lookups;     /* handle lookups */
+    unsigned int misses;      /* lookups of invalid handles */
+    unsigned int grows;       /* table reallocations to a larger size */
+    unsigned int shrinks;     /* table reallocations to a smaller size */
+    int          peak;        /* highest used entry */
+};
+
 struct handle_table
 {
     struct object        obj;         /* object header */
     struct process      *process;     /* process owning this table */
+    struct list          entry;       /* entry in the list of handle tables */
     int                  count;       /* number of allocated entries */
     int                  last;        /* last used entry */
     int                  free;        /* first entry that may be free */
     struct handle_entry *entries;     /* handle entries */
+    struct handle_stats  stats;       /* operation counters */
 };
 
 static struct handle_table *global_table;
+static struct list handle_tables = LIST_INIT( handle_tables );
 
 /* reserved handle access rights */
 #define RESERVED_SHIFT         26
@@ -165,6 +181,28 @@ static void handle_table_dump( struct object *obj, int verbose )
     }
 }
 
+/* print the operation counters of a handle table */
+static void dump_handle_table_stats( struct handle_table *table )
+{
+    const struct handle_stats *stats = &table->stats;
+
+    fprintf( stderr, "%04x %10u %10u %8u %10u %8u %6u %6u %8d %8d\n",
+             table->process ? table->process->id : 0, stats->allocs, stats->closes, stats->batches,
+             stats->lookups, stats->misses, stats->grows, stats->shrinks, stats->peak + 1, table->count );
+}
+
+/* dump the operation counters of all the handle tables to stderr */
+void dump_handle_stats(void)
+{
+    struct handle_table *table;
+
+    fprintf( stderr, "wineserver: handle table statistics\n" );
+    fprintf( stderr, "%-4s %10s %10s %8s %10s %8s %6s %6s %8s %8s\n", "pid", "allocs", "closes",
+             "batches", "lookups", "misses", "grows", "shrink", "peak", "size" );
+    LIST_FOR_EACH_ENTRY( table, &handle_tables, struct handle_table, entry )
+        dump_handle_table_stats( table );
+}
+
 /* destroy a handle table */
 static void handle_table_destroy( struct object *obj )
 {
@@ -174,6 +212,13 @@ static void handle_table_destroy( struct object *obj )
 
     assert( obj->ops == &handle_table_ops );
 
+    if (server_stats && table->process && table->stats.allocs)
+    {
+        fprintf( stderr, "wineserver: handle table of exiting process\n" );
+        dump_handle_table_stats( table );
+    }
+    list_remove( &table->entry );
+
     for (i = 0, entry = table->entries; i <= table->last; i++, entry++)
     {
         struct object *obj = entry->ptr;
@@ -209,6 +254,9 @@ struct handle_table *alloc_handle_table( struct process *process, int count )
     table->count   = count;
     table->last    = -1;
     table->free    = 0;
+    memset( &table->stats, 0, sizeof(table->stats) );
+    table->stats.peak = -1;
+    list_add_tail( &handle_tables, &table->entry );
     if ((table->entries = mem_alloc( count * sizeof(*table->entries) ))) return table;
     release_object( table );
     return NULL;
@@ -228,6 +276,7 @@ static int grow_handle_table( struct handle_table *table )
     }
     table->entries = new_entries;
     table->count   = count;
+    table->stats.grows++;
     return 1;
 }
 
@@ -244,8 +293,10 @@ static obj_handle_t alloc_entry( struct handle_table *table, void *obj, unsigned
         entry = table->entries + i;  /* the entries may have moved */
     }
     table->last = i;
+    table->stats.peak = max( table->stats.peak, i );
  found:
     table->free = i + 1;
+    table->stats.allocs++;
     entry->ptr    = grab_object_for_handle( obj );
     entry->access = access;
     return index_to_handle(i);
@@ -323,11 +374,14 @@ static struct handle_entry *get_handle( struct process *process, obj_handle_t ha
         table = global_table;
     }
     if (!table) return NULL;
+    table->stats.lookups++;
     index = handle_to_index( handle );
-    if (index < 0) return NULL;
-    if (index > table->last) return NULL;
+    if (index < 0 || index > table->last || !table->entries[index].ptr)
+    {
+        table->stats.misses++;
+        return NULL;
+    }
     entry = table->entries + index;
-    if (!entry->ptr) return NULL;
     return entry;
 }
 
@@ -344,12 +398,14 @@ static void shrink_handle_table( struct handle_table *table )
         table->last--;
         entry--;
     }
-    if (table->last >= count / 4) return;  /* no need to shrink */
-    if (count < MIN_HANDLE_ENTRIES * 2) return;  /* too small to shrink */
-    count /= 2;
+    /* shrink to the final size at once, and keep the table at most a quarter full
+     * afterwards so that growing again doesn't need an immediate reallocation */
+    while (count >= MIN_HANDLE_ENTRIES * 2 && table->last < count / 8) count /= 2;
+    if (count == table->count) return;  /* no need to shrink */
     if (!(new_entries = realloc( table->entries, count * sizeof(*new_entries) ))) return;
     table->count   = count;
     table->entries = new_entries;
+    table->stats.shrinks++;
 }
 
 static void inherit_handle( struct process *parent, const obj_handle_t handle, struct handle_table *table )
@@ -412,6 +468,7 @@ struct handle_table *copy_handle_table( struct process *process, struct process
             }
         }
     }
+    table->stats.peak = table->last;
     /* attempt to shrink the table */
     shrink_handle_table( table );
     return table;
@@ -430,6 +487,7 @@ unsigned int close_handle( struct process *process, obj_handle_t handle )
     if (!obj->ops->close_handle( obj, process, handle )) return STATUS_HANDLE_NOT_CLOSABLE;
     entry->ptr = NULL;
     table = handle_is_global(handle) ? global_table : process->handles;
+    table->stats.closes++;
     if (entry < table->entries + table->free) table->free = entry - table->entries;
     if (entry == table->entries + table->last) shrink_handle_table( table );
     release_object_from_handle( obj );
@@ -646,6 +704,22 @@ DECL_HANDLER(close_handle)
     set_error( err );
 }
 
+/* close a list of handles */
+DECL_HANDLER(close_handles)
+{
+    const obj_handle_t *handles = get_req_data();
+    unsigned int i, err, count = get_req_data_size() / sizeof(*handles);
+    unsigned int status = STATUS_SUCCESS;
+
+    if (current->process->handles) current->process->handles->stats.batches++;
+    for (i = 0; i < count; i++)
+    {
+        if (!(err = close_handle( current->process, handles[i] ))) reply->closed++;
+        else if (!status) status = err;
+    }
+    set_error( status );
+}
+
 /* set a handle information */
 DECL_HANDLER(set_handle_info)
 {
@@ -1114,6 +1114,137 @@ struct object *create_user_data_mapping( struct object *root, const struct unico
     return &mapping->obj;
 }
 
+/* create an anonymous mapping that the server updates and the clients map read-only */
+struct object *create_shared_mapping( mem_size_t size, void **ptr )
+{
+    struct mapping *mapping;
+
+    if (!(mapping = create_mapping( NULL, NULL, 0, size, SEC_COMMIT, 0,
+                                    FILE_READ_DATA | FILE_WRITE_DATA, NULL ))) return NULL;
+    *ptr = mmap( NULL, mapping->size, PROT_READ | PROT_WRITE, MAP_SHARED, get_unix_fd( mapping->fd ), 0 );
+    if (*ptr == MAP_FAILED)
+    {
+        file_set_error();
+        release_object( mapping );
+        return NULL;
+    }
+    return &mapping->obj;
+}
+
+/* The state of the events, mutexes and semaphores created by a process is published
+ * in an area that only this process maps, read-only. The objects keep the real state,
+ * the server never reads the area back; the clients only use it to avoid the requests
+ * that couldn't change anything. */
+
+#define FAST_SYNC_MAX_SLOTS 16384  /* per process, slot 0 is never used */
+#define FAST_SYNC_AREA_SIZE (FAST_SYNC_MAX_SLOTS * sizeof(fast_sync_t))
+
+struct fast_sync_area
+{
+    struct process *process;    /* owner process, NULL once it is gone */
+    int             fd;         /* fd of the shared mapping */
+    fast_sync_t    *ptr;        /* server mapping of the area */
+    unsigned int    used;       /* number of slots ever allocated */
+    unsigned int    count;      /* number of slots in use */
+    unsigned int    free_count; /* number of entries in the free slots array */
+    unsigned int    free[FAST_SYNC_MAX_SLOTS];  /* free slots */
+};
+
+static void destroy_fast_sync_area( struct fast_sync_area *area )
+{
+    munmap( (void *)area->ptr, FAST_SYNC_AREA_SIZE );
+    close( area->fd );
+    free( area );
+}
+
+/* get the shared area of a process, creating it if needed */
+static struct fast_sync_area *get_fast_sync_area( struct process *process )
+{
+    struct fast_sync_area *area;
+    void *ptr;
+    int fd;
+
+    if (process->fast_sync) return process->fast_sync;
+
+    if ((fd = create_temp_file( FAST_SYNC_AREA_SIZE )) == -1) return NULL;
+    ptr = mmap( NULL, FAST_SYNC_AREA_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0 );
+    if (ptr == MAP_FAILED)
+    {
+        close( fd );
+        return NULL;
+    }
+    if (!(area = mem_alloc( sizeof(*area) )))
+    {
+        munmap( ptr, FAST_SYNC_AREA_SIZE );
+        close( fd );
+        return NULL;
+    }
+    area->process    = process;
+    area->fd         = fd;
+    area->ptr        = ptr;
+    area->used       = 1;
+    area->count      = 0;
+    area->free_count = 0;
+    return process->fast_sync = area;
+}
+
+/* detach the shared area from a dying process, the remaining objects keep it alive */
+void release_fast_sync_area( struct process *process )
+{
+    struct fast_sync_area *area = process->fast_sync;
+
+    if (!area) return;
+    process->fast_sync = NULL;
+    area->process = NULL;
+    if (!area->count) destroy_fast_sync_area( area );
+}
+
+/* allocate a slot to publish the state of a synchronization object created by the current process;
+ * return 0 if the state can't be published */
+unsigned int alloc_fast_sync( unsigned int type, struct fast_sync_area **ret_area )
+{
+    struct fast_sync_area *area;
+    unsigned int index;
+
+    *ret_area = NULL;
+    if (!current || !(area = get_fast_sync_area( current->process ))) return 0;
+
+    if (area->free_count) index = area->free[--area->free_count];
+    else if (area->used < FAST_SYNC_MAX_SLOTS) index = area->used++;
+    else return 0;
+
+    area->count++;
+    area->ptr[index].data  = 0;
+    area->ptr[index].state = 0;
+    area->ptr[index].type  = type;
+    *ret_area = area;
+    return index;
+}
+
+/* free the slot of a synchronization object */
+void free_fast_sync( struct fast_sync_area *area, unsigned int index )
+{
+    if (!area) return;
+    area->ptr[index].type = FAST_SYNC_NONE;
+    area->free[area->free_count++] = index;
+    if (!--area->count && !area->process) destroy_fast_sync_area( area );
+}
+
+/* publish the state of a synchronization object */
+void set_fast_sync( struct fast_sync_area *area, unsigned int index, unsigned int data, unsigned int state )
+{
+    if (!area) return;
+    __atomic_store_n( &area->ptr[index].data, data, __ATOMIC_SEQ_CST );
+    __atomic_store_n( &area->ptr[index].state, state, __ATOMIC_SEQ_CST );
+}
+
+/* return the index to report to the current process, 0 if it doesn't map the area */
+unsigned int get_fast_sync_index( struct fast_sync_area *area, unsigned int index )
+{
+    if (!area || area->process != current->process) return 0;
+    return index;
+}
+
 /* create a file mapping */
 DECL_HANDLER(create_mapping)
 {
@@ -1320,3 +1451,17 @@ DECL_HANDLER(get_mapping_filename)
 
     release_object( process );
 }
+
+/* retrieve the area the synchronization objects created by the current process are published in */
+DECL_HANDLER(get_fast_sync_area)
+{
+    struct fast_sync_area *area;
+
+    if (!(area = get_fast_sync_area( current->process )))
+    {
+        if (!get_error()) set_error( STATUS_NO_MEMORY );
+        return;
+    }
+    reply->size = FAST_SYNC_AREA_SIZE;
+    send_client_fd( current->process, area->fd, 0 );
+}
@@ -56,6 +56,8 @@ struct mutex
     struct thread *owner;           /* mutex owner */
     unsigned int   count;           /* recursion count */
     int            abandoned;       /* has it been abandoned? */
+    struct fast_sync_area *sync_area; /* area the state is published in, NULL if not published */
+    unsigned int   sync_idx;        /* index of the published state */
     struct list    entry;           /* entry in owner thread mutex list */
 };
 
@@ -90,6 +92,11 @@ static const struct object_ops mutex_ops =
 };
 
 
+static void update_mutex_sync( struct mutex *mutex )
+{
+    set_fast_sync( mutex->sync_area, mutex->sync_idx, mutex->count, mutex->owner ? mutex->owner->id : 0 );
+}
+
 /* grab a mutex for a given thread */
 static void do_grab( struct mutex *mutex, struct thread *thread )
 {
@@ -101,6 +108,7 @@ static void do_grab( struct mutex *mutex, struct thread *thread )
         mutex->owner = thread;
         list_add_head( &thread->mutex_list, &mutex->entry );
     }
+    update_mutex_sync( mutex );
 }
 
 /* release a mutex once the recursion count is 0 */
@@ -111,6 +119,7 @@ static void do_release( struct mutex *mutex )
     list_remove( &mutex->entry );
     mutex->owner = NULL;
     wake_up( &mutex->obj, 0 );
+    update_mutex_sync( mutex );
 }
 
 static struct mutex *create_mutex( struct object *root, const struct unicode_str *name,
@@ -126,7 +135,9 @@ static struct mutex *create_mutex( struct object *root, const struct unicode_str
             mutex->count = 0;
             mutex->owner = NULL;
             mutex->abandoned = 0;
+            mutex->sync_idx = alloc_fast_sync( FAST_SYNC_MUTEX, &mutex->sync_area );
             if (owned) do_grab( mutex, current );
+            else update_mutex_sync( mutex );
         }
     }
     return mutex;
@@ -186,6 +197,7 @@ static int mutex_signal( struct object *obj, unsigned int access )
         return 0;
     }
     if (!--mutex->count) do_release( mutex );
+    else update_mutex_sync( mutex );
     return 1;
 }
 
@@ -194,9 +206,26 @@ static void mutex_destroy( struct object *obj )
     struct mutex *mutex = (struct mutex *)obj;
     assert( obj->ops == &mutex_ops );
 
-    if (!mutex->count) return;
-    mutex->count = 0;
-    do_release( mutex );
+    if (mutex->count)
+    {
+        mutex->count = 0;
+        do_release( mutex );
+    }
+    free_fast_sync( mutex->sync_area, mutex->sync_idx );
+}
+
+/* return the published state index for a new mutex handle */
+static unsigned int get_mutex_fast_sync( obj_handle_t handle, unsigned int *access )
+{
+    struct mutex *mutex;
+    unsigned int index;
+
+    if (!handle || !(mutex = (struct mutex *)get_handle_obj( current->process, handle, 0, &mutex_ops )))
+        return 0;
+    *access = get_handle_access( current->process, handle );
+    index = get_fast_sync_index( mutex->sync_area, mutex->sync_idx );
+    release_object( mutex );
+    return index;
 }
 
 /* create a mutex */
@@ -217,6 +246,11 @@ DECL_HANDLER(create_mutex)
         else
             reply->handle = alloc_handle_no_access_check( current->process, mutex,
                                                           req->access, objattr->attributes );
+        if (reply->handle)
+        {
+            reply->access = get_handle_access( current->process, reply->handle );
+            reply->fast_sync = get_fast_sync_index( mutex->sync_area, mutex->sync_idx );
+        }
         release_object( mutex );
     }
 
@@ -230,6 +264,7 @@ DECL_HANDLER(open_mutex)
 
     reply->handle = open_object( current->process, req->rootdir, req->access,
                                  &mutex_ops, &name, req->attributes );
+    reply->fast_sync = get_mutex_fast_sync( reply->handle, &reply->access );
 }
 
 /* release a mutex */
@@ -245,6 +280,7 @@ DECL_HANDLER(release_mutex)
         {
             reply->prev_count = mutex->count;
             if (!--mutex->count) do_release( mutex );
+            else update_mutex_sync( mutex );
         }
         release_object( mutex );
     }
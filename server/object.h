@@ -219,6 +219,15 @@ extern void reset_event( struct event *event );
 
 extern void abandon_mutexes( struct thread *thread );
 
+/* shared synchronization state functions */
+
+struct fast_sync_area;
+extern unsigned int alloc_fast_sync( unsigned int type, struct fast_sync_area **area );
+extern void free_fast_sync( struct fast_sync_area *area, unsigned int index );
+extern void set_fast_sync( struct fast_sync_area *area, unsigned int index, unsigned int data, unsigned int state );
+extern unsigned int get_fast_sync_index( struct fast_sync_area *area, unsigned int index );
+extern void release_fast_sync_area( struct process *process );
+
 /* serial functions */
 
 int get_serial_async_timeout(struct object *obj, int type, int count);
@@ -293,6 +302,7 @@ extern struct object *create_symlink( struct object *root, const struct unicode_
   /* command-line options */
 extern int debug_level;
 extern int foreground;
+extern int server_stats;
 extern timeout_t master_socket_timeout;
 extern const char *server_argv0;
 
@@ -674,6 +674,8 @@ struct process *create_process( int fd, struct process *parent, unsigned int fla
     process->peb             = 0;
     process->ldt_copy        = 0;
     process->dir_cache       = NULL;
+    process->fast_sync       = NULL;
+    process->client_io_pipe  = NULL;
     process->winstation      = 0;
     process->desktop         = 0;
     process->token           = NULL;
@@ -687,6 +689,7 @@ struct process *create_process( int fd, struct process *parent, unsigned int fla
     list_init( &process->thread_list );
     list_init( &process->locks );
     list_init( &process->asyncs );
+    list_init( &process->client_ios );
     list_init( &process->classes );
     list_init( &process->views );
 
@@ -771,6 +774,7 @@ static void process_destroy( struct object *obj )
     assert( !process->sigkill_timeout );  /* timeout should hold a reference to the process */
 
     close_process_handles( process );
+    release_fast_sync_area( process );
     set_process_startup_state( process, STARTUP_ABORTED );
 
     if (process->job)
@@ -967,6 +971,7 @@ static void process_killed( struct process *process )
     process->winstation = 0;
     process->desktop = 0;
     cancel_process_asyncs( process );
+    free_process_client_ios( process );
     close_process_handles( process );
     if (process->idle_event) release_object( process->idle_event );
     process->idle_event = NULL;
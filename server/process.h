@@ -65,6 +65,8 @@ struct process
     struct job          *job;             /* job object associated with this process */
     struct list          job_entry;       /* list entry for job object */
     struct list          asyncs;          /* list of async object owned by the process */
+    struct list          client_ios;      /* overlapped I/O queued by the client */
+    struct client_io_pipe *client_io_pipe;/* pipe the client reports the results of its I/O through */
     struct list          locks;           /* list of file locks owned by the process */
     struct list          classes;         /* window classes owned by the process */
     struct console      *console;         /* console input */
@@ -78,6 +80,7 @@ struct process
     client_ptr_t         peb;             /* PEB address in client address space */
     client_ptr_t         ldt_copy;        /* pointer to LDT copy in client addr space */
     struct dir_cache    *dir_cache;       /* map of client-side directory cache */
+    struct fast_sync_area *fast_sync;     /* published state of the synchronization objects created by the process */
     unsigned int         trace_data;      /* opaque data used by the process tracing mechanism */
     struct rawinput_device *rawinput_devices;     /* list of registered rawinput devices */
     unsigned int         rawinput_device_count;   /* number of registered rawinput devices */
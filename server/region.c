@@ -91,6 +91,7 @@ struct region
 
 
 #define RGN_DEFAULT_RECTS 2
+#define RGN_SHRINK_RECTS  64
 
 #define EXTENTCHECK(r1, r2) \
     ((r1)->right > (r2)->left && \
@@ -105,6 +106,115 @@ typedef int (*non_overlap_func_t)( struct region *reg, const rectangle_t *r,
 
 static const rectangle_t empty_rect;  /* all-zero rectangle for empty regions */
 
+#define MAX_SPARE_RECTS 4096
+
+static rectangle_t *spare_rects;  /* rectangles array kept around for the next region operation */
+static int spare_size;
+
+/* get a rectangles array of at least *size entries, reusing the spare one if possible */
+static rectangle_t *get_rects_buffer( int *size )
+{
+    rectangle_t *rects;
+
+    if (spare_size < *size) return mem_alloc( *size * sizeof(*rects) );
+    rects = spare_rects;
+    *size = spare_size;
+    spare_rects = NULL;
+    spare_size = 0;
+    return rects;
+}
+
+/* release a rectangles array, keeping it as the spare one if it is larger */
+static void release_rects_buffer( rectangle_t *rects, int size )
+{
+    if (size > spare_size && size <= MAX_SPARE_RECTS)
+    {
+        free( spare_rects );
+        spare_rects = rects;
+        spare_size = size;
+    }
+    else free( rects );
+}
+
+/* find the first rectangle of the first band that ends below y */
+/* bottoms are increasing across bands, so this is a binary search */
+static int find_band( const struct region *region, int y )
+{
+    int min = 0, max = region->num_rects, pos;
+
+    while (min < max)
+    {
+        pos = (min + max) / 2;
+        if (region->rects[pos].bottom <= y) min = pos + 1;
+        else max = pos;
+    }
+    return min;
+}
+
+/* find the first rectangle of the first band that starts at or below y */
+static int find_band_after( const struct region *region, int y )
+{
+    int min = 0, max = region->num_rects, pos;
+
+    while (min < max)
+    {
+        pos = (min + max) / 2;
+        if (region->rects[pos].top < y) min = pos + 1;
+        else max = pos;
+    }
+    return min;
+}
+
+/* find the first rectangle of the band starting at index start that ends right of x; */
+/* returns the index of the next band if there is none */
+static int find_rect_in_band( const struct region *region, int start, int x )
+{
+    int min = start, max = region->num_rects, pos, top = region->rects[start].top;
+
+    while (min < max)
+    {
+        pos = (min + max) / 2;
+        if (region->rects[pos].top == top && region->rects[pos].right <= x) min = pos + 1;
+        else max = pos;
+    }
+    return min;
+}
+
+/* merge the band ending before index pos with the one starting at pos if they have the same rectangles */
+static void merge_bands( struct region *region, int pos )
+{
+    rectangle_t *rects = region->rects;
+    int i, prev, count;
+
+    if (pos <= 0 || pos >= region->num_rects) return;
+    if (rects[pos - 1].bottom != rects[pos].top) return;
+
+    for (prev = pos - 1; prev > 0 && rects[prev - 1].top == rects[prev].top; prev--) ;
+    count = pos - prev;
+    if (pos + count > region->num_rects) return;
+    if (rects[pos + count - 1].top != rects[pos].top) return;
+    if (pos + count < region->num_rects && rects[pos + count].top == rects[pos].top) return;
+
+    for (i = 0; i < count; i++)
+        if (rects[prev + i].left != rects[pos + i].left || rects[prev + i].right != rects[pos + i].right)
+            return;
+
+    for (i = 0; i < count; i++) rects[prev + i].bottom = rects[pos + i].bottom;
+    memmove( rects + pos, rects + pos + count, (region->num_rects - pos - count) * sizeof(*rects) );
+    region->num_rects -= count;
+}
+
+/* initialize a region pointing to the bands of another region between indices start and end */
+static void init_band_region( struct region *band, const struct region *region, int start, int end )
+{
+    band->size = band->num_rects = end - start;
+    band->rects = region->rects + start;
+    band->extents.left = region->extents.left;
+    band->extents.top = band->rects[0].top;
+    band->extents.right = region->extents.right;
+    band->extents.bottom = band->rects[band->num_rects - 1].bottom;
+}
+
 /* add a rectangle to a region */
 static inline rectangle_t *add_rect( struct region *reg )
 {
@@ -220,10 +330,10 @@ static int region_op( struct region *newReg, const struct region *reg1, const st
     const rectangle_t *r2End = r2 + reg2->num_rects;
 
     rectangle_t *new_rects, *old_rects = newReg->rects;
-    int new_size, ret = 0;
+    int new_size, old_size = newReg->size, ret = 0;
 
     new_size = max( reg1->num_rects, reg2->num_rects ) * 2;
-    if (!(new_rects = mem_alloc( new_size * sizeof(*newReg->rects) ))) return 0;
+    if (!(new_rects = get_rects_buffer( &new_size ))) return 0;
 
     newReg->size = new_size;
     newReg->rects = new_rects;
@@ -321,9 +431,9 @@ static int region_op( struct region *newReg, const struct region *reg1, const st
 
     if (newReg->num_rects != curBand) coalesce_region(newReg, prevBand, curBand);
 
-    if ((newReg->num_rects < (newReg->size / 2)) && (newReg->size > 2))
+    if ((newReg->num_rects < (newReg->size / 4)) && (newReg->size > RGN_SHRINK_RECTS))
     {
-        new_size = max( newReg->num_rects, RGN_DEFAULT_RECTS );
+        new_size = max( newReg->num_rects, RGN_SHRINK_RECTS );
         if ((new_rects = realloc( newReg->rects, sizeof(*newReg->rects) * new_size )))
         {
             newReg->rects = new_rects;
@@ -332,7 +442,7 @@ static int region_op( struct region *newReg, const struct region *reg1, const st
     }
     ret = 1;
 done:
-    free( old_rects );
+    release_rects_buffer( old_rects, old_size );
     return ret;
 }
 
@@ -616,7 +726,7 @@ struct region *create_region_from_req_data( const void *data, data_size_t size )
 /* free a region */
 void free_region( struct region *region )
 {
-    free( region->rects );
+    release_rects_buffer( region->rects, region->size );
     free( region );
 }
 
@@ -762,18 +872,88 @@ struct region *copy_region( struct region *dst, const struct region *src )
 struct region *intersect_region( struct region *dst, const struct region *src1,
                                  const struct region *src2 )
 {
+    struct region band1, band2;
+    int start1, end1, start2, end2;
+
     if (!src1->num_rects || !src2->num_rects || !EXTENTCHECK(&src1->extents, &src2->extents))
-    {
-        dst->num_rects = 0;
-        dst->extents.left = 0;
-        dst->extents.top = 0;
-        dst->extents.right = 0;
-        dst->extents.bottom = 0;
-        return dst;
-    }
-    if (!region_op( dst, src1, src2, intersect_overlapping, NULL, NULL )) return NULL;
+        goto empty;
+
+    /* only the bands within the vertical extents of the other region can intersect */
+    start1 = find_band( src1, src2->extents.top );
+    end1 = find_band_after( src1, src2->extents.bottom );
+    start2 = find_band( src2, src1->extents.top );
+    end2 = find_band_after( src2, src1->extents.bottom );
+    if (start1 == end1 || start2 == end2) goto empty;
+
+    init_band_region( &band1, src1, start1, end1 );
+    init_band_region( &band2, src2, start2, end2 );
+    if (!region_op( dst, &band1, &band2, intersect_overlapping, NULL, NULL )) return NULL;
     set_region_extents( dst );
     return dst;
+
+empty:
+    dst->num_rects = 0;
+    dst->extents.left = 0;
+    dst->extents.top = 0;
+    dst->extents.right = 0;
+    dst->extents.bottom = 0;
+    return dst;
+}
+
+/* subtract src from the region in place, only rebuilding the bands within the extents of src */
+static int subtract_region_bands( struct region *region, const struct region *src )
+{
+    struct region band, tmp;
+    rectangle_t extents = region->extents;
+    int start, end, tail, count;
+
+    start = find_band( region, src->extents.top );
+    end = find_band_after( region, src->extents.bottom );
+    if (start == end) return 1;
+
+    init_band_region( &band, region, start, end );
+    tmp.size = tmp.num_rects = 0;
+    tmp.rects = NULL;
+    if (!region_op( &tmp, &band, src, subtract_overlapping, subtract_non_overlapping, NULL ))
+    {
+        release_rects_buffer( tmp.rects, tmp.size );
+        return 0;
+    }
+
+    tail = region->num_rects - end;
+    count = start + tmp.num_rects + tail;
+    if (count > region->size)
+    {
+        int new_size = max( count, 2 * region->size );
+        rectangle_t *new_rects = realloc( region->rects, new_size * sizeof(*new_rects) );
+
+        if (!new_rects)
+        {
+            release_rects_buffer( tmp.rects, tmp.size );
+            set_error( STATUS_NO_MEMORY );
+            return 0;
+        }
+        region->rects = new_rects;
+        region->size = new_size;
+    }
+    memmove( region->rects + start + tmp.num_rects, region->rects + end, tail * sizeof(*region->rects) );
+    memcpy( region->rects + start, tmp.rects, tmp.num_rects * sizeof(*region->rects) );
+    region->num_rects = count;
+    release_rects_buffer( tmp.rects, tmp.size );
+
+    /* the new bands may now be identical to their neighbors */
+    merge_bands( region, start + tmp.num_rects );
+    merge_bands( region, start );
+
+    /* the horizontal extents can only change if src covers them */
+    if (src->extents.left <= extents.left || src->extents.right >= extents.right)
+        set_region_extents( region );
+    else if (region->num_rects)
+    {
+        region->extents.top = region->rects[0].top;
+        region->extents.bottom = region->rects[region->num_rects - 1].bottom;
+    }
+    return 1;
 }
 
 /* compute the subtraction of two regions into dst, which can be one of the source regions */
@@ -783,6 +963,12 @@ struct region *subtract_region( struct region *dst, const struct region *src1,
     if (!src1->num_rects || !src2->num_rects || !EXTENTCHECK(&src1->extents, &src2->extents))
         return copy_region( dst, src1 );
 
+    if (dst != src2)
+    {
+        if (!copy_region( dst, src1 )) return NULL;
+        return subtract_region_bands( dst, src2 ) ? dst : NULL;
+    }
+
     if (!region_op( dst, src1, src2, subtract_overlapping,
                     subtract_non_overlapping, NULL )) return NULL;
     set_region_extents( dst );
@@ -841,32 +1027,29 @@ struct region *xor_region( struct region *dst, const struct region *src1,
 /* check if the given point is inside the region */
 int point_in_region( struct region *region, int x, int y )
 {
-    const rectangle_t *ptr, *end;
+    int pos = find_band( region, y );
 
-    for (ptr = region->rects, end = region->rects + region->num_rects; ptr < end; ptr++)
-    {
-        if (ptr->top > y) return 0;
-        if (ptr->bottom <= y) continue;
-        /* now we are in the correct band */
-        if (ptr->left > x) return 0;
-        if (ptr->right <= x) continue;
-        return 1;
-    }
-    return 0;
+    if (pos == region->num_rects || region->rects[pos].top > y) return 0;
+    /* now we are in the correct band */
+    pos = find_rect_in_band( region, pos, x );
+    return pos < region->num_rects && region->rects[pos].top <= y && region->rects[pos].left <= x;
 }
 
 /* check if the given rectangle is (at least partially) inside the region */
 int rect_in_region( struct region *region, const rectangle_t *rect )
 {
-    const rectangle_t *ptr, *end;
+    int pos = find_band( region, rect->top ), top;
 
-    for (ptr = region->rects, end = region->rects + region->num_rects; ptr < end; ptr++)
+    while (pos < region->num_rects && region->rects[pos].top < rect->bottom)
     {
-        if (ptr->top >= rect->bottom) return 0;
-        if (ptr->bottom <= rect->top) continue;
-        if (ptr->left >= rect->right) continue;
-        if (ptr->right <= rect->left) continue;
-        return 1;
+        top = region->rects[pos].top;
+        pos = find_rect_in_band( region, pos, rect->left );
+        if (pos == region->num_rects) break;
+        if (region->rects[pos].top == top)
+        {
+            if (region->rects[pos].left < rect->right) return 1;
+            pos = find_band_after( region, top + 1 );
+        }
     }
     return 0;
 }
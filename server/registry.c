@@ -29,10 +29,13 @@
 #include <errno.h>
 #include <fcntl.h>
 #include <limits.h>
+#include <pthread.h>
+#include <signal.h>
 #include <stdio.h>
 #include <stdarg.h>
 #include <string.h>
 #include <stdlib.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <unistd.h>
@@ -48,6 +51,7 @@
 #include "security.h"
 
 #include "winternl.h"
+#include "wine/rbtree.h"
 
 struct notify
 {
@@ -74,22 +78,30 @@ struct type_descr key_type =
     },
 };
 
+/* position of the last entry accessed by index in a subkeys or values tree */
+struct enum_cursor
+{
+    struct rb_entry  *entry;       /* entry at the cursor, NULL if invalid */
+    unsigned int      index;       /* index of the entry */
+};
+
 /* a registry key */
 struct key
 {
-    struct object     obj;         /* object header */
-    WCHAR            *class;       /* key class */
-    data_size_t       classlen;    /* length of class name */
-    int               last_subkey; /* last in use subkey */
-    int               nb_subkeys;  /* count of allocated subkeys */
-    struct key      **subkeys;     /* subkeys array */
-    struct key       *wow6432node; /* Wow6432Node subkey */
-    int               last_value;  /* last in use value */
-    int               nb_values;   /* count of allocated values in array */
-    struct key_value *values;      /* values array */
-    unsigned int      flags;       /* flags */
-    timeout_t         modif;       /* last modification time */
-    struct list       notify_list; /* list of notifications */
+    struct object     obj;           /* object header */
+    WCHAR            *class;         /* key class */
+    data_size_t       classlen;      /* length of class name */
+    struct rb_entry   entry;         /* entry in the parent subkeys tree */
+    struct rb_tree    subkeys;       /* subkeys sorted by name */
+    unsigned int      subkey_count;  /* number of subkeys */
+    struct enum_cursor subkey_cursor; /* subkey enumeration cursor */
+    struct key       *wow6432node;   /* Wow6432Node subkey */
+    struct rb_tree    values;        /* values sorted by name */
+    unsigned int      value_count;   /* number of values */
+    struct enum_cursor value_cursor; /* value enumeration cursor */
+    unsigned int      flags;         /* flags */
+    timeout_t         modif;         /* last modification time */
+    struct list       notify_list;   /* list of notifications */
 };
 
 /* key flags */
@@ -105,16 +117,14 @@ struct key
 /* a key value */
 struct key_value
 {
-    WCHAR            *name;    /* value name */
+    struct rb_entry   entry;   /* entry in the key values tree */
     unsigned short    namelen; /* length of value name */
     unsigned int      type;    /* value type */
     data_size_t       len;     /* value data length in bytes */
     void             *data;    /* pointer to value data */
+    WCHAR             name[1]; /* value name */
 };
 
-#define MIN_SUBKEYS  8   /* min. number of allocated subkeys per key */
-#define MIN_VALUES   8   /* min. number of allocated values per key */
-
 #define MAX_NAME_LEN  256    /* max. length of a key name */
 #define MAX_VALUE_LEN 16383  /* max. length of a value name */
 
@@ -131,13 +141,14 @@ static const WCHAR symlink_value[] = {'S','y','m','b','o','l','i','c','L','i','n
 static const struct unicode_str symlink_str = { symlink_value, sizeof(symlink_value) };
 
 static void set_periodic_save_timer(void);
-static struct key_value *find_value( const struct key *key, const struct unicode_str *name, int *index );
+static struct key_value *find_value( const struct key *key, const struct unicode_str *name );
 
 /* information about where to save a registry branch */
 struct save_branch_info
 {
     struct key  *key;
     const char  *path;
+    int          failed;  /* the last background save failed */
 };
 
 #define MAX_SAVE_BRANCH_INFO 3
@@ -285,66 +296,84 @@ static void dump_value( const struct key_value *value, FILE *f )
     fputc( '\n', f );
 }
 
-/* find the named child of a given key and return its index */
-static struct key *find_subkey( const struct key *key, const struct unicode_str *name, int *index )
+/* case-insensitive comparison of a name with a key or value name */
+static int compare_name( const struct unicode_str *name, const WCHAR *str, data_size_t len )
 {
-    int i, min, max, res;
-    data_size_t len;
+    int res = memicmp_strW( name->str, str, min( name->len, len ));
 
-    min = 0;
-    max = key->last_subkey;
-    while (min <= max)
-    {
-        i = (min + max) / 2;
-        len = min( key->subkeys[i]->obj.name->len, name->len );
-        res = memicmp_strW( key->subkeys[i]->obj.name->name, name->str, len );
-        if (!res) res = key->subkeys[i]->obj.name->len - name->len;
-        if (!res)
-        {
-            *index = i;
-            return key->subkeys[i];
-        }
-        if (res > 0) max = i - 1;
-        else min = i + 1;
-    }
-    *index = min;  /* this is where we should insert it */
-    return NULL;
+    if (res) return res;
+    if (name->len == len) return 0;
+    return name->len < len ? -1 : 1;
 }
 
-/* try to grow the array of subkeys; return 1 if OK, 0 on error */
-static int grow_subkeys( struct key *key )
+static int compare_subkey( const void *name, const struct rb_entry *entry )
 {
-    struct key **new_subkeys;
-    int nb_subkeys;
+    const struct key *key = RB_ENTRY_VALUE( entry, const struct key, entry );
 
-    if (key->nb_subkeys)
+    return compare_name( name, key->obj.name->name, key->obj.name->len );
+}
+
+static int compare_value( const void *name, const struct rb_entry *entry )
+{
+    const struct key_value *value = RB_ENTRY_VALUE( entry, const struct key_value, entry );
+
+    return compare_name( name, value->name, value->namelen );
+}
+
+/* get the entry at a given index of a subkeys or values tree */
+/* the cursor makes enumerating the entries in order a constant time operation */
+static struct rb_entry *get_entry_at_index( const struct rb_tree *tree, unsigned int count,
+                                            struct enum_cursor *cursor, unsigned int index )
+{
+    struct rb_entry *entry;
+    unsigned int pos, dist;
+
+    if (index >= count) return NULL;
+
+    /* start from the closest of the first entry, the last entry and the cursor */
+    if (index < count - 1 - index)
     {
-        nb_subkeys = key->nb_subkeys + (key->nb_subkeys / 2);  /* grow by 50% */
-        if (!(new_subkeys = realloc( key->subkeys, nb_subkeys * sizeof(*new_subkeys) )))
-        {
-            set_error( STATUS_NO_MEMORY );
-            return 0;
-        }
+        entry = rb_head( tree->root );
+        pos = 0;
+        dist = index;
     }
     else
     {
-        nb_subkeys = MIN_SUBKEYS;
-        if (!(new_subkeys = mem_alloc( nb_subkeys * sizeof(*new_subkeys) ))) return 0;
+        entry = rb_tail( tree->root );
+        pos = count - 1;
+        dist = count - 1 - index;
     }
-    key->subkeys    = new_subkeys;
-    key->nb_subkeys = nb_subkeys;
-    return 1;
+    if (cursor->entry && (cursor->index > index ? cursor->index - index : index - cursor->index) < dist)
+    {
+        entry = cursor->entry;
+        pos = cursor->index;
+    }
+    for ( ; pos < index; pos++) entry = rb_next( entry );
+    for ( ; pos > index; pos--) entry = rb_prev( entry );
+
+    cursor->entry = entry;
+    cursor->index = index;
+    return entry;
+}
+
+/* find the named child of a given key */
+static struct key *find_subkey( const struct key *key, const struct unicode_str *name )
+{
+    struct rb_entry *entry = rb_get( &key->subkeys, name );
+
+    return entry ? RB_ENTRY_VALUE( entry, struct key, entry ) : NULL;
 }
 
 /* save a registry and all its subkeys to a text file */
 static void save_subkeys( const struct key *key, const struct key *base, FILE *f )
 {
-    int i;
+    struct key *subkey;
+    struct key_value *value;
 
     if (key->flags & KEY_VOLATILE) return;
     /* save key if it has either some values or no subkeys, or needs special options */
     /* keys with no values but subkeys are saved implicitly by saving the subkeys */
-    if ((key->last_value >= 0) || (key->last_subkey == -1) || key->class || (key->flags & KEY_SYMLINK))
+    if (key->value_count || !key->subkey_count || key->class || (key->flags & KEY_SYMLINK))
     {
         fprintf( f, "\n[" );
         if (key != base) dump_path( key, base, f );
@@ -357,9 +386,9 @@ static void save_subkeys( const struct key *key, const struct key *base, FILE *f
             fprintf( f, "\"\n" );
         }
         if (key->flags & KEY_SYMLINK) fputs( "#link\n", f );
-        for (i = 0; i <= key->last_value; i++) dump_value( &key->values[i], f );
+        RB_FOR_EACH_ENTRY( value, &key->values, struct key_value, entry ) dump_value( value, f );
     }
-    for (i = 0; i <= key->last_subkey; i++) save_subkeys( key->subkeys[i], base, f );
+    RB_FOR_EACH_ENTRY( subkey, &key->subkeys, struct key, entry ) save_subkeys( subkey, base, f );
 }
 
 static void dump_operation( const struct key *key, const struct key_value *value, const char *op )
@@ -479,7 +508,6 @@ static struct object *key_lookup_name( struct object *obj, struct unicode_str *n
     struct key *found, *key = (struct key *)obj;
     struct unicode_str tmp;
     data_size_t next;
-    int index;
 
     assert( obj->ops == &key_ops );
 
@@ -498,7 +526,7 @@ static struct object *key_lookup_name( struct object *obj, struct unicode_str *n
 
         if (!name->len && (attr & OBJ_OPENLINK)) return NULL;
 
-        if (!(value = find_value( key, &symlink_str, &index )) ||
+        if (!(value = find_value( key, &symlink_str )) ||
             value->len < sizeof(WCHAR) || *(WCHAR *)value->data != '\\')
         {
             set_error( STATUS_OBJECT_NAME_NOT_FOUND );
@@ -534,13 +562,13 @@ static struct object *key_lookup_name( struct object *obj, struct unicode_str *n
     for (next = tmp.len; next < name->len; next += sizeof(WCHAR))
         if (name->str[next / sizeof(WCHAR)] != '\\') break;
 
-    if (!(found = find_subkey( key, &tmp, &index )))
+    if (!(found = find_subkey( key, &tmp )))
     {
         if ((key->flags & KEY_WOWSHARE) && (attr & OBJ_KEY_WOW64))
         {
             /* try in the 64-bit parent */
             key = get_parent( key );
-            if (!(found = find_subkey( key, &tmp, &index ))) return grab_object( key );
+            if (!(found = find_subkey( key, &tmp ))) return grab_object( key );
         }
     }
 
@@ -573,7 +601,6 @@ static int key_link_name( struct object *obj, struct object_name *name, struct o
     struct key *key = (struct key *)obj;
     struct key *parent_key = (struct key *)parent;
     struct unicode_str tmp;
-    int i, index;
 
     if (parent->ops != &key_ops)
     {
@@ -583,18 +610,16 @@ static int key_link_name( struct object *obj, struct object_name *name, struct o
         return 0;
     }
 
-    if (parent_key->last_subkey + 1 == parent_key->nb_subkeys)
-    {
-        /* need to grow the array */
-        if (!grow_subkeys( parent_key )) return 0;
-    }
     tmp.str = name->name;
     tmp.len = name->len;
-    find_subkey( parent_key, &tmp, &index );
-
-    for (i = ++parent_key->last_subkey; i > index; i--)
-        parent_key->subkeys[i] = parent_key->subkeys[i - 1];
-    parent_key->subkeys[index] = (struct key *)grab_object( key );
+    if (rb_put( &parent_key->subkeys, &tmp, &key->entry ))
+    {
+        set_error( STATUS_OBJECT_NAME_COLLISION );
+        return 0;
+    }
+    parent_key->subkey_count++;
+    parent_key->subkey_cursor.entry = NULL;
+    grab_object( key );
     if (is_wow6432node( name->name, name->len ) &&
         !is_wow6432node( parent_key->obj.name->name, parent_key->obj.name->len ))
         parent_key->wow6432node = key;
@@ -606,7 +631,6 @@ static void key_unlink_name( struct object *obj, struct object_name *name )
 {
     struct key *key = (struct key *)obj;
     struct key *parent = (struct key *)name->parent;
-    int i, nb_subkeys;
 
     if (!parent) return;
 
@@ -616,25 +640,12 @@ static void key_unlink_name( struct object *obj, struct object_name *name )
         return;
     }
 
-    for (i = 0; i <= parent->last_subkey; i++) if (parent->subkeys[i] == key) break;
-    assert( i <= parent->last_subkey );
-    for ( ; i < parent->last_subkey; i++) parent->subkeys[i] = parent->subkeys[i + 1];
-    parent->last_subkey--;
+    rb_remove( &parent->subkeys, &key->entry );
+    parent->subkey_count--;
+    parent->subkey_cursor.entry = NULL;
     name->parent = NULL;
     if (parent->wow6432node == key) parent->wow6432node = NULL;
     release_object( key );
-
-    /* try to shrink the array */
-    nb_subkeys = parent->nb_subkeys;
-    if (nb_subkeys > MIN_SUBKEYS && parent->last_subkey < nb_subkeys / 2)
-    {
-        struct key **new_subkeys;
-        nb_subkeys -= nb_subkeys / 3;  /* shrink by 33% */
-        if (nb_subkeys < MIN_SUBKEYS) nb_subkeys = MIN_SUBKEYS;
-        if (!(new_subkeys = realloc( parent->subkeys, nb_subkeys * sizeof(*new_subkeys) ))) return;
-        parent->subkeys = new_subkeys;
-        parent->nb_subkeys = nb_subkeys;
-    }
 }
 
 /* close the notification associated with a handle */
@@ -648,24 +659,22 @@ static int key_close_handle( struct object *obj, struct process *process, obj_ha
 
 static void key_destroy( struct object *obj )
 {
-    int i;
     struct list *ptr;
-    struct key *key = (struct key *)obj;
+    struct key *key = (struct key *)obj, *subkey, *next_subkey;
+    struct key_value *value, *next_value;
     assert( obj->ops == &key_ops );
 
     free( key->class );
-    for (i = 0; i <= key->last_value; i++)
+    RB_FOR_EACH_ENTRY_DESTRUCTOR( value, next_value, &key->values, struct key_value, entry )
     {
-        free( key->values[i].name );
-        free( key->values[i].data );
+        free( value->data );
+        free( value );
     }
-    free( key->values );
-    for (i = 0; i <= key->last_subkey; i++)
+    RB_FOR_EACH_ENTRY_DESTRUCTOR( subkey, next_subkey, &key->subkeys, struct key, entry )
     {
-        key->subkeys[i]->obj.name->parent = NULL;
-        release_object( key->subkeys[i] );
+        subkey->obj.name->parent = NULL;
+        release_object( subkey );
     }
-    free( key->subkeys );
     /* unconditionally notify everything waiting on this key */
     while ((ptr = list_head( &key->notify_list )))
     {
@@ -691,14 +700,14 @@ static struct key *create_key_object( struct object *parent, const struct unicod
             key->class       = NULL;
             key->classlen    = 0;
             key->flags       = 0;
-            key->last_subkey = -1;
-            key->nb_subkeys  = 0;
-            key->subkeys     = NULL;
+            key->subkey_count = 0;
+            key->subkey_cursor.entry = NULL;
             key->wow6432node = NULL;
-            key->nb_values   = 0;
-            key->last_value  = -1;
-            key->values      = NULL;
+            key->value_count = 0;
+            key->value_cursor.entry = NULL;
             key->modif       = modif;
+            rb_init( &key->subkeys, compare_subkey );
+            rb_init( &key->values, compare_value );
             list_init( &key->notify_list );
 
             if (options & REG_OPTION_CREATE_LINK) key->flags |= KEY_SYMLINK;
@@ -730,12 +739,12 @@ static void make_dirty( struct key *key )
 /* mark a key and all its subkeys as clean (not modified) */
 static void make_clean( struct key *key )
 {
-    int i;
+    struct key *subkey;
 
     if (key->flags & KEY_VOLATILE) return;
     if (!(key->flags & KEY_DIRTY)) return;
     key->flags &= ~KEY_DIRTY;
-    for (i = 0; i <= key->last_subkey; i++) make_clean( key->subkeys[i] );
+    RB_FOR_EACH_ENTRY( subkey, &key->subkeys, struct key, entry ) make_clean( subkey );
 }
 
 /* go through all the notifications and send them if necessary */
@@ -865,7 +874,9 @@ static struct key *create_key_recursive( struct key *root, const struct unicode_
 /* query information about a key or a subkey */
 static void enum_key( struct key *key, int index, int info_class, struct enum_key_reply *reply )
 {
-    int i;
+    struct rb_entry *entry;
+    struct key *subkey;
+    struct key_value *value;
     data_size_t len, namelen, classlen;
     data_size_t max_subkey = 0, max_class = 0;
     data_size_t max_value = 0, max_data = 0;
@@ -880,12 +891,13 @@ static void enum_key( struct key *key, int index, int info_class, struct enum_ke
 
     if (index != -1)  /* -1 means use the specified key directly */
     {
-        if ((index < 0) || (index > key->last_subkey))
+        if (index < 0 || !(entry = get_entry_at_index( &key->subkeys, key->subkey_count,
+                                                       &key->subkey_cursor, index )))
         {
             set_error( STATUS_NO_MORE_ENTRIES );
             return;
         }
-        key = key->subkeys[index];
+        key = RB_ENTRY_VALUE( entry, struct key, entry );
     }
 
     namelen = key->obj.name->len;
@@ -907,15 +919,15 @@ static void enum_key( struct key *key, int index, int info_class, struct enum_ke
         break;
     case KeyFullInformation:
     case KeyCachedInformation:
-        for (i = 0; i <= key->last_subkey; i++)
+        RB_FOR_EACH_ENTRY( subkey, &key->subkeys, struct key, entry )
         {
-            if (key->subkeys[i]->obj.name->len > max_subkey) max_subkey = key->subkeys[i]->obj.name->len;
-            if (key->subkeys[i]->classlen > max_class) max_class = key->subkeys[i]->classlen;
+            if (subkey->obj.name->len > max_subkey) max_subkey = subkey->obj.name->len;
+            if (subkey->classlen > max_class) max_class = subkey->classlen;
         }
-        for (i = 0; i <= key->last_value; i++)
+        RB_FOR_EACH_ENTRY( value, &key->values, struct key_value, entry )
         {
-            if (key->values[i].namelen > max_value) max_value = key->values[i].namelen;
-            if (key->values[i].len > max_data) max_data = key->values[i].len;
+            if (value->namelen > max_value) max_value = value->namelen;
+            if (value->len > max_data) max_data = value->len;
         }
         reply->max_subkey = max_subkey;
         reply->max_class  = max_class;
@@ -930,8 +942,8 @@ static void enum_key( struct key *key, int index, int info_class, struct enum_ke
         set_error( STATUS_INVALID_PARAMETER );
         return;
     }
-    reply->subkeys = key->last_subkey + 1;
-    reply->values  = key->last_value + 1;
+    reply->subkeys = key->subkey_count;
+    reply->values  = key->value_count;
     reply->modif   = key->modif;
     reply->total   = namelen + classlen;
 
@@ -963,9 +975,8 @@ static void enum_key( struct key *key, int index, int info_class, struct enum_ke
 static void rename_key( struct key *key, const struct unicode_str *new_name )
 {
     struct object_name *new_name_ptr;
-    struct key *subkey, *parent = get_parent( key );
+    struct key *parent = get_parent( key );
     data_size_t len;
-    int i, index, cur_index;
 
     /* changing to a path is not allowed */
     len = get_path_element( new_name->str, new_name->len );
@@ -976,7 +987,7 @@ static void rename_key( struct key *key, const struct unicode_str *new_name )
     }
 
     /* check for existing subkey with the same name */
-    if (!parent || (subkey = find_subkey( parent, new_name, &index )))
+    if (!parent || find_subkey( parent, new_name ))
     {
         set_error( STATUS_CANNOT_DELETE );
         return;
@@ -996,22 +1007,11 @@ static void rename_key( struct key *key, const struct unicode_str *new_name )
     new_name_ptr->parent = &parent->obj;
     memcpy( new_name_ptr->name, new_name->str, new_name->len );
 
-    for (cur_index = 0; cur_index <= parent->last_subkey; cur_index++)
-        if (parent->subkeys[cur_index] == key) break;
-
-    if (cur_index < index && (index - cur_index) > 1)
-    {
-        --index;
-        for (i = cur_index; i < index; ++i) parent->subkeys[i] = parent->subkeys[i+1];
-    }
-    else if (cur_index > index)
-    {
-        for (i = cur_index; i > index; --i) parent->subkeys[i] = parent->subkeys[i-1];
-    }
-    parent->subkeys[index] = key;
-
+    rb_remove( &parent->subkeys, &key->entry );
     free( key->obj.name );
     key->obj.name = new_name_ptr;
+    rb_put( &parent->subkeys, new_name, &key->entry );
+    parent->subkey_cursor.entry = NULL;
 
     if (debug_level > 1) dump_operation( key, NULL, "Rename" );
     touch_key( key, REG_NOTIFY_CHANGE_NAME );
@@ -1037,10 +1037,10 @@ static int delete_key( struct key *key, int recurse )
 
     if (recurse)
     {
-        while (key->last_subkey >= 0)
-            if (!delete_key( key->subkeys[key->last_subkey], 1 )) return 0;
+        while (key->subkey_count)
+            if (!delete_key( RB_ENTRY_VALUE( rb_tail( key->subkeys.root ), struct key, entry ), 1 )) return 0;
     }
-    else if (key->last_subkey >= 0)  /* we can only delete a key that has no subkeys */
+    else if (key->subkey_count)  /* we can only delete a key that has no subkeys */
     {
         set_error( STATUS_ACCESS_DENIED );
         return 0;
@@ -1053,80 +1053,34 @@ static int delete_key( struct key *key, int recurse )
     return 1;
 }
 
-/* try to grow the array of values; return 1 if OK, 0 on error */
-static int grow_values( struct key *key )
+/* find the named value of a given key */
+static struct key_value *find_value( const struct key *key, const struct unicode_str *name )
 {
-    struct key_value *new_val;
-    int nb_values;
+    struct rb_entry *entry = rb_get( &key->values, name );
 
-    if (key->nb_values)
-    {
-        nb_values = key->nb_values + (key->nb_values / 2);  /* grow by 50% */
-        if (!(new_val = realloc( key->values, nb_values * sizeof(*new_val) )))
-        {
-            set_error( STATUS_NO_MEMORY );
-            return 0;
-        }
-    }
-    else
-    {
-        nb_values = MIN_VALUES;
-        if (!(new_val = mem_alloc( nb_values * sizeof(*new_val) ))) return 0;
-    }
-    key->values = new_val;
-    key->nb_values = nb_values;
-    return 1;
+    return entry ? RB_ENTRY_VALUE( entry, struct key_value, entry ) : NULL;
 }
 
-/* find the named value of a given key and return its index in the array */
-static struct key_value *find_value( const struct key *key, const struct unicode_str *name, int *index )
-{
-    int i, min, max, res;
-    data_size_t len;
-
-    min = 0;
-    max = key->last_value;
-    while (min <= max)
-    {
-        i = (min + max) / 2;
-        len = min( key->values[i].namelen, name->len );
-        res = memicmp_strW( key->values[i].name, name->str, len );
-        if (!res) res = key->values[i].namelen - name->len;
-        if (!res)
-        {
-            *index = i;
-            return &key->values[i];
-        }
-        if (res > 0) max = i - 1;
-        else min = i + 1;
-    }
-    *index = min;  /* this is where we should insert it */
-    return NULL;
-}
-
-/* insert a new value; the index must have been returned by find_value */
-static struct key_value *insert_value( struct key *key, const struct unicode_str *name, int index )
+/* insert a new value; it must not exist already */
+static struct key_value *insert_value( struct key *key, const struct unicode_str *name )
 {
     struct key_value *value;
-    WCHAR *new_name = NULL;
-    int i;
 
     if (name->len > MAX_VALUE_LEN * sizeof(WCHAR))
     {
         set_error( STATUS_NAME_TOO_LONG );
         return NULL;
     }
-    if (key->last_value + 1 == key->nb_values)
-    {
-        if (!grow_values( key )) return NULL;
-    }
-    if (name->len && !(new_name = memdup( name->str, name->len ))) return NULL;
-    for (i = ++key->last_value; i > index; i--) key->values[i] = key->values[i - 1];
-    value = &key->values[index];
-    value->name    = new_name;
+    /* the tree links the values by address, allocate the name along with them */
+    if (!(value = mem_alloc( FIELD_OFFSET( struct key_value, name[name->len / sizeof(WCHAR)] )))) return NULL;
+    memcpy( value->name, name->str, name->len );
     value->namelen = name->len;
+    value->type    = REG_NONE;
     value->len     = 0;
     value->data    = NULL;
+    rb_put( &key->values, name, &value->entry );
+    key->value_count++;
+    key->value_cursor.entry = NULL;
     return value;
 }
 
@@ -1136,7 +1090,6 @@ static void set_value( struct key *key, const struct unicode_str *name,
 {
     struct key_value *value;
     void *ptr = NULL;
-    int index;
 
     if (key->flags & KEY_PREDEF)
     {
@@ -1144,7 +1097,7 @@ static void set_value( struct key *key, const struct unicode_str *name,
         return;
     }
 
-    if ((value = find_value( key, name, &index )))
+    if ((value = find_value( key, name )))
     {
         /* check if the new value is identical to the existing one */
         if (value->type == type && value->len == len &&
@@ -1169,7 +1122,7 @@ static void set_value( struct key *key, const struct unicode_str *name,
 
     if (!value)
     {
-        if (!(value = insert_value( key, name, index )))
+        if (!(value = insert_value( key, name )))
         {
             free( ptr );
             return;
@@ -1188,7 +1141,6 @@ static void set_value( struct key *key, const struct unicode_str *name,
 static void get_value( struct key *key, const struct unicode_str *name, int *type, data_size_t *len )
 {
     struct key_value *value;
-    int index;
 
     if (key->flags & KEY_PREDEF)
     {
@@ -1196,7 +1148,7 @@ static void get_value( struct key *key, const struct unicode_str *name, int *typ
         return;
     }
 
-    if ((value = find_value( key, name, &index )))
+    if ((value = find_value( key, name )))
     {
         *type = value->type;
         *len  = value->len;
@@ -1213,7 +1165,7 @@ static void get_value( struct key *key, const struct unicode_str *name, int *typ
 /* enumerate a key value */
 static void enum_value( struct key *key, int i, int info_class, struct enum_key_value_reply *reply )
 {
-    struct key_value *value;
+    struct rb_entry *entry;
 
     if (key->flags & KEY_PREDEF)
     {
@@ -1221,13 +1173,14 @@ static void enum_value( struct key *key, int i, int info_class, struct enum_key_
         return;
     }
 
-    if (i < 0 || i > key->last_value) set_error( STATUS_NO_MORE_ENTRIES );
+    if (i < 0 || !(entry = get_entry_at_index( &key->values, key->value_count, &key->value_cursor, i )))
+        set_error( STATUS_NO_MORE_ENTRIES );
     else
     {
+        struct key_value *value = RB_ENTRY_VALUE( entry, struct key_value, entry );
         void *data;
         data_size_t namelen, maxlen;
 
-        value = &key->values[i];
         reply->type = value->type;
         namelen = value->namelen;
 
@@ -1271,7 +1224,6 @@ static void enum_value( struct key *key, int i, int info_class, struct enum_key_
 static void delete_value( struct key *key, const struct unicode_str *name )
 {
     struct key_value *value;
-    int i, index, nb_values;
 
     if (key->flags & KEY_PREDEF)
     {
@@ -1279,29 +1231,18 @@ static void delete_value( struct key *key, const struct unicode_str *name )
         return;
     }
 
-    if (!(value = find_value( key, name, &index )))
+    if (!(value = find_value( key, name )))
     {
         set_error( STATUS_OBJECT_NAME_NOT_FOUND );
         return;
     }
     if (debug_level > 1) dump_operation( key, value, "Delete" );
-    free( value->name );
+    rb_remove( &key->values, &value->entry );
+    key->value_count--;
+    key->value_cursor.entry = NULL;
     free( value->data );
-    for (i = index; i < key->last_value; i++) key->values[i] = key->values[i + 1];
-    key->last_value--;
+    free( value );
     touch_key( key, REG_NOTIFY_CHANGE_LAST_SET );
-
-    /* try to shrink the array */
-    nb_values = key->nb_values;
-    if (nb_values > MIN_VALUES && key->last_value < nb_values / 2)
-    {
-        struct key_value *new_val;
-        nb_values -= nb_values / 3;  /* shrink by 33% */
-        if (nb_values < MIN_VALUES) nb_values = MIN_VALUES;
-        if (!(new_val = realloc( key->values, nb_values * sizeof(*new_val) ))) return;
-        key->values = new_val;
-        key->nb_values = nb_values;
-    }
 }
 
 /* get the registry key corresponding to an hkey handle */
@@ -1550,7 +1491,6 @@ static struct key_value *parse_value_name( struct key *key, const char *buffer,
 {
     struct key_value *value;
     struct unicode_str name;
-    int index;
 
     if (!get_file_tmp_space( info, strlen(buffer) * sizeof(WCHAR) )) return NULL;
     name.str = info->tmp;
@@ -1571,7 +1511,7 @@ static struct key_value *parse_value_name( struct key *key, const char *buffer,
     if (buffer[*len] != '=') goto error;
     (*len)++;
     while (isspace(buffer[*len])) (*len)++;
-    if (!(value = find_value( key, &name, &index ))) value = insert_value( key, &name, index );
+    if (!(value = find_value( key, &name ))) value = insert_value( key, &name );
     return value;
 
  error:
@@ -1767,12 +1707,264 @@ static void load_registry( struct key *key, obj_handle_t handle )
     }
 }
 
+/*
+ * Binary registry cache
+ *
+ * Parsing the text files takes a noticeable time with large registries, so whenever
+ * a branch is saved the server also writes it in a binary format next to the text
+ * file, stamped with the identity of the text file it matches. At
+ * startup the cache is mapped and loaded directly if the text file hasn't changed
+ * in the meantime. The text file remains the reference, the cache can be deleted
+ * at any time.
+ */
+
+#define REG_CACHE_MAGIC   0x47455257  /* "WREG" */
+#define REG_CACHE_VERSION 2
+
+struct reg_cache_header
+{
+    unsigned int magic;
+    unsigned int version;
+    unsigned int arch;         /* prefix type */
+    unsigned int key_count;    /* number of key records */
+    __int64      size;         /* size of the text file */
+    __int64      mtime;        /* modification time of the text file */
+    __int64      ctime;        /* status change time of the text file */
+    __int64      ino;          /* inode of the text file */
+    unsigned int mtime_nsec;   /* nanoseconds of the modification time */
+    unsigned int ctime_nsec;   /* nanoseconds of the status change time */
+};
+
+/* the keys are stored in depth-first order, so that parents come before their children */
+struct reg_cache_key
+{
+    unsigned int parent;       /* index of the parent record, ~0u for the branch root */
+    unsigned int flags;        /* key flags (only KEY_SYMLINK) */
+    timeout_t    modif;        /* last modification time */
+    unsigned int size;         /* size of the record, including names and values */
+    unsigned int namelen;      /* length of the key name */
+    unsigned int classlen;     /* length of the class name */
+    unsigned int value_count;  /* number of values */
+    /* followed by the key name, the class name and the values */
+};
+
+struct reg_cache_value
+{
+    unsigned int namelen;      /* length of the value name */
+    unsigned int type;         /* value type */
+    unsigned int len;          /* length of the value data */
+    unsigned int pad;
+    /* followed by the value name and data */
+};
+
+/* buffer used to build a registry cache */
+struct reg_cache_buffer
+{
+    char        *data;
+    size_t       size;
+    size_t       alloc;
+    unsigned int count;        /* number of key records */
+    int          error;
+};
+
+static inline size_t reg_cache_align( size_t size )
+{
+    return (size + 7) & ~(size_t)7;
+}
+
+/* get the cache file name for a registry file */
+static char *get_reg_cache_path( const char *path )
+{
+    char *ret;
+
+    if ((ret = malloc( strlen( path ) + sizeof(".bin") ))) strcat( strcpy( ret, path ), ".bin" );
+    return ret;
+}
+
+/* store the identity of the text file matching a cache */
+static void set_reg_cache_file_info( struct reg_cache_header *header, const struct stat *st )
+{
+    header->size  = st->st_size;
+    header->mtime = st->st_mtime;
+    header->ctime = st->st_ctime;
+    header->ino   = st->st_ino;
+#ifdef HAVE_STRUCT_STAT_ST_MTIM
+    header->mtime_nsec = st->st_mtim.tv_nsec;
+#elif defined(HAVE_STRUCT_STAT_ST_MTIMESPEC)
+    header->mtime_nsec = st->st_mtimespec.tv_nsec;
+#endif
+#ifdef HAVE_STRUCT_STAT_ST_CTIM
+    header->ctime_nsec = st->st_ctim.tv_nsec;
+#elif defined(HAVE_STRUCT_STAT_ST_CTIMESPEC)
+    header->ctime_nsec = st->st_ctimespec.tv_nsec;
+#endif
+}
+
+/* fill the header of a cache matching the given text file */
+static void init_reg_cache_header( struct reg_cache_header *header, const struct stat *st )
+{
+    memset( header, 0, sizeof(*header) );
+    header->magic   = REG_CACHE_MAGIC;
+    header->version = REG_CACHE_VERSION;
+    header->arch    = prefix_type;
+    if (st) set_reg_cache_file_info( header, st );
+}
+
+/* check if a cache header matches the expected one */
+static int reg_cache_header_matches( const struct reg_cache_header *header,
+                                     const struct reg_cache_header *expected )
+{
+    return (header->magic == expected->magic && header->version == expected->version &&
+            header->size == expected->size && header->ino == expected->ino &&
+            header->mtime == expected->mtime && header->mtime_nsec == expected->mtime_nsec &&
+            header->ctime == expected->ctime && header->ctime_nsec == expected->ctime_nsec);
+}
+
+/* check that the cache contents are consistent before loading anything from it */
+static int check_reg_cache( const char *base, size_t size )
+{
+    const struct reg_cache_header *header = (const struct reg_cache_header *)base;
+    size_t pos = sizeof(*header), end, vpos;
+    unsigned int i, j;
+
+    if (!header->key_count) return 0;
+    for (i = 0; i < header->key_count; i++, pos = end)
+    {
+        const struct reg_cache_key *rec = (const struct reg_cache_key *)(base + pos);
+
+        if (size - pos < sizeof(*rec)) return 0;
+        if (rec->size < sizeof(*rec) || rec->size > size - pos || rec->size % 8) return 0;
+        if (i ? rec->parent >= i : rec->parent != ~0u) return 0;
+        if (i && (!rec->namelen || rec->namelen > MAX_NAME_LEN * sizeof(WCHAR))) return 0;
+        if (rec->namelen % sizeof(WCHAR) || rec->classlen % sizeof(WCHAR)) return 0;
+        if (rec->namelen > rec->size || rec->classlen > rec->size) return 0;
+
+        end = pos + rec->size;
+        vpos = pos + sizeof(*rec) + reg_cache_align( rec->namelen ) + reg_cache_align( rec->classlen );
+        if (vpos > end) return 0;
+        for (j = 0; j < rec->value_count; j++)
+        {
+            const struct reg_cache_value *val = (const struct reg_cache_value *)(base + vpos);
+
+            if (end - vpos < sizeof(*val)) return 0;
+            if (val->namelen > MAX_VALUE_LEN * sizeof(WCHAR) || val->namelen % sizeof(WCHAR)) return 0;
+            vpos += sizeof(*val) + reg_cache_align( val->namelen );
+            if (vpos > end || val->len > end - vpos || reg_cache_align( val->len ) > end - vpos) return 0;
+            vpos += reg_cache_align( val->len );
+        }
+    }
+    return pos == size;
+}
+
+/* load a registry branch from its binary cache; return 0 if the cache can't be used */
+static int load_reg_cache( struct key *base, const char *filename )
+{
+    const struct reg_cache_header *header;
+    struct reg_cache_header expected;
+    struct stat st, cache_st;
+    struct key **keys;
+    struct key_value *value;
+    struct unicode_str name;
+    const char *data;
+    char *cache_path, *ptr;
+    void *newptr;
+    size_t pos;
+    unsigned int i, j, count = 0;
+    int fd, ret = 0;
+
+    if (stat( filename, &st ) == -1) return 0;
+    if (!(cache_path = get_reg_cache_path( filename ))) return 0;
+    fd = open( cache_path, O_RDONLY );
+    free( cache_path );
+    if (fd == -1) return 0;
+    if (fstat( fd, &cache_st ) == -1 || cache_st.st_size < sizeof(*header) ||
+        cache_st.st_size != (size_t)cache_st.st_size)
+    {
+        close( fd );
+        return 0;
+    }
+    ptr = mmap( NULL, cache_st.st_size, PROT_READ, MAP_PRIVATE, fd, 0 );
+    close( fd );
+    if (ptr == MAP_FAILED) return 0;
+
+    header = (const struct reg_cache_header *)ptr;
+    init_reg_cache_header( &expected, &st );
+    if (!reg_cache_header_matches( header, &expected )) goto done;
+    if (header->arch != PREFIX_32BIT && header->arch != PREFIX_64BIT) goto done;
+    if (prefix_type != PREFIX_UNKNOWN && header->arch != prefix_type) goto done;
+    if (!check_reg_cache( ptr, cache_st.st_size )) goto done;
+    if (!(keys = mem_alloc( header->key_count * sizeof(*keys) ))) goto done;
+
+    keys[count++] = (struct key *)grab_object( base );
+    for (i = 0, pos = sizeof(*header); i < header->key_count; i++)
+    {
+        const struct reg_cache_key *rec = (const struct reg_cache_key *)(ptr + pos);
+        struct key *key;
+
+        data = (const char *)(rec + 1);
+        if (i)
+        {
+            name.str = (const WCHAR *)data;
+            name.len = rec->namelen;
+            if (!(key = create_key_object( &keys[rec->parent]->obj, &name, OBJ_OPENIF, 0, rec->modif, NULL )))
+                goto failed;
+            keys[count++] = key;
+        }
+        else key = base;
+
+        key->modif = rec->modif;
+        key->flags |= rec->flags & KEY_SYMLINK;
+        data += reg_cache_align( rec->namelen );
+        if (rec->classlen)
+        {
+            free( key->class );
+            key->classlen = (key->class = memdup( data, rec->classlen )) ? rec->classlen : 0;
+        }
+        data += reg_cache_align( rec->classlen );
+
+        for (j = 0; j < rec->value_count; j++)
+        {
+            const struct reg_cache_value *val = (const struct reg_cache_value *)data;
+
+            name.str = (const WCHAR *)(val + 1);
+            name.len = val->namelen;
+            data = (const char *)(val + 1) + reg_cache_align( val->namelen );
+            newptr = NULL;
+            if (!(value = find_value( key, &name ))) value = insert_value( key, &name );
+            if (value && (!val->len || (newptr = memdup( data, val->len ))))
+            {
+                free( value->data );
+                value->data = val->len ? newptr : NULL;
+                value->len  = val->len;
+                value->type = val->type;
+            }
+            data += reg_cache_align( val->len );
+        }
+        pos += rec->size;
+    }
+
+    /* the text file has the same contents, no need to write it again */
+    prefix_type = header->arch;
+    make_clean( base );
+    ret = 1;
+
+ failed:
+    for (j = 0; j < count; j++) release_object( keys[j] );
+    free( keys );
+ done:
+    munmap( ptr, cache_st.st_size );
+    return ret;
+}
+
 /* load one of the initial registry files */
 static int load_init_registry_from_file( const char *filename, struct key *key )
 {
-    FILE *f;
+    timeout_t start = server_stats ? monotonic_counter() : 0;
+    const char *format = "text";
+    FILE *f = NULL;
 
-    if ((f = fopen( filename, "r" )))
+    if (load_reg_cache( key, filename )) format = "cache";
+    else if ((f = fopen( filename, "r" )))
     {
         load_keys( key, filename, f, 0 );
         fclose( f );
@@ -1782,13 +1974,18 @@ static int load_init_registry_from_file( const char *filename, struct key *key )
             return 1;
         }
     }
+    else format = NULL;
+
+    if (server_stats && format)
+        fprintf( stderr, "wineserver: loaded %s from %s in %u ms\n", filename, format,
+                 (unsigned int)((monotonic_counter() - start) / 10000) );
 
     assert( save_branch_count < MAX_SAVE_BRANCH_INFO );
 
     save_branch_info[save_branch_count].path = filename;
     save_branch_info[save_branch_count++].key = (struct key *)grab_object( key );
     make_object_permanent( &key->obj );
-    return (f != NULL);
+    return (format != NULL);
 }
 
 static WCHAR *format_user_registry_path( const struct sid *sid, struct unicode_str *path )
@@ -2081,16 +2278,350 @@ done:
     return ret;
 }
 
+/* write a formatted registry branch to its file, from the save thread */
+static int write_branch_file( const char *path, const char *data, size_t size )
+{
+    struct stat st;
+    char *p, *tmp = NULL;
+    int fd, count = 0, ret = 0;
+    ssize_t res;
+
+    if ((fd = openat( config_dir_fd, path, O_WRONLY )) != -1)
+    {
+        /* same rules as save_branch() for special files */
+        if (!fstatat( config_dir_fd, path, &st, AT_SYMLINK_NOFOLLOW ) &&
+            (!S_ISREG(st.st_mode) || st.st_nlink > 1))
+        {
+            if (ftruncate( fd, 0 ) == -1) goto done;
+            goto save;
+        }
+        close( fd );
+        fd = -1;
+    }
+
+    if (!(tmp = malloc( strlen(path) + 20 ))) goto done;
+    strcpy( tmp, path );
+    if ((p = strrchr( tmp, '/' ))) p++;
+    else p = tmp;
+    for (;;)
+    {
+        sprintf( p, "reg%lx%04x.tmp", (long) getpid(), count++ );
+        if ((fd = openat( config_dir_fd, tmp, O_CREAT | O_EXCL | O_WRONLY, 0666 )) != -1) break;
+        if (errno != EEXIST) goto done;
+    }
+
+ save:
+    while (size)
+    {
+        if ((res = write( fd, data, size )) == -1)
+        {
+            if (errno == EINTR) continue;
+            break;
+        }
+        data += res;
+        size -= res;
+    }
+    ret = !size;
+    if (close( fd )) ret = 0;
+    fd = -1;
+
+    if (tmp)
+    {
+        if (ret) ret = !renameat( config_dir_fd, tmp, config_dir_fd, path );
+        if (!ret) unlinkat( config_dir_fd, tmp, 0 );
+    }
+
+done:
+    if (fd != -1) close( fd );
+    free( tmp );
+    return ret;
+}
+
+/* append data to a registry cache buffer, padded to the record alignment */
+static void reg_cache_append( struct reg_cache_buffer *buf, const void *data, size_t len )
+{
+    size_t aligned = reg_cache_align( len );
+    char *new_data;
+
+    if (buf->error) return;
+    if (buf->alloc - buf->size < aligned)
+    {
+        size_t new_alloc = max( buf->alloc * 2, buf->size + aligned );
+
+        if (!(new_data = realloc( buf->data, new_alloc )))
+        {
+            buf->error = 1;
+            return;
+        }
+        buf->data  = new_data;
+        buf->alloc = new_alloc;
+    }
+    if (len) memcpy( buf->data + buf->size, data, len );
+    memset( buf->data + buf->size + len, 0, aligned - len );
+    buf->size += aligned;
+}
+
+/* add a key and all its subkeys to a registry cache buffer */
+static void save_reg_cache_keys( struct reg_cache_buffer *buf, const struct key *key, unsigned int parent )
+{
+    struct reg_cache_key rec;
+    struct reg_cache_value val;
+    struct key_value *value;
+    struct key *subkey;
+    size_t pos = buf->size;
+    unsigned int index;
+
+    if (key->flags & KEY_VOLATILE) return;
+
+    index = buf->count++;
+    rec.parent      = parent;
+    rec.flags       = key->flags & KEY_SYMLINK;
+    rec.modif       = key->modif;
+    rec.size        = 0;
+    rec.namelen     = parent == ~0u ? 0 : key->obj.name->len;
+    rec.classlen    = key->class ? key->classlen : 0;
+    rec.value_count = key->value_count;
+    reg_cache_append( buf, &rec, sizeof(rec) );
+    reg_cache_append( buf, key->obj.name->name, rec.namelen );
+    reg_cache_append( buf, key->class, rec.classlen );
+    RB_FOR_EACH_ENTRY( value, &key->values, struct key_value, entry )
+    {
+        val.namelen = value->namelen;
+        val.type    = value->type;
+        val.len     = value->len;
+        val.pad     = 0;
+        reg_cache_append( buf, &val, sizeof(val) );
+        reg_cache_append( buf, value->name, val.namelen );
+        reg_cache_append( buf, value->data, val.len );
+    }
+    if (buf->error) return;
+    if (buf->size - pos > UINT_MAX)
+    {
+        buf->error = 1;
+        return;
+    }
+    ((struct reg_cache_key *)(buf->data + pos))->size = buf->size - pos;
+
+    RB_FOR_EACH_ENTRY( subkey, &key->subkeys, struct key, entry ) save_reg_cache_keys( buf, subkey, index );
+}
+
+/* build the binary cache of a registry branch, with the given text file identity */
+static int build_reg_cache( struct reg_cache_buffer *buf, struct key *key, const struct stat *st )
+{
+    struct reg_cache_header header;
+
+    memset( buf, 0, sizeof(*buf) );
+    init_reg_cache_header( &header, st );
+    reg_cache_append( buf, &header, sizeof(header) );
+    save_reg_cache_keys( buf, key, ~0u );
+    if (buf->error)
+    {
+        free( buf->data );
+        buf->data = NULL;
+        return 0;
+    }
+    ((struct reg_cache_header *)buf->data)->key_count = buf->count;
+    return 1;
+}
+
+/* write the binary cache of a registry branch once it has been saved to its text file */
+static void save_reg_cache( const struct save_branch_info *info )
+{
+    struct reg_cache_buffer buf;
+    struct reg_cache_header header, old;
+    struct stat st;
+    char *cache_path;
+    int fd, uptodate = 0;
+
+    if (info->key->flags & KEY_DIRTY) return;  /* the text file is out of date */
+    if (stat( info->path, &st ) == -1) return;
+    if (!(cache_path = get_reg_cache_path( info->path ))) return;
+
+    init_reg_cache_header( &header, &st );
+    if ((fd = open( cache_path, O_RDONLY )) != -1)
+    {
+        uptodate = (read( fd, &old, sizeof(old) ) == sizeof(old) && reg_cache_header_matches( &old, &header ));
+        close( fd );
+    }
+    if (!uptodate && build_reg_cache( &buf, info->key, &st ))
+    {
+        write_branch_file( cache_path, buf.data, buf.size );
+        free( buf.data );
+    }
+    free( cache_path );
+}
+
+/* Periodic saves are written to disk by a background thread. The main thread still
+ * formats the branches into memory, since the key tree can only be accessed from there,
+ * and only hands the finished buffers to the thread, so that slow storage doesn't stall
+ * the clients. */
+struct save_job
+{
+    struct save_branch_info *info;
+    char                    *data;   /* contents of the text file */
+    size_t                   size;
+    struct reg_cache_buffer  cache;  /* binary cache, stamped once the text file is written */
+};
+
+static pthread_mutex_t save_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t save_cond = PTHREAD_COND_INITIALIZER;       /* signaled when a round is queued */
+static pthread_cond_t save_done_cond = PTHREAD_COND_INITIALIZER;  /* signaled when a round is written */
+static struct save_job save_jobs[MAX_SAVE_BRANCH_INFO];
+static int save_job_count;      /* number of jobs in the current round, 0 when idle */
+static int save_thread_state;   /* 0 = not started, 1 = running, -1 = failed to start */
+
+/* stamp the cache of a saved branch with the identity of the new text file and write it */
+static void write_save_job_cache( struct save_job *job )
+{
+    struct stat st;
+    char *cache_path;
+
+    if (fstatat( config_dir_fd, job->info->path, &st, 0 ) == -1) return;
+    if (!(cache_path = get_reg_cache_path( job->info->path ))) return;
+    set_reg_cache_file_info( (struct reg_cache_header *)job->cache.data, &st );
+    write_branch_file( cache_path, job->cache.data, job->cache.size );
+    free( cache_path );
+}
+
+/* background thread writing the periodic registry saves */
+static void *save_thread( void *arg )
+{
+    int i, failed[MAX_SAVE_BRANCH_INFO];
+
+    pthread_mutex_lock( &save_mutex );
+    for (;;)
+    {
+        while (!save_job_count) pthread_cond_wait( &save_cond, &save_mutex );
+
+        /* the jobs are left alone by the main thread until the round is done */
+        pthread_mutex_unlock( &save_mutex );
+        for (i = 0; i < save_job_count; i++)
+        {
+            struct save_job *job = &save_jobs[i];
+
+            failed[i] = !write_branch_file( job->info->path, job->data, job->size );
+            if (!failed[i] && job->cache.data) write_save_job_cache( job );
+            free( job->data );
+            free( job->cache.data );
+            job->data = NULL;
+            job->cache.data = NULL;
+        }
+        pthread_mutex_lock( &save_mutex );
+        for (i = 0; i < save_job_count; i++) if (failed[i]) save_jobs[i].info->failed = 1;
+        save_job_count = 0;
+        pthread_cond_broadcast( &save_done_cond );
+    }
+    return NULL;
+}
+
+/* start the background save thread if needed */
+static int start_save_thread(void)
+{
+    pthread_t thread;
+    sigset_t all, old;
+
+    if (save_thread_state) return save_thread_state > 0;
+
+    /* signals have to be handled by the main thread */
+    sigfillset( &all );
+    pthread_sigmask( SIG_SETMASK, &all, &old );
+    if (pthread_create( &thread, NULL, save_thread, NULL ))
+    {
+        save_thread_state = -1;
+    }
+    else
+    {
+        pthread_detach( thread );
+        save_thread_state = 1;
+    }
+    pthread_sigmask( SIG_SETMASK, &old, NULL );
+    return save_thread_state > 0;
+}
+
+/* wait for the background save to finish and mark the branches that failed as dirty again */
+static void wait_save_thread(void)
+{
+    int i;
+
+    if (save_thread_state <= 0) return;
+    pthread_mutex_lock( &save_mutex );
+    while (save_job_count) pthread_cond_wait( &save_done_cond, &save_mutex );
+    for (i = 0; i < save_branch_count; i++)
+    {
+        if (!save_branch_info[i].failed) continue;
+        save_branch_info[i].failed = 0;
+        fprintf( stderr, "wineserver: could not save registry branch to %s\n", save_branch_info[i].path );
+        make_dirty( save_branch_info[i].key );
+    }
+    pthread_mutex_unlock( &save_mutex );
+}
+
+/* format a registry branch into memory for the save thread */
+static int format_save_branch( struct save_branch_info *info, struct save_job *job )
+{
+    FILE *f;
+
+    if (!(info->key->flags & KEY_DIRTY)) return 0;
+
+    job->info = info;
+    job->data = NULL;
+    job->size = 0;
+    if (!(f = open_memstream( &job->data, &job->size ))) return 0;
+    if (debug_level > 1)
+    {
+        fprintf( stderr, "%s: ", info->path );
+        dump_operation( info->key, NULL, "saving" );
+    }
+    save_all_subkeys( info->key, f );
+    if (fclose( f ))
+    {
+        free( job->data );  /* the key stays dirty, it will be saved next time */
+        job->data = NULL;
+        return 0;
+    }
+    /* a failure only means that the cache will be out of date */
+    build_reg_cache( &job->cache, info->key, NULL );
+    make_clean( info->key );
+    return 1;
+}
+
 /* periodic saving of the registry */
 static void periodic_save( void *arg )
 {
-    int i;
+    int i, busy, count = 0;
 
-    if (fchdir( config_dir_fd ) == -1) return;
     save_timeout_user = NULL;
-    for (i = 0; i < save_branch_count; i++)
-        save_branch( save_branch_info[i].key, save_branch_info[i].path );
-    if (fchdir( server_dir_fd ) == -1) fatal_error( "chdir to server dir: %s\n", strerror( errno ));
+    if (start_save_thread())
+    {
+        pthread_mutex_lock( &save_mutex );
+        busy = save_job_count != 0;
+        pthread_mutex_unlock( &save_mutex );
+        if (busy)  /* the previous round isn't written yet, try again later */
+        {
+            set_periodic_save_timer();
+            return;
+        }
+        wait_save_thread();  /* pick up the failures of the previous round */
+
+        /* the thread is idle, so the jobs can be filled without holding the lock */
+        for (i = 0; i < save_branch_count; i++)
+            if (format_save_branch( &save_branch_info[i], &save_jobs[count] )) count++;
+        if (count)
+        {
+            pthread_mutex_lock( &save_mutex );
+            save_job_count = count;
+            pthread_cond_signal( &save_cond );
+            pthread_mutex_unlock( &save_mutex );
+        }
+    }
+    else
+    {
+        if (fchdir( config_dir_fd ) == -1) return;
+        for (i = 0; i < save_branch_count; i++)
+            if (save_branch( save_branch_info[i].key, save_branch_info[i].path ))
+                save_reg_cache( &save_branch_info[i] );
+        if (fchdir( server_dir_fd ) == -1) fatal_error( "chdir to server dir: %s\n", strerror( errno ));
+    }
     set_periodic_save_timer();
 }
 
@@ -2101,22 +2632,45 @@ static void set_periodic_save_timer(void)
     save_timeout_user = add_timeout_user( save_period, periodic_save, NULL );
 }
 
+/* save a modified registry branch and its cache, the current directory must be the config dir */
+static void flush_branch( struct save_branch_info *info )
+{
+    if (!save_branch( info->key, info->path ))
+    {
+        fprintf( stderr, "wineserver: could not save registry branch to %s", info->path );
+        perror( " " );
+    }
+    else save_reg_cache( info );
+}
+
 /* save the modified registry branches to disk */
 void flush_registry(void)
 {
     int i;
 
+    wait_save_thread();
     if (fchdir( config_dir_fd ) == -1) return;
-    for (i = 0; i < save_branch_count; i++)
+    for (i = 0; i < save_branch_count; i++) flush_branch( &save_branch_info[i] );
+    if (fchdir( server_dir_fd ) == -1) fatal_error( "chdir to server dir: %s\n", strerror( errno ));
+}
+
+/* save the registry branch containing a key to disk */
+static void flush_key_branch( struct key *key )
+{
+    int i;
+
+    for ( ; key; key = get_parent( key ))
     {
-        if (!save_branch( save_branch_info[i].key, save_branch_info[i].path ))
+        for (i = 0; i < save_branch_count; i++)
         {
-            fprintf( stderr, "wineserver: could not save registry branch to %s",
-                     save_branch_info[i].path );
-            perror( " " );
+            if (save_branch_info[i].key != key) continue;
+            wait_save_thread();
+            if (fchdir( config_dir_fd ) == -1) return;
+            flush_branch( &save_branch_info[i] );
+            if (fchdir( server_dir_fd ) == -1) fatal_error( "chdir to server dir: %s\n", strerror( errno ));
+            return;
         }
     }
-    if (fchdir( server_dir_fd ) == -1) fatal_error( "chdir to server dir: %s\n", strerror( errno ));
 }
 
 /* determine if the thread is wow64 (32-bit client running on 64-bit prefix) */
@@ -2195,7 +2749,7 @@ DECL_HANDLER(flush_key)
     struct key *key = get_hkey_obj( req->hkey, 0 );
     if (key)
     {
-        /* we don't need to do anything here with the current implementation */
+        flush_key_branch( key );
         release_object( key );
     }
 }
@@ -288,11 +288,60 @@ static void send_reply( union generic_reply *reply )
         fatal_protocol_error( current, "reply write: %s\n", strerror( errno ));
 }
 
+/* per-request statistics, collected when running with --stats */
+#define REQ_STATS_BUCKETS 16  /* log2 buckets of 100ns ticks, last one catches everything above */
+
+struct request_stats
+{
+    unsigned int count;                         /* number of calls */
+    unsigned int errors;                        /* number of calls that returned an error */
+    timeout_t    total;                         /* total time spent in ticks */
+    timeout_t    max;                           /* longest call in ticks */
+    unsigned int hist[REQ_STATS_BUCKETS];       /* latency histogram */
+};
+
+static struct request_stats req_stats[REQ_NB_REQUESTS];
+
+static void add_request_stats( enum request req, timeout_t start, unsigned int error )
+{
+    struct request_stats *stats = &req_stats[req];
+    timeout_t elapsed = monotonic_counter() - start;
+    unsigned int bucket = 0;
+
+    while (bucket < REQ_STATS_BUCKETS - 1 && (elapsed >> bucket) > 1) bucket++;
+    stats->count++;
+    if (error) stats->errors++;
+    stats->total += elapsed;
+    if (elapsed > stats->max) stats->max = elapsed;
+    stats->hist[bucket]++;
+}
+
+/* dump the request statistics to stderr */
+void dump_request_stats(void)
+{
+    enum request req;
+    unsigned int i;
+
+    fprintf( stderr, "wineserver: request statistics (times in us, buckets are powers of 2 of 100ns)\n" );
+    fprintf( stderr, "%-32s %10s %8s %10s %10s  histogram\n", "request", "count", "errors", "avg", "max" );
+    for (req = 0; req < REQ_NB_REQUESTS; req++)
+    {
+        const struct request_stats *stats = &req_stats[req];
+
+        if (!stats->count) continue;
+        fprintf( stderr, "%-32s %10u %8u %10.1f %10.1f ", get_req_name( req ), stats->count, stats->errors,
+                 stats->total / 10.0 / stats->count, stats->max / 10.0 );
+        for (i = 0; i < REQ_STATS_BUCKETS; i++) fprintf( stderr, " %u", stats->hist[i] );
+        fputc( '\n', stderr );
+    }
+}
+
 /* call a request handler */
 static void call_req_handler( struct thread *thread )
 {
     union generic_reply reply;
     enum request req = thread->req.request_header.req;
+    timeout_t start = server_stats ? monotonic_counter() : 0;
 
     current = thread;
     current->reply_size = 0;
@@ -321,18 +370,34 @@ static void call_req_handler( struct thread *thread )
             kill_thread( current, 1 );  /* no way to continue without reply fd */
         }
     }
+    if (server_stats && req < REQ_NB_REQUESTS) add_request_stats( req, start, current ? current->error : 0 );
     current = NULL;
 }
 
 /* read a request from a thread */
 void read_request( struct thread *thread )
 {
+    /* clients wait for the reply before sending anything else, so a single read
+     * can't return more than one request; fetch small requests in one go */
+    static char data_buffer[MAX_REQUEST_LENGTH];
+    struct iovec vec[2];
+    data_size_t size;
     int ret;
 
     if (!thread->req_toread)  /* no pending request */
     {
-        if ((ret = read( get_unix_fd( thread->request_fd ), &thread->req,
-                         sizeof(thread->req) )) != sizeof(thread->req)) goto error;
+        vec[0].iov_base = &thread->req;
+        vec[0].iov_len  = sizeof(thread->req);
+        vec[1].iov_base = data_buffer;
+        vec[1].iov_len  = sizeof(data_buffer);
+        if ((ret = readv( get_unix_fd( thread->request_fd ), vec, 2 )) < (int)sizeof(thread->req)) goto error;
+        size = ret - sizeof(thread->req);
+        if (size > thread->req.request_header.request_size)
+        {
+            fatal_protocol_error( thread, "request %d overflow %u > %u\n", thread->req.request_header.req,
+                                  size, thread->req.request_header.request_size );
+            return;
+        }
         if (!(thread->req_toread = thread->req.request_header.request_size))
         {
             /* no data, handle request at once */
@@ -345,9 +410,17 @@ void read_request( struct thread *thread )
                                   thread->req_toread, thread->req.request_header.req );
             return;
         }
+        memcpy( thread->req_data, data_buffer, size );
+        if (!(thread->req_toread -= size))
+        {
+            call_req_handler( thread );
+            free( thread->req_data );
+            thread->req_data = NULL;
+            return;
+        }
     }
 
-    /* read the variable sized data */
+    /* read the rest of the variable sized data */
     for (;;)
     {
         ret = read( get_unix_fd( thread->request_fd ),
@@ -938,6 +1011,12 @@ static void close_socket_timeout( void *arg )
     master_timeout = NULL;
     flush_registry();
     if (debug_level) fprintf( stderr, "wineserver: exiting (pid=%ld)\n", (long) getpid() );
+    if (server_stats)
+    {
+        dump_request_stats();
+        dump_handle_stats();
+        dump_completion_stats();
+    }
 
 #ifdef DEBUG_OBJECTS
     close_objects();  /* shut down everything properly */
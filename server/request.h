@@ -65,6 +65,8 @@ extern int server_dir_fd, config_dir_fd;
 
 extern void trace_request(void);
 extern void trace_reply( enum request req, const union generic_reply *reply );
+extern const char *get_req_name( enum request req );
+extern void dump_request_stats(void);
 
 /* get current tick count to return to client */
 static inline unsigned int get_tick_count(void)
@@ -141,6 +143,7 @@ DECL_HANDLER(resume_thread);
 DECL_HANDLER(queue_apc);
 DECL_HANDLER(get_apc_result);
 DECL_HANDLER(close_handle);
+DECL_HANDLER(close_handles);
 DECL_HANDLER(set_handle_info);
 DECL_HANDLER(dup_handle);
 DECL_HANDLER(compare_objects);
@@ -162,6 +165,7 @@ DECL_HANDLER(create_semaphore);
 DECL_HANDLER(release_semaphore);
 DECL_HANDLER(query_semaphore);
 DECL_HANDLER(open_semaphore);
+DECL_HANDLER(get_fast_sync_area);
 DECL_HANDLER(create_file);
 DECL_HANDLER(open_file_object);
 DECL_HANDLER(alloc_file_handle);
@@ -257,6 +261,7 @@ DECL_HANDLER(destroy_window);
 DECL_HANDLER(get_desktop_window);
 DECL_HANDLER(set_window_owner);
 DECL_HANDLER(get_window_info);
+DECL_HANDLER(get_window_shm_area);
 DECL_HANDLER(set_window_info);
 DECL_HANDLER(set_parent);
 DECL_HANDLER(get_window_parents);
@@ -370,9 +375,12 @@ DECL_HANDLER(create_completion);
 DECL_HANDLER(open_completion);
 DECL_HANDLER(add_completion);
 DECL_HANDLER(remove_completion);
+DECL_HANDLER(remove_completions);
 DECL_HANDLER(query_completion);
 DECL_HANDLER(set_completion_info);
 DECL_HANDLER(add_fd_completion);
+DECL_HANDLER(complete_fd_io);
+DECL_HANDLER(set_client_io_pipe);
 DECL_HANDLER(set_fd_completion_mode);
 DECL_HANDLER(set_fd_disp_info);
 DECL_HANDLER(set_fd_name_info);
@@ -424,6 +432,7 @@ static const req_handler req_handlers[REQ_NB_REQUESTS] =
     (req_handler)req_queue_apc,
     (req_handler)req_get_apc_result,
     (req_handler)req_close_handle,
+    (req_handler)req_close_handles,
     (req_handler)req_set_handle_info,
     (req_handler)req_dup_handle,
     (req_handler)req_compare_objects,
@@ -445,6 +454,7 @@ static const req_handler req_handlers[REQ_NB_REQUESTS] =
     (req_handler)req_release_semaphore,
     (req_handler)req_query_semaphore,
     (req_handler)req_open_semaphore,
+    (req_handler)req_get_fast_sync_area,
     (req_handler)req_create_file,
     (req_handler)req_open_file_object,
     (req_handler)req_alloc_file_handle,
@@ -540,6 +550,7 @@ static const req_handler req_handlers[REQ_NB_REQUESTS] =
     (req_handler)req_get_desktop_window,
     (req_handler)req_set_window_owner,
     (req_handler)req_get_window_info,
+    (req_handler)req_get_window_shm_area,
     (req_handler)req_set_window_info,
     (req_handler)req_set_parent,
     (req_handler)req_get_window_parents,
@@ -653,9 +664,12 @@ static const req_handler req_handlers[REQ_NB_REQUESTS] =
     (req_handler)req_open_completion,
     (req_handler)req_add_completion,
     (req_handler)req_remove_completion,
+    (req_handler)req_remove_completions,
     (req_handler)req_query_completion,
     (req_handler)req_set_completion_info,
     (req_handler)req_add_fd_completion,
+    (req_handler)req_complete_fd_io,
+    (req_handler)req_set_client_io_pipe,
     (req_handler)req_set_fd_completion_mode,
     (req_handler)req_set_fd_disp_info,
     (req_handler)req_set_fd_name_info,
@@ -865,6 +879,9 @@ C_ASSERT( FIELD_OFFSET(struct get_apc_result_reply, result) == 8 );
 C_ASSERT( sizeof(struct get_apc_result_reply) == 48 );
 C_ASSERT( FIELD_OFFSET(struct close_handle_request, handle) == 12 );
 C_ASSERT( sizeof(struct close_handle_request) == 16 );
+C_ASSERT( sizeof(struct close_handles_request) == 16 );
+C_ASSERT( FIELD_OFFSET(struct close_handles_reply, closed) == 8 );
+C_ASSERT( sizeof(struct close_handles_reply) == 16 );
 C_ASSERT( FIELD_OFFSET(struct set_handle_info_request, handle) == 12 );
 C_ASSERT( FIELD_OFFSET(struct set_handle_info_request, flags) == 16 );
 C_ASSERT( FIELD_OFFSET(struct set_handle_info_request, mask) == 20 );
@@ -912,7 +929,9 @@ C_ASSERT( FIELD_OFFSET(struct create_event_request, manual_reset) == 16 );
 C_ASSERT( FIELD_OFFSET(struct create_event_request, initial_state) == 20 );
 C_ASSERT( sizeof(struct create_event_request) == 24 );
 C_ASSERT( FIELD_OFFSET(struct create_event_reply, handle) == 8 );
-C_ASSERT( sizeof(struct create_event_reply) == 16 );
+C_ASSERT( FIELD_OFFSET(struct create_event_reply, access) == 12 );
+C_ASSERT( FIELD_OFFSET(struct create_event_reply, fast_sync) == 16 );
+C_ASSERT( sizeof(struct create_event_reply) == 24 );
 C_ASSERT( FIELD_OFFSET(struct event_op_request, handle) == 12 );
 C_ASSERT( FIELD_OFFSET(struct event_op_request, op) == 16 );
 C_ASSERT( sizeof(struct event_op_request) == 24 );
@@ -928,7 +947,9 @@ C_ASSERT( FIELD_OFFSET(struct open_event_request, attributes) == 16 );
 C_ASSERT( FIELD_OFFSET(struct open_event_request, rootdir) == 20 );
 C_ASSERT( sizeof(struct open_event_request) == 24 );
 C_ASSERT( FIELD_OFFSET(struct open_event_reply, handle) == 8 );
-C_ASSERT( sizeof(struct open_event_reply) == 16 );
+C_ASSERT( FIELD_OFFSET(struct open_event_reply, access) == 12 );
+C_ASSERT( FIELD_OFFSET(struct open_event_reply, fast_sync) == 16 );
+C_ASSERT( sizeof(struct open_event_reply) == 24 );
 C_ASSERT( FIELD_OFFSET(struct create_keyed_event_request, access) == 12 );
 C_ASSERT( sizeof(struct create_keyed_event_request) == 16 );
 C_ASSERT( FIELD_OFFSET(struct create_keyed_event_reply, handle) == 8 );
@@ -943,7 +964,9 @@ C_ASSERT( FIELD_OFFSET(struct create_mutex_request, access) == 12 );
 C_ASSERT( FIELD_OFFSET(struct create_mutex_request, owned) == 16 );
 C_ASSERT( sizeof(struct create_mutex_request) == 24 );
 C_ASSERT( FIELD_OFFSET(struct create_mutex_reply, handle) == 8 );
-C_ASSERT( sizeof(struct create_mutex_reply) == 16 );
+C_ASSERT( FIELD_OFFSET(struct create_mutex_reply, access) == 12 );
+C_ASSERT( FIELD_OFFSET(struct create_mutex_reply, fast_sync) == 16 );
+C_ASSERT( sizeof(struct create_mutex_reply) == 24 );
 C_ASSERT( FIELD_OFFSET(struct release_mutex_request, handle) == 12 );
 C_ASSERT( sizeof(struct release_mutex_request) == 16 );
 C_ASSERT( FIELD_OFFSET(struct release_mutex_reply, prev_count) == 8 );
@@ -953,7 +976,9 @@ C_ASSERT( FIELD_OFFSET(struct open_mutex_request, attributes) == 16 );
 C_ASSERT( FIELD_OFFSET(struct open_mutex_request, rootdir) == 20 );
 C_ASSERT( sizeof(struct open_mutex_request) == 24 );
 C_ASSERT( FIELD_OFFSET(struct open_mutex_reply, handle) == 8 );
-C_ASSERT( sizeof(struct open_mutex_reply) == 16 );
+C_ASSERT( FIELD_OFFSET(struct open_mutex_reply, access) == 12 );
+C_ASSERT( FIELD_OFFSET(struct open_mutex_reply, fast_sync) == 16 );
+C_ASSERT( sizeof(struct open_mutex_reply) == 24 );
 C_ASSERT( FIELD_OFFSET(struct query_mutex_request, handle) == 12 );
 C_ASSERT( sizeof(struct query_mutex_request) == 16 );
 C_ASSERT( FIELD_OFFSET(struct query_mutex_reply, count) == 8 );
@@ -965,7 +990,9 @@ C_ASSERT( FIELD_OFFSET(struct create_semaphore_request, initial) == 16 );
 C_ASSERT( FIELD_OFFSET(struct create_semaphore_request, max) == 20 );
 C_ASSERT( sizeof(struct create_semaphore_request) == 24 );
 C_ASSERT( FIELD_OFFSET(struct create_semaphore_reply, handle) == 8 );
-C_ASSERT( sizeof(struct create_semaphore_reply) == 16 );
+C_ASSERT( FIELD_OFFSET(struct create_semaphore_reply, access) == 12 );
+C_ASSERT( FIELD_OFFSET(struct create_semaphore_reply, fast_sync) == 16 );
+C_ASSERT( sizeof(struct create_semaphore_reply) == 24 );
 C_ASSERT( FIELD_OFFSET(struct release_semaphore_request, handle) == 12 );
 C_ASSERT( FIELD_OFFSET(struct release_semaphore_request, count) == 16 );
 C_ASSERT( sizeof(struct release_semaphore_request) == 24 );
@@ -981,7 +1008,12 @@ C_ASSERT( FIELD_OFFSET(struct open_semaphore_request, attributes) == 16 );
 C_ASSERT( FIELD_OFFSET(struct open_semaphore_request, rootdir) == 20 );
 C_ASSERT( sizeof(struct open_semaphore_request) == 24 );
 C_ASSERT( FIELD_OFFSET(struct open_semaphore_reply, handle) == 8 );
-C_ASSERT( sizeof(struct open_semaphore_reply) == 16 );
+C_ASSERT( FIELD_OFFSET(struct open_semaphore_reply, access) == 12 );
+C_ASSERT( FIELD_OFFSET(struct open_semaphore_reply, fast_sync) == 16 );
+C_ASSERT( sizeof(struct open_semaphore_reply) == 24 );
+C_ASSERT( sizeof(struct get_fast_sync_area_request) == 16 );
+C_ASSERT( FIELD_OFFSET(struct get_fast_sync_area_reply, size) == 8 );
+C_ASSERT( sizeof(struct get_fast_sync_area_reply) == 16 );
 C_ASSERT( FIELD_OFFSET(struct create_file_request, access) == 12 );
 C_ASSERT( FIELD_OFFSET(struct create_file_request, sharing) == 16 );
 C_ASSERT( FIELD_OFFSET(struct create_file_request, create) == 20 );
@@ -1049,18 +1081,24 @@ C_ASSERT( sizeof(struct unlock_file_request) == 32 );
 C_ASSERT( FIELD_OFFSET(struct recv_socket_request, oob) == 12 );
 C_ASSERT( FIELD_OFFSET(struct recv_socket_request, async) == 16 );
 C_ASSERT( FIELD_OFFSET(struct recv_socket_request, force_async) == 56 );
+C_ASSERT( FIELD_OFFSET(struct recv_socket_request, direct) == 60 );
 C_ASSERT( sizeof(struct recv_socket_request) == 64 );
 C_ASSERT( FIELD_OFFSET(struct recv_socket_reply, wait) == 8 );
 C_ASSERT( FIELD_OFFSET(struct recv_socket_reply, options) == 12 );
 C_ASSERT( FIELD_OFFSET(struct recv_socket_reply, nonblocking) == 16 );
-C_ASSERT( sizeof(struct recv_socket_reply) == 24 );
+C_ASSERT( FIELD_OFFSET(struct recv_socket_reply, direct) == 20 );
+C_ASSERT( FIELD_OFFSET(struct recv_socket_reply, comp_flags) == 24 );
+C_ASSERT( sizeof(struct recv_socket_reply) == 32 );
 C_ASSERT( FIELD_OFFSET(struct send_socket_request, async) == 16 );
 C_ASSERT( FIELD_OFFSET(struct send_socket_request, force_async) == 56 );
+C_ASSERT( FIELD_OFFSET(struct send_socket_request, direct) == 60 );
 C_ASSERT( sizeof(struct send_socket_request) == 64 );
 C_ASSERT( FIELD_OFFSET(struct send_socket_reply, wait) == 8 );
 C_ASSERT( FIELD_OFFSET(struct send_socket_reply, options) == 12 );
 C_ASSERT( FIELD_OFFSET(struct send_socket_reply, nonblocking) == 16 );
-C_ASSERT( sizeof(struct send_socket_reply) == 24 );
+C_ASSERT( FIELD_OFFSET(struct send_socket_reply, direct) == 20 );
+C_ASSERT( FIELD_OFFSET(struct send_socket_reply, comp_flags) == 24 );
+C_ASSERT( sizeof(struct send_socket_reply) == 32 );
 C_ASSERT( FIELD_OFFSET(struct socket_send_icmp_id_request, handle) == 12 );
 C_ASSERT( FIELD_OFFSET(struct socket_send_icmp_id_request, icmp_id) == 16 );
 C_ASSERT( FIELD_OFFSET(struct socket_send_icmp_id_request, icmp_seq) == 18 );
@@ -1498,6 +1536,10 @@ C_ASSERT( FIELD_OFFSET(struct get_window_info_reply, is_unicode) == 28 );
 C_ASSERT( FIELD_OFFSET(struct get_window_info_reply, dpi) == 32 );
 C_ASSERT( FIELD_OFFSET(struct get_window_info_reply, awareness) == 36 );
 C_ASSERT( sizeof(struct get_window_info_reply) == 40 );
+C_ASSERT( sizeof(struct get_window_shm_area_request) == 16 );
+C_ASSERT( FIELD_OFFSET(struct get_window_shm_area_reply, handle) == 8 );
+C_ASSERT( FIELD_OFFSET(struct get_window_shm_area_reply, count) == 12 );
+C_ASSERT( sizeof(struct get_window_shm_area_reply) == 16 );
 C_ASSERT( FIELD_OFFSET(struct set_window_info_request, flags) == 12 );
 C_ASSERT( FIELD_OFFSET(struct set_window_info_request, is_unicode) == 14 );
 C_ASSERT( FIELD_OFFSET(struct set_window_info_request, handle) == 16 );
@@ -2153,6 +2195,9 @@ C_ASSERT( FIELD_OFFSET(struct remove_completion_reply, cvalue) == 16 );
 C_ASSERT( FIELD_OFFSET(struct remove_completion_reply, information) == 24 );
 C_ASSERT( FIELD_OFFSET(struct remove_completion_reply, status) == 32 );
 C_ASSERT( sizeof(struct remove_completion_reply) == 40 );
+C_ASSERT( FIELD_OFFSET(struct remove_completions_request, handle) == 12 );
+C_ASSERT( sizeof(struct remove_completions_request) == 16 );
+C_ASSERT( sizeof(struct remove_completions_reply) == 8 );
 C_ASSERT( FIELD_OFFSET(struct query_completion_request, handle) == 12 );
 C_ASSERT( sizeof(struct query_completion_request) == 16 );
 C_ASSERT( FIELD_OFFSET(struct query_completion_reply, depth) == 8 );
@@ -2167,6 +2212,16 @@ C_ASSERT( FIELD_OFFSET(struct add_fd_completion_request, information) == 24 );
 C_ASSERT( FIELD_OFFSET(struct add_fd_completion_request, status) == 32 );
 C_ASSERT( FIELD_OFFSET(struct add_fd_completion_request, async) == 36 );
 C_ASSERT( sizeof(struct add_fd_completion_request) == 40 );
+C_ASSERT( FIELD_OFFSET(struct complete_fd_io_request, handle) == 12 );
+C_ASSERT( FIELD_OFFSET(struct complete_fd_io_request, event) == 16 );
+C_ASSERT( FIELD_OFFSET(struct complete_fd_io_request, cvalue) == 24 );
+C_ASSERT( FIELD_OFFSET(struct complete_fd_io_request, information) == 32 );
+C_ASSERT( FIELD_OFFSET(struct complete_fd_io_request, status) == 40 );
+C_ASSERT( sizeof(struct complete_fd_io_request) == 48 );
+C_ASSERT( FIELD_OFFSET(struct complete_fd_io_reply, id) == 8 );
+C_ASSERT( sizeof(struct complete_fd_io_reply) == 16 );
+C_ASSERT( FIELD_OFFSET(struct set_client_io_pipe_request, fd) == 12 );
+C_ASSERT( sizeof(struct set_client_io_pipe_request) == 16 );
 C_ASSERT( FIELD_OFFSET(struct set_fd_completion_mode_request, handle) == 12 );
 C_ASSERT( FIELD_OFFSET(struct set_fd_completion_mode_request, flags) == 16 );
 C_ASSERT( sizeof(struct set_fd_completion_mode_request) == 24 );
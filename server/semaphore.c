@@ -55,12 +55,15 @@ struct semaphore
     struct object  obj;    /* object header */
     unsigned int   count;  /* current count */
     unsigned int   max;    /* maximum possible count */
+    struct fast_sync_area *sync_area; /* area the state is published in, NULL if not published */
+    unsigned int   sync_idx;          /* index of the published state */
 };
 
 static void semaphore_dump( struct object *obj, int verbose );
 static int semaphore_signaled( struct object *obj, struct wait_queue_entry *entry );
 static void semaphore_satisfied( struct object *obj, struct wait_queue_entry *entry );
 static int semaphore_signal( struct object *obj, unsigned int access );
+static void semaphore_destroy( struct object *obj );
 
 static const struct object_ops semaphore_ops =
 {
@@ -83,10 +86,15 @@ static const struct object_ops semaphore_ops =
     no_open_file,                  /* open_file */
     no_kernel_obj_list,            /* get_kernel_obj_list */
     no_close_handle,               /* close_handle */
-    no_destroy                     /* destroy */
+    semaphore_destroy              /* destroy */
 };
 
 
+static void update_semaphore_sync( struct semaphore *sem )
+{
+    set_fast_sync( sem->sync_area, sem->sync_idx, sem->max, sem->count );
+}
+
 static struct semaphore *create_semaphore( struct object *root, const struct unicode_str *name,
                                            unsigned int attr, unsigned int initial, unsigned int max,
                                            const struct security_descriptor *sd )
@@ -105,6 +113,8 @@ static struct semaphore *create_semaphore( struct object *root, const struct uni
             /* initialize it if it didn't already exist */
             sem->count = initial;
             sem->max   = max;
+            sem->sync_idx = alloc_fast_sync( FAST_SYNC_SEMAPHORE, &sem->sync_area );
+            update_semaphore_sync( sem );
         }
     }
     return sem;
@@ -129,6 +139,7 @@ static int release_semaphore( struct semaphore *sem, unsigned int count,
         sem->count = count;
         wake_up( &sem->obj, count );
     }
+    update_semaphore_sync( sem );
     return 1;
 }
 
@@ -152,6 +163,7 @@ static void semaphore_satisfied( struct object *obj, struct wait_queue_entry *en
     assert( obj->ops == &semaphore_ops );
     assert( sem->count );
     sem->count--;
+    update_semaphore_sync( sem );
 }
 
 static int semaphore_signal( struct object *obj, unsigned int access )
@@ -167,6 +179,27 @@ static int semaphore_signal( struct object *obj, unsigned int access )
     return release_semaphore( sem, 1, NULL );
 }
 
+static void semaphore_destroy( struct object *obj )
+{
+    struct semaphore *sem = (struct semaphore *)obj;
+    assert( obj->ops == &semaphore_ops );
+    free_fast_sync( sem->sync_area, sem->sync_idx );
+}
+
+/* return the published state index for a new semaphore handle */
+static unsigned int get_semaphore_fast_sync( obj_handle_t handle, unsigned int *access )
+{
+    struct semaphore *sem;
+    unsigned int index;
+
+    if (!handle || !(sem = (struct semaphore *)get_handle_obj( current->process, handle, 0, &semaphore_ops )))
+        return 0;
+    *access = get_handle_access( current->process, handle );
+    index = get_fast_sync_index( sem->sync_area, sem->sync_idx );
+    release_object( sem );
+    return index;
+}
+
 /* create a semaphore */
 DECL_HANDLER(create_semaphore)
 {
@@ -185,6 +218,11 @@ DECL_HANDLER(create_semaphore)
         else
             reply->handle = alloc_handle_no_access_check( current->process, sem,
                                                           req->access, objattr->attributes );
+        if (reply->handle)
+        {
+            reply->access = get_handle_access( current->process, reply->handle );
+            reply->fast_sync = get_fast_sync_index( sem->sync_area, sem->sync_idx );
+        }
         release_object( sem );
     }
 
@@ -198,6 +236,7 @@ DECL_HANDLER(open_semaphore)
 
     reply->handle = open_object( current->process, req->rootdir, req->access,
                                  &semaphore_ops, &name, req->attributes );
+    reply->fast_sync = get_semaphore_fast_sync( reply->handle, &reply->access );
 }
 
 /* release a semaphore */
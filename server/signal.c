@@ -33,6 +33,7 @@
 #include "object.h"
 #include "process.h"
 #include "thread.h"
+#include "handle.h"
 #include "request.h"
 
 #if defined(linux) && defined(__SIGRTMIN)
@@ -176,6 +177,12 @@ static void sighup_callback(void)
 #ifdef DEBUG_OBJECTS
     dump_objects();
 #endif
+    if (server_stats)
+    {
+        dump_request_stats();
+        dump_handle_stats();
+        dump_completion_stats();
+    }
 }
 
 /* SIGTERM callback */
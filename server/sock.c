@@ -3447,6 +3447,26 @@ struct object *create_socket_device( struct object *root, const struct unicode_s
     return create_named_object( root, &socket_device_ops, name, attr, sd );
 }
 
+/* check whether the client may perform overlapped I/O on the socket on its own,
+ * because we don't need to track the socket state for anything else */
+static int sock_allows_direct_io( struct sock *sock )
+{
+    struct completion *completion;
+    apc_param_t key;
+
+    if (sock->type != WS_SOCK_STREAM || sock->state != SOCK_CONNECTED) return 0;
+    if (sock->mask || sock->nonblocking || sock->rd_shutdown || sock->wr_shutdown) return 0;
+    if (async_queued( &sock->read_q ) || async_queued( &sock->write_q ) || async_queued( &sock->poll_q ))
+        return 0;
+    if (!is_fd_overlapped( sock->fd )) return 0;
+    /* other handles, possibly in other processes, keep going through the server */
+    if (sock->obj.handle_count > 1) return 0;
+
+    if (!(completion = fd_get_completion( sock->fd, &key ))) return 0;
+    release_object( completion );
+    return 1;
+}
+
 DECL_HANDLER(recv_socket)
 {
     struct sock *sock = (struct sock *)get_handle_obj( current->process, req->async.handle, 0, &sock_ops );
@@ -3458,6 +3478,14 @@ DECL_HANDLER(recv_socket)
     if (!sock) return;
     fd = sock->fd;
 
+    if (req->direct && sock_allows_direct_io( sock ))
+    {
+        reply->direct = 1;
+        reply->comp_flags = get_fd_comp_flags( fd );
+        release_object( sock );
+        return;
+    }
+
     if (!req->force_async && !sock->nonblocking && is_fd_overlapped( fd ))
         timeout = (timeout_t)sock->rcvtimeo * -10000;
 
@@ -3543,6 +3571,14 @@ DECL_HANDLER(send_socket)
     if (!sock) return;
     fd = sock->fd;
 
+    if (req->direct && sock_allows_direct_io( sock ))
+    {
+        reply->direct = 1;
+        reply->comp_flags = get_fd_comp_flags( fd );
+        release_object( sock );
+        return;
+    }
+
     if (sock->type == WS_SOCK_DGRAM && !sock->bound)
     {
         union unix_sockaddr unix_addr;
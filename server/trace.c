@@ -976,6 +976,25 @@ static void dump_varargs_cursor_positions( const char *prefix, data_size_t size
     remove_data( size );
 }
 
+static void dump_varargs_completion_msgs( const char *prefix, data_size_t size )
+{
+    const completion_msg_t *msg = cur_data;
+    data_size_t len = size / sizeof(*msg);
+
+    fprintf( stderr, "%s{", prefix );
+    while (len > 0)
+    {
+        dump_uint64( "{ckey=", &msg->ckey );
+        dump_uint64( ",cvalue=", &msg->cvalue );
+        dump_uint64( ",information=", &msg->information );
+        fprintf( stderr, ",status=%08x}", msg->status );
+        msg++;
+        if (--len) fputc( ',', stderr );
+    }
+    fputc( '}', stderr );
+    remove_data( size );
+}
+
 static void dump_varargs_message_data( const char *prefix, data_size_t size )
 {
     /* FIXME: dump the structured data */
@@ -1645,6 +1664,16 @@ static void dump_close_handle_request( const struct close_handle_request *req )
     fprintf( stderr, " handle=%04x", req->handle );
 }
 
+static void dump_close_handles_request( const struct close_handles_request *req )
+{
+    dump_varargs_uints( " handles=", cur_size );
+}
+
+static void dump_close_handles_reply( const struct close_handles_reply *req )
+{
+    fprintf( stderr, " closed=%08x", req->closed );
+}
+
 static void dump_set_handle_info_request( const struct set_handle_info_request *req )
 {
     fprintf( stderr, " handle=%04x", req->handle );
@@ -1738,6 +1767,8 @@ static void dump_create_event_request( const struct create_event_request *req )
 static void dump_create_event_reply( const struct create_event_reply *req )
 {
     fprintf( stderr, " handle=%04x", req->handle );
+    fprintf( stderr, ", access=%08x", req->access );
+    fprintf( stderr, ", fast_sync=%08x", req->fast_sync );
 }
 
 static void dump_event_op_request( const struct event_op_request *req )
@@ -1773,6 +1804,8 @@ static void dump_open_event_request( const struct open_event_request *req )
 static void dump_open_event_reply( const struct open_event_reply *req )
 {
     fprintf( stderr, " handle=%04x", req->handle );
+    fprintf( stderr, ", access=%08x", req->access );
+    fprintf( stderr, ", fast_sync=%08x", req->fast_sync );
 }
 
 static void dump_create_keyed_event_request( const struct create_keyed_event_request *req )
@@ -1809,6 +1842,8 @@ static void dump_create_mutex_request( const struct create_mutex_request *req )
 static void dump_create_mutex_reply( const struct create_mutex_reply *req )
 {
     fprintf( stderr, " handle=%04x", req->handle );
+    fprintf( stderr, ", access=%08x", req->access );
+    fprintf( stderr, ", fast_sync=%08x", req->fast_sync );
 }
 
 static void dump_release_mutex_request( const struct release_mutex_request *req )
@@ -1832,6 +1867,8 @@ static void dump_open_mutex_request( const struct open_mutex_request *req )
 static void dump_open_mutex_reply( const struct open_mutex_reply *req )
 {
     fprintf( stderr, " handle=%04x", req->handle );
+    fprintf( stderr, ", access=%08x", req->access );
+    fprintf( stderr, ", fast_sync=%08x", req->fast_sync );
 }
 
 static void dump_query_mutex_request( const struct query_mutex_request *req )
@@ -1857,6 +1894,8 @@ static void dump_create_semaphore_request( const struct create_semaphore_request
 static void dump_create_semaphore_reply( const struct create_semaphore_reply *req )
 {
     fprintf( stderr, " handle=%04x", req->handle );
+    fprintf( stderr, ", access=%08x", req->access );
+    fprintf( stderr, ", fast_sync=%08x", req->fast_sync );
 }
 
 static void dump_release_semaphore_request( const struct release_semaphore_request *req )
@@ -1892,6 +1931,17 @@ static void dump_open_semaphore_request( const struct open_semaphore_request *re
 static void dump_open_semaphore_reply( const struct open_semaphore_reply *req )
 {
     fprintf( stderr, " handle=%04x", req->handle );
+    fprintf( stderr, ", access=%08x", req->access );
+    fprintf( stderr, ", fast_sync=%08x", req->fast_sync );
+}
+
+static void dump_get_fast_sync_area_request( const struct get_fast_sync_area_request *req )
+{
+}
+
+static void dump_get_fast_sync_area_reply( const struct get_fast_sync_area_reply *req )
+{
+    dump_uint64( " size=", &req->size );
 }
 
 static void dump_create_file_request( const struct create_file_request *req )
@@ -2033,6 +2083,7 @@ static void dump_recv_socket_request( const struct recv_socket_request *req )
     fprintf( stderr, " oob=%d", req->oob );
     dump_async_data( ", async=", &req->async );
     fprintf( stderr, ", force_async=%d", req->force_async );
+    fprintf( stderr, ", direct=%d", req->direct );
 }
 
 static void dump_recv_socket_reply( const struct recv_socket_reply *req )
@@ -2040,12 +2091,15 @@ static void dump_recv_socket_reply( const struct recv_socket_reply *req )
     fprintf( stderr, " wait=%04x", req->wait );
     fprintf( stderr, ", options=%08x", req->options );
     fprintf( stderr, ", nonblocking=%d", req->nonblocking );
+    fprintf( stderr, ", direct=%d", req->direct );
+    fprintf( stderr, ", comp_flags=%08x", req->comp_flags );
 }
 
 static void dump_send_socket_request( const struct send_socket_request *req )
 {
     dump_async_data( " async=", &req->async );
     fprintf( stderr, ", force_async=%d", req->force_async );
+    fprintf( stderr, ", direct=%d", req->direct );
 }
 
 static void dump_send_socket_reply( const struct send_socket_reply *req )
@@ -2053,6 +2107,8 @@ static void dump_send_socket_reply( const struct send_socket_reply *req )
     fprintf( stderr, " wait=%04x", req->wait );
     fprintf( stderr, ", options=%08x", req->options );
     fprintf( stderr, ", nonblocking=%d", req->nonblocking );
+    fprintf( stderr, ", direct=%d", req->direct );
+    fprintf( stderr, ", comp_flags=%08x", req->comp_flags );
 }
 
 static void dump_socket_send_icmp_id_request( const struct socket_send_icmp_id_request *req )
@@ -2936,6 +2992,16 @@ static void dump_get_window_info_reply( const struct get_window_info_reply *req
     fprintf( stderr, ", awareness=%d", req->awareness );
 }
 
+static void dump_get_window_shm_area_request( const struct get_window_shm_area_request *req )
+{
+}
+
+static void dump_get_window_shm_area_reply( const struct get_window_shm_area_reply *req )
+{
+    fprintf( stderr, " handle=%04x", req->handle );
+    fprintf( stderr, ", count=%08x", req->count );
+}
+
 static void dump_set_window_info_request( const struct set_window_info_request *req )
 {
     fprintf( stderr, " flags=%04x", req->flags );
@@ -4269,6 +4335,16 @@ static void dump_remove_completion_reply( const struct remove_completion_reply *
     fprintf( stderr, ", status=%08x", req->status );
 }
 
+static void dump_remove_completions_request( const struct remove_completions_request *req )
+{
+    fprintf( stderr, " handle=%04x", req->handle );
+}
+
+static void dump_remove_completions_reply( const struct remove_completions_reply *req )
+{
+    dump_varargs_completion_msgs( " msgs=", cur_size );
+}
+
 static void dump_query_completion_request( const struct query_completion_request *req )
 {
     fprintf( stderr, " handle=%04x", req->handle );
@@ -4295,6 +4371,25 @@ static void dump_add_fd_completion_request( const struct add_fd_completion_reque
     fprintf( stderr, ", async=%d", req->async );
 }
 
+static void dump_complete_fd_io_request( const struct complete_fd_io_request *req )
+{
+    fprintf( stderr, " handle=%04x", req->handle );
+    fprintf( stderr, ", event=%04x", req->event );
+    dump_uint64( ", cvalue=", &req->cvalue );
+    dump_uint64( ", information=", &req->information );
+    fprintf( stderr, ", status=%08x", req->status );
+}
+
+static void dump_complete_fd_io_reply( const struct complete_fd_io_reply *req )
+{
+    fprintf( stderr, " id=%08x", req->id );
+}
+
+static void dump_set_client_io_pipe_request( const struct set_client_io_pipe_request *req )
+{
+    fprintf( stderr, " fd=%d", req->fd );
+}
+
 static void dump_set_fd_completion_mode_request( const struct set_fd_completion_mode_request *req )
 {
     fprintf( stderr, " handle=%04x", req->handle );
@@ -4522,6 +4617,7 @@ static const dump_func req_dumpers[REQ_NB_REQUESTS] = {
     (dump_func)dump_queue_apc_request,
     (dump_func)dump_get_apc_result_request,
     (dump_func)dump_close_handle_request,
+    (dump_func)dump_close_handles_request,
     (dump_func)dump_set_handle_info_request,
     (dump_func)dump_dup_handle_request,
     (dump_func)dump_compare_objects_request,
@@ -4543,6 +4639,7 @@ static const dump_func req_dumpers[REQ_NB_REQUESTS] = {
     (dump_func)dump_release_semaphore_request,
     (dump_func)dump_query_semaphore_request,
     (dump_func)dump_open_semaphore_request,
+    (dump_func)dump_get_fast_sync_area_request,
     (dump_func)dump_create_file_request,
     (dump_func)dump_open_file_object_request,
     (dump_func)dump_alloc_file_handle_request,
@@ -4638,6 +4735,7 @@ static const dump_func req_dumpers[REQ_NB_REQUESTS] = {
     (dump_func)dump_get_desktop_window_request,
     (dump_func)dump_set_window_owner_request,
     (dump_func)dump_get_window_info_request,
+    (dump_func)dump_get_window_shm_area_request,
     (dump_func)dump_set_window_info_request,
     (dump_func)dump_set_parent_request,
     (dump_func)dump_get_window_parents_request,
@@ -4751,9 +4849,12 @@ static const dump_func req_dumpers[REQ_NB_REQUESTS] = {
     (dump_func)dump_open_completion_request,
     (dump_func)dump_add_completion_request,
     (dump_func)dump_remove_completion_request,
+    (dump_func)dump_remove_completions_request,
     (dump_func)dump_query_completion_request,
     (dump_func)dump_set_completion_info_request,
     (dump_func)dump_add_fd_completion_request,
+    (dump_func)dump_complete_fd_io_request,
+    (dump_func)dump_set_client_io_pipe_request,
     (dump_func)dump_set_fd_completion_mode_request,
     (dump_func)dump_set_fd_disp_info_request,
     (dump_func)dump_set_fd_name_info_request,
@@ -4802,6 +4903,7 @@ static const dump_func reply_dumpers[REQ_NB_REQUESTS] = {
     (dump_func)dump_queue_apc_reply,
     (dump_func)dump_get_apc_result_reply,
     NULL,
+    (dump_func)dump_close_handles_reply,
     (dump_func)dump_set_handle_info_reply,
     (dump_func)dump_dup_handle_reply,
     NULL,
@@ -4823,6 +4925,7 @@ static const dump_func reply_dumpers[REQ_NB_REQUESTS] = {
     (dump_func)dump_release_semaphore_reply,
     (dump_func)dump_query_semaphore_reply,
     (dump_func)dump_open_semaphore_reply,
+    (dump_func)dump_get_fast_sync_area_reply,
     (dump_func)dump_create_file_reply,
     (dump_func)dump_open_file_object_reply,
     (dump_func)dump_alloc_file_handle_reply,
@@ -4918,6 +5021,7 @@ static const dump_func reply_dumpers[REQ_NB_REQUESTS] = {
     (dump_func)dump_get_desktop_window_reply,
     (dump_func)dump_set_window_owner_reply,
     (dump_func)dump_get_window_info_reply,
+    (dump_func)dump_get_window_shm_area_reply,
     (dump_func)dump_set_window_info_reply,
     (dump_func)dump_set_parent_reply,
     (dump_func)dump_get_window_parents_reply,
@@ -5031,9 +5135,12 @@ static const dump_func reply_dumpers[REQ_NB_REQUESTS] = {
     (dump_func)dump_open_completion_reply,
     NULL,
     (dump_func)dump_remove_completion_reply,
+    (dump_func)dump_remove_completions_reply,
     (dump_func)dump_query_completion_reply,
     NULL,
     NULL,
+    (dump_func)dump_complete_fd_io_reply,
+    NULL,
     NULL,
     NULL,
     NULL,
@@ -5082,6 +5189,7 @@ static const char * const req_names[REQ_NB_REQUESTS] = {
     "queue_apc",
     "get_apc_result",
     "close_handle",
+    "close_handles",
     "set_handle_info",
     "dup_handle",
     "compare_objects",
@@ -5103,6 +5211,7 @@ static const char * const req_names[REQ_NB_REQUESTS] = {
     "release_semaphore",
     "query_semaphore",
     "open_semaphore",
+    "get_fast_sync_area",
     "create_file",
     "open_file_object",
     "alloc_file_handle",
@@ -5198,6 +5307,7 @@ static const char * const req_names[REQ_NB_REQUESTS] = {
     "get_desktop_window",
     "set_window_owner",
     "get_window_info",
+    "get_window_shm_area",
     "set_window_info",
     "set_parent",
     "get_window_parents",
@@ -5311,9 +5421,12 @@ static const char * const req_names[REQ_NB_REQUESTS] = {
     "open_completion",
     "add_completion",
     "remove_completion",
+    "remove_completions",
     "query_completion",
     "set_completion_info",
     "add_fd_completion",
+    "complete_fd_io",
+    "set_client_io_pipe",
     "set_fd_completion_mode",
     "set_fd_disp_info",
     "set_fd_name_info",
@@ -5571,3 +5684,9 @@ void trace_reply( enum request req, const union generic_reply *reply )
     else fprintf( stderr, "%04x: %d() = %s\n",
                   current->id, req, get_status_name(current->error) );
 }
+
+const char *get_req_name( enum request req )
+{
+    if (req < REQ_NB_REQUESTS) return req_names[req];
+    return "?";
+}
@@ -30,6 +30,8 @@
 #include "ntuser.h"
 
 #include "object.h"
+#include "file.h"
+#include "handle.h"
 #include "request.h"
 #include "thread.h"
 #include "process.h"
@@ -156,6 +158,67 @@ static struct window *taskman_window;
 #define WINPTR_TOPMOST   ((struct window *)3L)
 #define WINPTR_NOTOPMOST ((struct window *)4L)
 
+/* read-mostly window information shared with the clients, one entry per user handle */
+#define WINDOW_SHM_COUNT (((LAST_USER_HANDLE - FIRST_USER_HANDLE) >> 1) + 1)
+
+static struct object *window_shm_mapping;
+static volatile window_shm_t *window_shm;
+
+static int init_window_shm(void)
+{
+    static int failed;
+    unsigned int error;
+    void *ptr;
+
+    if (window_shm) return 1;
+    if (failed) return 0;
+
+    /* don't clobber the status of the request that triggered the update */
+    error = get_error();
+    if ((window_shm_mapping = create_shared_mapping( WINDOW_SHM_COUNT * sizeof(window_shm_t), &ptr )))
+        window_shm = ptr;
+    else
+        failed = 1;
+    set_error( error );
+    return !failed;
+}
+
+/* publish the current state of a window; clients retry their reads while seq is odd or changes */
+static void update_window_shm( struct window *win )
+{
+    volatile window_shm_t *shm;
+
+    if (!win->handle || !init_window_shm()) return;
+    shm = &window_shm[((win->handle & 0xffff) - FIRST_USER_HANDLE) >> 1];
+
+    __atomic_add_fetch( &shm->seq, 1, __ATOMIC_SEQ_CST );
+    shm->handle      = win->handle;
+    shm->pid         = win->thread ? get_process_id( win->thread->process ) : 0;
+    shm->tid         = win->thread ? get_thread_id( win->thread ) : 0;
+    shm->parent      = win->parent ? win->parent->handle : 0;
+    shm->owner       = win->owner;
+    shm->style       = win->style;
+    shm->ex_style    = win->ex_style;
+    shm->is_unicode  = win->is_unicode;
+    shm->dpi         = win->dpi;
+    shm->awareness   = win->dpi_awareness;
+    shm->window_rect = win->window_rect;
+    shm->client_rect = win->client_rect;
+    __atomic_add_fetch( &shm->seq, 1, __ATOMIC_SEQ_CST );
+}
+
+static void clear_window_shm( struct window *win )
+{
+    volatile window_shm_t *shm;
+
+    if (!win->handle || !window_shm) return;
+    shm = &window_shm[((win->handle & 0xffff) - FIRST_USER_HANDLE) >> 1];
+
+    __atomic_add_fetch( &shm->seq, 1, __ATOMIC_SEQ_CST );
+    shm->handle = 0;
+    __atomic_add_fetch( &shm->seq, 1, __ATOMIC_SEQ_CST );
+}
+
 static void window_dump( struct object *obj, int verbose )
 {
     struct window *win = (struct window *)obj;
@@ -306,6 +369,7 @@ static void link_window( struct window *win, struct window *previous )
     }
 
     win->is_linked = 1;
+    update_window_shm( win );
 }
 
 /* change the parent of a window (or unlink the window if the new parent is NULL) */
@@ -350,6 +414,7 @@ static int set_parent_window( struct window *win, struct window *parent )
         win->is_linked = 0;
         win->is_orphan = 1;
     }
+    update_window_shm( win );
     return 1;
 }
 
@@ -488,6 +553,7 @@ static void detach_window_thread( struct window *win )
     /* destroyed when the desktop ref count reaches zero */
     release_object( win->desktop );
     win->thread = NULL;
+    update_window_shm( win );
 }
 
 /* get the process owning the top window of a given desktop */
@@ -1780,6 +1846,7 @@ static void set_window_pos( struct window *win, struct window *previous,
     if (!(swp_flags & SWP_NOZORDER) && win->parent) link_window( win, previous );
     if (swp_flags & SWP_SHOWWINDOW) win->style |= WS_VISIBLE;
     else if (swp_flags & SWP_HIDEWINDOW) win->style &= ~WS_VISIBLE;
+    update_window_shm( win );
 
     /* keep children at the same position relative to top right corner when the parent is mirrored */
     if (win->ex_style & WS_EX_LAYOUTRTL)
@@ -1794,6 +1861,7 @@ static void set_window_pos( struct window *win, struct window *previous,
             offset_rect( &child->visible_rect, new_size - old_size, 0 );
             offset_rect( &child->surface_rect, new_size - old_size, 0 );
             offset_rect( &child->client_rect, new_size - old_size, 0 );
+            update_window_shm( child );
         }
     }
 
@@ -2011,6 +2079,7 @@ void free_window_handle( struct window *win )
     detach_window_thread( win );
 
     if (win->parent) set_parent_window( win, NULL );
+    clear_window_shm( win );
     free_user_handle( win->handle );
     win->handle = 0;
     release_object( win );
@@ -2066,6 +2135,7 @@ DECL_HANDLER(create_window)
     }
     win->style = req->style;
     win->ex_style = req->ex_style;
+    update_window_shm( win );
 
     reply->handle    = win->handle;
     reply->parent    = win->parent ? win->parent->handle : 0;
@@ -2133,6 +2203,7 @@ DECL_HANDLER(get_desktop_window)
         {
             detach_window_thread( desktop->top_window );
             desktop->top_window->style  = WS_POPUP | WS_VISIBLE | WS_CLIPSIBLINGS | WS_CLIPCHILDREN;
+            update_window_shm( desktop->top_window );
         }
     }
 
@@ -2145,6 +2216,7 @@ DECL_HANDLER(get_desktop_window)
         {
             detach_window_thread( desktop->msg_window );
             desktop->msg_window->style = WS_POPUP | WS_CLIPSIBLINGS | WS_CLIPCHILDREN;
+            update_window_shm( desktop->msg_window );
         }
     }
 
@@ -2180,6 +2252,7 @@ DECL_HANDLER(set_window_owner)
 
     reply->prev_owner = win->owner;
     reply->full_owner = win->owner = owner ? owner->handle : 0;
+    update_window_shm( win );
 }
 
 
@@ -2205,6 +2278,20 @@ DECL_HANDLER(get_window_info)
 }
 
 
+/* retrieve a mapping of the shared window information */
+DECL_HANDLER(get_window_shm_area)
+{
+    if (!init_window_shm())
+    {
+        set_error( STATUS_NO_MEMORY );
+        return;
+    }
+    reply->handle = alloc_handle_no_access_check( current->process, window_shm_mapping,
+                                                  SECTION_MAP_READ | SECTION_QUERY, 0 );
+    reply->count  = WINDOW_SHM_COUNT;
+}
+
+
 /* set some information in a window */
 DECL_HANDLER(set_window_info)
 {
@@ -2252,6 +2339,8 @@ DECL_HANDLER(set_window_info)
     if (req->flags & SET_WIN_EXTRA) memcpy( win->extra_bytes + req->extra_offset,
                                             &req->extra_value, req->extra_size );
 
+    if (req->flags & (SET_WIN_STYLE | SET_WIN_EXSTYLE | SET_WIN_UNICODE)) update_window_shm( win );
+
     /* changing window style triggers a non-client paint */
     if (req->flags & SET_WIN_STYLE) win->paint_flags |= PAINT_NONCLIENT;
 }